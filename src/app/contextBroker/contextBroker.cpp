@@ -67,6 +67,8 @@
 #include "mongoBackend/MongoGlobal.h"
 #include "mongoBackend/dbConstants.h"
 #include "cache/subCache.h"
+#include "cache/entityCache.h"
+#include "cache/typeCatalog.h"
 
 #include "parseArgs/parseArgs.h"
 #include "parseArgs/paConfig.h"
@@ -94,6 +96,7 @@
 #include "ngsi/ParseData.h"
 #include "ngsiNotify/onTimeIntervalThread.h"
 #include "ngsiNotify/QueueNotifier.h"
+#include "ngsiNotify/AsyncNotifier.h"
 #include "ngsiNotify/QueueWorkers.h"
 #include "ngsiNotify/senderThread.h"
 #include "serviceRoutines/logTraceTreat.h"
@@ -257,7 +260,11 @@ int             subCacheInterval;
 char            notificationMode[64];
 int             notificationQueueSize;
 int             notificationThreadNum;
+bool            notifQueueLockFree;
+bool            notifCoalesce;
 bool            noCache;
+unsigned int    entityCacheMem;
+int             typeCatalogIval;
 unsigned int    connectionMemory;
 unsigned int    maxConnections;
 unsigned int    reqPoolSize;
@@ -268,6 +275,7 @@ bool            statTiming;
 bool            statNotifQueue;
 int             lsPeriod;
 bool            relogAlarms;
+unsigned int    logAsyncSize;
 bool            strictIdv1;
 
 
@@ -304,12 +312,16 @@ bool            strictIdv1;
 #define HTTP_TMO_DESC          "timeout in milliseconds for forwards and notifications"
 #define DBPS_DESC              "database connection pool size"
 #define MAX_L                  900000
-#define MUTEX_POLICY_DESC      "mutex policy (none/read/write/all)"
+#define MUTEX_POLICY_DESC      "mutex policy (none/read/write/all/entity)"
 #define WRITE_CONCERN_DESC     "db write concern (0:unacknowledged, 1:acknowledged)"
 #define CPR_FORWARD_LIMIT_DESC "maximum number of forwarded requests to Context Providers for a single client request"
 #define SUB_CACHE_IVAL_DESC    "interval in seconds between calls to Subscription Cache refresh (0: no refresh)"
-#define NOTIFICATION_MODE_DESC "notification mode (persistent|transient|threadpool:q:n)"
+#define NOTIFICATION_MODE_DESC "notification mode (persistent|transient|threadpool:q:n|async:q:n)"
+#define NOTIF_QUEUE_LF_DESC    "use a lock-free queue in threadpool notification mode"
+#define NOTIF_COALESCE_DESC    "coalesce the notifications of an update request for the same subscription"
 #define NO_CACHE               "disable subscription cache for lookups"
+#define ENTITY_CACHE_SIZE_DESC "maximum memory size of the entity cache (in kilobytes, 0: no entity cache)"
+#define TYPE_CATALOG_IVAL_DESC "interval in seconds between reloads of the entity type catalog (0: no entity type catalog)"
 #define CONN_MEMORY_DESC       "maximum memory size per connection (in kilobytes)"
 #define MAX_CONN_DESC          "maximum number of simultaneous connections"
 #define REQ_POOL_SIZE          "size of thread pool for incoming connections"
@@ -320,6 +332,7 @@ bool            strictIdv1;
 #define STAT_NOTIF_QUEUE       "enable thread pool notifications queue statistics"
 #define LOG_SUMMARY_DESC       "log summary period in seconds (defaults to 0, meaning 'off')"
 #define RELOGALARMS_DESC       "log messages for existing alarms beyond the raising alarm log message itself"
+#define LOG_ASYNC_DESC         "size of the log buffer of each thread in kilobytes, for asynchronous logging (0: synchronous logging)"
 #define CHECK_v1_ID_DESC       "additional checks for id fields in the NGSIv1 API"
 
 
@@ -374,11 +387,15 @@ PaArgument paArgs[] =
   { "-cprForwardLimit",  &cprForwardLimit,  "CPR_FORWARD_LIMIT", PaUInt,   PaOpt, 1000,           0,     UINT_MAX, CPR_FORWARD_LIMIT_DESC },
   { "-subCacheIval",     &subCacheInterval, "SUBCACHE_IVAL",     PaInt,    PaOpt, 60,             0,     3600,     SUB_CACHE_IVAL_DESC    },
   { "-noCache",          &noCache,          "NOCACHE",           PaBool,   PaOpt, false,          false, true,     NO_CACHE               },
+  { "-entityCacheSize",  &entityCacheMem,   "ENTITY_CACHE_SIZE", PaUInt,   PaOpt, 0,              0,     4194304,  ENTITY_CACHE_SIZE_DESC },
+  { "-typeCatalogIval",  &typeCatalogIval,  "TYPE_CATALOG_IVAL", PaInt,    PaOpt, 0,              0,     86400,    TYPE_CATALOG_IVAL_DESC },
   { "-connectionMemory", &connectionMemory, "CONN_MEMORY",       PaUInt,   PaOpt, 64,             0,     1024,     CONN_MEMORY_DESC       },  
   { "-maxConnections",   &maxConnections,   "MAX_CONN",          PaUInt,   PaOpt, FD_SETSIZE - 4, 0,     FD_SETSIZE - 4, MAX_CONN_DESC    },
   { "-reqPoolSize",      &reqPoolSize,      "TRQ_POOL_SIZE",     PaUInt,   PaOpt, 0,              0,     1024,     REQ_POOL_SIZE          },
 
   { "-notificationMode",      &notificationMode,      "NOTIF_MODE", PaString, PaOpt, _i "transient", PaNL,  PaNL, NOTIFICATION_MODE_DESC },
+  { "-notifQueueLockFree",    &notifQueueLockFree,    "NOTIF_Q_LF", PaBool,   PaOpt, false,          false, true, NOTIF_QUEUE_LF_DESC    },
+  { "-notifCoalesce",         &notifCoalesce,         "NOTIF_COAL", PaBool,   PaOpt, false,          false, true, NOTIF_COALESCE_DESC    },
   { "-simulatedNotification", &simulatedNotification, "DROP_NOTIF", PaBool,   PaOpt, false,          false, true, SIMULATED_NOTIF_DESC   },
 
   { "-statCounters",   &statCounters,   "STAT_COUNTERS",    PaBool, PaOpt, false, false, true, STAT_COUNTERS     },
@@ -388,6 +405,7 @@ PaArgument paArgs[] =
 
   { "-logSummary",     &lsPeriod,       "LOG_SUMMARY_PERIOD", PaInt,PaOpt,   0,     0,     ONE_MONTH_PERIOD, LOG_SUMMARY_DESC },
   { "-relogAlarms",    &relogAlarms,    "RELOG_ALARMS",       PaBool, PaOpt, false, false, true,             RELOGALARMS_DESC },
+  { "-logAsync",       &logAsyncSize,   "LOG_ASYNC",          PaUInt, PaOpt, 0,     0,     65536,            LOG_ASYNC_DESC   },
 
   { "-strictNgsiv1Ids",  &strictIdv1, "CHECK_ID_V1",  PaBool, PaOpt, false, false, true, CHECK_v1_ID_DESC  },
 
@@ -1309,6 +1327,8 @@ void exitFunc(void)
   {
     LM_T(LmtSoftError, ("error removing PID file '%s': %s", pidPath, strerror(errno)));
   }
+
+  lmAsyncFlush();
 }
 
 
@@ -1341,7 +1361,7 @@ static void contextBrokerInit(std::string dbPrefix, bool multitenant)
   /* If we use a queue for notifications, start worker threads */
   if (strcmp(notificationMode, "threadpool") == 0)
   {
-    QueueNotifier*  pQNotifier = new QueueNotifier(notificationQueueSize, notificationThreadNum);
+    QueueNotifier*  pQNotifier = new QueueNotifier(notificationQueueSize, notificationThreadNum, notifQueueLockFree);
     int rc = pQNotifier->start();
     if (rc != 0)
     {
@@ -1349,6 +1369,16 @@ static void contextBrokerInit(std::string dbPrefix, bool multitenant)
     }
     pNotifier = pQNotifier;
   }
+  else if (strcmp(notificationMode, "async") == 0)
+  {
+    AsyncNotifier*  pANotifier = new AsyncNotifier(notificationQueueSize, notificationThreadNum);
+    int rc = pANotifier->start();
+    if (rc != 0)
+    {
+      LM_X(1,("Runtime Error starting notification event loops (%d)", rc));
+    }
+    pNotifier = pANotifier;
+  }
   else
   {
     pNotifier = new Notifier();
@@ -1546,6 +1576,10 @@ static SemOpType policyGet(std::string mutexPolicy)
   {
     return SemNoneOp;
   }
+  else if (mutexPolicy == "entity")
+  {
+    return SemEntityOp;
+  }
 
   //
   // Default is to protect both reads and writes
@@ -1571,7 +1605,7 @@ static void notificationModeParse(char *notifModeArg, int *pQueueSize, int *pNum
   {
     LM_X(1, ("Fatal Error parsing notification mode: sscanf (%s)", strerror(errno)));
   }
-  if (flds_num == 3 && strcmp(mode, "threadpool") == 0)
+  if (flds_num == 3 && (strcmp(mode, "threadpool") == 0 || strcmp(mode, "async") == 0))
   {
     if (*pQueueSize <= 0)
     {
@@ -1587,6 +1621,11 @@ static void notificationModeParse(char *notifModeArg, int *pQueueSize, int *pNum
     *pQueueSize = DEFAULT_NOTIF_QS;
     *pNumThreads = DEFAULT_NOTIF_TN;
   }
+  else if (flds_num == 1 && strcmp(mode, "async") == 0)
+  {
+    *pQueueSize = DEFAULT_ASYNC_NOTIF_QS;
+    *pNumThreads = DEFAULT_ASYNC_NOTIF_TN;
+  }
   else if (!(
              flds_num == 1 &&
              (strcmp(mode, "transient") == 0 || strcmp(mode, "persistent") == 0)
@@ -1732,6 +1771,15 @@ int main(int argC, char* argV[])
     daemonize();
   }
 
+  // The log writer thread is started once daemonized (threads don't survive the fork)
+  if (logAsyncSize != 0)
+  {
+    if (lmAsyncStart(logAsyncSize * 1024) != LmsOk)
+    {
+      LM_X(1, ("Fatal Error (error starting asynchronous logging)"));
+    }
+  }
+
 #if 0
   //
   // This 'almost always outdeffed' piece of code is used whenever a change is done to the
@@ -1796,6 +1844,19 @@ int main(int argC, char* argV[])
     LM_T(LmtSubCache, ("noCache == false"));
   }
 
+  if (entityCacheMem != 0)
+  {
+    // The entity cache is emptied as often as the subscription cache is refreshed (other brokers may write the DB)
+    entityCacheInit(entityCacheMem * 1024UL);
+    entityCacheStart(subCacheInterval);
+  }
+
+  if (typeCatalogIval != 0)
+  {
+    typeCatalogInit();
+    typeCatalogStart(typeCatalogIval);
+  }
+
   if (https)
   {
     char* httpsPrivateServerKey = (char*) malloc(2048);
@@ -0,0 +1,420 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <pthread.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "cache/entityCache.h"
+
+using namespace mongo;
+
+
+
+/* ****************************************************************************
+*
+* ENTITY_CACHE_VERSION_SLOTS - number of versions of entities (entities are hashed to them)
+*/
+#define ENTITY_CACHE_VERSION_SLOTS  1024
+
+
+
+/* ****************************************************************************
+*
+* ENTITY_CACHE_ENTRY_OVERHEAD - memory of an entry in the cache, besides key and documents
+*/
+#define ENTITY_CACHE_ENTRY_OVERHEAD  128
+
+
+
+/* ****************************************************************************
+*
+* CachedResult - 
+*/
+typedef struct CachedResult
+{
+  std::vector<BSONObj>              docs;
+  long long                         count;
+  unsigned long                     size;
+  std::list<std::string>::iterator  lruIter;
+} CachedResult;
+
+
+
+/* ****************************************************************************
+*
+* EntityCache - 
+*
+* Results are kept in a map by key "tenant\0id\0query", so that all the results of an
+* entity are together (and can be invalidated by prefix). The LRU list has the keys,
+* most recently used first.
+*/
+typedef struct EntityCache
+{
+  std::map<std::string, CachedResult>  results;
+  std::list<std::string>               lru;
+  unsigned long                        size;
+  unsigned long                        maxSize;
+  unsigned int                         versionV[ENTITY_CACHE_VERSION_SLOTS];
+} EntityCache;
+
+static EntityCache      cache;
+static pthread_mutex_t  cacheMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+/* ****************************************************************************
+*
+* entityKey - prefix of the keys of all the results of an entity
+*/
+static std::string entityKey(const std::string& tenant, const std::string& id)
+{
+  std::string key;
+
+  key.reserve(tenant.size() + id.size() + 2);
+  key += tenant;
+  key += '\0';
+  key += id;
+  key += '\0';
+
+  return key;
+}
+
+
+
+/* ****************************************************************************
+*
+* versionSlot - 
+*/
+static unsigned int versionSlot(const std::string& key)
+{
+  unsigned int h = 5381;
+
+  for (unsigned int ix = 0; ix < key.size(); ++ix)
+  {
+    h = h * 33 + (unsigned char) key[ix];
+  }
+
+  return h % ENTITY_CACHE_VERSION_SLOTS;
+}
+
+
+
+/* ****************************************************************************
+*
+* resultRemove - remove a result from the cache (mutex taken)
+*/
+static void resultRemove(std::map<std::string, CachedResult>::iterator it)
+{
+  cache.size -= it->second.size;
+  cache.lru.erase(it->second.lruIter);
+  cache.results.erase(it);
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheInit - 
+*/
+void entityCacheInit(unsigned long maxSize)
+{
+  pthread_mutex_lock(&cacheMutex);
+  cache.maxSize = maxSize;
+  pthread_mutex_unlock(&cacheMutex);
+
+  entityCacheClear();
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheRefresherThread - 
+*/
+static void* entityCacheRefresherThread(void* vP)
+{
+  int interval = *((int*) vP);
+
+  delete (int*) vP;
+
+  while (1)
+  {
+    sleep(interval);
+
+    LM_T(LmtEntityCache, ("emptying the entity cache (%lu bytes)", entityCacheSize()));
+    entityCacheClear();
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheStart - 
+*/
+void entityCacheStart(int interval)
+{
+  pthread_t  tid;
+  int        ret;
+
+  if ((interval <= 0) || !entityCacheEnabled())
+  {
+    return;
+  }
+
+  ret = pthread_create(&tid, NULL, entityCacheRefresherThread, new int(interval));
+
+  if (ret != 0)
+  {
+    LM_E(("Runtime Error (error creating thread: %d)", ret));
+    return;
+  }
+  pthread_detach(tid);
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheEnabled - 
+*/
+bool entityCacheEnabled(void)
+{
+  return cache.maxSize != 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheVersion - 
+*/
+unsigned int entityCacheVersion(const std::string& tenant, const std::string& id)
+{
+  unsigned int  slot = versionSlot(entityKey(tenant, id));
+  unsigned int  version;
+
+  pthread_mutex_lock(&cacheMutex);
+  version = cache.versionV[slot];
+  pthread_mutex_unlock(&cacheMutex);
+
+  return version;
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheLookup - 
+*/
+bool entityCacheLookup
+(
+  const std::string&     tenant,
+  const std::string&     id,
+  const std::string&     query,
+  std::vector<BSONObj>*  docsP,
+  long long*             countP
+)
+{
+  if (!entityCacheEnabled())
+  {
+    return false;
+  }
+
+  std::string key = entityKey(tenant, id) + query;
+
+  pthread_mutex_lock(&cacheMutex);
+
+  std::map<std::string, CachedResult>::iterator it = cache.results.find(key);
+
+  if ((it == cache.results.end()) || ((countP != NULL) && (it->second.count == -1)))
+  {
+    pthread_mutex_unlock(&cacheMutex);
+    return false;
+  }
+
+  *docsP = it->second.docs;
+  if (countP != NULL)
+  {
+    *countP = it->second.count;
+  }
+
+  cache.lru.splice(cache.lru.begin(), cache.lru, it->second.lruIter);
+
+  pthread_mutex_unlock(&cacheMutex);
+
+  LM_T(LmtEntityCache, ("entity '%s' (tenant '%s'): %d documents found in cache", id.c_str(), tenant.c_str(), (int) docsP->size()));
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheInsert - 
+*/
+void entityCacheInsert
+(
+  const std::string&           tenant,
+  const std::string&           id,
+  const std::string&           query,
+  const std::vector<BSONObj>&  docs,
+  long long                    count,
+  unsigned int                 version
+)
+{
+  if (!entityCacheEnabled())
+  {
+    return;
+  }
+
+  std::string   prefix = entityKey(tenant, id);
+  std::string   key    = prefix + query;
+  unsigned int  slot   = versionSlot(prefix);
+  CachedResult  result;
+
+  result.count = count;
+  result.size  = key.size() + ENTITY_CACHE_ENTRY_OVERHEAD;
+
+  result.docs.reserve(docs.size());
+  for (unsigned int ix = 0; ix < docs.size(); ++ix)
+  {
+    result.docs.push_back(docs[ix].getOwned());
+    result.size += docs[ix].objsize();
+  }
+
+  if (result.size > cache.maxSize / 4)
+  {
+    // A single result is not allowed to take a big part of the cache
+    return;
+  }
+
+  pthread_mutex_lock(&cacheMutex);
+
+  if (cache.versionV[slot] != version)
+  {
+    // The entity (or another one in the same slot) has been written meanwhile
+    pthread_mutex_unlock(&cacheMutex);
+    return;
+  }
+
+  std::map<std::string, CachedResult>::iterator it = cache.results.find(key);
+
+  if (it != cache.results.end())
+  {
+    resultRemove(it);
+  }
+
+  while ((cache.size + result.size > cache.maxSize) && (cache.lru.size() != 0))
+  {
+    resultRemove(cache.results.find(cache.lru.back()));
+  }
+
+  cache.lru.push_front(key);
+  result.lruIter = cache.lru.begin();
+
+  cache.results[key] = result;
+  cache.size        += result.size;
+
+  pthread_mutex_unlock(&cacheMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheInvalidate - 
+*/
+void entityCacheInvalidate(const std::string& tenant, const std::string& id)
+{
+  if (!entityCacheEnabled())
+  {
+    return;
+  }
+
+  std::string   prefix = entityKey(tenant, id);
+  unsigned int  slot   = versionSlot(prefix);
+
+  pthread_mutex_lock(&cacheMutex);
+
+  ++cache.versionV[slot];
+
+  std::map<std::string, CachedResult>::iterator it = cache.results.lower_bound(prefix);
+
+  while ((it != cache.results.end()) && (it->first.compare(0, prefix.size(), prefix) == 0))
+  {
+    resultRemove(it++);
+  }
+
+  pthread_mutex_unlock(&cacheMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheClear - 
+*/
+void entityCacheClear(void)
+{
+  pthread_mutex_lock(&cacheMutex);
+
+  for (unsigned int ix = 0; ix < ENTITY_CACHE_VERSION_SLOTS; ++ix)
+  {
+    ++cache.versionV[ix];
+  }
+
+  cache.results.clear();
+  cache.lru.clear();
+  cache.size = 0;
+
+  pthread_mutex_unlock(&cacheMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* entityCacheSize - 
+*/
+unsigned long entityCacheSize(void)
+{
+  unsigned long size;
+
+  pthread_mutex_lock(&cacheMutex);
+  size = cache.size;
+  pthread_mutex_unlock(&cacheMutex);
+
+  return size;
+}
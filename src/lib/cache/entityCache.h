@@ -0,0 +1,147 @@
+#ifndef SRC_LIB_CACHE_ENTITYCACHE_H_
+#define SRC_LIB_CACHE_ENTITYCACHE_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "mongo/client/dbclient.h"
+
+
+
+/* ****************************************************************************
+*
+* Entity cache -
+*
+* Keeps the result of the database queries on the entities collection that target a
+* single entity id (i.e. no id patterns), so that repeated reads of the same entities
+* don't go to the database.
+*
+* A cached result is identified by tenant, entity id and the query itself (as a string,
+* including anything else that makes a difference, e.g. offset and limit). All the
+* cached results of an entity are dropped whenever the entity is written (created,
+* updated or removed) by this broker. As other brokers may write the same database,
+* the whole cache is also dropped periodically (see entityCacheStart).
+*
+* To avoid caching a document read before a concurrent write (and its invalidation),
+* the version of the entity is taken before querying the database and passed to
+* entityCacheInsert, that does nothing if the entity has been invalidated meanwhile.
+*
+* The cache is bounded in memory, the least recently used results are dropped first.
+*/
+
+
+
+/* ****************************************************************************
+*
+* entityCacheInit - set the maximum size of the cache (in bytes, 0: cache disabled)
+*/
+extern void entityCacheInit(unsigned long maxSize);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheStart - start a thread that empties the cache every 'interval' seconds
+*/
+extern void entityCacheStart(int interval);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheEnabled -
+*/
+extern bool entityCacheEnabled(void);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheVersion - to be passed to entityCacheInsert
+*/
+extern unsigned int entityCacheVersion(const std::string& tenant, const std::string& id);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheLookup -
+*
+* Returns false if the result of the query is not in the cache. Otherwise, the documents
+* are returned in *docsP and, if countP is not NULL, the total count of matching entities
+* in *countP (a result cached without count is not used if the count is needed).
+*/
+extern bool entityCacheLookup
+(
+  const std::string&            tenant,
+  const std::string&            id,
+  const std::string&            query,
+  std::vector<mongo::BSONObj>*  docsP,
+  long long*                    countP = NULL
+);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheInsert - cache the result of a query ('count' is -1 if unknown)
+*/
+extern void entityCacheInsert
+(
+  const std::string&                  tenant,
+  const std::string&                  id,
+  const std::string&                  query,
+  const std::vector<mongo::BSONObj>&  docs,
+  long long                           count,
+  unsigned int                        version
+);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheInvalidate - drop all the cached results of an entity
+*/
+extern void entityCacheInvalidate(const std::string& tenant, const std::string& id);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheClear - drop all the cached results
+*/
+extern void entityCacheClear(void);
+
+
+
+/* ****************************************************************************
+*
+* entityCacheSize - memory used by the cache (in bytes, approximately)
+*/
+extern unsigned long entityCacheSize(void);
+
+#endif  // SRC_LIB_CACHE_ENTITYCACHE_H_
@@ -0,0 +1,304 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "cache/geoIndex.h"
+
+
+
+/* ****************************************************************************
+*
+* GEO_INDEX_NODE_SIZE - maximum number of children of a node of the tree
+*/
+#define GEO_INDEX_NODE_SIZE  16
+
+
+
+/* ****************************************************************************
+*
+* boxExtend - 
+*/
+static void boxExtend(GeoIndexBox* boxP, const GeoIndexBox& box)
+{
+  boxP->minLat = (box.minLat < boxP->minLat)? box.minLat : boxP->minLat;
+  boxP->maxLat = (box.maxLat > boxP->maxLat)? box.maxLat : boxP->maxLat;
+  boxP->minLon = (box.minLon < boxP->minLon)? box.minLon : boxP->minLon;
+  boxP->maxLon = (box.maxLon > boxP->maxLon)? box.maxLon : boxP->maxLon;
+}
+
+
+
+/* ****************************************************************************
+*
+* boxContains - 
+*/
+static inline bool boxContains(const GeoIndexBox& box, double lat, double lon)
+{
+  return (lat >= box.minLat) && (lat <= box.maxLat) && (lon >= box.minLon) && (lon <= box.maxLon);
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoIndex::GeoIndex - 
+*/
+GeoIndex::GeoIndex(): isDirty(false)
+{
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoIndex::lonLess - 
+*/
+bool GeoIndex::lonLess(const Entry& e1, const Entry& e2)
+{
+  return (e1.box.minLon + e1.box.maxLon) < (e2.box.minLon + e2.box.maxLon);
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoIndex::latLess - 
+*/
+bool GeoIndex::latLess(const Entry& e1, const Entry& e2)
+{
+  return (e1.box.minLat + e1.box.maxLat) < (e2.box.minLat + e2.box.maxLat);
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoIndex::add - 
+*/
+void GeoIndex::add(CachedSubscription* cSubP, const GeoIndexBox& box)
+{
+  Entry entry;
+
+  entry.box   = box;
+  entry.cSubP = cSubP;
+
+  entries.push_back(entry);
+  isDirty = true;
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoIndex::remove - 
+*/
+void GeoIndex::remove(CachedSubscription* cSubP)
+{
+  for (unsigned int ix = 0; ix < entries.size(); ++ix)
+  {
+    if (entries[ix].cSubP == cSubP)
+    {
+      entries[ix] = entries.back();
+      entries.pop_back();
+      isDirty = true;
+      return;
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoIndex::build - 
+*
+* Sort-Tile-Recursive packing:
+*   1. the entries are sorted by longitude and cut into S vertical slices of S leaves each
+*      (S being the square root of the number of leaves)
+*   2. the entries of each slice are sorted by latitude and packed into the leaves
+*   3. the upper levels are built packing consecutive nodes of the level below, which are
+*      already close to each other after 1 and 2
+*/
+void GeoIndex::build(void)
+{
+  levels.clear();
+  isDirty = false;
+
+  if (entries.size() == 0)
+  {
+    return;
+  }
+
+  unsigned int leaves      = (entries.size() + GEO_INDEX_NODE_SIZE - 1) / GEO_INDEX_NODE_SIZE;
+  unsigned int slices      = (unsigned int) ceil(sqrt((double) leaves));
+  unsigned int sliceSize   = slices * GEO_INDEX_NODE_SIZE;
+
+  std::sort(entries.begin(), entries.end(), lonLess);
+
+  for (unsigned int start = 0; start < entries.size(); start += sliceSize)
+  {
+    unsigned int end = (start + sliceSize < entries.size())? start + sliceSize : entries.size();
+
+    std::sort(entries.begin() + start, entries.begin() + end, latLess);
+  }
+
+  //
+  // Leaves: consecutive entries, without crossing slices
+  //
+  levels.push_back(std::vector<Node>());
+
+  for (unsigned int start = 0; start < entries.size(); start += sliceSize)
+  {
+    unsigned int sliceEnd = (start + sliceSize < entries.size())? start + sliceSize : entries.size();
+
+    for (unsigned int first = start; first < sliceEnd; first += GEO_INDEX_NODE_SIZE)
+    {
+      Node node;
+
+      node.first = first;
+      node.count = (first + GEO_INDEX_NODE_SIZE < sliceEnd)? GEO_INDEX_NODE_SIZE : sliceEnd - first;
+      node.box   = entries[first].box;
+
+      for (unsigned int ix = first + 1; ix < first + node.count; ++ix)
+      {
+        boxExtend(&node.box, entries[ix].box);
+      }
+
+      levels[0].push_back(node);
+    }
+  }
+
+  //
+  // Upper levels, up to a single root node
+  //
+  while (levels.back().size() > 1)
+  {
+    const std::vector<Node>  below = levels.back();
+    std::vector<Node>        level;
+
+    for (unsigned int first = 0; first < below.size(); first += GEO_INDEX_NODE_SIZE)
+    {
+      Node node;
+
+      node.first = first;
+      node.count = (first + GEO_INDEX_NODE_SIZE < below.size())? GEO_INDEX_NODE_SIZE : below.size() - first;
+      node.box   = below[first].box;
+
+      for (unsigned int ix = first + 1; ix < first + node.count; ++ix)
+      {
+        boxExtend(&node.box, below[ix].box);
+      }
+
+      level.push_back(node);
+    }
+
+    levels.push_back(level);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoIndex::dirty - 
+*/
+bool GeoIndex::dirty(void) const
+{
+  return isDirty;
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoIndex::size - 
+*/
+unsigned int GeoIndex::size(void) const
+{
+  return entries.size();
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoIndex::queryNode - 
+*/
+void GeoIndex::queryNode
+(
+  unsigned int                        level,
+  unsigned int                        nodeIx,
+  double                              lat,
+  double                              lon,
+  std::vector<CachedSubscription*>*   resultP
+) const
+{
+  const Node& node = levels[level][nodeIx];
+
+  if (!boxContains(node.box, lat, lon))
+  {
+    return;
+  }
+
+  for (unsigned int ix = node.first; ix < node.first + node.count; ++ix)
+  {
+    if (level > 0)
+    {
+      queryNode(level - 1, ix, lat, lon, resultP);
+    }
+    else if (boxContains(entries[ix].box, lat, lon))
+    {
+      resultP->push_back(entries[ix].cSubP);
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoIndex::query - add to resultP the subscriptions whose box contains the point
+*/
+void GeoIndex::query(double lat, double lon, std::vector<CachedSubscription*>* resultP) const
+{
+  if (isDirty)
+  {
+    for (unsigned int ix = 0; ix < entries.size(); ++ix)
+    {
+      resultP->push_back(entries[ix].cSubP);
+    }
+
+    return;
+  }
+
+  if (levels.size() == 0)
+  {
+    return;
+  }
+
+  queryNode(levels.size() - 1, 0, lat, lon, resultP);
+}
@@ -0,0 +1,104 @@
+#ifndef SRC_LIB_CACHE_GEOINDEX_H_
+#define SRC_LIB_CACHE_GEOINDEX_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <vector>
+
+
+
+struct CachedSubscription;
+
+
+
+/* ****************************************************************************
+*
+* GeoIndexBox - a box in lat/lon coordinates
+*/
+typedef struct GeoIndexBox
+{
+  double  minLat;
+  double  maxLat;
+  double  minLon;
+  double  maxLon;
+} GeoIndexBox;
+
+
+
+/* ****************************************************************************
+*
+* GeoIndex - R-tree over the areas (bounding boxes) of the subscriptions with a geo filter
+*
+* The tree is packed (built bottom-up from all the entries at once, using the Sort-Tile-Recursive
+* algorithm), which gives full nodes and little overlap between them, and is rebuilt when
+* the entries change: add() and remove() only modify the entries and mark the tree as dirty,
+* and build() must be called before the tree is used again by query().
+*
+* The subscription cache modifies its indexes in batches and only readers use query(), so the
+* tree is rebuilt once per batch of modifications (see subCachePublish).
+*
+* A query on a dirty tree returns all the entries, which is slow but still correct, as the
+* caller checks every returned entry anyway.
+*/
+class GeoIndex
+{
+ public:
+  GeoIndex();
+
+  void          add(CachedSubscription* cSubP, const GeoIndexBox& box);
+  void          remove(CachedSubscription* cSubP);
+  void          build(void);
+  bool          dirty(void) const;
+  unsigned int  size(void) const;
+  void          query(double lat, double lon, std::vector<CachedSubscription*>* resultP) const;
+
+ private:
+  typedef struct Entry
+  {
+    GeoIndexBox          box;
+    CachedSubscription*  cSubP;
+  } Entry;
+
+  //
+  // Node - the children of a node are the nodes [first, first + count) of the level below,
+  //        or the entries [first, first + count) if the node is a leaf (level 0)
+  //
+  typedef struct Node
+  {
+    GeoIndexBox   box;
+    unsigned int  first;
+    unsigned int  count;
+  } Node;
+
+  std::vector<Entry>              entries;
+  std::vector<std::vector<Node> > levels;
+  bool                            isDirty;
+
+  static bool  lonLess(const Entry& e1, const Entry& e2);
+  static bool  latLess(const Entry& e1, const Entry& e2);
+  void         queryNode(unsigned int level, unsigned int nodeIx, double lat, double lon, std::vector<CachedSubscription*>* resultP) const;
+};
+
+#endif  // SRC_LIB_CACHE_GEOINDEX_H_
@@ -23,16 +23,23 @@
 * Author: Ken Zangelin
 */
 #include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
 #include <regex.h>
+#include <sched.h>
 
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
 #include "common/sem.h"
 #include "common/string.h"
+#include "common/globals.h"
 #include "mongoBackend/MongoGlobal.h"
 #include "mongoBackend/mongoSubCache.h"
 #include "ngsi10/SubscribeContextRequest.h"
 #include "cache/subCache.h"
+#include "cache/geoIndex.h"
 
 using std::map;
 
@@ -57,12 +64,21 @@ volatile SubCacheState subCacheState = ScsIdle;
 //   - mongoUpdateContextSubscription.cpp  (in function mongoUpdateContextSubscription)
 //   - contextBroker.cpp                   (to initialize and sybchronize)
 //
-// To manipulate the subscription cache, a semaphore is necessary, as various threads can be
-// reading/inserting/removing subs at the same time.
+// Readers of the subscription cache (subCacheMatch, subCacheItemLookup) don't take any lock.
+// The cache is kept in two instances: readers use one of them, which is never modified while
+// in use, and writers (subCacheItemInsert, subCacheItemRemove, subCacheRefresh and the
+// synchronization) modify the other one and then switch the readers to it atomically.
+// See subCachePublish for the details.
+//
+// To modify the subscription cache, a semaphore is necessary, as various threads can be
+// inserting/removing subs at the same time.
 // This semaphore is NOT optional, like the mongo request semaphore.
 //
 // Two functions have been added to common/sem.cpp|h for this: cacheSemTake/Give.
 //
+// The counters of the cached subscriptions (lastNotificationTime and count) are modified
+// using atomic operations, without any semaphore (see subCacheItemNotified).
+//
 
 
 /* ****************************************************************************
@@ -152,9 +168,6 @@ void EntityInfo::present(const std::string& prefix)
 */
 typedef struct SubCache
 {
-  CachedSubscription* head;
-  CachedSubscription* tail;
-
   // Statistics counters
   int                 noOfRefreshes;
   int                 noOfInserts;
@@ -168,11 +181,565 @@ typedef struct SubCache
 *
 * subCache - 
 */
-static SubCache  subCache       = { NULL, NULL, 0 };
+static SubCache  subCache       = { 0, 0, 0, 0 };
 bool             subCacheActive = false;
 
 
 
+/* ****************************************************************************
+*
+* subCacheLastSync - start time of the last refresh/sync, see subCacheSync
+*/
+static long long subCacheLastSync = 0;
+
+
+
+/* ****************************************************************************
+*
+* subCacheTombstones - subscriptions removed locally since the current sync started
+*
+* A sync may read a subscription from the database just before it is removed by this
+* broker (from the database and then from the cache). subCacheDeltaApply skips the
+* subscriptions in here, so that such a subscription is not brought back to the cache.
+* The set is emptied when a sync starts: the subscriptions removed before that are no
+* longer in the database when the sync reads it.
+*
+* Protected by the cache semaphore, as the rest of writes to the cache.
+*/
+static std::set<std::pair<std::string, std::string> > subCacheTombstones;  // (tenant, subscriptionId)
+
+
+
+/* ****************************************************************************
+*
+* SubCacheBucket - 
+*/
+typedef std::vector<CachedSubscription*>       SubCacheBucket;
+typedef std::map<std::string, SubCacheBucket>  SubCacheBucketMap;
+
+
+
+/* ****************************************************************************
+*
+* SubCacheIndex - per-tenant index over the cached subscriptions
+*
+* The fields:
+* -------------------------------------------------------------------------------
+* o byEntityId      non-patterned entity id -> subscriptions with an EntityInfo for that id
+* o byPatternType   entity type -> subscriptions with a patterned EntityInfo of that type
+*                   (subscriptions with patterned EntityInfos without type are under "")
+* o byAttribute     condValue -> subscriptions with that condValue in any of its notify conditions
+* o anyAttribute    subscriptions with a notify condition without condValues (ONANYCHANGE)
+* o geoBounded      R-tree over the areas of the subscriptions with a bounded geo filter
+*                   (see GeoFilter), that can only match entities located inside their area
+* o geoAny          subscriptions without a bounded geo filter
+* o bySubId         subscriptionId -> subscription
+*
+* bySubId is the owner of the subscriptions of the tenant, the buckets only hold pointers
+* to the subscriptions in bySubId of the same index.
+*
+* subCacheMatch uses byEntityId/byPatternType, byAttribute/anyAttribute or (if the location
+* of the entity is known) geoBounded/geoAny to get a set of candidates and then runs the
+* complete subMatch() only on those candidates.
+*/
+typedef struct SubCacheIndex
+{
+  SubCacheBucketMap                           byEntityId;
+  SubCacheBucketMap                           byPatternType;
+  SubCacheBucketMap                           byAttribute;
+  SubCacheBucket                              anyAttribute;
+  GeoIndex                                    geoBounded;
+  SubCacheBucket                              geoAny;
+  std::map<std::string, CachedSubscriptionP>  bySubId;
+} SubCacheIndex;
+
+
+
+/* ****************************************************************************
+*
+* SubCacheInstance - the indexes of all tenants (the default tenant is stored under the key "")
+*/
+typedef struct SubCacheInstance
+{
+  std::map<std::string, SubCacheIndex*>  indexV;
+} SubCacheInstance;
+
+
+
+/* ****************************************************************************
+*
+* SubCacheOp - a modification of the subscription cache
+*/
+typedef enum SubCacheOpType
+{
+  SubCacheOpInsert,
+  SubCacheOpRemove,
+  SubCacheOpClear
+} SubCacheOpType;
+
+typedef struct SubCacheOp
+{
+  SubCacheOpType       type;
+  CachedSubscriptionP  cSubP;
+} SubCacheOp;
+
+
+
+/* ****************************************************************************
+*
+* Left-right instances of the subscription cache - 
+*
+* The cache is kept in two instances. Readers use the instance given by subCacheReadIx,
+* which is never modified while they use it, and they never wait: they just register
+* themselves in one of the two reader counters (see subCacheReadBegin/End).
+*
+* A writer (that must hold the cache semaphore) modifies the other instance, keeping each
+* modification in subCacheOpLog, and then publishes the changes (subCachePublish): readers
+* are switched to the modified instance and, once the readers still using the old instance
+* are done, the same modifications are applied to it.
+*
+* The subscriptions are shared by both instances, and freed when removed from both of them
+* and released by the readers still holding a reference to them (see CachedSubscriptionP).
+*
+* o subCacheReadIx      instance to be used by readers
+* o subCacheVersionIx   reader counter to be used by readers
+* o subCacheReaders     reader counters
+* o subCacheOpLog       modifications applied to the writer instance, pending to be applied to the other one
+* o subCacheBatch       while true, modifications are accumulated and not published (see subCacheBatchBegin)
+*/
+static SubCacheInstance         subCacheInstance[2];
+static volatile int             subCacheReadIx     = 0;
+static volatile int             subCacheVersionIx  = 0;
+static volatile int             subCacheReaders[2] = { 0, 0 };
+static std::vector<SubCacheOp>  subCacheOpLog;
+static bool                     subCacheBatch      = false;
+
+
+
+/* ****************************************************************************
+*
+* tenantKey - 
+*
+* The tenant of a cached subscription can be NULL or "" for the default tenant.
+* Both are mapped to "" for the index.
+*/
+static inline const char* tenantKey(const char* tenant)
+{
+  return (tenant == NULL)? "" : tenant;
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheItemRelease - deleter of CachedSubscriptionP
+*/
+static void subCacheItemRelease(CachedSubscription* cSubP)
+{
+  LM_T(LmtSubCache,  ("removing CachedSubscription at %p", cSubP));
+
+  subCacheItemDestroy(cSubP);
+  delete cSubP;
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheReadBegin - get the instance of the cache to be used by a reader
+*
+* The returned reader counter index is to be passed to subCacheReadEnd once the
+* reader is done with the instance.
+*/
+static int subCacheReadBegin(const SubCacheInstance** instPP)
+{
+  int vi = subCacheVersionIx;
+
+  __sync_fetch_and_add(&subCacheReaders[vi], 1);
+  *instPP = &subCacheInstance[subCacheReadIx];
+
+  return vi;
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheReadEnd - 
+*/
+static void subCacheReadEnd(int vi)
+{
+  __sync_fetch_and_sub(&subCacheReaders[vi], 1);
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheReadersWait - wait until all readers registered in a reader counter are done
+*/
+static void subCacheReadersWait(int vi)
+{
+  while (__sync_add_and_fetch(&subCacheReaders[vi], 0) != 0)
+  {
+    sched_yield();
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheWork - get the instance of the cache to be modified by the writer
+*/
+static SubCacheInstance* subCacheWork(void)
+{
+  return &subCacheInstance[1 - subCacheReadIx];
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheInstanceIndex - get the index of a tenant in an instance
+*
+* If the tenant has no index and 'create' is false, NULL is returned.
+*/
+static SubCacheIndex* subCacheInstanceIndex(SubCacheInstance* instP, const std::string& tenant, bool create)
+{
+  std::map<std::string, SubCacheIndex*>::iterator it = instP->indexV.find(tenant);
+
+  if (it != instP->indexV.end())
+  {
+    return it->second;
+  }
+
+  if (create == false)
+  {
+    return NULL;
+  }
+
+  SubCacheIndex* indexP = new SubCacheIndex();
+
+  instP->indexV[tenant] = indexP;
+
+  return indexP;
+}
+
+
+
+/* ****************************************************************************
+*
+* bucketAdd - 
+*
+* A subscription may have more than one EntityInfo/condValue with the same key,
+* so the subscription is only added to the bucket if not already in it.
+*/
+static void bucketAdd(SubCacheBucket* bucketP, CachedSubscription* cSubP)
+{
+  if ((bucketP->size() > 0) && (bucketP->back() == cSubP))
+  {
+    return;
+  }
+
+  if (std::find(bucketP->begin(), bucketP->end(), cSubP) == bucketP->end())
+  {
+    bucketP->push_back(cSubP);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* bucketRemove - 
+*/
+static void bucketRemove(SubCacheBucketMap* mapP, const std::string& key, CachedSubscription* cSubP)
+{
+  SubCacheBucketMap::iterator it = mapP->find(key);
+
+  if (it == mapP->end())
+  {
+    return;
+  }
+
+  SubCacheBucket* bucketP = &it->second;
+
+  bucketP->erase(std::remove(bucketP->begin(), bucketP->end(), cSubP), bucketP->end());
+
+  if (bucketP->size() == 0)
+  {
+    mapP->erase(it);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheIndexAdd - 
+*/
+static void subCacheIndexAdd(SubCacheIndex* indexP, const CachedSubscriptionP& cSubPtr)
+{
+  CachedSubscription* cSubP = cSubPtr.get();
+
+  for (unsigned int ix = 0; ix < cSubP->entityIdInfos.size(); ++ix)
+  {
+    EntityInfo* eiP = cSubP->entityIdInfos[ix];
+
+    if (eiP->isPattern)
+    {
+      bucketAdd(&indexP->byPatternType[eiP->entityType], cSubP);
+    }
+    else
+    {
+      bucketAdd(&indexP->byEntityId[eiP->entityId], cSubP);
+    }
+  }
+
+  for (unsigned int ncvIx = 0; ncvIx < cSubP->notifyConditionVector.size(); ++ncvIx)
+  {
+    NotifyCondition* ncP = cSubP->notifyConditionVector[ncvIx];
+
+    if (ncP->condValueList.size() == 0)
+    {
+      bucketAdd(&indexP->anyAttribute, cSubP);
+      continue;
+    }
+
+    for (unsigned int cvIx = 0; cvIx < ncP->condValueList.size(); ++cvIx)
+    {
+      bucketAdd(&indexP->byAttribute[ncP->condValueList[cvIx]], cSubP);
+    }
+  }
+
+  GeoFilter* gfP = cSubP->geoFilterP.get();
+
+  if ((gfP != NULL) && (gfP->valid) && (gfP->bounded))
+  {
+    GeoIndexBox box = { gfP->minLat, gfP->maxLat, gfP->minLon, gfP->maxLon };
+
+    indexP->geoBounded.add(cSubP, box);
+  }
+  else
+  {
+    indexP->geoAny.push_back(cSubP);
+  }
+
+  indexP->bySubId[cSubP->subscriptionId] = cSubPtr;
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheIndexRemove - 
+*
+* Note that removing the subscription from bySubId may free it, so this is done last.
+*/
+static void subCacheIndexRemove(SubCacheIndex* indexP, CachedSubscription* cSubP)
+{
+  for (unsigned int ix = 0; ix < cSubP->entityIdInfos.size(); ++ix)
+  {
+    EntityInfo* eiP = cSubP->entityIdInfos[ix];
+
+    if (eiP->isPattern)
+    {
+      bucketRemove(&indexP->byPatternType, eiP->entityType, cSubP);
+    }
+    else
+    {
+      bucketRemove(&indexP->byEntityId, eiP->entityId, cSubP);
+    }
+  }
+
+  for (unsigned int ncvIx = 0; ncvIx < cSubP->notifyConditionVector.size(); ++ncvIx)
+  {
+    NotifyCondition* ncP = cSubP->notifyConditionVector[ncvIx];
+
+    for (unsigned int cvIx = 0; cvIx < ncP->condValueList.size(); ++cvIx)
+    {
+      bucketRemove(&indexP->byAttribute, ncP->condValueList[cvIx], cSubP);
+    }
+  }
+
+  indexP->anyAttribute.erase(std::remove(indexP->anyAttribute.begin(), indexP->anyAttribute.end(), cSubP), indexP->anyAttribute.end());
+  indexP->geoAny.erase(std::remove(indexP->geoAny.begin(), indexP->geoAny.end(), cSubP), indexP->geoAny.end());
+  indexP->geoBounded.remove(cSubP);
+
+  std::map<std::string, CachedSubscriptionP>::iterator sIt = indexP->bySubId.find(cSubP->subscriptionId);
+  if ((sIt != indexP->bySubId.end()) && (sIt->second.get() == cSubP))
+  {
+    indexP->bySubId.erase(sIt);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheOpApply - apply a modification to an instance of the cache
+*/
+static void subCacheOpApply(SubCacheInstance* instP, const SubCacheOp& op)
+{
+  if (op.type == SubCacheOpClear)
+  {
+    for (std::map<std::string, SubCacheIndex*>::iterator it = instP->indexV.begin(); it != instP->indexV.end(); ++it)
+    {
+      delete it->second;
+    }
+
+    instP->indexV.clear();
+    return;
+  }
+
+  std::string     tenant = tenantKey(op.cSubP->tenant);
+  SubCacheIndex*  indexP = subCacheInstanceIndex(instP, tenant, op.type == SubCacheOpInsert);
+
+  if (indexP == NULL)
+  {
+    return;
+  }
+
+  //
+  // An inserted subscription replaces the subscription with the same subscriptionId, if any
+  //
+  std::map<std::string, CachedSubscriptionP>::iterator sIt = indexP->bySubId.find(op.cSubP->subscriptionId);
+
+  if (sIt != indexP->bySubId.end())
+  {
+    if ((op.type == SubCacheOpInsert) || (sIt->second == op.cSubP))
+    {
+      subCacheIndexRemove(indexP, sIt->second.get());
+    }
+  }
+
+  if (op.type == SubCacheOpInsert)
+  {
+    subCacheIndexAdd(indexP, op.cSubP);
+  }
+  else if (indexP->bySubId.size() == 0)
+  {
+    delete indexP;
+    instP->indexV.erase(tenant);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheGeoBuild - rebuild the modified R-trees of an instance
+*/
+static void subCacheGeoBuild(SubCacheInstance* instP)
+{
+  for (std::map<std::string, SubCacheIndex*>::iterator it = instP->indexV.begin(); it != instP->indexV.end(); ++it)
+  {
+    if (it->second->geoBounded.dirty())
+    {
+      it->second->geoBounded.build();
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* subCachePublish - make the modifications of the writer visible to readers
+*
+* 1. Readers are switched to the modified instance (once its R-trees are rebuilt)
+* 2. The writer waits until the readers still using the old instance are done.
+*    New readers always use the modified instance.
+* 3. The modifications are applied to the old instance, that becomes the writer instance
+*
+* Nothing is done while a batch is open (see subCacheBatchBegin).
+*/
+static void subCachePublish(void)
+{
+  if ((subCacheBatch == true) || (subCacheOpLog.size() == 0))
+  {
+    return;
+  }
+
+  int newReadIx = 1 - subCacheReadIx;
+  int prevVi    = subCacheVersionIx;
+  int nextVi    = 1 - prevVi;
+
+  // 1. Switch readers to the modified instance
+  subCacheGeoBuild(subCacheWork());
+  __sync_synchronize();
+  subCacheReadIx = newReadIx;
+  __sync_synchronize();
+
+  // 2. Wait for the readers of the old instance, toggling reader counters
+  subCacheReadersWait(nextVi);
+  subCacheVersionIx = nextVi;
+  __sync_synchronize();
+  subCacheReadersWait(prevVi);
+
+  // 3. Apply the modifications to the old instance
+  SubCacheInstance* instP = subCacheWork();
+
+  for (unsigned int ix = 0; ix < subCacheOpLog.size(); ++ix)
+  {
+    subCacheOpApply(instP, subCacheOpLog[ix]);
+  }
+
+  subCacheGeoBuild(instP);
+  subCacheOpLog.clear();
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheOp - apply a modification to the writer instance and publish it
+*
+* WARNING
+*  The cache semaphore must be taken before this function is called
+*/
+static void subCacheOp(SubCacheOpType type, const CachedSubscriptionP& cSubP)
+{
+  SubCacheOp op;
+
+  op.type  = type;
+  op.cSubP = cSubP;
+
+  subCacheOpApply(subCacheWork(), op);
+  subCacheOpLog.push_back(op);
+
+  subCachePublish();
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheBatchBegin - 
+*
+* Modifications made between subCacheBatchBegin and subCacheBatchEnd are published at once
+* by subCacheBatchEnd, so the writer waits for the readers only once for the whole batch.
+*/
+static void subCacheBatchBegin(void)
+{
+  subCacheBatch = true;
+}
+
+
+
+/* ****************************************************************************
+*
+* subCacheBatchEnd - 
+*/
+static void subCacheBatchEnd(void)
+{
+  subCacheBatch = false;
+  subCachePublish();
+}
+
+
+
 /* ****************************************************************************
 *
 * subCacheInit - 
@@ -181,8 +748,9 @@ void subCacheInit(void)
 {
   LM_T(LmtSubCache, ("Initializing subscription cache"));
 
-  subCache.head   = NULL;
-  subCache.tail   = NULL;
+  subCacheBatch = false;
+  subCacheDestroy();
+  subCacheTombstones.clear();
 
   subCacheStatisticsReset("subCacheInit");
 
@@ -197,15 +765,17 @@ void subCacheInit(void)
 */
 int subCacheItems(void)
 {
-  CachedSubscription* cSubP = subCache.head;
-  int                 items = 0;
+  const SubCacheInstance*  instP;
+  int                      vi    = subCacheReadBegin(&instP);
+  int                      items = 0;
 
-  while (cSubP != NULL)
+  for (std::map<std::string, SubCacheIndex*>::const_iterator it = instP->indexV.begin(); it != instP->indexV.end(); ++it)
   {
-    ++items;
-    cSubP = cSubP->next;
+    items += it->second->bySubId.size();
   }
 
+  subCacheReadEnd(vi);
+
   return items;
 }
 
@@ -310,79 +880,215 @@ static bool servicePathMatch(CachedSubscription* cSubP, char* servicePath)
   len = strlen(spath) - 1;
   if (strncmp(spath, servicePath, len) == 0)
   {
-    return true;
+    return true;
+  }
+  
+  return false;
+}
+
+
+
+/* ****************************************************************************
+*
+* subMatch - 
+*/
+static bool subMatch
+(
+  CachedSubscription*              cSubP,
+  const char*                      tenant,
+  const char*                      servicePath,
+  const char*                      entityId,
+  const char*                      entityType,
+  const std::vector<std::string>&  attrV
+)
+{
+  if ((cSubP->tenant == NULL) || (tenant == NULL) || (cSubP->tenant[0] == 0) || (tenant[0] == 0))
+  {
+    if ((cSubP->tenant != NULL) && (cSubP->tenant[0] != 0))
+    {
+      LM_T(LmtSubCacheMatch, ("No match due to tenant I"));
+      return false;
+    }
+
+    if ((tenant != NULL) && (tenant[0] != 0))
+    {
+      LM_T(LmtSubCacheMatch, ("No match due to tenant II"));
+      return false;
+    }
+  }
+  else if (strcmp(cSubP->tenant, tenant) != 0)
+  {
+    LM_T(LmtSubCacheMatch, ("No match due to tenant III"));
+    return false;
+  }
+
+  if (servicePathMatch(cSubP, (char*) servicePath) == false)
+  {
+    LM_T(LmtSubCacheMatch, ("No match due to servicePath"));
+    return false;
+  }
+
+
+  //
+  // If ONCHANGE and one of the attribute names in the scope vector
+  // of the subscription has the same name as the incoming attribute. there is a match.
+  // Additionaly, if the attribute list in cSubP is empty, there is a match (this is the
+  // case of ONANYCHANGE subscriptions).
+  //
+  if (!attributeMatch(cSubP, attrV))
+  {
+    LM_T(LmtSubCacheMatch, ("No match due to attributes"));
+    return false;
+  }
+
+  for (unsigned int ix = 0; ix < cSubP->entityIdInfos.size(); ++ix)
+  {
+    EntityInfo* eiP = cSubP->entityIdInfos[ix];
+
+    if (eiP->match(entityId, entityType))
+    {
+      return true;
+    }
+  }
+
+  LM_T(LmtSubCacheMatch, ("No match due to EntityInfo"));
+  return false;
+}
+
+
+
+/* ****************************************************************************
+*
+* bucketsSize - 
+*/
+static unsigned int bucketsSize(const SubCacheBucketMap& bucketMap, const std::string& key)
+{
+  SubCacheBucketMap::const_iterator it = bucketMap.find(key);
+
+  return (it == bucketMap.end())? 0 : it->second.size();
+}
+
+
+
+/* ****************************************************************************
+*
+* bucketsCollect - 
+*/
+static void bucketsCollect(const SubCacheBucketMap& bucketMap, const std::string& key, SubCacheBucket* candidatesP)
+{
+  SubCacheBucketMap::const_iterator it = bucketMap.find(key);
+
+  if (it != bucketMap.end())
+  {
+    candidatesP->insert(candidatesP->end(), it->second.begin(), it->second.end());
   }
-  
-  return false;
 }
 
 
 
 /* ****************************************************************************
 *
-* subMatch - 
+* subCacheCandidates - 
+*
+* Collects, from the index of the tenant, the subscriptions that may match the update.
+* Three candidate sets are possible:
+*   - by entity: subscriptions for the entityId + patterned subscriptions for the entityType
+*   - by attribute: subscriptions with any of attrV as condValue + ONANYCHANGE subscriptions
+*   - by location (only if the location is known): subscriptions whose bounded geo filter
+*     contains the location + subscriptions without bounded geo filter
+* All of them are supersets of the real matches, so the smaller one is used.
+* Any candidate must still be checked using subMatch().
 */
-static bool subMatch
+static void subCacheCandidates
 (
-  CachedSubscription*              cSubP,
-  const char*                      tenant,
-  const char*                      servicePath,
+  SubCacheIndex*                   indexP,
   const char*                      entityId,
   const char*                      entityType,
-  const std::vector<std::string>&  attrV
+  const std::vector<std::string>&  attrV,
+  const orion::Point*              locationP,
+  SubCacheBucket*                  candidatesP
 )
 {
-  if ((cSubP->tenant == NULL) || (tenant == NULL) || (cSubP->tenant[0] == 0) || (tenant[0] == 0))
+  bool            anyType       = (entityType == NULL) || (entityType[0] == 0);
+  unsigned int    entitySize    = bucketsSize(indexP->byEntityId, entityId);
+  unsigned int    attributeSize = indexP->anyAttribute.size();
+  unsigned int    locationSize  = (unsigned int) -1;
+  SubCacheBucket  geoHits;
+
+  if (locationP != NULL)
   {
-    if ((cSubP->tenant != NULL) && (cSubP->tenant[0] != 0))
-    {
-      LM_T(LmtSubCacheMatch, ("No match due to tenant I"));
-      return false;
-    }
+    indexP->geoBounded.query(locationP->latitude(), locationP->longitude(), &geoHits);
+    locationSize = geoHits.size() + indexP->geoAny.size();
+  }
 
-    if ((tenant != NULL) && (tenant[0] != 0))
+  if (anyType)
+  {
+    for (SubCacheBucketMap::const_iterator it = indexP->byPatternType.begin(); it != indexP->byPatternType.end(); ++it)
     {
-      LM_T(LmtSubCacheMatch, ("No match due to tenant II"));
-      return false;
+      entitySize += it->second.size();
     }
   }
-  else if (strcmp(cSubP->tenant, tenant) != 0)
+  else
   {
-    LM_T(LmtSubCacheMatch, ("No match due to tenant III"));
-    return false;
+    entitySize += bucketsSize(indexP->byPatternType, entityType);
+    entitySize += bucketsSize(indexP->byPatternType, "");
   }
 
-  if (servicePathMatch(cSubP, (char*) servicePath) == false)
+  for (unsigned int ix = 0; ix < attrV.size(); ++ix)
   {
-    LM_T(LmtSubCacheMatch, ("No match due to servicePath"));
-    return false;
+    attributeSize += bucketsSize(indexP->byAttribute, attrV[ix]);
   }
 
+  LM_T(LmtSubCacheMatch, ("candidates: %d by entity, %d by attribute, %d by location", entitySize, attributeSize, locationSize));
 
-  //
-  // If ONCHANGE and one of the attribute names in the scope vector
-  // of the subscription has the same name as the incoming attribute. there is a match.
-  // Additionaly, if the attribute list in cSubP is empty, there is a match (this is the
-  // case of ONANYCHANGE subscriptions).
-  //
-  if (!attributeMatch(cSubP, attrV))
+  if ((entitySize == 0) || (attributeSize == 0) || (locationSize == 0))
   {
-    LM_T(LmtSubCacheMatch, ("No match due to attributes"));
-    return false;
+    return;
   }
 
-  for (unsigned int ix = 0; ix < cSubP->entityIdInfos.size(); ++ix)
+  if ((locationSize < entitySize) && (locationSize < attributeSize))
   {
-    EntityInfo* eiP = cSubP->entityIdInfos[ix];
+    candidatesP->swap(geoHits);
+    candidatesP->insert(candidatesP->end(), indexP->geoAny.begin(), indexP->geoAny.end());
 
-    if (eiP->match(entityId, entityType))
+    // geoBounded and geoAny are disjoint and a subscription is only once in geoBounded - no duplicates
+    return;
+  }
+
+  candidatesP->reserve((entitySize < attributeSize)? entitySize : attributeSize);
+
+  if (entitySize <= attributeSize)
+  {
+    bucketsCollect(indexP->byEntityId, entityId, candidatesP);
+
+    if (anyType)
     {
-      return true;
+      for (SubCacheBucketMap::const_iterator it = indexP->byPatternType.begin(); it != indexP->byPatternType.end(); ++it)
+      {
+        candidatesP->insert(candidatesP->end(), it->second.begin(), it->second.end());
+      }
+    }
+    else
+    {
+      bucketsCollect(indexP->byPatternType, entityType, candidatesP);
+      bucketsCollect(indexP->byPatternType, "", candidatesP);
+    }
+  }
+  else
+  {
+    candidatesP->insert(candidatesP->end(), indexP->anyAttribute.begin(), indexP->anyAttribute.end());
+
+    for (unsigned int ix = 0; ix < attrV.size(); ++ix)
+    {
+      bucketsCollect(indexP->byAttribute, attrV[ix], candidatesP);
     }
   }
 
-  LM_T(LmtSubCacheMatch, ("No match due to EntityInfo"));
-  return false;
+  //
+  // A subscription may be in more than one bucket - remove duplicates
+  //
+  std::sort(candidatesP->begin(), candidatesP->end());
+  candidatesP->erase(std::unique(candidatesP->begin(), candidatesP->end()), candidatesP->end());
 }
 
 
@@ -398,25 +1104,14 @@ void subCacheMatch
   const char*                        entityId,
   const char*                        entityType,
   const char*                        attr,
-  std::vector<CachedSubscription*>*  subVecP
+  std::vector<CachedSubscriptionP>*  subVecP
 )
 {
-  CachedSubscription* cSubP = subCache.head;
+  std::vector<std::string> attrV;
 
-  while (cSubP != NULL)
-  {
-    std::vector<std::string> attrV;
-
-    attrV.push_back(attr);
-
-    if (subMatch(cSubP, tenant, servicePath, entityId, entityType, attrV))
-    {
-      subVecP->push_back(cSubP);
-      LM_T(LmtSubCache, ("added subscription '%s': lastNotificationTime: %lu", cSubP->subscriptionId, cSubP->lastNotificationTime));
-    }
+  attrV.push_back(attr);
 
-    cSubP = cSubP->next;
-  }
+  subCacheMatch(tenant, servicePath, entityId, entityType, attrV, subVecP);
 }
 
 
@@ -424,6 +1119,13 @@ void subCacheMatch
 /* ****************************************************************************
 *
 * subCacheMatch - 
+*
+* Only the subscriptions in the index of the tenant that may match (see subCacheCandidates)
+* are checked, so the cost of the match depends on the number of candidates and not on
+* the total number of subscriptions in the cache.
+*
+* No semaphore is needed, and the matching subscriptions are kept alive by the references
+* returned in subVecP, even if they are removed from the cache after the match.
 */
 void subCacheMatch
 (
@@ -432,21 +1134,43 @@ void subCacheMatch
   const char*                        entityId,
   const char*                        entityType,
   const std::vector<std::string>&    attrV,
-  std::vector<CachedSubscription*>*  subVecP
+  std::vector<CachedSubscriptionP>*  subVecP,
+  const orion::Point*                locationP
 )
 {
-  CachedSubscription* cSubP = subCache.head;
+  const SubCacheInstance*                                instP;
+  int                                                    vi = subCacheReadBegin(&instP);
+  std::map<std::string, SubCacheIndex*>::const_iterator  it = instP->indexV.find(tenantKey(tenant));
+
+  if (it == instP->indexV.end())
+  {
+    subCacheReadEnd(vi);
+    return;
+  }
+
+  SubCacheIndex*  indexP = it->second;
+  SubCacheBucket  candidates;
+
+  subCacheCandidates(indexP, entityId, entityType, attrV, locationP, &candidates);
 
-  while (cSubP != NULL)
+  for (unsigned int ix = 0; ix < candidates.size(); ++ix)
   {
+    CachedSubscription* cSubP = candidates[ix];
+
+    if ((locationP != NULL) && (cSubP->geoFilterP.get() != NULL) && (cSubP->geoFilterP->inBounds(*locationP) == false))
+    {
+      LM_T(LmtSubCacheMatch, ("No match due to location"));
+      continue;
+    }
+
     if (subMatch(cSubP, tenant, servicePath, entityId, entityType, attrV))
     {
-      subVecP->push_back(cSubP);
+      subVecP->push_back(indexP->bySubId.find(cSubP->subscriptionId)->second);
       LM_T(LmtSubCache, ("added subscription '%s': lastNotificationTime: %lu", cSubP->subscriptionId, cSubP->lastNotificationTime));
     }
-
-    cSubP = cSubP->next;
   }
+
+  subCacheReadEnd(vi);
 }
 
 
@@ -497,8 +1221,6 @@ void subCacheItemDestroy(CachedSubscription* cSubP)
 
   cSubP->notifyConditionVector.release();
   cSubP->notifyConditionVector.vec.clear();
-
-  cSubP->next = NULL;
 }
 
 
@@ -506,90 +1228,79 @@ void subCacheItemDestroy(CachedSubscription* cSubP)
 /* ****************************************************************************
 *
 * subCacheDestroy - 
+*
+* The subscriptions are freed as soon as the readers still using them (if any) release them.
 */
 void subCacheDestroy(void)
 {
   LM_T(LmtSubCache, ("destroying subscription cache"));
 
-  CachedSubscription* cSubP  = subCache.head;
-
-  if (subCache.head == NULL)
-  {
-    return;
-  }
-
-  while (cSubP->next)
-  {
-    CachedSubscription* prev = cSubP;
-
-    cSubP = cSubP->next;
-    subCacheItemDestroy(prev);
-    LM_T(LmtSubCache,  ("removing CachedSubscription at %p", prev));
-    delete prev;
-  }
-
-  subCacheItemDestroy(cSubP);
-  LM_T(LmtSubCache,  ("removing CachedSubscription at %p", cSubP));
-  delete cSubP;
-
-  subCache.head  = NULL;
-  subCache.tail  = NULL;
+  subCacheOp(SubCacheOpClear, CachedSubscriptionP());
 }
 
 
 
 /* ****************************************************************************
 *
-* tenantMatch - 
+* subCacheItemLookup - 
 */
-static bool tenantMatch(const char* tenant1, const char* tenant2)
+CachedSubscriptionP subCacheItemLookup(const char* tenant, const char* subscriptionId)
 {
-  //
-  // Removing complications with NULL, giving NULL tenants the value of an empty string;
-  //
-  tenant1 = (tenant1 == NULL)? "" : tenant1;
-  tenant2 = (tenant2 == NULL)? "" : tenant2;
+  const SubCacheInstance*                                instP;
+  int                                                    vi = subCacheReadBegin(&instP);
+  std::map<std::string, SubCacheIndex*>::const_iterator  it = instP->indexV.find(tenantKey(tenant));
+  CachedSubscriptionP                                    cSubP;
 
-  if (strlen(tenant1) != strlen(tenant2))
+  if (it != instP->indexV.end())
   {
-    return false;
-  }
+    std::map<std::string, CachedSubscriptionP>::const_iterator sIt = it->second->bySubId.find(subscriptionId);
 
-  if (strcmp(tenant1, tenant2) == 0)
-  {
-    return true;
+    if (sIt != it->second->bySubId.end())
+    {
+      cSubP = sIt->second;
+    }
   }
 
-  return false;
+  subCacheReadEnd(vi);
+
+  return cSubP;
 }
 
 
 
 /* ****************************************************************************
 *
-* subCacheItemLookup - 
-*
-* FIXME P7: lookups would be A LOT faster if the subCache used a hash-table instead of
-*           just a single linked link for the subscriptions.
-*           The hash could be adding each char in 'tenant' and 'subscriptionId' to a 8-bit
-*           integer and then we'd have a vector of 256 linked lists.
-*           Another way of implementing this would be to use a std::vector or std::map.
+* lastNotificationTimeUpdate - set lastNotificationTime, unless the current one is newer
 */
-CachedSubscription* subCacheItemLookup(const char* tenant, const char* subscriptionId)
+static void lastNotificationTimeUpdate(CachedSubscription* cSubP, int64_t lastNotificationTime)
 {
-  CachedSubscription* cSubP = subCache.head;
+  int64_t current = cSubP->lastNotificationTime;
 
-  while (cSubP != NULL)
+  while (current < lastNotificationTime)
   {
-    if ((tenantMatch(tenant, cSubP->tenant)) && (strcmp(subscriptionId, cSubP->subscriptionId) == 0))
+    int64_t prev = __sync_val_compare_and_swap(&cSubP->lastNotificationTime, current, lastNotificationTime);
+
+    if (prev == current)
     {
-      return cSubP;
+      break;
     }
 
-    cSubP = cSubP->next;
+    current = prev;
   }
+}
 
-  return NULL;
+
+
+/* ****************************************************************************
+*
+* subCacheItemNotified - update the counters of a subscription after a notification
+*
+* No semaphore is needed, the counters are modified using atomic operations.
+*/
+void subCacheItemNotified(CachedSubscription* cSubP, int64_t notificationTime)
+{
+  __sync_fetch_and_add(&cSubP->count, 1);
+  lastNotificationTimeUpdate(cSubP, notificationTime);
 }
 
 
@@ -609,38 +1320,27 @@ void subCacheUpdateStatisticsIncrement(void)
 *
 * subCacheItemInsert - 
 *
-* First of all, insertion is done at the end of the list, so, 
-* cSubP->next must ALWAYS be zero at insertion time
-*
 * Note that this is the insert function that *really inserts* the
-* CachedSubscription in the list of CachedSubscriptions.
+* CachedSubscription in the cache.
 *
-* All other subCacheItemInsert functions crea<te the subscription and then
+* All other subCacheItemInsert functions create the subscription and then
 * calls this function.
 *
-* So, the subscription itself is untouched by this function, is it ONLY inserted
-* in the list (only the 'next' field is modified).
+* The cache takes the ownership of the subscription, which is untouched by this function.
+* If a subscription with the same subscriptionId is already in the cache, it is
+* replaced, so that readers never see the subscription missing.
 *
+* WARNING
+*  The cache semaphore must be taken before this function is called
 */
 void subCacheItemInsert(CachedSubscription* cSubP)
 {
-  cSubP->next = NULL;
-
   LM_T(LmtSubCache, ("inserting sub '%s', lastNotificationTime: %lu", cSubP->subscriptionId, cSubP->lastNotificationTime));
 
   ++subCache.noOfInserts;
+  subCacheTombstones.erase(std::make_pair(std::string(tenantKey(cSubP->tenant)), std::string(cSubP->subscriptionId)));
 
-  // First insertion?
-  if ((subCache.head == NULL) && (subCache.tail == NULL))
-  {
-    subCache.head   = cSubP;
-    subCache.tail   = cSubP;
-
-    return;
-  }
-
-  subCache.tail->next  = cSubP;
-  subCache.tail        = cSubP;
+  subCacheOp(SubCacheOpInsert, CachedSubscriptionP(cSubP, subCacheItemRelease));
 }
 
 
@@ -713,13 +1413,15 @@ void subCacheItemInsert
   cSubP->expirationTime        = expirationTime;
   cSubP->throttling            = throttling;
   cSubP->lastNotificationTime  = lastNotificationTime;
+  cSubP->modificationTime      = 0;
   cSubP->notifyFormat          = notifyFormat;
-  cSubP->next                  = NULL;
   cSubP->count                 = (notificationDone == true)? 1 : 0;
   cSubP->expression.q          = q;
   cSubP->expression.geometry   = geometry;
   cSubP->expression.coords     = coords;
   cSubP->expression.georel     = georel;
+  cSubP->stringFilterP         = stringFilterCompile(q);
+  cSubP->geoFilterP            = geoFilterCompile(geometry, coords, georel);
 
   LM_T(LmtSubCache, ("inserting a new sub in cache (%s). lastNotifictionTime: %lu", cSubP->subscriptionId, cSubP->lastNotificationTime));
 
@@ -776,7 +1478,19 @@ void subCacheStatisticsGet(int* refreshes, int* inserts, int* removes, int* upda
   *updates   = subCache.noOfUpdates;
   *items     = subCacheItems();
 
-  CachedSubscription* cSubP = subCache.head;
+  const SubCacheInstance*           instP;
+  int                               vi = subCacheReadBegin(&instP);
+  std::vector<CachedSubscriptionP>  subV;
+
+  for (std::map<std::string, SubCacheIndex*>::const_iterator it = instP->indexV.begin(); it != instP->indexV.end(); ++it)
+  {
+    for (std::map<std::string, CachedSubscriptionP>::const_iterator sIt = it->second->bySubId.begin(); sIt != it->second->bySubId.end(); ++sIt)
+    {
+      subV.push_back(sIt->second);
+    }
+  }
+
+  subCacheReadEnd(vi);
 
   //
   // NOTE
@@ -789,10 +1503,11 @@ void subCacheStatisticsGet(int* refreshes, int* inserts, int* removes, int* upda
   *list = 0;
   if (listSize > 128)
   {
-    while (cSubP != NULL)
+    for (unsigned int ix = 0; ix < subV.size(); ++ix)
     {
-      char          msg[256];
-      unsigned int  bytesLeft = listSize - strlen(list);
+      CachedSubscription*  cSubP     = subV[ix].get();
+      char                 msg[256];
+      unsigned int         bytesLeft = listSize - strlen(list);
 
 #if 0
       //
@@ -822,8 +1537,6 @@ void subCacheStatisticsGet(int* refreshes, int* inserts, int* removes, int* upda
         strcat(list, ", ");
 
       strcat(list, msg);
-
-      cSubP = cSubP->next;
     }
   }
   else
@@ -858,50 +1571,72 @@ void subCacheStatisticsReset(const char* by)
 */
 void subCachePresent(const char* title)
 {
-  CachedSubscription* cSubP = subCache.head;
+  const SubCacheInstance*  instP;
+  int                      vi = subCacheReadBegin(&instP);
 
   LM_T(LmtSubCache, ("----------- %s ------------", title));
 
-  while (cSubP != NULL)
+  for (std::map<std::string, SubCacheIndex*>::const_iterator it = instP->indexV.begin(); it != instP->indexV.end(); ++it)
   {
-    LM_T(LmtSubCache, ("o %s (tenant: %s, LNT: %lu, THR: %d)", cSubP->subscriptionId, cSubP->tenant, cSubP->lastNotificationTime, cSubP->throttling));
-    cSubP = cSubP->next;
+    for (std::map<std::string, CachedSubscriptionP>::const_iterator sIt = it->second->bySubId.begin(); sIt != it->second->bySubId.end(); ++sIt)
+    {
+      CachedSubscription* cSubP = sIt->second.get();
+
+      LM_T(LmtSubCache, ("o %s (tenant: %s, LNT: %lu, THR: %d)", cSubP->subscriptionId, cSubP->tenant, cSubP->lastNotificationTime, cSubP->throttling));
+    }
   }
 
+  subCacheReadEnd(vi);
+
   LM_T(LmtSubCache, ("--------------------------------"));
 }
 
 
 
+/* ****************************************************************************
+*
+* subCacheTombstoneAdd - 
+*
+* WARNING
+*  The cache semaphore must be taken before this function is called
+*/
+void subCacheTombstoneAdd(const char* tenant, const char* subscriptionId)
+{
+  subCacheTombstones.insert(std::make_pair(std::string(tenantKey(tenant)), std::string(subscriptionId)));
+}
+
+
+
 /* ****************************************************************************
 *
 * subCacheItemRemove - 
+*
+* The subscription is freed once the readers still using it (if any) release it.
+*
+* WARNING
+*  The cache semaphore must be taken before this function is called
 */
 int subCacheItemRemove(CachedSubscription* cSubP)
 {
-  CachedSubscription* current = subCache.head;
-  CachedSubscription* prev    = NULL;
-
   LM_T(LmtSubCache, ("in subCacheItemRemove, trying to remove '%s'", cSubP->subscriptionId));
-  while (current != NULL)
+
+  SubCacheIndex* indexP = subCacheInstanceIndex(subCacheWork(), tenantKey(cSubP->tenant), false);
+
+  if (indexP != NULL)
   {
-    if (current == cSubP)
-    {
-      if (cSubP == subCache.head)  { subCache.head = cSubP->next; }
-      if (cSubP == subCache.tail)  { subCache.tail = prev;        }
-      if (prev != NULL)                 { prev->next         = cSubP->next; }
+    std::map<std::string, CachedSubscriptionP>::iterator sIt = indexP->bySubId.find(cSubP->subscriptionId);
 
+    if ((sIt != indexP->bySubId.end()) && (sIt->second.get() == cSubP))
+    {
       LM_T(LmtSubCache, ("in subCacheItemRemove, REMOVING '%s'", cSubP->subscriptionId));
       ++subCache.noOfRemoves;
 
-      subCacheItemDestroy(cSubP);
-      delete cSubP;
+      subCacheTombstoneAdd(cSubP->tenant, cSubP->subscriptionId);
+
+      subCacheOp(SubCacheOpRemove, sIt->second);
 
       return 0;
     }
-
-    prev    = current;
-    current = current->next;
   }
 
   LM_E(("Runtime Error (item to remove from sub-cache not found)"));
@@ -925,6 +1660,11 @@ void subCacheRefresh(void)
 
   LM_T(LmtSubCache, ("Refreshing subscription cache"));
 
+  subCacheLastSync = getCurrentTime();
+
+  // The new content of the cache is published at once, when the refresh is done
+  subCacheBatchBegin();
+
   // Empty the cache
   subCacheDestroy();
 
@@ -945,58 +1685,122 @@ void subCacheRefresh(void)
     mongoSubCacheRefresh(databases[ix]);
   }
 
+  subCacheBatchEnd();
+
   ++subCache.noOfRefreshes;
   LM_T(LmtSubCache, ("Refreshed subscription cache [%d]", subCache.noOfRefreshes));
+}
 
 
-  //
-  // FIXME P5: Remove this debugging code once the refresh works again
-  //
-#if 0
 
-  //
-  // DEBUG STARTS HERE
-  //
-  CachedSubscription* cSubP = subCache.head;
-  int                 items = 0;
+/* ****************************************************************************
+*
+* subCacheDeltaApply - 
+*
+* Applies to the cache the changes read from the database for a tenant by mongoSubCacheDelta.
+*
+* 1. Created/modified subscriptions (changedV) replace the cached ones, keeping the local
+*    counters of the cached subscription. If the cached subscription is newer than the one
+*    read from DB (it has been modified by this broker after the read), it is kept. If it
+*    has been removed by this broker after the read (see subCacheTombstones), it is skipped.
+* 2. Cached subscriptions that were in the cache when the sync started (savedV) and that
+*    are no longer in the database (presentV) are removed. Subscriptions inserted during the
+*    sync are not in savedV and are never removed here.
+* 3. If the lastNotification in DB is newer than the cached one (notification sent by another
+*    broker), it is taken, so that throttling works in multi-CB configurations.
+*
+* All the changes are published at once (see subCacheBatchBegin).
+*
+* Note that a reader that looked up a replaced subscription just before the changes are
+* published may still increment the count of the old subscription. Such an increment is lost,
+* which is acceptable as the count is only informative.
+*
+* WARNING
+*  The cache semaphore must be taken before this function is called
+*/
+void subCacheDeltaApply
+(
+  const std::string&                              tenant,
+  const std::vector<CachedSubscription*>&         changedV,
+  const std::map<std::string, long long>&         presentV,
+  const std::map<std::string, CachedSubSaved*>&   savedV
+)
+{
+  std::string key = tenantKey(tenant.c_str());
 
-  while (cSubP != NULL)
+  subCacheBatchBegin();
+
+  for (unsigned int ix = 0; ix < changedV.size(); ++ix)
   {
-    LM_T(LmtSubCache, ("%s: TEN:%s, SPath:%s, THR:%lu, EXP:%lu, LNT:%lu REF:%s, Es:%d, As:%d, NCs:%d",
-                            cSubP->subscriptionId,
-                            cSubP->tenant,
-                            cSubP->servicePath,
-                            cSubP->throttling,
-                            cSubP->expirationTime,
-                            cSubP->lastNotificationTime,
-                            cSubP->reference,
-                            cSubP->entityIdInfos.size(),
-                            cSubP->attributes.size(),
-                            cSubP->notifyConditionVector.size()));
+    CachedSubscription*  cSubP  = changedV[ix];
+    SubCacheIndex*       indexP = subCacheInstanceIndex(subCacheWork(), key, true);
+
+    if (subCacheTombstones.find(std::make_pair(key, std::string(cSubP->subscriptionId))) != subCacheTombstones.end())
+    {
+      LM_T(LmtCacheSync, ("sub '%s' removed from cache after the read - skipped", cSubP->subscriptionId));
+      subCacheItemDestroy(cSubP);
+      delete cSubP;
+      continue;
+    }
+
+    std::map<std::string, CachedSubscriptionP>::iterator sIt = indexP->bySubId.find(cSubP->subscriptionId);
+
+    if (sIt != indexP->bySubId.end())
+    {
+      CachedSubscription* oldP = sIt->second.get();
+
+      if (oldP->modificationTime > cSubP->modificationTime)
+      {
+        LM_T(LmtCacheSync, ("sub '%s' in cache is newer than in DB - kept", cSubP->subscriptionId));
+        subCacheItemDestroy(cSubP);
+        delete cSubP;
+        continue;
+      }
+
+      cSubP->count = __sync_lock_test_and_set(&oldP->count, 0);
+      if (oldP->lastNotificationTime > cSubP->lastNotificationTime)
+      {
+        cSubP->lastNotificationTime = oldP->lastNotificationTime;
+      }
+    }
 
-    cSubP = cSubP->next;
-    ++items;
+    LM_T(LmtCacheSync, ("sub '%s' created/modified in DB", cSubP->subscriptionId));
+    subCacheItemInsert(cSubP);  // replaces the old one, if any
   }
 
-  LM_T(LmtSubCache, ("%d subs in sub.cache", items));
+  SubCacheIndex* indexP = subCacheInstanceIndex(subCacheWork(), key, false);
 
-  //
-  // DEBUG ENDS HERE
-  //
-#endif
-}
+  if (indexP != NULL)
+  {
+    std::vector<CachedSubscription*>  removeV;
 
+    for (std::map<std::string, CachedSubscriptionP>::iterator sIt = indexP->bySubId.begin(); sIt != indexP->bySubId.end(); ++sIt)
+    {
+      CachedSubscription*                               cSubP = sIt->second.get();
+      std::map<std::string, long long>::const_iterator  pIt   = presentV.find(sIt->first);
 
+      if (pIt == presentV.end())
+      {
+        if (savedV.find(sIt->first) != savedV.end())
+        {
+          removeV.push_back(cSubP);
+        }
 
-/* ****************************************************************************
-*
-* CachedSubSaved - 
-*/
-typedef struct CachedSubSaved
-{
-  long long  lastNotificationTime;
-  long long  count;
-} CachedSubSaved;
+        continue;
+      }
+
+      lastNotificationTimeUpdate(cSubP, pIt->second);
+    }
+
+    for (unsigned int ix = 0; ix < removeV.size(); ++ix)
+    {
+      LM_T(LmtCacheSync, ("sub '%s' removed from DB", removeV[ix]->subscriptionId));
+      subCacheItemRemove(removeV[ix]);
+    }
+  }
+
+  subCacheBatchEnd();
+}
 
 
 
@@ -1004,23 +1808,35 @@ typedef struct CachedSubSaved
 *
 * subCacheSync - 
 *
-* 1. Save subscriptionId, lastNotificationTime, and count for all items in cache (savedSubV)
-* 2. Refresh cache (count set to 0)
-* 3. Compare lastNotificationTime in savedSubV with the new cache-contents and:
-*    3.1 Update cache-items where 'saved lastNotificationTime' > 'cached lastNotificationTime'
-*    3.2 Remember this more correct lastNotificationTime (must be flushed to mongo) -
-*        by clearing out (set to 0) those lastNotificationTimes that are newer in cache
-* 4. Update 'count' for each item in savedSubV where count != 0
-* 5. Update 'lastNotificationTime' foreach item in savedSubV where lastNotificationTime != 0
-* 6. Free the vector created in step 1 - savedSubV
+* Incremental synchronization of the subscription cache with the database.
+* The cache semaphore is only taken while applying the changes of each tenant (step 4),
+* never during database operations. Readers of the cache never wait for the synchronization.
+*
+* 0. Forget the subscriptions removed before this sync (see subCacheTombstones)
+* 1. Save subscriptionId, lastNotificationTime, and count for all items in cache (savedV),
+*    and reset count in the cache (from now on, count in the cache is a delta over what is
+*    about to be flushed to DB). As count is atomically exchanged with zero, no notification
+*    is lost and no semaphore is needed
+* 2. Foreach tenant, flush 'count' and 'lastNotificationTime' of the saved items with count != 0
+*    (i.e. those that have sent notifications since the last sync) in a single bulk write
+* 3. Foreach tenant, read the subscriptions modified since the last sync and the ids of
+*    all the subscriptions in DB (mongoSubCacheDelta)
+* 4. Foreach tenant, apply the changes to the cache (subCacheDeltaApply)
+* 5. Free the saved items
+*
+* Subscriptions are read since the start of the previous sync minus one interval, so that
+* modifications done by other brokers with a slightly different clock are not lost. Reading
+* a subscription twice is harmless.
+* Note that subscriptions created or modified by brokers not setting CSUB_MODIFICATION_DATE
+* (versions previous to the incremental sync) are only read in the full refresh at startup.
 *
 * NOTE
-*   This function runs in a separate thread and it allocates temporal objects (in savedSubV).
+*   This function runs in a separate thread and it allocates temporal objects (in savedV).
 *   If the broker dies when this function is executing, all these temporal objects will be reported
 *   as memory leaks.
 *   We see this in our valgrind tests, where we force the broker to die.
 *   This is of course not a real leak, we only see this as a leak as the function hasn't finished to
-*   execute until the point where the temporal objects are deleted (See '6. Free the vector savedSubV').
+*   execute until the point where the temporal objects are deleted (See '5. Free the saved items').
 *   To fix this little problem, we have created a variable 'subCacheState' that is set to ScsSynchronizing while
 *   the sub-cache synchronization is working.
 *   In serviceRoutines/exitTreat.cpp this variable is checked and if iot is set to ScsSynchronizing, then a 
@@ -1028,87 +1844,117 @@ typedef struct CachedSubSaved
 */
 void subCacheSync(void)
 {
-  std::map<std::string, CachedSubSaved*> savedSubV;
+  extern int                                                      subCacheInterval;
+  std::map<std::string, std::map<std::string, CachedSubSaved*> >  savedV;  // tenant -> subscriptionId -> counters
+  std::vector<std::string>                                        databases;
+  long long                                                       syncStart = getCurrentTime();
+  long long                                                       since     = subCacheLastSync - subCacheInterval;
 
-  cacheSemTake(__FUNCTION__, "Synchronizing subscription cache");
   subCacheState = ScsSynchronizing;
 
+  cacheSemTake(__FUNCTION__, "Synchronizing subscription cache (starting)");
+  subCacheTombstones.clear();
+  cacheSemGive(__FUNCTION__, "Synchronizing subscription cache (starting)");
+
 
   //
   // 1. Save subscriptionId, lastNotificationTime, and count for all items in cache
   //
-  CachedSubscription* cSubP = subCache.head;
+  const SubCacheInstance*  instP;
+  int                      vi    = subCacheReadBegin(&instP);
+  int                      saved = 0;
 
-  while (cSubP != NULL)
+  for (std::map<std::string, SubCacheIndex*>::const_iterator it = instP->indexV.begin(); it != instP->indexV.end(); ++it)
   {
-    CachedSubSaved* cssP       = new CachedSubSaved();
+    for (std::map<std::string, CachedSubscriptionP>::const_iterator sIt = it->second->bySubId.begin(); sIt != it->second->bySubId.end(); ++sIt)
+    {
+      CachedSubscription*  cSubP = sIt->second.get();
+      CachedSubSaved*      cssP  = new CachedSubSaved();
 
-    cssP->lastNotificationTime = cSubP->lastNotificationTime;
-    cssP->count                = cSubP->count;
+      cssP->subscriptionId       = cSubP->subscriptionId;
+      cssP->count                = __sync_lock_test_and_set(&cSubP->count, 0);
+      cssP->lastNotificationTime = (cssP->count != 0)? cSubP->lastNotificationTime : 0;
 
-    savedSubV[cSubP->subscriptionId]= cssP;
-    cSubP = cSubP->next;
+      savedV[it->first][cSubP->subscriptionId] = cssP;
+      ++saved;
+    }
   }
 
-  LM_T(LmtCacheSync, ("Pushed back %d items to savedSubV", savedSubV.size()));
+  subCacheReadEnd(vi);
 
+  LM_T(LmtCacheSync, ("Saved %d items", saved));
 
-  //
-  // 2. Refresh cache (count set to 0)
-  //
-  subCacheRefresh();
 
+  if (mongoMultitenant())
+  {
+    getOrionDatabases(databases);
+  }
+  databases.push_back(getDbPrefix());
 
-  //
-  // 3. Compare lastNotificationTime in savedSubV with the new cache-contents
-  //
-  cSubP = subCache.head;
-  while (cSubP != NULL)
+  for (unsigned int ix = 0; ix < databases.size(); ++ix)
   {
-    CachedSubSaved* cssP = savedSubV[cSubP->subscriptionId];
-    if ((cssP != NULL) && (cssP->lastNotificationTime <= cSubP->lastNotificationTime))
+    std::string                              tenant  = tenantFromDb(databases[ix]);
+    std::map<std::string, CachedSubSaved*>&  tSavedV = savedV[tenant];
+    std::vector<CachedSubSaved*>             flushV;
+    std::vector<CachedSubscription*>         changedV;
+    std::map<std::string, long long>         presentV;
+
+    //
+    // 2. Flush counters
+    //
+    for (std::map<std::string, CachedSubSaved*>::iterator it = tSavedV.begin(); it != tSavedV.end(); ++it)
     {
-      // cssP->lastNotificationTime older than what's currently in DB => throw away
-      cssP->lastNotificationTime = 0;
+      if (it->second->count != 0)
+      {
+        flushV.push_back(it->second);
+      }
     }
-    cSubP = cSubP->next;
-  }
 
+    mongoSubCacheUpdate(tenant, flushV);
 
-  //
-  // 4. Update 'count' for each item in savedSubV where count != 0
-  // 5. Update 'lastNotificationTime' foreach item in savedSubV where lastNotificationTime != 0
-  //
-  cSubP = subCache.head;
-  while (cSubP != NULL)
-  {
-    CachedSubSaved* cssP = savedSubV[cSubP->subscriptionId];
 
-    if (cssP == NULL)
+    //
+    // 3. Read changes
+    //
+    if (mongoSubCacheDelta(databases[ix], since, &changedV, &presentV) == false)
     {
-      cSubP = cSubP->next;
+      LM_E(("Runtime Error (error synchronizing subscription cache for DB '%s')", databases[ix].c_str()));
+
+      for (unsigned int cIx = 0; cIx < changedV.size(); ++cIx)
+      {
+        subCacheItemDestroy(changedV[cIx]);
+        delete changedV[cIx];
+      }
+
       continue;
     }
 
-    std::string tenant = (cSubP->tenant == NULL)? "" : cSubP->tenant;
 
-    mongoSubCacheUpdate(tenant, cSubP->subscriptionId, cssP->count, cssP->lastNotificationTime);
-    cSubP = cSubP->next;
+    //
+    // 4. Apply changes
+    //
+    cacheSemTake(__FUNCTION__, "Synchronizing subscription cache (applying changes)");
+    subCacheDeltaApply(tenant, changedV, presentV, tSavedV);
+    cacheSemGive(__FUNCTION__, "Synchronizing subscription cache (applying changes)");
   }
 
 
   //
-  // 6. Free the vector savedSubV
+  // 5. Free the saved items
   //
-  for (std::map<std::string, CachedSubSaved*>::iterator it = savedSubV.begin(); it != savedSubV.end(); ++it)
+  for (std::map<std::string, std::map<std::string, CachedSubSaved*> >::iterator tIt = savedV.begin(); tIt != savedV.end(); ++tIt)
   {
-    delete it->second;
+    for (std::map<std::string, CachedSubSaved*>::iterator it = tIt->second.begin(); it != tIt->second.end(); ++it)
+    {
+      delete it->second;
+    }
   }
-  savedSubV.clear();
+  savedV.clear();
 
+  subCacheLastSync = syncStart;
+  ++subCache.noOfRefreshes;
 
   subCacheState = ScsIdle;
-  cacheSemGive(__FUNCTION__, "Synchronizing subscription cache");
 }
 
 
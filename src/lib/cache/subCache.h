@@ -27,13 +27,18 @@
 */
 #include <string>
 #include <vector>
+#include <map>
 #include <regex.h>
 
+#include <boost/shared_ptr.hpp>
+
 #include "mongo/client/dbclient.h"
 
 #include "ngsi/NotifyConditionVector.h"
 #include "ngsi10/SubscribeContextRequest.h"
 #include "apiTypesV2/SubscriptionExpression.h"
+#include "mongoBackend/StringFilter.h"
+#include "mongoBackend/GeoFilter.h"
 
 using namespace mongo;
 
@@ -82,6 +87,14 @@ struct EntityInfo
 /* ****************************************************************************
 *
 * CachedSubscription - 
+*
+* A cached subscription is never modified once inserted in the cache, except for
+* 'lastNotificationTime' and 'count', which are only to be modified using atomic
+* operations (see subCacheItemNotified), as readers don't hold any lock.
+*
+* 'stringFilterP' is 'expression.q', parsed once when the subscription enters the cache
+* (empty if there is no q), to be evaluated on every triggering update. In the same way,
+* 'geoFilterP' is the geo part of the expression (geometry, coords and georel), parsed.
 */
 struct CachedSubscription
 {
@@ -95,14 +108,40 @@ struct CachedSubscription
   int64_t                     expirationTime;
   int64_t                     lastNotificationTime;
   int64_t                     count;
+  int64_t                     modificationTime;
   Format                      notifyFormat;
   char*                       reference;
   SubscriptionExpression      expression;
-  struct CachedSubscription*  next;
+  StringFilterP               stringFilterP;
+  GeoFilterP                  geoFilterP;
 };
 
 
 
+/* ****************************************************************************
+*
+* CachedSubscriptionP - 
+*
+* Reference to a cached subscription, that keeps the subscription alive even if it is
+* removed from the cache (or the cache is synchronized) while the reference is in use.
+*/
+typedef boost::shared_ptr<CachedSubscription> CachedSubscriptionP;
+
+
+
+/* ****************************************************************************
+*
+* CachedSubSaved - counters of a cached subscription, to be flushed to the database
+*/
+typedef struct CachedSubSaved
+{
+  std::string  subscriptionId;
+  long long    lastNotificationTime;
+  long long    count;
+} CachedSubSaved;
+
+
+
 /* ****************************************************************************
 *
 * subCacheActive - 
@@ -195,7 +234,7 @@ extern void subCacheItemInsert(CachedSubscription* cSubP);
 *
 * subCacheItemLookup - 
 */
-extern CachedSubscription* subCacheItemLookup(const char* tenant, const char* subscriptionId);
+extern CachedSubscriptionP subCacheItemLookup(const char* tenant, const char* subscriptionId);
 
 
 
@@ -207,6 +246,24 @@ extern int subCacheItemRemove(CachedSubscription* cSubP);
 
 
 
+/* ****************************************************************************
+*
+* subCacheTombstoneAdd - keep a subscription removed from DB out of the cache until the next sync
+*
+* subCacheItemRemove does it, this is for subscriptions removed from DB that were not in the cache.
+*/
+extern void subCacheTombstoneAdd(const char* tenant, const char* subscriptionId);
+
+
+
+/* ****************************************************************************
+*
+* subCacheItemNotified - 
+*/
+extern void subCacheItemNotified(CachedSubscription* cSubP, int64_t notificationTime);
+
+
+
 /* ****************************************************************************
 *
 * subCacheRefresh - 
@@ -223,6 +280,20 @@ extern void subCacheSync(void);
 
 
 
+/* ****************************************************************************
+*
+* subCacheDeltaApply - apply the changes read from DB in a sync for a tenant (see subCacheSync)
+*/
+extern void subCacheDeltaApply
+(
+  const std::string&                              tenant,
+  const std::vector<CachedSubscription*>&         changedV,
+  const std::map<std::string, long long>&         presentV,
+  const std::map<std::string, CachedSubSaved*>&   savedV
+);
+
+
+
 /* ****************************************************************************
 *
 * subCacheMatch - 
@@ -234,7 +305,7 @@ extern void subCacheMatch
   const char*                        entityId,
   const char*                        entityType,
   const char*                        attr,
-  std::vector<CachedSubscription*>*  subVecP
+  std::vector<CachedSubscriptionP>*  subVecP
 );
 
 
@@ -242,6 +313,9 @@ extern void subCacheMatch
 /* ****************************************************************************
 *
 * subCacheMatch - 
+*
+* If the location of the updated entity is known (locationP != NULL), subscriptions whose
+* geo filter cannot match that location are not returned.
 */
 extern void subCacheMatch
 (
@@ -250,7 +324,8 @@ extern void subCacheMatch
   const char*                        entityId,
   const char*                        entityType,
   const std::vector<std::string>&    attrV,
-  std::vector<CachedSubscription*>*  subVecP
+  std::vector<CachedSubscriptionP>*  subVecP,
+  const orion::Point*                locationP = NULL
 );
 
 
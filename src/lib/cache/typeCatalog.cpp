@@ -0,0 +1,491 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <pthread.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "mongoBackend/mongoQueryTypes.h"
+#include "cache/typeCatalog.h"
+
+
+
+/* ****************************************************************************
+*
+* TypeCatalogJournal - the writes of a tenant while it is being loaded
+*
+* The journal is kept while there is some load of the tenant in progress (the request path
+* and the reloader thread may load the same tenant at the same time), so each load replays
+* the changes from its own position on. 'first' is the position of changes[0].
+*/
+typedef struct TypeCatalogJournal
+{
+  int                             loads;
+  unsigned long long              first;
+  std::vector<TypeCatalogChange>  changes;
+
+  TypeCatalogJournal(): loads(0), first(0) {}
+} TypeCatalogJournal;
+
+
+
+/* ****************************************************************************
+*
+* catalogs - the catalogs of the loaded tenants
+*/
+static std::map<std::string, TypeCatalog>         catalogs;
+static std::map<std::string, TypeCatalogJournal>  journals;
+static bool                                       catalogEnabled = false;
+static pthread_mutex_t                            catalogMutex   = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+/* ****************************************************************************
+*
+* changeApply - apply an entity write to a catalog
+*/
+static void changeApply(TypeCatalog* catalogP, const TypeCatalogChange& change)
+{
+  std::map<std::string, TypeCatalogEntry>&  types = (*catalogP)[change.servicePath];
+  TypeCatalogEntry&                         entry = types[change.entityType];
+
+  if (change.existed)
+  {
+    entry.count -= 1;
+
+    for (TypeCatalogAttrs::const_iterator aIt = change.oldAttrs.begin(); aIt != change.oldAttrs.end(); ++aIt)
+    {
+      std::map<std::string, TypeCatalogAttr>::iterator attrIt = entry.attrs.find(aIt->first);
+
+      if ((attrIt != entry.attrs.end()) && (--attrIt->second.count <= 0))
+      {
+        entry.attrs.erase(attrIt);
+      }
+    }
+  }
+
+  if (change.exists)
+  {
+    entry.count += 1;
+
+    for (TypeCatalogAttrs::const_iterator aIt = change.newAttrs.begin(); aIt != change.newAttrs.end(); ++aIt)
+    {
+      TypeCatalogAttr& attr = entry.attrs[aIt->first];
+
+      attr.count += 1;
+      attr.type   = aIt->second;
+    }
+  }
+
+  if (entry.count <= 0)
+  {
+    types.erase(change.entityType);
+
+    if (types.size() == 0)
+    {
+      catalogP->erase(change.servicePath);
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* loadEnd - a load of the tenant finished (the mutex must be taken)
+*/
+static void loadEnd(const std::string& tenant)
+{
+  std::map<std::string, TypeCatalogJournal>::iterator it = journals.find(tenant);
+
+  if ((it != journals.end()) && (--it->second.loads <= 0))
+  {
+    journals.erase(it);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* servicePathMatch - 
+*
+* Same semantics as the servicePath filter used in entity queries. Entities without
+* servicePath ("") are in the default servicePath.
+*/
+static bool servicePathMatch(const std::string& servicePath, const std::vector<std::string>& servicePathV)
+{
+  if (servicePathV.size() == 0)
+  {
+    return true;
+  }
+
+  for (unsigned int ix = 0; ix < servicePathV.size(); ++ix)
+  {
+    const std::string& sp = servicePathV[ix];
+
+    if ((servicePath == "") && ((sp == "/") || (sp == "/#")))
+    {
+      return true;
+    }
+
+    if ((sp.size() >= 2) && (sp.substr(sp.size() - 2) == "/#"))
+    {
+      std::string path = sp.substr(0, sp.size() - 1);  // keeping the trailing '/'
+
+      if ((servicePath == path.substr(0, path.size() - 1)) || (servicePath.compare(0, path.size(), path) == 0))
+      {
+        return true;
+      }
+    }
+    else if (servicePath == sp)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogInit - 
+*/
+void typeCatalogInit(void)
+{
+  catalogEnabled = true;
+}
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogReloaderThread - 
+*/
+static void* typeCatalogReloaderThread(void* vP)
+{
+  int interval = *((int*) vP);
+
+  delete (int*) vP;
+
+  while (1)
+  {
+    sleep(interval);
+    typeCatalogReloadAll();
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogStart - 
+*/
+void typeCatalogStart(int interval)
+{
+  pthread_t  tid;
+  int        ret;
+
+  if ((interval <= 0) || !catalogEnabled)
+  {
+    return;
+  }
+
+  ret = pthread_create(&tid, NULL, typeCatalogReloaderThread, new int(interval));
+
+  if (ret != 0)
+  {
+    LM_E(("Runtime Error (error creating thread: %d)", ret));
+    return;
+  }
+  pthread_detach(tid);
+}
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogEnabled - 
+*/
+bool typeCatalogEnabled(void)
+{
+  return catalogEnabled;
+}
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogLoaded - 
+*/
+bool typeCatalogLoaded(const std::string& tenant)
+{
+  bool loaded;
+
+  pthread_mutex_lock(&catalogMutex);
+  loaded = (catalogs.find(tenant) != catalogs.end());
+  pthread_mutex_unlock(&catalogMutex);
+
+  return loaded;
+}
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogLoadStart - 
+*/
+unsigned long long typeCatalogLoadStart(const std::string& tenant)
+{
+  unsigned long long start;
+
+  pthread_mutex_lock(&catalogMutex);
+
+  TypeCatalogJournal& journal = journals[tenant];
+
+  journal.loads += 1;
+  start = journal.first + journal.changes.size();
+
+  pthread_mutex_unlock(&catalogMutex);
+
+  return start;
+}
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogLoadAbort - 
+*/
+void typeCatalogLoadAbort(const std::string& tenant)
+{
+  pthread_mutex_lock(&catalogMutex);
+  loadEnd(tenant);
+  pthread_mutex_unlock(&catalogMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogSet - 
+*/
+void typeCatalogSet(const std::string& tenant, TypeCatalog* catalogP, unsigned long long start)
+{
+  unsigned int replayed = 0;
+  size_t       size;
+
+  pthread_mutex_lock(&catalogMutex);
+
+  std::map<std::string, TypeCatalogJournal>::iterator it = journals.find(tenant);
+
+  if (it != journals.end())
+  {
+    const TypeCatalogJournal& journal = it->second;
+
+    for (unsigned long long ix = start - journal.first; ix < journal.changes.size(); ++ix)
+    {
+      changeApply(catalogP, journal.changes[ix]);
+      ++replayed;
+    }
+  }
+
+  loadEnd(tenant);
+
+  TypeCatalog& catalog = catalogs[tenant];
+
+  catalog.swap(*catalogP);
+  catalogP->clear();
+  size = catalog.size();
+
+  pthread_mutex_unlock(&catalogMutex);
+
+  LM_T(LmtTypeCatalog, ("type catalog of tenant '%s' set (%zu servicePaths, %u writes replayed)",
+                        tenant.c_str(), size, replayed));
+}
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogGet - 
+*/
+bool typeCatalogGet(const std::string& tenant, TypeCatalog* catalogP)
+{
+  bool loaded = false;
+
+  pthread_mutex_lock(&catalogMutex);
+
+  std::map<std::string, TypeCatalog>::iterator it = catalogs.find(tenant);
+
+  if (it != catalogs.end())
+  {
+    *catalogP = it->second;
+    loaded    = true;
+  }
+
+  pthread_mutex_unlock(&catalogMutex);
+
+  return loaded;
+}
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogApply - 
+*/
+void typeCatalogApply(const std::string& tenant, const TypeCatalogChange& change)
+{
+  if (!catalogEnabled || (!change.existed && !change.exists))
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&catalogMutex);
+
+  // A load in progress replays the change on the catalog it is reading
+  std::map<std::string, TypeCatalogJournal>::iterator jIt = journals.find(tenant);
+
+  if (jIt != journals.end())
+  {
+    jIt->second.changes.push_back(change);
+  }
+
+  // If not loaded, the change will be read from the database when it is loaded
+  std::map<std::string, TypeCatalog>::iterator it = catalogs.find(tenant);
+
+  if (it != catalogs.end())
+  {
+    changeApply(&it->second, change);
+  }
+
+  pthread_mutex_unlock(&catalogMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogTypes - 
+*/
+bool typeCatalogTypes
+(
+  const std::string&                         tenant,
+  const std::vector<std::string>&            servicePathV,
+  std::map<std::string, TypeCatalogEntry>*   typesP
+)
+{
+  pthread_mutex_lock(&catalogMutex);
+
+  std::map<std::string, TypeCatalog>::const_iterator it = catalogs.find(tenant);
+
+  if (it == catalogs.end())
+  {
+    pthread_mutex_unlock(&catalogMutex);
+    return false;
+  }
+
+  for (TypeCatalog::const_iterator spIt = it->second.begin(); spIt != it->second.end(); ++spIt)
+  {
+    if (!servicePathMatch(spIt->first, servicePathV))
+    {
+      continue;
+    }
+
+    for (std::map<std::string, TypeCatalogEntry>::const_iterator tIt = spIt->second.begin(); tIt != spIt->second.end(); ++tIt)
+    {
+      TypeCatalogEntry& entry = (*typesP)[tIt->first];
+
+      entry.count += tIt->second.count;
+
+      for (std::map<std::string, TypeCatalogAttr>::const_iterator aIt = tIt->second.attrs.begin(); aIt != tIt->second.attrs.end(); ++aIt)
+      {
+        TypeCatalogAttr& attr = entry.attrs[aIt->first];
+
+        attr.count += aIt->second.count;
+        if (attr.type == "")
+        {
+          attr.type = aIt->second.type;
+        }
+      }
+    }
+  }
+
+  pthread_mutex_unlock(&catalogMutex);
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogReloadAll - 
+*
+* The database is read without holding the catalog mutex, so the entity writes (and the
+* type queries) go on meanwhile. The writes done during the reload of a tenant are replayed
+* on the catalog read (see typeCatalogSet).
+*/
+void typeCatalogReloadAll(void)
+{
+  std::vector<std::string> tenants;
+
+  pthread_mutex_lock(&catalogMutex);
+  for (std::map<std::string, TypeCatalog>::iterator it = catalogs.begin(); it != catalogs.end(); ++it)
+  {
+    tenants.push_back(it->first);
+  }
+  pthread_mutex_unlock(&catalogMutex);
+
+  for (unsigned int ix = 0; ix < tenants.size(); ++ix)
+  {
+    LM_T(LmtTypeCatalog, ("reloading the type catalog of tenant '%s'", tenants[ix].c_str()));
+    mongoTypeCatalogLoad(tenants[ix]);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogRelease - 
+*/
+void typeCatalogRelease(void)
+{
+  pthread_mutex_lock(&catalogMutex);
+  catalogs.clear();
+  journals.clear();
+  pthread_mutex_unlock(&catalogMutex);
+}
@@ -0,0 +1,237 @@
+#ifndef SRC_LIB_CACHE_TYPECATALOG_H_
+#define SRC_LIB_CACHE_TYPECATALOG_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+#include <map>
+
+
+
+/* ****************************************************************************
+*
+* Entity type catalog -
+*
+* Keeps, for each tenant, servicePath and entity type, the number of entities and the
+* attributes of those entities (with the number of entities having each attribute and the
+* type of the attribute), so that the type queries (GET /v2/types, GET /v1/contextTypes, etc.)
+* don't need to aggregate the whole entities collection.
+*
+* The catalog of a tenant is loaded from the database the first time it is needed (see
+* mongoTypeCatalogLoad) and then maintained by the entity writes done by this broker (see
+* typeCatalogApply). As other brokers may write the same database, the catalogs of all the
+* loaded tenants are also reloaded periodically (see typeCatalogStart).
+*
+* While a tenant is being loaded, its entity writes are also kept in a journal, and they are
+* replayed on the catalog read from the database before setting it (see typeCatalogSet), so
+* a load is never discarded because of the writes done meanwhile. As the database is not read
+* at a single point in time, the writes that the load already saw are counted twice, until the
+* next reload.
+*/
+
+
+
+/* ****************************************************************************
+*
+* TypeCatalogAttrs - attribute name -> attribute type, of an entity
+*/
+typedef std::map<std::string, std::string> TypeCatalogAttrs;
+
+
+
+/* ****************************************************************************
+*
+* TypeCatalogAttr -
+*/
+typedef struct TypeCatalogAttr
+{
+  long long    count;
+  std::string  type;
+
+  TypeCatalogAttr(): count(0) {}
+} TypeCatalogAttr;
+
+
+
+/* ****************************************************************************
+*
+* TypeCatalogEntry - the entities of an entity type
+*/
+typedef struct TypeCatalogEntry
+{
+  long long                               count;
+  std::map<std::string, TypeCatalogAttr>  attrs;
+
+  TypeCatalogEntry(): count(0) {}
+} TypeCatalogEntry;
+
+
+
+/* ****************************************************************************
+*
+* TypeCatalog - the catalog of a tenant: servicePath -> entity type -> entry
+*
+* Entities without servicePath or without type (created by old versions or by NGSIv1) are
+* kept under the "" servicePath and type.
+*/
+typedef std::map<std::string, std::map<std::string, TypeCatalogEntry> > TypeCatalog;
+
+
+
+/* ****************************************************************************
+*
+* TypeCatalogChange - an entity write, to be applied with typeCatalogApply
+*
+* An entity creation has 'existed' false, a removal has 'exists' false. The type and
+* servicePath of an entity never change.
+*/
+typedef struct TypeCatalogChange
+{
+  std::string       servicePath;
+  std::string       entityType;
+  bool              existed;
+  bool              exists;
+  TypeCatalogAttrs  oldAttrs;
+  TypeCatalogAttrs  newAttrs;
+
+  TypeCatalogChange(): existed(false), exists(false) {}
+} TypeCatalogChange;
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogInit - enable the catalog
+*/
+extern void typeCatalogInit(void);
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogStart - start a thread that reloads the loaded catalogs every 'interval' seconds
+*/
+extern void typeCatalogStart(int interval);
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogEnabled -
+*/
+extern bool typeCatalogEnabled(void);
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogLoaded - is the catalog of the tenant in memory?
+*/
+extern bool typeCatalogLoaded(const std::string& tenant);
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogLoadStart - start journaling the writes of a tenant, before reading its catalog
+*
+* Returns the position in the journal to be given to typeCatalogSet.
+*/
+extern unsigned long long typeCatalogLoadStart(const std::string& tenant);
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogLoadAbort - the catalog of the tenant could not be read
+*/
+extern void typeCatalogLoadAbort(const std::string& tenant);
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogSet - set the catalog of a tenant, as read from the database
+*
+* The writes journaled since 'start' (see typeCatalogLoadStart) are applied to *catalogP
+* and then it is taken as the catalog of the tenant (*catalogP is left empty).
+*/
+extern void typeCatalogSet(const std::string& tenant, TypeCatalog* catalogP, unsigned long long start);
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogGet - get a copy of the catalog of a tenant (false if not loaded)
+*/
+extern bool typeCatalogGet(const std::string& tenant, TypeCatalog* catalogP);
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogApply - apply an entity write to the catalog of the tenant (if loaded)
+*
+* If the tenant is being loaded, the write is also journaled.
+*/
+extern void typeCatalogApply(const std::string& tenant, const TypeCatalogChange& change);
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogTypes -
+*
+* The entity types of the entities in the servicePaths (the same servicePath vector that
+* is used in queries, i.e. "/#" ending servicePaths include the descendants, and an empty
+* vector means all the servicePaths), sorted by type and merging the servicePaths.
+*
+* Returns false if the catalog of the tenant is not loaded.
+*/
+extern bool typeCatalogTypes
+(
+  const std::string&                         tenant,
+  const std::vector<std::string>&            servicePathV,
+  std::map<std::string, TypeCatalogEntry>*   typesP
+);
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogReloadAll - reload the catalogs of all the loaded tenants
+*/
+extern void typeCatalogReloadAll(void);
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogRelease - unload all the catalogs
+*/
+extern void typeCatalogRelease(void);
+
+#endif  // SRC_LIB_CACHE_TYPECATALOG_H_
@@ -0,0 +1,238 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/Arena.h"
+
+
+
+/* ****************************************************************************
+*
+* ARENA_ALIGN - alignment of the pointers returned by Arena::alloc
+*/
+#define ARENA_ALIGN         sizeof(double)
+#define ARENA_HEADER_SIZE   ((sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+
+
+/* ****************************************************************************
+*
+* Per thread cache of free blocks - 
+*
+* A ConnectionInfo is created and destroyed by the same thread of the HTTP server, so
+* the blocks released at the end of a request are used again by the next one served by
+* the thread, without any locking.
+*/
+static __thread ArenaBlock*  freeBlockList  = NULL;
+static __thread int          freeBlocks     = 0;
+
+
+
+/* ****************************************************************************
+*
+* blockData - 
+*/
+static inline char* blockData(ArenaBlock* blockP)
+{
+  return (char*) blockP + ARENA_HEADER_SIZE;
+}
+
+
+
+/* ****************************************************************************
+*
+* blockGet - 
+*/
+static ArenaBlock* blockGet(size_t size)
+{
+  ArenaBlock* blockP;
+
+  if ((size <= ARENA_BLOCK_SIZE) && (freeBlockList != NULL))
+  {
+    blockP        = freeBlockList;
+    freeBlockList = blockP->next;
+    --freeBlocks;
+  }
+  else
+  {
+    if (size < ARENA_BLOCK_SIZE)
+    {
+      size = ARENA_BLOCK_SIZE;
+    }
+
+    if ((blockP = (ArenaBlock*) malloc(ARENA_HEADER_SIZE + size)) == NULL)
+    {
+      return NULL;
+    }
+
+    blockP->size = size;
+  }
+
+  blockP->next = NULL;
+  blockP->used = 0;
+
+  return blockP;
+}
+
+
+
+/* ****************************************************************************
+*
+* blockPut - 
+*/
+static void blockPut(ArenaBlock* blockP)
+{
+  if ((blockP->size == ARENA_BLOCK_SIZE) && (freeBlocks < ARENA_BLOCK_CACHE_SIZE))
+  {
+    blockP->next  = freeBlockList;
+    freeBlockList = blockP;
+    ++freeBlocks;
+  }
+  else
+  {
+    free(blockP);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* Arena::Arena - 
+*/
+Arena::Arena(): blockList(NULL), bytes(0)
+{
+}
+
+
+
+/* ****************************************************************************
+*
+* Arena::~Arena - 
+*/
+Arena::~Arena()
+{
+  release();
+}
+
+
+
+/* ****************************************************************************
+*
+* Arena::alloc - 
+*
+* Returns NULL if the heap is exhausted.
+*/
+void* Arena::alloc(size_t size)
+{
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+  if ((blockList != NULL) && (blockList->size - blockList->used >= size))
+  {
+    void* p = blockData(blockList) + blockList->used;
+
+    blockList->used += size;
+    bytes           += size;
+
+    return p;
+  }
+
+  ArenaBlock* blockP = blockGet(size > ARENA_BLOCK_SIZE / 2 ? size : ARENA_BLOCK_SIZE);
+
+  if (blockP == NULL)
+  {
+    return NULL;
+  }
+
+  blockP->used  = size;
+  bytes        += size;
+
+  //
+  // Big chunks take a block of their own, which is put after the current one, so that
+  // the room left in the current block can still be used
+  //
+  if ((blockList != NULL) && (blockP->size != ARENA_BLOCK_SIZE))
+  {
+    blockP->next    = blockList->next;
+    blockList->next = blockP;
+  }
+  else
+  {
+    blockP->next = blockList;
+    blockList    = blockP;
+  }
+
+  return blockData(blockP);
+}
+
+
+
+/* ****************************************************************************
+*
+* Arena::strndup - copy of the first 'len' bytes of 's', zero-terminated
+*/
+char* Arena::strndup(const char* s, size_t len)
+{
+  char* p = (char*) alloc(len + 1);
+
+  if (p != NULL)
+  {
+    memcpy(p, s, len);
+    p[len] = 0;
+  }
+
+  return p;
+}
+
+
+
+/* ****************************************************************************
+*
+* Arena::release - give back all the memory of the arena
+*/
+void Arena::release(void)
+{
+  while (blockList != NULL)
+  {
+    ArenaBlock* next = blockList->next;
+
+    blockPut(blockList);
+    blockList = next;
+  }
+
+  bytes = 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* Arena::allocated - number of bytes allocated in the arena
+*/
+size_t Arena::allocated(void) const
+{
+  return bytes;
+}
@@ -0,0 +1,92 @@
+#ifndef SRC_LIB_COMMON_ARENA_H_
+#define SRC_LIB_COMMON_ARENA_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stddef.h>
+
+
+
+/* ****************************************************************************
+*
+* ARENA_BLOCK_SIZE - size of the blocks an Arena allocates from
+*
+* Requests bigger than half a block get a block of their own.
+*/
+#define ARENA_BLOCK_SIZE         (16 * 1024)
+
+/* ****************************************************************************
+*
+* ARENA_BLOCK_CACHE_SIZE - number of free blocks each thread keeps for reuse
+*/
+#define ARENA_BLOCK_CACHE_SIZE   16
+
+
+
+/* ****************************************************************************
+*
+* ArenaBlock - 
+*/
+typedef struct ArenaBlock
+{
+  ArenaBlock*  next;
+  size_t       size;   // usable bytes after the header
+  size_t       used;
+} ArenaBlock;
+
+
+
+/* ****************************************************************************
+*
+* Arena - bump allocator for memory that lives as long as a request
+*
+* Memory is taken from the current block by just moving a pointer, and all of it is
+* given back at once when the arena is released (or destroyed). Nothing allocated in
+* an arena may be freed on its own.
+*
+* Blocks of the standard size are not given back to the heap, but kept in a (per thread)
+* cache of free blocks, so that in the steady state serving a request does not call
+* malloc/free for the arena.
+*/
+class Arena
+{
+ public:
+  Arena();
+  ~Arena();
+
+  void*   alloc(size_t size);
+  char*   strndup(const char* s, size_t len);
+  void    release(void);
+  size_t  allocated(void) const;
+
+ private:
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+
+  ArenaBlock*  blockList;    // the first one is the current block
+  size_t       bytes;
+};
+
+#endif  // SRC_LIB_COMMON_ARENA_H_
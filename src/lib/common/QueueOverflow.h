@@ -0,0 +1,58 @@
+#ifndef SRC_LIB_COMMON_QUEUEOVERFLOW_H
+#define SRC_LIB_COMMON_QUEUEOVERFLOW_H
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+
+#include <stddef.h>
+
+/* ****************************************************************************
+*
+* template class QueueOverflow<> - interface of the bounded queues
+*
+* A bounded queue that rejects new elements when full (try_push returns false)
+* and blocks the consumers while it is empty. Implemented by SyncQOverflow
+* (mutex based) and RingQOverflow (lock-free).
+*/
+template <typename Data>
+class QueueOverflow
+{
+public:
+    virtual ~QueueOverflow() {}
+
+    /* Add an element, false if the queue is full */
+    virtual bool try_push(Data element) = 0;
+
+    /* Take an element, waiting for it if the queue is empty */
+    virtual Data pop() = 0;
+
+    /* Take between 1 and 'max' elements, waiting if the queue is empty.
+       If 'leftP' is not NULL, the number of elements left in the queue is returned in it */
+    virtual size_t popBatch(Data* elements, size_t max, size_t* leftP) = 0;
+
+    /* Current number of elements (an estimation, as other threads may be using the queue) */
+    virtual size_t size() const = 0;
+};
+#endif // SRC_LIB_COMMON_QUEUEOVERFLOW_H
@@ -0,0 +1,324 @@
+#ifndef SRC_LIB_COMMON_RINGQOVERFLOW_H
+#define SRC_LIB_COMMON_RINGQOVERFLOW_H
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "common/QueueOverflow.h"
+
+/* ****************************************************************************
+*
+* RING_Q_CACHE_LINE - to keep the producer and consumer positions apart
+*/
+#define RING_Q_CACHE_LINE 64
+
+/* ****************************************************************************
+*
+* RING_Q_SPIN - attempts to dequeue before a consumer goes to sleep
+*/
+#define RING_Q_SPIN 64
+
+/* ****************************************************************************
+*
+* template class RingQOverflow<> - lock-free bounded multi-producer/multi-consumer queue
+*
+* Ring buffer in which every cell has a sequence number telling whether it is free
+* for the producer that claims position 'pos' (sequence == pos) or holds an element
+* for the consumer that claims it (sequence == pos + 1). Producers and consumers claim
+* positions with a compare-and-swap on their own counter, so they only contend with
+* each other on the cells, never on a lock.
+*
+* Consumers only sleep (on a condition variable) when the queue is empty, and producers
+* only take the mutex to wake them up if there is a consumer sleeping. popBatch takes
+* several consecutive elements with a single compare-and-swap.
+*/
+template <typename Data>
+class RingQOverflow : public QueueOverflow<Data>
+{
+private:
+    struct Cell
+    {
+      volatile size_t sequence;
+      Data            data;
+    };
+
+    Cell*                      buffer;
+    size_t                     mask;
+    size_t                     max_size;
+
+    char                       pad0[RING_Q_CACHE_LINE];
+    volatile size_t            enqueuePos;
+    char                       pad1[RING_Q_CACHE_LINE];
+    volatile size_t            dequeuePos;
+    char                       pad2[RING_Q_CACHE_LINE];
+
+    volatile int               waiters;
+    boost::mutex               mtx;
+    boost::condition_variable  addedElement;
+
+    size_t try_popBatch(Data* elements, size_t max);
+    void   wakeup();
+
+public:
+    RingQOverflow(size_t sz);
+    ~RingQOverflow();
+    bool try_push(Data element);
+    Data pop();
+    size_t popBatch(Data* elements, size_t max, size_t* leftP);
+    size_t size() const;
+};
+
+/* ****************************************************************************
+*
+* RingQOverflow<Data>::RingQOverflow -
+*
+* The ring has the smallest power of two cells able to hold 'sz' elements
+*/
+template <typename Data>
+RingQOverflow<Data>::RingQOverflow(size_t sz): max_size(sz), enqueuePos(0), dequeuePos(0), waiters(0)
+{
+  size_t cells = 2;
+
+  while (cells < sz)
+    {
+      cells *= 2;
+    }
+
+  buffer = new Cell[cells];
+  mask   = cells - 1;
+
+  for (size_t ix = 0; ix < cells; ++ix)
+    {
+      buffer[ix].sequence = ix;
+    }
+}
+
+/* ****************************************************************************
+*
+* RingQOverflow<Data>::~RingQOverflow -
+*/
+template <typename Data>
+RingQOverflow<Data>::~RingQOverflow()
+{
+  delete[] buffer;
+}
+
+/* ****************************************************************************
+*
+* RingQOverflow<Data>::try_push -
+*/
+template <typename Data>
+bool RingQOverflow<Data>::try_push(Data element)
+{
+  Cell*   cell;
+  size_t  pos = enqueuePos;
+
+  for (;;)
+    {
+      cell = &buffer[pos & mask];
+
+      intptr_t dif = (intptr_t) cell->sequence - (intptr_t) pos;
+
+      if (dif == 0)
+        {
+          if ((intptr_t) (pos - dequeuePos) >= (intptr_t) max_size)
+            {
+              return false;
+            }
+
+          if (__sync_bool_compare_and_swap(&enqueuePos, pos, pos + 1))
+            {
+              break;
+            }
+        }
+      else if (dif < 0)
+        {
+          return false;
+        }
+
+      pos = enqueuePos;
+    }
+
+  cell->data = element;
+  __sync_synchronize();
+  cell->sequence = pos + 1;
+
+  __sync_synchronize();
+  if (waiters != 0)
+    {
+      wakeup();
+    }
+
+  return true;
+}
+
+/* ****************************************************************************
+*
+* RingQOverflow<Data>::try_popBatch - take up to 'max' elements without waiting
+*
+* Returns the number of elements taken, 0 if the queue is empty
+*/
+template <typename Data>
+size_t RingQOverflow<Data>::try_popBatch(Data* elements, size_t max)
+{
+  size_t  pos = dequeuePos;
+  size_t  n;
+
+  for (;;)
+    {
+      // Consecutive cells already holding an element
+      for (n = 0; n < max; ++n)
+        {
+          if ((intptr_t) buffer[(pos + n) & mask].sequence - (intptr_t) (pos + n + 1) != 0)
+            {
+              break;
+            }
+        }
+
+      if (n == 0)
+        {
+          intptr_t dif = (intptr_t) buffer[pos & mask].sequence - (intptr_t) (pos + 1);
+
+          if (dif < 0)
+            {
+              return 0;
+            }
+        }
+      else if (__sync_bool_compare_and_swap(&dequeuePos, pos, pos + n))
+        {
+          break;
+        }
+
+      pos = dequeuePos;
+    }
+
+  for (size_t ix = 0; ix < n; ++ix)
+    {
+      elements[ix] = buffer[(pos + ix) & mask].data;
+    }
+
+  __sync_synchronize();
+
+  for (size_t ix = 0; ix < n; ++ix)
+    {
+      buffer[(pos + ix) & mask].sequence = pos + ix + mask + 1;
+    }
+
+  return n;
+}
+
+/* ****************************************************************************
+*
+* RingQOverflow<Data>::wakeup - wake up a sleeping consumer
+*/
+template <typename Data>
+void RingQOverflow<Data>::wakeup()
+{
+  boost::mutex::scoped_lock lock(mtx);
+
+  addedElement.notify_one();
+}
+
+/* ****************************************************************************
+*
+* RingQOverflow<Data>::popBatch -
+*
+* After spinning for a while, the consumer registers itself as waiter before
+* checking the queue for the last time (under the mutex), so either it sees the
+* element of a concurrent try_push or the producer sees it waiting and wakes it up.
+*/
+template <typename Data>
+size_t RingQOverflow<Data>::popBatch(Data* elements, size_t max, size_t* leftP)
+{
+  size_t n;
+
+  for (int ix = 0; ix < RING_Q_SPIN; ++ix)
+    {
+      if ((n = try_popBatch(elements, max)) != 0)
+        {
+          if (leftP != NULL)
+            {
+              *leftP = size();
+            }
+          return n;
+        }
+    }
+
+  boost::mutex::scoped_lock lock(mtx);
+
+  __sync_fetch_and_add(&waiters, 1);
+  while ((n = try_popBatch(elements, max)) == 0)
+    {
+      addedElement.wait(lock);
+    }
+  __sync_fetch_and_sub(&waiters, 1);
+
+  size_t left = size();
+
+  // Elements left for another sleeping consumer
+  if ((waiters != 0) && (left != 0))
+    {
+      addedElement.notify_one();
+    }
+
+  if (leftP != NULL)
+    {
+      *leftP = left;
+    }
+  return n;
+}
+
+/* ****************************************************************************
+*
+* RingQOverflow<Data>::pop -
+*/
+template <typename Data>
+Data RingQOverflow<Data>::pop()
+{
+  Data element;
+
+  popBatch(&element, 1, NULL);
+  return element;
+}
+
+/* ****************************************************************************
+*
+* RingQOverflow<Data>::size -
+*/
+template <typename Data>
+size_t RingQOverflow<Data>::size() const
+{
+  size_t   deq = dequeuePos;
+  intptr_t n   = (intptr_t) (enqueuePos - deq);
+
+  return (n < 0)? 0 : n;
+}
+#endif // SRC_LIB_COMMON_RINGQOVERFLOW_H
@@ -31,12 +31,14 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 
+#include "common/QueueOverflow.h"
+
 /* ****************************************************************************
 *
 * template class SyncQOverflow<>-
 */
 template <typename Data>
-class SyncQOverflow
+class SyncQOverflow : public QueueOverflow<Data>
 {
 private:
     std::queue<Data> queue;
@@ -48,6 +50,7 @@ public:
     SyncQOverflow(size_t sz): max_size(sz) {}
     bool try_push(Data element);
     Data pop();
+    size_t popBatch(Data* elements, size_t max, size_t* leftP);
     size_t size() const;
 };
 
@@ -88,6 +91,33 @@ Data SyncQOverflow<Data>::pop()
   return element;
 }
 
+/* ****************************************************************************
+*
+* SyncQOverflow<Data>::popBatch -
+*/
+template <typename Data>
+size_t SyncQOverflow<Data>::popBatch(Data* elements, size_t max, size_t* leftP)
+{
+  boost::mutex::scoped_lock lock(mtx);
+  while(queue.empty())
+    {
+      addedElement.wait(lock);
+    }
+
+  size_t n = 0;
+  while ((n < max) && (!queue.empty()))
+    {
+      elements[n++] = queue.front();
+      queue.pop();
+    }
+
+  if (leftP != NULL)
+    {
+      *leftP = queue.size();
+    }
+  return n;
+}
+
 /* ****************************************************************************
 *
 * SyncQOverflow<Data>::size -
@@ -0,0 +1,307 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+#include <vector>
+
+#include "common/TimerWheel.h"
+
+
+
+/* ****************************************************************************
+*
+* TimerWheelEntry::TimerWheelEntry -
+*/
+TimerWheelEntry::TimerWheelEntry(): prev(NULL), next(NULL), expires(0)
+{
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheelEntry::~TimerWheelEntry -
+*/
+TimerWheelEntry::~TimerWheelEntry()
+{
+  unlink();
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheelEntry::pending - is the entry in a wheel?
+*/
+bool TimerWheelEntry::pending(void) const
+{
+  return next != NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheelEntry::unlink - take the entry out of the list (slot) it is in
+*/
+void TimerWheelEntry::unlink(void)
+{
+  if (next != NULL)
+  {
+    prev->next = next;
+    next->prev = prev;
+    next       = NULL;
+    prev       = NULL;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* slotInit - an empty slot is a list head pointing to itself
+*/
+static void slotInit(TimerWheelEntry* slotP)
+{
+  slotP->next = slotP;
+  slotP->prev = slotP;
+}
+
+
+
+/* ****************************************************************************
+*
+* slotAppend -
+*/
+static void slotAppend(TimerWheelEntry* slotP, TimerWheelEntry* entryP)
+{
+  entryP->prev       = slotP->prev;
+  entryP->next       = slotP;
+  slotP->prev->next  = entryP;
+  slotP->prev        = entryP;
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::TimerWheel -
+*/
+TimerWheel::TimerWheel(unsigned long long now): nextTick(now)
+{
+  for (int ix = 0; ix < TW_ROOT_SIZE; ++ix)
+  {
+    slotInit(&root[ix]);
+  }
+
+  for (int lIx = 0; lIx < TW_LEVELS; ++lIx)
+  {
+    for (int ix = 0; ix < TW_LEVEL_SIZE; ++ix)
+    {
+      slotInit(&level[lIx][ix]);
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::~TimerWheel - the entries still in the wheel are left out of it (not freed)
+*/
+TimerWheel::~TimerWheel()
+{
+  for (int ix = 0; ix < TW_ROOT_SIZE; ++ix)
+  {
+    while (root[ix].next != &root[ix])
+    {
+      root[ix].next->unlink();
+    }
+    root[ix].next = NULL;
+  }
+
+  for (int lIx = 0; lIx < TW_LEVELS; ++lIx)
+  {
+    for (int ix = 0; ix < TW_LEVEL_SIZE; ++ix)
+    {
+      while (level[lIx][ix].next != &level[lIx][ix])
+      {
+        level[lIx][ix].next->unlink();
+      }
+      level[lIx][ix].next = NULL;
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::place - put an entry in the slot corresponding to its expiration
+*
+* Entries already expired go to the slot of the next tick.
+*/
+void TimerWheel::place(TimerWheelEntry* entryP)
+{
+  unsigned long long expires = entryP->expires;
+
+  if (expires < nextTick)
+  {
+    expires = nextTick;
+  }
+  else if (expires - nextTick > TW_MAX_DELTA)
+  {
+    expires = nextTick + TW_MAX_DELTA;
+  }
+
+  unsigned long long delta = expires - nextTick;
+
+  if (delta < TW_ROOT_SIZE)
+  {
+    slotAppend(&root[expires & TW_ROOT_MASK], entryP);
+    return;
+  }
+
+  for (int lIx = 0; lIx < TW_LEVELS; ++lIx)
+  {
+    int shift = TW_ROOT_BITS + (lIx + 1) * TW_LEVEL_BITS;
+
+    if ((lIx == TW_LEVELS - 1) || (delta < (1ULL << shift)))
+    {
+      slotAppend(&level[lIx][(expires >> (shift - TW_LEVEL_BITS)) & TW_LEVEL_MASK], entryP);
+      return;
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::add - add (or move) an entry, to expire at tick 'expires'
+*/
+void TimerWheel::add(TimerWheelEntry* entryP, unsigned long long expires)
+{
+  entryP->unlink();
+  entryP->expires = expires;
+  place(entryP);
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::remove -
+*/
+void TimerWheel::remove(TimerWheelEntry* entryP)
+{
+  entryP->unlink();
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::cascade - move the entries of the current slot of a level to the finer levels
+*
+* Returns the index of the slot, 0 meaning that the next level is to be cascaded too.
+*/
+int TimerWheel::cascade(int levelIx)
+{
+  int               shift = TW_ROOT_BITS + levelIx * TW_LEVEL_BITS;
+  int               ix    = (nextTick >> shift) & TW_LEVEL_MASK;
+  TimerWheelEntry*  slotP = &level[levelIx][ix];
+  TimerWheelEntry   list;
+
+  // Detach the whole slot before placing its entries again, as they may go back to the same slot
+  if (slotP->next != slotP)
+  {
+    list.next        = slotP->next;
+    list.prev        = slotP->prev;
+    list.next->prev  = &list;
+    list.prev->next  = &list;
+    slotInit(slotP);
+
+    while (list.next != &list)
+    {
+      TimerWheelEntry* entryP = list.next;
+
+      entryP->unlink();
+      place(entryP);
+    }
+    list.next = NULL;
+  }
+
+  return ix;
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::advance - process the ticks up to 'now', included
+*
+* The entries expiring in those ticks are taken out of the wheel and added to *expiredP.
+*/
+void TimerWheel::advance(unsigned long long now, std::vector<TimerWheelEntry*>* expiredP)
+{
+  while (nextTick <= now)
+  {
+    int ix = nextTick & TW_ROOT_MASK;
+
+    if (ix == 0)
+    {
+      for (int lIx = 0; lIx < TW_LEVELS; ++lIx)
+      {
+        if (cascade(lIx) != 0)
+        {
+          break;
+        }
+      }
+    }
+
+    TimerWheelEntry* slotP = &root[ix];
+
+    while (slotP->next != slotP)
+    {
+      TimerWheelEntry* entryP = slotP->next;
+
+      entryP->unlink();
+      expiredP->push_back(entryP);
+    }
+
+    ++nextTick;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel::current - the next tick to be processed
+*/
+unsigned long long TimerWheel::current(void) const
+{
+  return nextTick;
+}
@@ -0,0 +1,102 @@
+#ifndef SRC_LIB_COMMON_TIMERWHEEL_H_
+#define SRC_LIB_COMMON_TIMERWHEEL_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <vector>
+
+
+
+/* ****************************************************************************
+*
+* Sizes of the levels of the wheel - 
+*
+* The first level has one slot per tick (256 ticks), and each of the four other levels
+* has 64 slots, each one 64 times larger than the ones of the previous level, so that
+* the wheel covers 2^32 ticks
+*/
+#define TW_ROOT_BITS    8
+#define TW_LEVEL_BITS   6
+#define TW_ROOT_SIZE    (1 << TW_ROOT_BITS)
+#define TW_LEVEL_SIZE   (1 << TW_LEVEL_BITS)
+#define TW_ROOT_MASK    (TW_ROOT_SIZE - 1)
+#define TW_LEVEL_MASK   (TW_LEVEL_SIZE - 1)
+#define TW_LEVELS       4
+#define TW_MAX_DELTA    0xFFFFFFFFULL
+
+
+
+/* ****************************************************************************
+*
+* TimerWheelEntry - an entry of a TimerWheel, to be extended with the data of the timer
+*/
+class TimerWheelEntry
+{
+ public:
+  TimerWheelEntry*    prev;
+  TimerWheelEntry*    next;
+  unsigned long long  expires;
+
+  TimerWheelEntry();
+  virtual ~TimerWheelEntry();
+
+  bool  pending(void) const;
+  void  unlink(void);
+};
+
+
+
+/* ****************************************************************************
+*
+* TimerWheel - hierarchical timing wheel
+*
+* Adding and removing a timer are O(1), regardless of the number of timers and of how
+* far in the future they expire. Timers far in the future are kept in the coarse levels
+* and cascaded down to the finer ones as their time approaches.
+*
+* The wheel has no notion of time units nor clock, the caller advances it up to a given
+* tick (typically, the current second). It is not thread-safe.
+*/
+class TimerWheel
+{
+ public:
+  TimerWheel(unsigned long long now);
+  ~TimerWheel();
+
+  void                add(TimerWheelEntry* entryP, unsigned long long expires);
+  void                remove(TimerWheelEntry* entryP);
+  void                advance(unsigned long long now, std::vector<TimerWheelEntry*>* expiredP);
+  unsigned long long  current(void) const;
+
+ private:
+  TimerWheelEntry     root[TW_ROOT_SIZE];
+  TimerWheelEntry     level[TW_LEVELS][TW_LEVEL_SIZE];
+  unsigned long long  nextTick;
+
+  void  place(TimerWheelEntry* entryP);
+  int   cascade(int levelIx);
+};
+
+#endif  // SRC_LIB_COMMON_TIMERWHEEL_H_
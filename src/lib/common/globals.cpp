@@ -49,6 +49,8 @@ int                    startTime            = -1;
 int                    statisticsTime       = -1;
 OrionExitFunction      orionExitFunction    = NULL;
 static struct timeval  logStartTime;
+static char            transactionIdPrefix[32];
+static int64_t         transactionCounter   = 0;
 bool                   countersStatistics   = false;
 bool                   semWaitStatistics    = false;
 bool                   timingStatistics     = false;
@@ -56,6 +58,30 @@ bool                   notifQueueStatistics = false;
 bool                   checkIdv1            = false;
 
 
+/* ****************************************************************************
+*
+* TRANSACTION_RUNNING_MAX - max value of the running number of a transaction id
+*/
+#define TRANSACTION_RUNNING_MAX  0x7FFFFFFFLL
+
+
+
+/* ****************************************************************************
+*
+* transactionRunningNumber - running number of the 'counter'th transaction (from 1 to 0x7FFFFFFF)
+*/
+inline int transactionRunningNumber(int64_t counter)
+{
+  if (counter == 0)
+  {
+    return 0;
+  }
+
+  return (int) ((counter - 1) % TRANSACTION_RUNNING_MAX) + 1;
+}
+
+
+
 /* ****************************************************************************
 *
 * transactionIdGet - 
@@ -65,18 +91,12 @@ bool                   checkIdv1            = false;
 */
 int transactionIdGet(bool readonly)
 {
-  static int transactionId = 0;
-
   if (readonly == false)
   {
-    ++transactionId;
-    if (transactionId < 0)
-    {
-      transactionId = 1;
-    }
+    return transactionRunningNumber(__sync_add_and_fetch(&transactionCounter, 1));
   }
 
-  return transactionId;
+  return transactionRunningNumber(__sync_fetch_and_add(&transactionCounter, 0));
 }
 
 
@@ -98,29 +118,30 @@ int transactionIdGet(bool readonly)
 *   XXXXXXXXX.123.1  # the VERY first transaction
 *   XXXXXXXXX.124.1  # the first transaction after running number overflow
 *
+* No lock is needed: the transactions are counted with an atomic 64-bit counter, whose value gives
+* both the running number and the number of overflows. The prefix (start time of the broker) is
+* formatted once, in orionInit, and only recalculated after an overflow.
+*
 * The whole thing is stored in the thread variable 'transactionId', supported by the
 * logging library 'liblm'.
 *
 */
 void transactionIdSet(void)
 {
-  static int firstTime = true;
-
-  transSemTake("transactionIdSet", "changing the transaction id");
+  int64_t  counter     = __sync_add_and_fetch(&transactionCounter, 1);
+  int64_t  overflows   = (counter - 1) / TRANSACTION_RUNNING_MAX;
+  int      transaction = transactionRunningNumber(counter);
 
-  int   transaction = transactionIdGet(false);
-
-  if ((firstTime == false) && (transaction == 1))  // Overflow - see function header for explanation
+  if (overflows == 0)
   {
-    logStartTime.tv_usec += 1;
+    snprintf(transactionId, sizeof(transactionId), "%s%011d", transactionIdPrefix, transaction);
   }
+  else
+  {
+    int64_t msecs = (int64_t) logStartTime.tv_sec * 1000 + logStartTime.tv_usec / 1000 + overflows;
 
-  snprintf(transactionId, sizeof(transactionId), "%lu-%03d-%011d",
-           logStartTime.tv_sec, (int) logStartTime.tv_usec / 1000, transaction);
-
-  transSemGive("transactionIdSet", "changing the transaction id");
-
-  firstTime = false;
+    snprintf(transactionId, sizeof(transactionId), "%lu-%03d-%011d", (unsigned long) (msecs / 1000), (int) (msecs % 1000), transaction);
+  }
 }
 
 
@@ -158,6 +179,10 @@ void orionInit
     orionExitFunction(1, "gettimeofday error");
   }
 
+  // Prefix of the transaction ids
+  snprintf(transactionIdPrefix, sizeof(transactionIdPrefix), "%lu-%03d-",
+           logStartTime.tv_sec, (int) logStartTime.tv_usec / 1000);
+
   // Set start time and statisticsTime used by REST interface
   startTime      = logStartTime.tv_sec;
   statisticsTime = startTime;
@@ -139,6 +139,7 @@ extern unsigned           cprForwardLimit;
 extern char               notificationMode[];
 extern bool               noCache;
 extern bool               simulatedNotification;
+extern bool               notifCoalesce;
 
 extern bool               semWaitStatistics;
 extern bool               timingStatistics;
@@ -253,6 +254,7 @@ int transactionIdGet(bool readonly = true);
 * Furthermore, a running number is appended for the transaction.
 * A 32 bit signed number is used, so its max value is 0x7FFFFFFF (2,147,483,647).
 * If the running number overflows, a millisecond is added to the startTime.
+* No lock is taken (the running number comes from an atomic counter).
 *
 * The whole thing is stored in the thread variable 'transactionId', supported by the
 * logging library 'liblm'.
@@ -97,6 +97,37 @@
 #define STATIC_BUFFER_SIZE (32 * 1024) // 32 KB 
 
 
+/* ****************************************************************************
+*
+* JSON_V2_POOL_SIZE - memory taken from the request arena for the DOM of an NGSIv2 payload
+*
+* The payload is parsed in place, so that strings are not copied. This is the room for the
+* values of the DOM, if more is needed it is taken from the heap.
+*/
+#define JSON_V2_POOL_SIZE (8 * 1024) // 8 KB
+
+
+
+/* ****************************************************************************
+*
+* STREAM_RESPONSE_THRESHOLD - responses bigger than this are streamed (chunked encoding)
+*
+* Applies to the responses that can be rendered piece by piece, e.g. the entities of a query.
+* Smaller responses are sent in a single buffer, as always.
+*/
+#define STREAM_RESPONSE_THRESHOLD (64 * 1024) // 64 KB
+
+
+
+/* ****************************************************************************
+*
+* STREAM_BATCH_SIZE - entities read from the database at a time for a streamed response
+*
+* Each batch is rendered in memory and the DB connection is released before sending it.
+*/
+#define STREAM_BATCH_SIZE 100
+
+
 /* ****************************************************************************
 *
 * CONSTANTS RESTINIT - 
@@ -26,6 +26,9 @@
 #include <errno.h>
 #include <time.h>
 #include <map>  // for curl contexts
+#include <string>
+#include <vector>
+#include <algorithm>
 
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
@@ -40,21 +43,37 @@
 * Globals -
 */
 static sem_t           reqSem;
-static sem_t           transSem;
 static sem_t           cacheSem;
-static sem_t           timeStatSem;
 static SemOpType  reqPolicy;
 
 
 
+/* ****************************************************************************
+*
+* Entity semaphores -
+*
+* Under the 'entity' request policy, the entities (and other documents, such as
+* subscriptions) modified by a request are hashed (together with the tenant) into one of
+* ENTITY_SEM_STRIPES mutexes. Requests modifying different entities don't wait for each
+* other (except for hash collisions) and read requests don't wait at all.
+*
+* The entity semaphores taken by a thread are kept in thread local variables, so that
+* reqSemGive can give them back, with no changes in the many exit paths of the mongoBackend
+* operations. entitySemHeld is -1 if the thread holds all the entity semaphores.
+*/
+static pthread_mutex_t  entitySem[ENTITY_SEM_STRIPES];
+static pthread_mutex_t  entitySemTimeMutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread int     entitySemHeldV[ENTITY_SEM_KEYS_MAX];
+static __thread int     entitySemHeld = 0;
+
+
+
 /* ****************************************************************************
 *
 * Time measuring variables - 
 */
 static struct timespec accReqSemTime      = { 0, 0 };
-static struct timespec accTransSemTime    = { 0, 0 };
 static struct timespec accCacheSemTime    = { 0, 0 };
-static struct timespec accTimeStatSemTime = { 0, 0 };
 
 
 
@@ -78,22 +97,15 @@ int semInit(SemOpType _reqPolicy, bool semTimeStat, int shared, int takenInitial
     return -1;
   }
 
-  if (sem_init(&transSem, shared, takenInitially) == -1)
-  {
-    LM_E(("Runtime Error (error initializing 'transactionId' semaphore: %s)", strerror(errno)));
-    return -1;
-  }
-
   if (sem_init(&cacheSem, shared, takenInitially) == -1)
   {
     LM_E(("Runtime Error (error initializing 'cache' semaphore: %s)", strerror(errno)));
     return -1;
   }
 
-  if (sem_init(&timeStatSem, shared, takenInitially) == -1)
+  for (int ix = 0; ix < ENTITY_SEM_STRIPES; ++ix)
   {
-    LM_E(("Runtime Error (error initializing 'timeStat' semaphore: %s)", strerror(errno)));
-    return -1;
+    pthread_mutex_init(&entitySem[ix], NULL);
   }
 
   reqPolicy = _reqPolicy;
@@ -126,7 +138,7 @@ int reqSemTake(const char* who, const char* what, SemOpType reqType, bool* taken
 {
   int r;
 
-  if (reqPolicy == SemNoneOp)
+  if ((reqPolicy == SemNoneOp) || (reqPolicy == SemEntityOp))
   {
     *taken = false;
     return -1;
@@ -175,128 +187,193 @@ int reqSemTake(const char* who, const char* what, SemOpType reqType, bool* taken
 
 /* ****************************************************************************
 *
-* semTimeReqGet - get accumulated req semaphore waiting time
+* entitySemIndex - FNV-1a hash of tenant and key, into an entity semaphore
 */
-float semTimeReqGet(void)
+static int entitySemIndex(const std::string& tenant, const std::string& key)
 {
-  return accReqSemTime.tv_sec + ((float) accReqSemTime.tv_nsec) / 1E9;
-}
+  unsigned int hash = 2166136261U;
 
+  for (unsigned int ix = 0; ix < tenant.size(); ++ix)
+  {
+    hash = (hash ^ (unsigned char) tenant[ix]) * 16777619U;
+  }
 
+  hash = (hash ^ '/') * 16777619U;
 
-/* ****************************************************************************
-*
-* semTimeTransGet - get accumulated trans semaphore waiting time
-*/
-float semTimeTransGet(void)
-{
-  return accTransSemTime.tv_sec + ((float) accTransSemTime.tv_nsec) / 1E9;
+  for (unsigned int ix = 0; ix < key.size(); ++ix)
+  {
+    hash = (hash ^ (unsigned char) key[ix]) * 16777619U;
+  }
+
+  return hash % ENTITY_SEM_STRIPES;
 }
 
 
 
 /* ****************************************************************************
 *
-* semTimeCacheGet - get accumulated cache semaphore waiting time
+* entitySemTake - take the entity semaphores of a write request
+*
+* Only used under the 'entity' request policy (for any other policy, nothing is done and -1 is
+* returned). Each key is typically the id of the entity to be modified. An empty key (e.g. an
+* entity id pattern) or more than ENTITY_SEM_KEYS_MAX different semaphores makes the request
+* take all the entity semaphores.
+*
+* The semaphores are taken in increasing order, so that requests with several keys can't
+* deadlock. They are given back by reqSemGive.
 */
-float semTimeCacheGet(void)
+int entitySemTake(const char* who, const char* what, const std::string& tenant, const std::vector<std::string>& keys)
 {
-  return accCacheSemTime.tv_sec + ((float) accCacheSemTime.tv_nsec)/ 1E9;
-}
+  if ((reqPolicy != SemEntityOp) || (entitySemHeld != 0))
+  {
+    return -1;
+  }
 
+  std::vector<int>  semV;
+  bool              all = false;
 
+  for (unsigned int ix = 0; ix < keys.size(); ++ix)
+  {
+    if (keys[ix] == "")
+    {
+      all = true;
+      break;
+    }
 
-/* ****************************************************************************
-*
-* semTimeTimeStatGet - get accumulated trans semaphore waiting time
-*/
-float semTimeTimeStatGet(void)
-{
-  return accTimeStatSemTime.tv_sec + ((float) accTimeStatSemTime.tv_nsec) / 1E9;
+    semV.push_back(entitySemIndex(tenant, keys[ix]));
+  }
+
+  std::sort(semV.begin(), semV.end());
+  semV.erase(std::unique(semV.begin(), semV.end()), semV.end());
+
+  if (semV.size() > ENTITY_SEM_KEYS_MAX)
+  {
+    all = true;
+  }
+
+  LM_T(LmtReqSem, ("%s taking %s entity semaphores for '%s'", who, all? "all" : "its", what));
+
+  struct timespec startTime;
+  struct timespec endTime;
+  struct timespec diffTime;
+
+  if (semWaitStatistics)
+  {
+    clock_gettime(CLOCK_REALTIME, &startTime);
+  }
+
+  if (all)
+  {
+    for (int ix = 0; ix < ENTITY_SEM_STRIPES; ++ix)
+    {
+      pthread_mutex_lock(&entitySem[ix]);
+    }
+
+    entitySemHeld = -1;
+  }
+  else
+  {
+    for (unsigned int ix = 0; ix < semV.size(); ++ix)
+    {
+      pthread_mutex_lock(&entitySem[semV[ix]]);
+      entitySemHeldV[ix] = semV[ix];
+    }
+
+    entitySemHeld = semV.size();
+  }
+
+  if (semWaitStatistics)
+  {
+    clock_gettime(CLOCK_REALTIME, &endTime);
+    clock_difftime(&endTime, &startTime, &diffTime);
+
+    pthread_mutex_lock(&entitySemTimeMutex);
+    clock_addtime(&accReqSemTime, &diffTime);
+    pthread_mutex_unlock(&entitySemTimeMutex);
+  }
+
+  LM_T(LmtReqSem, ("%s has its entity semaphores", who));
+
+  return 0;
 }
 
 
 
 /* ****************************************************************************
 *
-* semTimeReqReset - 
+* entitySemGive - give the entity semaphores taken by the calling thread, if any
 */
-void semTimeReqReset(void)
+static void entitySemGive(const char* who)
 {
-  accReqSemTime.tv_sec  = 0;
-  accReqSemTime.tv_nsec = 0;
+  if (entitySemHeld == 0)
+  {
+    return;
+  }
+
+  LM_T(LmtReqSem, ("%s gives its entity semaphores", who));
+
+  if (entitySemHeld == -1)
+  {
+    for (int ix = ENTITY_SEM_STRIPES - 1; ix >= 0; --ix)
+    {
+      pthread_mutex_unlock(&entitySem[ix]);
+    }
+  }
+  else
+  {
+    for (int ix = entitySemHeld - 1; ix >= 0; --ix)
+    {
+      pthread_mutex_unlock(&entitySem[entitySemHeldV[ix]]);
+    }
+  }
+
+  entitySemHeld = 0;
 }
 
 
 
 /* ****************************************************************************
 *
-* semTimeTransReset - 
+* semTimeReqGet - get accumulated req semaphore waiting time
 */
-void semTimeTransReset(void)
+float semTimeReqGet(void)
 {
-  accTransSemTime.tv_sec  = 0;
-  accTransSemTime.tv_nsec = 0;
+  return accReqSemTime.tv_sec + ((float) accReqSemTime.tv_nsec) / 1E9;
 }
 
 
 
 /* ****************************************************************************
 *
-* semTimeCacheReset - 
+* semTimeCacheGet - get accumulated cache semaphore waiting time
 */
-void semTimeCacheReset(void)
+float semTimeCacheGet(void)
 {
-  accCacheSemTime.tv_sec  = 0;
-  accCacheSemTime.tv_nsec = 0;
+  return accCacheSemTime.tv_sec + ((float) accCacheSemTime.tv_nsec)/ 1E9;
 }
 
 
 
 /* ****************************************************************************
 *
-* semTimeTimeStatReset - 
+* semTimeReqReset - 
 */
-void semTimeTimeStatReset(void)
+void semTimeReqReset(void)
 {
-  accTimeStatSemTime.tv_sec  = 0;
-  accTimeStatSemTime.tv_nsec = 0;
+  accReqSemTime.tv_sec  = 0;
+  accReqSemTime.tv_nsec = 0;
 }
 
 
 
 /* ****************************************************************************
 *
-* transSemTake -
+* semTimeCacheReset - 
 */
-int transSemTake(const char* who, const char* what)
+void semTimeCacheReset(void)
 {
-  int r;
-
-  LM_T(LmtTransSem, ("%s taking the 'trans' semaphore for '%s'", who, what));
-
-  struct timespec startTime;
-  struct timespec endTime;
-  struct timespec diffTime;
-
-  if (semWaitStatistics)
-  {
-    clock_gettime(CLOCK_REALTIME, &startTime);
-  }
-
-  r = sem_wait(&transSem);
-
-  if (semWaitStatistics)
-  {
-    clock_gettime(CLOCK_REALTIME, &endTime);
-
-    clock_difftime(&endTime, &startTime, &diffTime);
-    clock_addtime(&accTransSemTime, &diffTime);
-  }
-
-  LM_T(LmtTransSem, ("%s has the 'trans' semaphore", who));
-
-  return r;
+  accCacheSemTime.tv_sec  = 0;
+  accCacheSemTime.tv_nsec = 0;
 }
 
 
@@ -343,6 +420,8 @@ int cacheSemTake(const char* who, const char* what)
 */
 int reqSemGive(const char* who, const char* what, bool semTaken)
 {
+  entitySemGive(who);
+
   if (semTaken == false)
   {
     return 0;
@@ -362,26 +441,6 @@ int reqSemGive(const char* who, const char* what, bool semTaken)
 
 
 
-/* ****************************************************************************
-*
-* transSemGive -
-*/
-int transSemGive(const char* who, const char* what)
-{
-  if (what != NULL)
-  {
-    LM_T(LmtTransSem, ("%s gives the 'trans' semaphore for '%s'", who, what));
-  }
-  else
-  {
-    LM_T(LmtTransSem, ("%s gives the 'trans' semaphore", who));
-  }
-
-  return sem_post(&transSem);
-}
-
-
-
 /* ****************************************************************************
 *
 * cacheSemGive -
@@ -402,62 +461,6 @@ int cacheSemGive(const char* who, const char* what)
 
 
 
-/* ****************************************************************************
-*
-* timeStatSemTake -
-*/
-int timeStatSemTake(const char* who, const char* what)
-{
-  int r;
-
-  LM_T(LmtTimeStatSem, ("%s taking the 'timeStat' semaphore for '%s'", who, what));
-
-  struct timespec startTime;
-  struct timespec endTime;
-  struct timespec diffTime;
-
-  if (semWaitStatistics)
-  {
-    clock_gettime(CLOCK_REALTIME, &startTime);
-  }
-
-  r = sem_wait(&timeStatSem);
-
-  if (semWaitStatistics)
-  {
-    clock_gettime(CLOCK_REALTIME, &endTime);
-
-    clock_difftime(&endTime, &startTime, &diffTime);
-    clock_addtime(&accTimeStatSemTime, &diffTime);
-  }
-
-  LM_T(LmtTimeStatSem, ("%s has the 'timeStat' semaphore", who));
-
-  return r;
-}
-
-
-
-/* ****************************************************************************
-*
-* timeStatSemGive -
-*/
-int timeStatSemGive(const char* who, const char* what)
-{
-  if (what != NULL)
-  {
-    LM_T(LmtTimeStatSem, ("%s gives the 'timeStat' semaphore for '%s'", who, what));
-  }
-  else
-  {
-    LM_T(LmtTimeStatSem, ("%s gives the 'timeStat' semaphore", who));
-  }
-
-  return sem_post(&timeStatSem);
-}
-
-
-
 /* ****************************************************************************
 *  curl context
 */
@@ -30,6 +30,7 @@
 
 // curl context includes
 #include <string>
+#include <vector>
 
 #include <pthread.h>
 #include <curl/curl.h>
@@ -38,17 +39,34 @@
 /* ****************************************************************************
 *
 * SemOpType -
+*
+* SemEntityOp is only used as request policy (-reqMutexPolicy entity): the 'req' semaphore
+* is never taken and write requests take the entity semaphores of what they modify instead
+* (see entitySemTake).
 */
 typedef enum SemOpType
 {
   SemReadOp,
   SemWriteOp,
   SemReadWriteOp,
-  SemNoneOp
+  SemNoneOp,
+  SemEntityOp
 } SemOpType;
 
 
 
+/* ****************************************************************************
+*
+* ENTITY_SEM_STRIPES - number of entity semaphores
+*
+* ENTITY_SEM_KEYS_MAX - maximum number of different entity semaphores that are taken
+* one by one by a single request. Requests with more keys take all the entity semaphores.
+*/
+#define ENTITY_SEM_STRIPES   256
+#define ENTITY_SEM_KEYS_MAX  16
+
+
+
 /* ****************************************************************************
 *
 * semInit -
@@ -86,20 +104,20 @@ extern int reqSemTryToTake(void);
 * xxxSemTake -
 */
 extern int reqSemTake(const char* who, const char* what, SemOpType reqType, bool* taken);
-extern int transSemTake(const char* who, const char* what);
+extern int entitySemTake(const char* who, const char* what, const std::string& tenant, const std::vector<std::string>& keys);
 extern int cacheSemTake(const char* who, const char* what);
-extern int timeStatSemTake(const char* who, const char* what);
 
 
 
 /* ****************************************************************************
 *
 * xxxSemGive -
+*
+* reqSemGive also gives the entity semaphores taken by the calling thread (entitySemTake),
+* no matter the value of 'taken'.
 */
 extern int reqSemGive(const char* who, const char* what = NULL, bool taken = true);
-extern int transSemGive(const char* who, const char* what = NULL);
 extern int cacheSemGive(const char* who, const char* what = NULL);
-extern int timeStatSemGive(const char* who, const char* what = NULL);
 
 
 
@@ -108,9 +126,7 @@ extern int timeStatSemGive(const char* who, const char* what = NULL);
 * semTimeXxxGet - get accumulated semaphore waiting time
 */
 extern float semTimeReqGet(void);
-extern float semTimeTransGet(void);
 extern float semTimeCacheGet(void);
-extern float semTimeTimeStatGet(void);
 
 
 
@@ -119,9 +135,7 @@ extern float semTimeTimeStatGet(void);
 * semTimeXxxReset - 
 */
 extern void semTimeReqReset(void);
-extern void semTimeTransReset(void);
 extern void semTimeCacheReset(void);
-extern void semTimeTimeStatReset(void);
 
 
 
@@ -22,6 +22,10 @@
 *
 * Author: Ken Zangelin
 */
+#include <sched.h>
+
+#include <string>
+
 #include "common/statistics.h"
 #include "common/tag.h"
 #include "ngsi/Request.h"
@@ -59,129 +63,535 @@ do                                                                            \
 *
 * Statistic time counters -
 */
-TimeStat           accTimeStat;
-TimeStat           lastTimeStat;
 __thread TimeStat  threadLastTimeStat;
 
 
 
+/* ****************************************************************************
+*
+* statShardIx - shard of the statistic counters used by the thread
+*/
+__thread int       statShardIx = -1;
+static int         statShardNext = 0;
+
+
+
+/* ****************************************************************************
+*
+* statShardAssign - 
+*/
+int statShardAssign(void)
+{
+  return (__sync_fetch_and_add(&statShardNext, 1) & 0x7FFFFFFF) % STAT_SHARDS;
+}
+
+
+
+/* ****************************************************************************
+*
+* StatCounter::StatCounter - 
+*/
+StatCounter::StatCounter(long long initial)
+{
+  *this = initial;
+}
+
+
+
+/* ****************************************************************************
+*
+* StatCounter::operator= - 
+*
+* Not atomic with respect to concurrent increments (the same as resetting an int counter).
+*/
+StatCounter& StatCounter::operator=(long long value)
+{
+  for (int ix = 1; ix < STAT_SHARDS; ++ix)
+  {
+    shard[ix].value = 0;
+  }
+  shard[0].value = value;
+
+  return *this;
+}
+
+
+
+/* ****************************************************************************
+*
+* StatCounter::get - 
+*/
+long long StatCounter::get(void) const
+{
+  long long total = 0;
+
+  for (int ix = 0; ix < STAT_SHARDS; ++ix)
+  {
+    total += shard[ix].value;
+  }
+
+  return total;
+}
+
+
+
+/* ****************************************************************************
+*
+* StatHistogram::StatHistogram - 
+*/
+StatHistogram::StatHistogram()
+{
+  reset();
+}
+
+
+
+/* ****************************************************************************
+*
+* StatHistogram::bucket - the bucket where 'usecs' is counted
+*
+* Values under STAT_HISTOGRAM_SUB_BUCKETS have a bucket each. For bigger values, the
+* position of the most significant bit selects the power of two and the next three bits
+* select the sub-bucket inside it.
+*/
+int StatHistogram::bucket(long long usecs)
+{
+  if (usecs < 0)
+  {
+    usecs = 0;
+  }
+  else if (usecs > 0xFFFFFFFFLL)
+  {
+    usecs = 0xFFFFFFFFLL;
+  }
+
+  if (usecs < STAT_HISTOGRAM_SUB_BUCKETS)
+  {
+    return (int) usecs;
+  }
+
+  int msb = 63 - __builtin_clzll((unsigned long long) usecs);
+  int sub = (int) ((usecs >> (msb - 3)) & (STAT_HISTOGRAM_SUB_BUCKETS - 1));
+
+  return (msb - 2) * STAT_HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+
+
+/* ****************************************************************************
+*
+* StatHistogram::bucketValue - the highest value (in microseconds) counted in 'bucket'
+*/
+long long StatHistogram::bucketValue(int bucket)
+{
+  if (bucket < STAT_HISTOGRAM_SUB_BUCKETS)
+  {
+    return bucket;
+  }
+
+  int        msb   = bucket / STAT_HISTOGRAM_SUB_BUCKETS + 2;
+  int        sub   = bucket % STAT_HISTOGRAM_SUB_BUCKETS;
+  long long  lower = (long long) (STAT_HISTOGRAM_SUB_BUCKETS + sub) << (msb - 3);
+
+  return lower + (1LL << (msb - 3)) - 1;
+}
+
+
+
+/* ****************************************************************************
+*
+* StatHistogram::record - 
+*/
+void StatHistogram::record(long long usecs)
+{
+  __sync_fetch_and_add(&shard[statShard()].bucket[bucket(usecs)], 1);
+}
+
+
+
+/* ****************************************************************************
+*
+* StatHistogram::merge - add up the shards into 'bucketV'
+*/
+void StatHistogram::merge(long long* bucketV) const
+{
+  for (int bIx = 0; bIx < STAT_HISTOGRAM_BUCKETS; ++bIx)
+  {
+    bucketV[bIx] = 0;
+  }
+
+  for (int sIx = 0; sIx < STAT_SHARDS; ++sIx)
+  {
+    for (int bIx = 0; bIx < STAT_HISTOGRAM_BUCKETS; ++bIx)
+    {
+      bucketV[bIx] += shard[sIx].bucket[bIx];
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* StatHistogram::count - 
+*/
+long long StatHistogram::count(void) const
+{
+  long long bucketV[STAT_HISTOGRAM_BUCKETS];
+  long long total = 0;
+
+  merge(bucketV);
+  for (int bIx = 0; bIx < STAT_HISTOGRAM_BUCKETS; ++bIx)
+  {
+    total += bucketV[bIx];
+  }
+
+  return total;
+}
+
+
+
+/* ****************************************************************************
+*
+* StatHistogram::percentile - value (in microseconds) under which 'p' percent of the values are
+*/
+long long StatHistogram::percentile(double p) const
+{
+  long long bucketV[STAT_HISTOGRAM_BUCKETS];
+  long long total = 0;
+
+  merge(bucketV);
+  for (int bIx = 0; bIx < STAT_HISTOGRAM_BUCKETS; ++bIx)
+  {
+    total += bucketV[bIx];
+  }
+
+  if (total == 0)
+  {
+    return 0;
+  }
+
+  long long rank = (long long) ((p / 100) * total + 0.999999);
+  long long seen = 0;
+
+  if (rank < 1)
+  {
+    rank = 1;
+  }
+
+  for (int bIx = 0; bIx < STAT_HISTOGRAM_BUCKETS; ++bIx)
+  {
+    seen += bucketV[bIx];
+    if (seen >= rank)
+    {
+      return bucketValue(bIx);
+    }
+  }
+
+  return bucketValue(STAT_HISTOGRAM_BUCKETS - 1);
+}
+
+
+
+/* ****************************************************************************
+*
+* StatHistogram::reset - 
+*/
+void StatHistogram::reset(void)
+{
+  for (int sIx = 0; sIx < STAT_SHARDS; ++sIx)
+  {
+    for (int bIx = 0; bIx < STAT_HISTOGRAM_BUCKETS; ++bIx)
+    {
+      shard[sIx].bucket[bIx] = 0;
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* Accumulated times - 
+*
+* One sharded counter (in nanoseconds) per field of TimeStat, in the order of timeStatFieldV.
+*/
+static const struct
+{
+  const char*               name;
+  struct timespec TimeStat::*  field;
+} timeStatFieldV[] =
+{
+  { "jsonV1Parse",      &TimeStat::jsonV1ParseTime      },
+  { "jsonV2Parse",      &TimeStat::jsonV2ParseTime      },
+  { "mongoBackend",     &TimeStat::mongoBackendTime     },
+  { "mongoReadWait",    &TimeStat::mongoReadWaitTime    },
+  { "mongoWriteWait",   &TimeStat::mongoWriteWaitTime   },
+  { "mongoCommandWait", &TimeStat::mongoCommandWaitTime },
+  { "render",           &TimeStat::renderTime           },
+  { "total",            &TimeStat::reqTime              },
+  { "xmlParse",         &TimeStat::xmlParseTime         }
+};
+
+#define TIME_STAT_FIELDS  ((int) (sizeof(timeStatFieldV) / sizeof(timeStatFieldV[0])))
+
+static StatCounter  accTimeV[TIME_STAT_FIELDS];
+
+
+
+/* ****************************************************************************
+*
+* Last request times - 
+*
+* Kept under a sequence lock: a writer that finds another writer at work just skips its
+* update (any of them is 'the last one') and readers retry if the times changed meanwhile.
+*/
+static TimeStat      lastTimeStat;
+static volatile int  lastTimeStatSeq = 0;
+
+
+
+/* ****************************************************************************
+*
+* Latency histograms - 
+*
+* One histogram per request type and phase, allocated the first time a request of the type
+* finishes.
+*/
+enum TimeStatPhase
+{
+  PhaseTotal = 0,
+  PhaseParse,
+  PhaseMongoReadWait,
+  PhaseMongoBackend,
+  PhaseRender,
+  TimeStatPhases
+};
+
+static const char* phaseNameV[TimeStatPhases] = { "total", "parse", "mongoReadWait", "mongoBackend", "render" };
+
+static StatHistogram* volatile  histogramV[InvalidRequest + 1][TimeStatPhases];
+
+
+
+/* ****************************************************************************
+*
+* timeSpecToNanos -
+*/
+inline long long timeSpecToNanos(const struct timespec& t)
+{
+  return (long long) t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+
+
+/* ****************************************************************************
+*
+* histogramRecord - 
+*/
+static void histogramRecord(RequestType rt, TimeStatPhase phase, long long nanos)
+{
+  StatHistogram* hP = histogramV[rt][phase];
+
+  if (hP == NULL)
+  {
+    StatHistogram* newP = new StatHistogram();
+
+    if (__sync_bool_compare_and_swap(&histogramV[rt][phase], (StatHistogram*) NULL, newP))
+    {
+      hP = newP;
+    }
+    else
+    {
+      delete newP;
+      hP = histogramV[rt][phase];
+    }
+  }
+
+  hP->record(nanos / 1000);
+}
+
+
+
+/* ****************************************************************************
+*
+* timingStatisticsUpdate - 
+*
+* Called by each request when it finishes, without any lock.
+*
+* "Fix" mongoBackendTime
+*   Substract times waiting at mongo driver operation (in mongo[Read|Write|Command]WaitTime counters) so mongoBackendTime
+*   contains at the end the time passed in our logic, i.e. a kind of "self-time" for mongoBackend
+*/
+void timingStatisticsUpdate(TimeStat* tsP)
+{
+  int seq = lastTimeStatSeq;
+
+  if (((seq & 1) == 0) && __sync_bool_compare_and_swap(&lastTimeStatSeq, seq, seq + 1))
+  {
+    lastTimeStat = *tsP;
+    __sync_synchronize();
+    lastTimeStatSeq = seq + 2;
+  }
+
+  clock_subtime(&tsP->mongoBackendTime, &tsP->mongoReadWaitTime);
+  clock_subtime(&tsP->mongoBackendTime, &tsP->mongoWriteWaitTime);
+  clock_subtime(&tsP->mongoBackendTime, &tsP->mongoCommandWaitTime);
+
+  for (int ix = 0; ix < TIME_STAT_FIELDS; ++ix)
+  {
+    long long nanos = timeSpecToNanos(tsP->*timeStatFieldV[ix].field);
+
+    if (nanos != 0)
+    {
+      accTimeV[ix].add(nanos);
+    }
+  }
+
+  RequestType rt = tsP->requestType;
+
+  if ((rt <= NoRequest) || (rt > InvalidRequest))
+  {
+    return;
+  }
+
+  long long parse = timeSpecToNanos(tsP->xmlParseTime) + timeSpecToNanos(tsP->jsonV1ParseTime) + timeSpecToNanos(tsP->jsonV2ParseTime);
+  long long phaseV[TimeStatPhases];
+
+  phaseV[PhaseTotal]         = timeSpecToNanos(tsP->reqTime);
+  phaseV[PhaseParse]         = parse;
+  phaseV[PhaseMongoReadWait] = timeSpecToNanos(tsP->mongoReadWaitTime);
+  phaseV[PhaseMongoBackend]  = timeSpecToNanos(tsP->mongoBackendTime);
+  phaseV[PhaseRender]        = timeSpecToNanos(tsP->renderTime);
+
+  for (int phase = 0; phase < TimeStatPhases; ++phase)
+  {
+    if (phaseV[phase] > 0)
+    {
+      histogramRecord(rt, (TimeStatPhase) phase, phaseV[phase]);
+    }
+  }
+}
+
+
+
 /* ****************************************************************************
 *
 * Statistic counters for NGSI REST requests
 */
-int noOfJsonRequests                                     = -1;
-int noOfXmlRequests                                      = -1;
-int noOfRequestsWithoutPayload                           = -1;
-int noOfRegistrations                                    = -1;
-int noOfRegistrationErrors                               = -1;
-int noOfRegistrationUpdates                              = -1;
-int noOfRegistrationUpdateErrors                         = -1;
-int noOfDiscoveries                                      = -1;
-int noOfDiscoveryErrors                                  = -1;
-int noOfAvailabilitySubscriptions                        = -1;
-int noOfAvailabilitySubscriptionErrors                   = -1;
-int noOfAvailabilityUnsubscriptions                      = -1;
-int noOfAvailabilityUnsubscriptionErrors                 = -1;
-int noOfAvailabilitySubscriptionUpdates                  = -1;
-int noOfAvailabilitySubscriptionUpdateErrors             = -1;
-int noOfAvailabilityNotificationsReceived                = -1;
-int noOfAvailabilityNotificationsSent                    = -1;
-
-int noOfQueries                                          = -1;
-int noOfQueryErrors                                      = -1;
-int noOfUpdates                                          = -1;
-int noOfUpdateErrors                                     = -1;
-int noOfSubscriptions                                    = -1;
-int noOfSubscriptionErrors                               = -1;
-int noOfSubscriptionUpdates                              = -1;
-int noOfSubscriptionUpdateErrors                         = -1;
-int noOfUnsubscriptions                                  = -1;
-int noOfUnsubscriptionErrors                             = -1;
-int noOfNotificationsReceived                            = -1;
-int noOfNotificationsSent                                = -1;
-int noOfQueryContextResponses                            = -1;
-int noOfUpdateContextResponses                           = -1;
-
-int noOfContextEntitiesByEntityId                        = -1;
-int noOfContextEntityAttributes                          = -1;
-int noOfEntityByIdAttributeByName                        = -1;
-int noOfContextEntityTypes                               = -1;
-int noOfContextEntityTypeAttributeContainer              = -1;
-int noOfContextEntityTypeAttribute                       = -1;
-int noOfNgsi9SubscriptionsConvOp                         = -1;
-
-int noOfIndividualContextEntity                          = -1;
-int noOfIndividualContextEntityAttributes                = -1;
-int noOfIndividualContextEntityAttribute                 = -1;
-int noOfAttributeValueInstance                           = -1;
-int noOfNgsi10ContextEntityTypes                         = -1;
-int noOfNgsi10ContextEntityTypesAttributeContainer       = -1;
-int noOfNgsi10ContextEntityTypesAttribute                = -1;
-int noOfNgsi10SubscriptionsConvOp                        = -1;
-
-int noOfUpdateContextElement                             = -1;
-int noOfAppendContextElement                             = -1;
-int noOfUpdateContextAttribute                           = -1;
-
-int noOfAllContextEntitiesRequests                       = -1;
-int noOfAllEntitiesWithTypeAndIdRequests                 = -1;
-int noOfIndividualContextEntityAttributeWithTypeAndId    = -1;
-int noOfAttributeValueInstanceWithTypeAndId              = -1;
-int noOfEntityByIdAttributeByNameIdAndType               = -1;
-
-int noOfLogRequests                                      = -1;
-int noOfVersionRequests                                  = -1;
-int noOfExitRequests                                     = -1;
-int noOfLeakRequests                                     = -1;
-int noOfStatisticsRequests                               = -1;
-int noOfInvalidRequests                                  = -1;
-int noOfRegisterResponses                                = -1;
-
-int noOfRtSubscribeContextAvailabilityResponse           = -1;
-int noOfRtUpdateContextAvailabilitySubscriptionResponse  = -1;
-int noOfRtUnsubscribeContextAvailabilityResponse         = -1;
-int noOfRtUnsubscribeContextResponse                     = -1;
-int noOfRtSubscribeResponse                              = -1;
-int noOfRtSubscribeError                                 = -1;
-int noOfContextElementResponse                           = -1;
-int noOfContextAttributeResponse                         = -1;
-
-int noOfEntityTypesRequest                               = -1;
-int noOfEntityTypesResponse                              = -1;
-int noOfAttributesForEntityTypeRequest                   = -1;
-int noOfAttributesForEntityTypeResponse                  = -1;
-int noOfContextEntitiesByEntityIdAndType                 = -1;
-
-int noOfEntitiesRequests                                 = -1;
-int noOfEntitiesResponses                                = -1;
-
-int noOfEntryPointsRequests                              = -1;
-int noOfEntryPointsResponses                             = -1;
-
-int noOfEntityRequests                                   = -1;
-int noOfEntityResponses                                  = -1;
-
-int noOfEntityAttributeRequests                          = -1;
-int noOfEntityAttributeResponses                         = -1;
-
-int noOfEntityAttributeValueRequests                     = -1;
-int noOfEntityAttributeValueResponses                    = -1;
-
-int noOfPostEntity                                       = -1;
-
-int noOfPostAttributes                                   = -1;
-int noOfDeleteEntity                                     = -1;
-int noOfSubCacheEntries                                  = -1;
-int noOfSubCacheLookups                                  = -1;
-int noOfSubCacheRemovals                                 = -1;
-int noOfSubCacheRemovalFailures                          = -1;
-int noOfEntityTypeRequest                                = -1;
-int noOfEntityAllTypesRequest                            = -1;
-int noOfSubscriptionsRequest                             = -1;
-int noOfIndividualSubscriptionRequest                    = -1;
-int noOfSimulatedNotifications                           = -1;
-int noOfBatchQueryRequest                                = -1;
-int noOfBatchUpdateRequest                               = -1;
+StatCounter noOfJsonRequests(-1);
+StatCounter noOfXmlRequests(-1);
+StatCounter noOfRequestsWithoutPayload(-1);
+StatCounter noOfRegistrations(-1);
+StatCounter noOfRegistrationErrors(-1);
+StatCounter noOfRegistrationUpdates(-1);
+StatCounter noOfRegistrationUpdateErrors(-1);
+StatCounter noOfDiscoveries(-1);
+StatCounter noOfDiscoveryErrors(-1);
+StatCounter noOfAvailabilitySubscriptions(-1);
+StatCounter noOfAvailabilitySubscriptionErrors(-1);
+StatCounter noOfAvailabilityUnsubscriptions(-1);
+StatCounter noOfAvailabilityUnsubscriptionErrors(-1);
+StatCounter noOfAvailabilitySubscriptionUpdates(-1);
+StatCounter noOfAvailabilitySubscriptionUpdateErrors(-1);
+StatCounter noOfAvailabilityNotificationsReceived(-1);
+StatCounter noOfAvailabilityNotificationsSent(-1);
+
+StatCounter noOfQueries(-1);
+StatCounter noOfQueryErrors(-1);
+StatCounter noOfUpdates(-1);
+StatCounter noOfUpdateErrors(-1);
+StatCounter noOfSubscriptions(-1);
+StatCounter noOfSubscriptionErrors(-1);
+StatCounter noOfSubscriptionUpdates(-1);
+StatCounter noOfSubscriptionUpdateErrors(-1);
+StatCounter noOfUnsubscriptions(-1);
+StatCounter noOfUnsubscriptionErrors(-1);
+StatCounter noOfNotificationsReceived(-1);
+StatCounter noOfNotificationsSent(-1);
+StatCounter noOfQueryContextResponses(-1);
+StatCounter noOfUpdateContextResponses(-1);
+
+StatCounter noOfContextEntitiesByEntityId(-1);
+StatCounter noOfContextEntityAttributes(-1);
+StatCounter noOfEntityByIdAttributeByName(-1);
+StatCounter noOfContextEntityTypes(-1);
+StatCounter noOfContextEntityTypeAttributeContainer(-1);
+StatCounter noOfContextEntityTypeAttribute(-1);
+StatCounter noOfNgsi9SubscriptionsConvOp(-1);
+
+StatCounter noOfIndividualContextEntity(-1);
+StatCounter noOfIndividualContextEntityAttributes(-1);
+StatCounter noOfIndividualContextEntityAttribute(-1);
+StatCounter noOfAttributeValueInstance(-1);
+StatCounter noOfNgsi10ContextEntityTypes(-1);
+StatCounter noOfNgsi10ContextEntityTypesAttributeContainer(-1);
+StatCounter noOfNgsi10ContextEntityTypesAttribute(-1);
+StatCounter noOfNgsi10SubscriptionsConvOp(-1);
+
+StatCounter noOfUpdateContextElement(-1);
+StatCounter noOfAppendContextElement(-1);
+StatCounter noOfUpdateContextAttribute(-1);
+
+StatCounter noOfAllContextEntitiesRequests(-1);
+StatCounter noOfAllEntitiesWithTypeAndIdRequests(-1);
+StatCounter noOfIndividualContextEntityAttributeWithTypeAndId(-1);
+StatCounter noOfAttributeValueInstanceWithTypeAndId(-1);
+StatCounter noOfEntityByIdAttributeByNameIdAndType(-1);
+
+StatCounter noOfLogRequests(-1);
+StatCounter noOfVersionRequests(-1);
+StatCounter noOfExitRequests(-1);
+StatCounter noOfLeakRequests(-1);
+StatCounter noOfStatisticsRequests(-1);
+StatCounter noOfInvalidRequests(-1);
+StatCounter noOfRegisterResponses(-1);
+
+StatCounter noOfRtSubscribeContextAvailabilityResponse(-1);
+StatCounter noOfRtUpdateContextAvailabilitySubscriptionResponse(-1);
+StatCounter noOfRtUnsubscribeContextAvailabilityResponse(-1);
+StatCounter noOfRtUnsubscribeContextResponse(-1);
+StatCounter noOfRtSubscribeResponse(-1);
+StatCounter noOfRtSubscribeError(-1);
+StatCounter noOfContextElementResponse(-1);
+StatCounter noOfContextAttributeResponse(-1);
+
+StatCounter noOfEntityTypesRequest(-1);
+StatCounter noOfEntityTypesResponse(-1);
+StatCounter noOfAttributesForEntityTypeRequest(-1);
+StatCounter noOfAttributesForEntityTypeResponse(-1);
+StatCounter noOfContextEntitiesByEntityIdAndType(-1);
+
+StatCounter noOfEntitiesRequests(-1);
+StatCounter noOfEntitiesResponses(-1);
+
+StatCounter noOfEntryPointsRequests(-1);
+StatCounter noOfEntryPointsResponses(-1);
+
+StatCounter noOfEntityRequests(-1);
+StatCounter noOfEntityResponses(-1);
+
+StatCounter noOfEntityAttributeRequests(-1);
+StatCounter noOfEntityAttributeResponses(-1);
+
+StatCounter noOfEntityAttributeValueRequests(-1);
+StatCounter noOfEntityAttributeValueResponses(-1);
+
+StatCounter noOfPostEntity(-1);
+
+StatCounter noOfPostAttributes(-1);
+StatCounter noOfDeleteEntity(-1);
+StatCounter noOfSubCacheEntries(-1);
+StatCounter noOfSubCacheLookups(-1);
+StatCounter noOfSubCacheRemovals(-1);
+StatCounter noOfSubCacheRemovalFailures(-1);
+StatCounter noOfEntityTypeRequest(-1);
+StatCounter noOfEntityAllTypesRequest(-1);
+StatCounter noOfSubscriptionsRequest(-1);
+StatCounter noOfIndividualSubscriptionRequest(-1);
+StatCounter noOfSimulatedNotifications(-1);
+StatCounter noOfBatchQueryRequest(-1);
+StatCounter noOfBatchUpdateRequest(-1);
 
 
 
@@ -197,54 +607,141 @@ inline float timeSpecToFloat(const struct timespec& t)
 
 
 
+/* ****************************************************************************
+*
+* lastTimeStatGet - consistent copy of the times of the last request
+*/
+static void lastTimeStatGet(TimeStat* tsP)
+{
+  while (true)
+  {
+    int seq = lastTimeStatSeq;
+
+    if ((seq & 1) == 0)
+    {
+      __sync_synchronize();
+      *tsP = lastTimeStat;
+      __sync_synchronize();
+
+      if (lastTimeStatSeq == seq)
+      {
+        return;
+      }
+    }
+
+    sched_yield();
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* renderLatency - percentiles of the latency histograms, per request type and phase
+*/
+static std::string renderLatency(void)
+{
+  JsonHelper  jh;
+  bool        empty = true;
+
+  for (int rt = NoRequest + 1; rt <= InvalidRequest; ++rt)
+  {
+    JsonHelper  rtJh;
+    bool        rtEmpty = true;
+
+    for (int phase = 0; phase < TimeStatPhases; ++phase)
+    {
+      StatHistogram* hP = histogramV[rt][phase];
+
+      if ((hP == NULL) || (hP->count() == 0))
+      {
+        continue;
+      }
+
+      JsonHelper phaseJh;
+
+      phaseJh.addNumber("count", hP->count());
+      phaseJh.addFloat("p50",    hP->percentile(50)   / 1E6);
+      phaseJh.addFloat("p90",    hP->percentile(90)   / 1E6);
+      phaseJh.addFloat("p99",    hP->percentile(99)   / 1E6);
+      phaseJh.addFloat("p999",   hP->percentile(99.9) / 1E6);
+
+      rtJh.addRaw(phaseNameV[phase], phaseJh.str());
+      rtEmpty = false;
+    }
+
+    if (!rtEmpty)
+    {
+      jh.addRaw(requestType((RequestType) rt), rtJh.str());
+      empty = false;
+    }
+  }
+
+  return empty? "" : jh.str();
+}
+
+
+
 /* ****************************************************************************
 *
 * renderTimingStatistics -
 *
-* xxxReqTime           - the total time that the LAST request took.
+* accumulated          - the accumulated times of all requests, per phase (xxxReqTime is 'total').
+* last                 - the times of the LAST request.
+* latency              - percentiles of the times of the requests, per request type and phase.
+*
+* xxxReqTime           - the total time that the request took.
 *                        Measuring from the first MHD callback to 'connectionTreat',
 *                        until the MHD callback to 'requestCompleted'.
-* xxxXmlParseTime      - the time that the XML Parse of the LAST request took.
-* xxxJsonV1ParseTime   - the time that the JSON parse+treat of the LAST request took.
-* xxxJsonV2ParseTime   - the time that the JSON parse+treat of the LAST request took.
-* xxxMongoBackendTime  - the time that the mongoBackend took to treat the last request
+* xxxXmlParseTime      - the time that the XML Parse of the request took.
+* xxxJsonV1ParseTime   - the time that the JSON parse+treat of the request took.
+* xxxJsonV2ParseTime   - the time that the JSON parse+treat of the request took.
+* xxxMongoBackendTime  - the time that the mongoBackend took to treat the request
 * xxxReadWaitTime      - 
 * xxxWriteWaitTime     - 
 * xxxCommandWaitTime   - 
-* xxxRenderTime        - the time that the last render took to render the response
+* xxxRenderTime        - the time that the render took to render the response
 *
+* No lock is taken: the accumulated times and the histograms are read while they are being
+* updated, so they may not include the requests finishing at the moment of the read.
 */
 std::string renderTimingStatistics(void)
 {
+  TimeStat    lastTs;
+  JsonHelper  accJh;
+  bool        acc = false;
+
+  for (int ix = 0; ix < TIME_STAT_FIELDS; ++ix)
+  {
+    long long nanos = accTimeV[ix].get();
+
+    if (nanos != 0)
+    {
+      accJh.addFloat(timeStatFieldV[ix].name, nanos / 1E9);
+      acc = true;
+    }
+  }
+
+  lastTimeStatGet(&lastTs);
+
+  JsonHelper  lastJh;
+  bool        last = false;
+
+  for (int ix = 0; ix < TIME_STAT_FIELDS; ++ix)
+  {
+    const struct timespec& t = lastTs.*timeStatFieldV[ix].field;
 
-  timeStatSemTake(__FUNCTION__, "putting stats together");
-
-  bool accJsonV1ParseTime      = (accTimeStat.jsonV1ParseTime.tv_sec != 0)        || (accTimeStat.jsonV1ParseTime.tv_nsec != 0);
-  bool accJsonV2ParseTime      = (accTimeStat.jsonV2ParseTime.tv_sec != 0)        || (accTimeStat.jsonV2ParseTime.tv_nsec != 0);
-  bool accMongoBackendTime     = (accTimeStat.mongoBackendTime.tv_sec != 0)       || (accTimeStat.mongoBackendTime.tv_nsec != 0);
-  bool accMongoReadWaitTime    = (accTimeStat.mongoReadWaitTime.tv_sec != 0)      || (accTimeStat.mongoReadWaitTime.tv_nsec != 0);
-  bool accMongoWriteWaitTime   = (accTimeStat.mongoWriteWaitTime.tv_sec != 0)     || (accTimeStat.mongoWriteWaitTime.tv_nsec != 0);
-  bool accMongoCommandWaitTime = (accTimeStat.mongoCommandWaitTime.tv_sec != 0)   || (accTimeStat.mongoCommandWaitTime.tv_nsec != 0);
-  bool accRenderTime           = (accTimeStat.renderTime.tv_sec != 0)             || (accTimeStat.renderTime.tv_nsec != 0);
-  bool accReqTime              = (accTimeStat.reqTime.tv_sec != 0)                || (accTimeStat.reqTime.tv_nsec != 0);
-  bool accXmlParseTime         = (accTimeStat.xmlParseTime.tv_sec != 0)           || (accTimeStat.xmlParseTime.tv_nsec != 0);
-
-  bool lastJsonV1ParseTime      = (lastTimeStat.jsonV1ParseTime.tv_sec != 0)      || (lastTimeStat.jsonV1ParseTime.tv_nsec != 0);
-  bool lastJsonV2ParseTime      = (lastTimeStat.jsonV2ParseTime.tv_sec != 0)      || (lastTimeStat.jsonV2ParseTime.tv_nsec != 0);
-  bool lastMongoBackendTime     = (lastTimeStat.mongoBackendTime.tv_sec != 0)     || (lastTimeStat.mongoBackendTime.tv_nsec != 0);
-  bool lastMongoReadWaitTime    = (lastTimeStat.mongoReadWaitTime.tv_sec != 0)    || (lastTimeStat.mongoReadWaitTime.tv_nsec != 0);
-  bool lastMongoWriteWaitTime   = (lastTimeStat.mongoWriteWaitTime.tv_sec != 0)   || (lastTimeStat.mongoWriteWaitTime.tv_nsec != 0);
-  bool lastMongoCommandWaitTime = (lastTimeStat.mongoCommandWaitTime.tv_sec != 0) || (lastTimeStat.mongoCommandWaitTime.tv_nsec != 0);
-  bool lastRenderTime           = (lastTimeStat.renderTime.tv_sec != 0)           || (lastTimeStat.renderTime.tv_nsec != 0);
-  bool lastReqTime              = (lastTimeStat.reqTime.tv_sec != 0)              || (lastTimeStat.reqTime.tv_nsec != 0);
-  bool lastXmlParseTime         = (lastTimeStat.xmlParseTime.tv_sec != 0)         || (lastTimeStat.xmlParseTime.tv_nsec != 0);
-
-  bool last = lastJsonV1ParseTime || lastJsonV2ParseTime || lastMongoBackendTime || lastRenderTime || lastReqTime || lastXmlParseTime;
-  bool acc  = accJsonV1ParseTime || accJsonV2ParseTime || accMongoBackendTime || accRenderTime || accReqTime || accXmlParseTime;
-
-  if (!acc && !last)
-  {
-    timeStatSemGive(__FUNCTION__, "no stats to report");
+    if ((t.tv_sec != 0) || (t.tv_nsec != 0))
+    {
+      lastJh.addFloat(timeStatFieldV[ix].name, timeSpecToFloat(t));
+      last = true;
+    }
+  }
+
+  std::string latency = renderLatency();
+
+  if (!acc && !last && (latency == ""))
+  {
     return "{}";
   }
 
@@ -252,38 +749,19 @@ std::string renderTimingStatistics(void)
 
   if (acc)
   {
-    JsonHelper accJh;
-
-    if (accJsonV1ParseTime)      accJh.addFloat("jsonV1Parse",      timeSpecToFloat(accTimeStat.jsonV1ParseTime));
-    if (accJsonV2ParseTime)      accJh.addFloat("jsonV2Parse",      timeSpecToFloat(accTimeStat.jsonV2ParseTime));
-    if (accMongoBackendTime)     accJh.addFloat("mongoBackend",     timeSpecToFloat(accTimeStat.mongoBackendTime));
-    if (accMongoReadWaitTime)    accJh.addFloat("mongoReadWait",    timeSpecToFloat(accTimeStat.mongoReadWaitTime));
-    if (accMongoWriteWaitTime)   accJh.addFloat("mongoWriteWait",   timeSpecToFloat(accTimeStat.mongoWriteWaitTime));
-    if (accMongoCommandWaitTime) accJh.addFloat("mongoCommandWait", timeSpecToFloat(accTimeStat.mongoCommandWaitTime));
-    if (accRenderTime)           accJh.addFloat("render",           timeSpecToFloat(accTimeStat.renderTime));
-    if (accReqTime)              accJh.addFloat("total",            timeSpecToFloat(accTimeStat.reqTime));
-    if (accXmlParseTime)         accJh.addFloat("xmlParse",         timeSpecToFloat(accTimeStat.xmlParseTime));
-
     jh.addRaw("accumulated", accJh.str());
   }
+
   if (last)
   {
-    JsonHelper lastJh;
-
-    if (lastJsonV1ParseTime)      lastJh.addFloat("jsonV1Parse",      timeSpecToFloat(lastTimeStat.jsonV1ParseTime));
-    if (lastJsonV2ParseTime)      lastJh.addFloat("jsonV2Parse",      timeSpecToFloat(lastTimeStat.jsonV2ParseTime));
-    if (lastMongoBackendTime)     lastJh.addFloat("mongoBackend",     timeSpecToFloat(lastTimeStat.mongoBackendTime));
-    if (lastMongoReadWaitTime)    lastJh.addFloat("mongoReadWait",    timeSpecToFloat(lastTimeStat.mongoReadWaitTime));
-    if (lastMongoWriteWaitTime)   lastJh.addFloat("mongoWriteWait",   timeSpecToFloat(lastTimeStat.mongoWriteWaitTime));
-    if (lastMongoCommandWaitTime) lastJh.addFloat("mongoCommandWait", timeSpecToFloat(lastTimeStat.mongoCommandWaitTime));
-    if (lastRenderTime)           lastJh.addFloat("render",           timeSpecToFloat(lastTimeStat.renderTime));
-    if (lastReqTime)              lastJh.addFloat("total",            timeSpecToFloat(lastTimeStat.reqTime));
-    if (lastXmlParseTime)         lastJh.addFloat("xmlParse",         timeSpecToFloat(lastTimeStat.xmlParseTime));
-
     jh.addRaw("last", lastJh.str());
   }
 
-  timeStatSemGive(__FUNCTION__, "putting stats together");
+  if (latency != "")
+  {
+    jh.addRaw("latency", latency);
+  }
+
   return jh.str();
 }
 
@@ -295,7 +773,21 @@ std::string renderTimingStatistics(void)
 */
 void timingStatisticsReset(void)
 {
-  memset(&accTimeStat, 0, sizeof(accTimeStat));
+  for (int ix = 0; ix < TIME_STAT_FIELDS; ++ix)
+  {
+    accTimeV[ix] = 0;
+  }
+
+  for (int rt = 0; rt <= InvalidRequest; ++rt)
+  {
+    for (int phase = 0; phase < TimeStatPhases; ++phase)
+    {
+      if (histogramV[rt][phase] != NULL)
+      {
+        histogramV[rt][phase]->reset();
+      }
+    }
+  }
 }
 
 
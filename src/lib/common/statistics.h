@@ -207,6 +207,129 @@
 
 
 
+/* ****************************************************************************
+*
+* STAT_SHARDS - number of shards of a StatCounter/StatHistogram
+*/
+#define STAT_SHARDS  16
+
+
+
+/* ****************************************************************************
+*
+* STAT_HISTOGRAM_SUB_BUCKETS - buckets of a StatHistogram per power of two
+*
+* The relative error of a value taken from the histogram is at most 1/STAT_HISTOGRAM_SUB_BUCKETS.
+* Values (in microseconds) from 0 to 2^32 (more than an hour) are kept, bigger values are
+* counted as 2^32.
+*/
+#define STAT_HISTOGRAM_SUB_BUCKETS  8
+#define STAT_HISTOGRAM_BUCKETS      (30 * STAT_HISTOGRAM_SUB_BUCKETS)
+
+
+
+/* ****************************************************************************
+*
+* statShard - the shard of the statistic counters used by the calling thread
+*
+* Threads are given shards round robin, the first time they modify a counter.
+*/
+extern __thread int statShardIx;
+extern int statShardAssign(void);
+
+inline int statShard(void)
+{
+  if (statShardIx < 0)
+  {
+    statShardIx = statShardAssign();
+  }
+
+  return statShardIx;
+}
+
+
+
+/* ****************************************************************************
+*
+* StatCounter - 64-bit counter, sharded by thread
+*
+* Each thread modifies its own shard (in its own cache line), so counters modified by many
+* threads at the same time don't share cache lines and need no lock. The shards are added
+* up when the counter is read. Shards are modified atomically, as there may be more threads
+* than shards.
+*
+* A StatCounter can be used as a plain integer (++, = and reading its value), which is the
+* way the statistic counters were used when they were ints.
+*/
+class StatCounter
+{
+ public:
+  explicit StatCounter(long long initial = 0);
+
+  StatCounter&  operator=(long long value);
+  long long     get(void) const;
+  operator      long long() const { return get(); }
+
+  void add(long long delta)
+  {
+    __sync_fetch_and_add(&shard[statShard()].value, delta);
+  }
+
+  StatCounter& operator++(void)
+  {
+    add(1);
+    return *this;
+  }
+
+ private:
+  struct Shard
+  {
+    volatile long long  value;
+  } __attribute__((aligned(64)));
+
+  Shard  shard[STAT_SHARDS];
+
+  StatCounter(const StatCounter&);
+};
+
+
+
+/* ****************************************************************************
+*
+* StatHistogram - HDR-style histogram of times (in microseconds), sharded by thread
+*
+* Buckets are linear (one per microsecond) up to STAT_HISTOGRAM_SUB_BUCKETS and then, for
+* every power of two, there are STAT_HISTOGRAM_SUB_BUCKETS buckets, so the precision
+* of the histogram is relative to the values kept.
+*/
+class StatHistogram
+{
+ public:
+  StatHistogram();
+
+  void       record(long long usecs);
+  long long  count(void) const;
+  long long  percentile(double p) const;
+  void       reset(void);
+
+  static int        bucket(long long usecs);
+  static long long  bucketValue(int bucket);
+
+ private:
+  // Shards are allocated with 'new', which doesn't honor over-alignment in C++03, but their size
+  // is a multiple of a cache line, so two shards share at most one cache line
+  struct Shard
+  {
+    volatile long long  bucket[STAT_HISTOGRAM_BUCKETS];
+  };
+
+  Shard  shard[STAT_SHARDS];
+
+  void  merge(long long* bucketV) const;
+};
+
+
+
 /* ****************************************************************************
 *
 * TimeStat - 
@@ -222,10 +345,9 @@ typedef struct TimeStat
   struct timespec  renderTime;
   struct timespec  reqTime;
   struct timespec  xmlParseTime;
+  RequestType      requestType;
 } TimeStat;
 
-extern TimeStat           accTimeStat;
-extern TimeStat           lastTimeStat;
 extern __thread TimeStat  threadLastTimeStat;
 
 
@@ -234,79 +356,79 @@ extern __thread TimeStat  threadLastTimeStat;
 *
 * Statistic counters for NGSI REST requests
 */
-extern int noOfJsonRequests;
-extern int noOfXmlRequests;
-extern int noOfRegistrations;
-extern int noOfRegistrationErrors;
-extern int noOfRegistrationUpdates;
-extern int noOfRegistrationUpdateErrors;
-extern int noOfDiscoveries;
-extern int noOfDiscoveryErrors;
-extern int noOfAvailabilitySubscriptions;
-extern int noOfAvailabilitySubscriptionErrors;
-extern int noOfAvailabilityUnsubscriptions;
-extern int noOfAvailabilityUnsubscriptionErrors;
-extern int noOfAvailabilitySubscriptionUpdates;
-extern int noOfAvailabilitySubscriptionUpdateErrors;
-extern int noOfAvailabilityNotificationsReceived;
-extern int noOfAvailabilityNotificationsSent;
-
-extern int noOfQueries;
-extern int noOfQueryErrors;
-extern int noOfUpdates;
-extern int noOfUpdateErrors;
-extern int noOfSubscriptions;
-extern int noOfSubscriptionErrors;
-extern int noOfSubscriptionUpdates;
-extern int noOfSubscriptionUpdateErrors;
-extern int noOfUnsubscriptions;
-extern int noOfUnsubscriptionErrors;
-extern int noOfNotificationsReceived;
-extern int noOfNotificationsSent;
-extern int noOfQueryContextResponses;
-extern int noOfUpdateContextResponses;
-extern int noOfContextEntitiesByEntityId;
-extern int noOfContextEntityAttributes;
-extern int noOfEntityByIdAttributeByName;
-extern int noOfContextEntityTypes;
-extern int noOfContextEntityTypeAttributeContainer;
-extern int noOfContextEntityTypeAttribute;
-extern int noOfIndividualContextEntity;
-extern int noOfIndividualContextEntityAttributes;
-extern int noOfAttributeValueInstance;
-extern int noOfIndividualContextEntityAttribute;
-extern int noOfUpdateContextElement;
-extern int noOfAppendContextElement;
-extern int noOfUpdateContextAttribute;
-extern int noOfNgsi10ContextEntityTypes;
-extern int noOfNgsi10ContextEntityTypesAttributeContainer;
-extern int noOfNgsi10ContextEntityTypesAttribute;
-extern int noOfNgsi10SubscriptionsConvOp;
-extern int noOfAllContextEntitiesRequests;
-extern int noOfAllEntitiesWithTypeAndIdRequests;
-extern int noOfIndividualContextEntityAttributeWithTypeAndId;
-extern int noOfAttributeValueInstanceWithTypeAndId;
-extern int noOfContextEntitiesByEntityIdAndType;
-extern int noOfEntityByIdAttributeByNameIdAndType;
-
-extern int noOfLogRequests;
-extern int noOfVersionRequests;
-extern int noOfExitRequests;
-extern int noOfLeakRequests;
-extern int noOfStatisticsRequests;
-extern int noOfInvalidRequests;
-extern int noOfRegisterResponses;
-
-extern int noOfRtSubscribeContextAvailabilityResponse;
-extern int noOfRtUpdateContextAvailabilitySubscriptionResponse;
-extern int noOfRtUnsubscribeContextAvailabilityResponse;
-extern int noOfRtUnsubscribeContextResponse;
-extern int noOfRtSubscribeResponse;
-extern int noOfRtSubscribeError;
-
-extern int noOfSimulatedNotifications;
-extern int noOfBatchQueryRequest;
-extern int noOfBatchUpdateRequest;
+extern StatCounter noOfJsonRequests;
+extern StatCounter noOfXmlRequests;
+extern StatCounter noOfRegistrations;
+extern StatCounter noOfRegistrationErrors;
+extern StatCounter noOfRegistrationUpdates;
+extern StatCounter noOfRegistrationUpdateErrors;
+extern StatCounter noOfDiscoveries;
+extern StatCounter noOfDiscoveryErrors;
+extern StatCounter noOfAvailabilitySubscriptions;
+extern StatCounter noOfAvailabilitySubscriptionErrors;
+extern StatCounter noOfAvailabilityUnsubscriptions;
+extern StatCounter noOfAvailabilityUnsubscriptionErrors;
+extern StatCounter noOfAvailabilitySubscriptionUpdates;
+extern StatCounter noOfAvailabilitySubscriptionUpdateErrors;
+extern StatCounter noOfAvailabilityNotificationsReceived;
+extern StatCounter noOfAvailabilityNotificationsSent;
+
+extern StatCounter noOfQueries;
+extern StatCounter noOfQueryErrors;
+extern StatCounter noOfUpdates;
+extern StatCounter noOfUpdateErrors;
+extern StatCounter noOfSubscriptions;
+extern StatCounter noOfSubscriptionErrors;
+extern StatCounter noOfSubscriptionUpdates;
+extern StatCounter noOfSubscriptionUpdateErrors;
+extern StatCounter noOfUnsubscriptions;
+extern StatCounter noOfUnsubscriptionErrors;
+extern StatCounter noOfNotificationsReceived;
+extern StatCounter noOfNotificationsSent;
+extern StatCounter noOfQueryContextResponses;
+extern StatCounter noOfUpdateContextResponses;
+extern StatCounter noOfContextEntitiesByEntityId;
+extern StatCounter noOfContextEntityAttributes;
+extern StatCounter noOfEntityByIdAttributeByName;
+extern StatCounter noOfContextEntityTypes;
+extern StatCounter noOfContextEntityTypeAttributeContainer;
+extern StatCounter noOfContextEntityTypeAttribute;
+extern StatCounter noOfIndividualContextEntity;
+extern StatCounter noOfIndividualContextEntityAttributes;
+extern StatCounter noOfAttributeValueInstance;
+extern StatCounter noOfIndividualContextEntityAttribute;
+extern StatCounter noOfUpdateContextElement;
+extern StatCounter noOfAppendContextElement;
+extern StatCounter noOfUpdateContextAttribute;
+extern StatCounter noOfNgsi10ContextEntityTypes;
+extern StatCounter noOfNgsi10ContextEntityTypesAttributeContainer;
+extern StatCounter noOfNgsi10ContextEntityTypesAttribute;
+extern StatCounter noOfNgsi10SubscriptionsConvOp;
+extern StatCounter noOfAllContextEntitiesRequests;
+extern StatCounter noOfAllEntitiesWithTypeAndIdRequests;
+extern StatCounter noOfIndividualContextEntityAttributeWithTypeAndId;
+extern StatCounter noOfAttributeValueInstanceWithTypeAndId;
+extern StatCounter noOfContextEntitiesByEntityIdAndType;
+extern StatCounter noOfEntityByIdAttributeByNameIdAndType;
+
+extern StatCounter noOfLogRequests;
+extern StatCounter noOfVersionRequests;
+extern StatCounter noOfExitRequests;
+extern StatCounter noOfLeakRequests;
+extern StatCounter noOfStatisticsRequests;
+extern StatCounter noOfInvalidRequests;
+extern StatCounter noOfRegisterResponses;
+
+extern StatCounter noOfRtSubscribeContextAvailabilityResponse;
+extern StatCounter noOfRtUpdateContextAvailabilitySubscriptionResponse;
+extern StatCounter noOfRtUnsubscribeContextAvailabilityResponse;
+extern StatCounter noOfRtUnsubscribeContextResponse;
+extern StatCounter noOfRtSubscribeResponse;
+extern StatCounter noOfRtSubscribeError;
+
+extern StatCounter noOfSimulatedNotifications;
+extern StatCounter noOfBatchQueryRequest;
+extern StatCounter noOfBatchUpdateRequest;
 
 
 
@@ -318,6 +440,14 @@ extern std::string renderTimingStatistics(void);
 
 
 
+/* ****************************************************************************
+*
+* timingStatisticsUpdate - add the times of a finished request to the timing statistics
+*/
+extern void timingStatisticsUpdate(TimeStat* tsP);
+
+
+
 /* ****************************************************************************
 *
 * timingStatisticsReset - 
@@ -801,3 +801,25 @@ std::string isodate2str(long long timestamp)
   strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S.00Z", gmtime(&rawtime));
   return std::string(buffer);
 }
+
+
+
+/*****************************************************************************
+*
+* regexEscape -
+*/
+std::string regexEscape(const std::string& s)
+{
+  std::string escaped;
+
+  for (unsigned int ix = 0; ix < s.size(); ++ix)
+  {
+    if ((s[ix] != 0) && (strchr(".[]{}()*+?|^$\\", s[ix]) != NULL))
+    {
+      escaped += '\\';
+    }
+    escaped += s[ix];
+  }
+
+  return escaped;
+}
@@ -185,4 +185,12 @@ template <typename T> std::string toString(T t)
 extern std::string isodate2str(long long timestamp);
 
 
+
+/*****************************************************************************
+*
+* regexEscape - escape the regex metacharacters of a literal string
+*/
+extern std::string regexEscape(const std::string& s);
+
+
 #endif  // SRC_LIB_COMMON_STRING_H_
@@ -23,23 +23,12 @@
 * Author: Ken Zangelin
 */
 #include <stdint.h>
+#include <string.h>
 
-//
-// http://www.boost.org/doc/libs/1_31_0/libs/spirit/doc/grammar.html:
-//
-//  if a grammar is intended to be used in multithreaded code, we should then define
-//  BOOST_SPIRIT_THREADSAFE before including any spirit header files.
-//  In this case it will also be required to link against Boost.Threads
-//
-#define BOOST_SPIRIT_THREADSAFE
-
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/json_parser.hpp>
-#include <boost/foreach.hpp>
-
-#include <set>
+#include <map>
+#include <vector>
 #include <string>
-#include <exception>
+#include <stdexcept>
 
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
@@ -58,11 +47,140 @@
 #include "jsonParse/JsonNode.h"
 #include "jsonParse/jsonParse.h"
 
-using boost::property_tree::ptree;
 using namespace orion;
 
 
 
+/* ****************************************************************************
+*
+* JsonNodeIndex - hash index of the paths of a parse vector
+*
+* Open addressing, with a table of at least twice the number of paths, so lookups
+* take one or two probes. If a path is repeated in the parse vector, the first one is used,
+* as with a linear search.
+*/
+typedef struct JsonNodeIndex
+{
+  std::vector<int>  slotV;     // index in the parse vector, -1 for empty slots
+  unsigned int      mask;
+  unsigned int      nodes;     // number of nodes in the parse vector
+} JsonNodeIndex;
+
+
+
+/* ****************************************************************************
+*
+* nodeIndexMap - the indexes built by jsonParseIndex
+*
+* Filled before the broker starts serving requests and never modified afterwards, so
+* it is read without any lock.
+*/
+static std::map<const JsonNode*, JsonNodeIndex*>  nodeIndexMap;
+
+
+
+/* ****************************************************************************
+*
+* pathHash - FNV-1a
+*/
+static inline unsigned int pathHash(const std::string& path)
+{
+  unsigned int h = 2166136261U;
+
+  for (unsigned int ix = 0; ix < path.size(); ++ix)
+  {
+    h = (h ^ (unsigned char) path[ix]) * 16777619U;
+  }
+
+  return h;
+}
+
+
+
+/* ****************************************************************************
+*
+* nodeIndexBuild - build the index of a parse vector
+*/
+static void nodeIndexBuild(JsonNode* parseVector, JsonNodeIndex* indexP)
+{
+  unsigned int size = 4;
+
+  indexP->nodes = 0;
+  while (parseVector[indexP->nodes].path != "LAST")
+  {
+    ++indexP->nodes;
+  }
+
+  while (size < indexP->nodes * 2)
+  {
+    size *= 2;
+  }
+
+  indexP->mask = size - 1;
+  indexP->slotV.resize(size, -1);
+
+  for (unsigned int ix = 0; ix < indexP->nodes; ++ix)
+  {
+    unsigned int slot = pathHash(parseVector[ix].path) & indexP->mask;
+
+    while ((indexP->slotV[slot] != -1) && (parseVector[indexP->slotV[slot]].path != parseVector[ix].path))
+    {
+      slot = (slot + 1) & indexP->mask;
+    }
+
+    if (indexP->slotV[slot] == -1)
+    {
+      indexP->slotV[slot] = ix;
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* jsonParseIndex - 
+*/
+void jsonParseIndex(JsonNode* parseVector)
+{
+  if (nodeIndexMap.find(parseVector) != nodeIndexMap.end())
+  {
+    return;
+  }
+
+  JsonNodeIndex* indexP = new JsonNodeIndex();
+
+  nodeIndexBuild(parseVector, indexP);
+  nodeIndexMap[parseVector] = indexP;
+}
+
+
+
+/* ****************************************************************************
+*
+* nodeLookup - the node of a parse vector for a path, NULL if not found
+*/
+static JsonNode* nodeLookup(JsonNode* parseVector, JsonNodeIndex* indexP, const std::string& path)
+{
+  unsigned int slot = pathHash(path) & indexP->mask;
+
+  while (indexP->slotV[slot] != -1)
+  {
+    JsonNode* nodeP = &parseVector[indexP->slotV[slot]];
+
+    if (nodeP->path == path)
+    {
+      return nodeP;
+    }
+
+    slot = (slot + 1) & indexP->mask;
+  }
+
+  return NULL;
+}
+
+
+
 /* ****************************************************************************
 *
 * compoundRootV -
@@ -138,53 +256,503 @@ static bool isScopeValue(const char* path)
 
 
 
+/* ****************************************************************************
+*
+* JsonReader - position of the parser in the payload
+*
+* The payload is parsed in one pass, as a stream of tokens, without building any
+* intermediate tree. The values are the same as those of the boost property_tree JSON
+* parser used before: numbers, true, false and null are kept as their literal text,
+* and empty strings, objects and arrays can't be told apart (all of them are "" without children).
+*/
+typedef struct JsonReader
+{
+  ConnectionInfo*  ciP;
+  JsonNode*        parseVector;
+  JsonNodeIndex*   indexP;
+  ParseData*       parseDataP;
+  const char*      start;
+  const char*      cP;
+} JsonReader;
+
+
+
+/* ****************************************************************************
+*
+* JsonValueKind -
+*/
+typedef enum JsonValueKind
+{
+  JsonScalar,
+  JsonObject,
+  JsonArray
+} JsonValueKind;
+
+
+
+/* ****************************************************************************
+*
+* parseError - throw an exception, as the boost parser did for syntax errors
+*/
+static void parseError(JsonReader* rP, const char* what)
+{
+  int line = 1;
+
+  for (const char* cP = rP->start; cP < rP->cP; ++cP)
+  {
+    if (*cP == '\n')
+    {
+      ++line;
+    }
+  }
+
+  char details[128];
+
+  snprintf(details, sizeof(details), "line %d: %s", line, what);
+  throw std::runtime_error(details);
+}
+
+
+
+/* ****************************************************************************
+*
+* skipWs -
+*/
+static inline void skipWs(JsonReader* rP)
+{
+  while ((*rP->cP == ' ') || (*rP->cP == '\t') || (*rP->cP == '\n') || (*rP->cP == '\r'))
+  {
+    ++rP->cP;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* utf8Append - append a code point encoded in UTF-8
+*/
+static void utf8Append(std::string* outP, unsigned int cp)
+{
+  if (cp < 0x80)
+  {
+    *outP += (char) cp;
+  }
+  else if (cp < 0x800)
+  {
+    *outP += (char) (0xC0 | (cp >> 6));
+    *outP += (char) (0x80 | (cp & 0x3F));
+  }
+  else if (cp < 0x10000)
+  {
+    *outP += (char) (0xE0 | (cp >> 12));
+    *outP += (char) (0x80 | ((cp >> 6) & 0x3F));
+    *outP += (char) (0x80 | (cp & 0x3F));
+  }
+  else
+  {
+    *outP += (char) (0xF0 | (cp >> 18));
+    *outP += (char) (0x80 | ((cp >> 12) & 0x3F));
+    *outP += (char) (0x80 | ((cp >> 6) & 0x3F));
+    *outP += (char) (0x80 | (cp & 0x3F));
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* hex4 - read the four hex digits of a \u escape
+*/
+static unsigned int hex4(JsonReader* rP)
+{
+  unsigned int cp = 0;
+
+  for (int ix = 0; ix < 4; ++ix)
+  {
+    char c = *rP->cP++;
+
+    cp <<= 4;
+
+    if      ((c >= '0') && (c <= '9'))  cp |= c - '0';
+    else if ((c >= 'a') && (c <= 'f'))  cp |= c - 'a' + 10;
+    else if ((c >= 'A') && (c <= 'F'))  cp |= c - 'A' + 10;
+    else
+    {
+      --rP->cP;
+      parseError(rP, "invalid escape sequence");
+    }
+  }
+
+  return cp;
+}
+
+
+
+/* ****************************************************************************
+*
+* utf8Length - length of a well-formed UTF-8 sequence starting at 'cP', 0 if invalid
+*/
+static int utf8Length(const unsigned char* cP)
+{
+  int len;
+
+  if      ((cP[0] >= 0xC2) && (cP[0] <= 0xDF))  len = 2;
+  else if ((cP[0] >= 0xE0) && (cP[0] <= 0xEF))  len = 3;
+  else if ((cP[0] >= 0xF0) && (cP[0] <= 0xF4))  len = 4;
+  else                                          return 0;
+
+  for (int ix = 1; ix < len; ++ix)
+  {
+    if ((cP[ix] & 0xC0) != 0x80)
+    {
+      return 0;
+    }
+  }
+
+  return len;
+}
+
+
+
+/* ****************************************************************************
+*
+* readString - read a string token (the reader is on the opening quote)
+*/
+static void readString(JsonReader* rP, std::string* outP)
+{
+  ++rP->cP;  // opening quote
+  outP->clear();
+
+  while (true)
+  {
+    // Copy in one go the run of plain characters
+    const char* runP = rP->cP;
+
+    while (((unsigned char) *rP->cP >= 0x20) && (*rP->cP != '"') && (*rP->cP != '\\') && ((unsigned char) *rP->cP < 0x80))
+    {
+      ++rP->cP;
+    }
+    outP->append(runP, rP->cP - runP);
+
+    unsigned char c = *rP->cP;
+
+    if (c == '"')
+    {
+      ++rP->cP;
+      return;
+    }
+    else if (c == '\\')
+    {
+      ++rP->cP;
+      switch (*rP->cP++)
+      {
+      case '"':  *outP += '"';  break;
+      case '\\': *outP += '\\'; break;
+      case '/':  *outP += '/';  break;
+      case 'b':  *outP += '\b'; break;
+      case 'f':  *outP += '\f'; break;
+      case 'n':  *outP += '\n'; break;
+      case 'r':  *outP += '\r'; break;
+      case 't':  *outP += '\t'; break;
+      case 'u':
+        {
+          unsigned int cp = hex4(rP);
+
+          if ((cp >= 0xD800) && (cp <= 0xDBFF))
+          {
+            if ((rP->cP[0] != '\\') || (rP->cP[1] != 'u'))
+            {
+              parseError(rP, "invalid codepoint, stray high surrogate");
+            }
+            rP->cP += 2;
+
+            unsigned int low = hex4(rP);
+
+            if ((low < 0xDC00) || (low > 0xDFFF))
+            {
+              parseError(rP, "expected low surrogate after high surrogate");
+            }
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+          }
+          else if ((cp >= 0xDC00) && (cp <= 0xDFFF))
+          {
+            parseError(rP, "invalid codepoint, stray low surrogate");
+          }
+
+          utf8Append(outP, cp);
+        }
+        break;
+      default:
+        --rP->cP;
+        parseError(rP, "invalid escape sequence");
+      }
+    }
+    else if (c >= 0x80)
+    {
+      int len = utf8Length((const unsigned char*) rP->cP);
+
+      if (len == 0)
+      {
+        parseError(rP, "invalid code sequence");
+      }
+      outP->append(rP->cP, len);
+      rP->cP += len;
+    }
+    else if (c == 0)
+    {
+      parseError(rP, "unterminated string");
+    }
+    else
+    {
+      parseError(rP, "invalid code sequence");
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* readDigits -
+*/
+static inline bool readDigits(JsonReader* rP)
+{
+  const char* startP = rP->cP;
+
+  while ((*rP->cP >= '0') && (*rP->cP <= '9'))
+  {
+    ++rP->cP;
+  }
+
+  return rP->cP != startP;
+}
+
+
+
+/* ****************************************************************************
+*
+* readNumber - read a number, keeping its literal text
+*/
+static void readNumber(JsonReader* rP, std::string* outP)
+{
+  const char* startP = rP->cP;
+
+  if (*rP->cP == '-')
+  {
+    ++rP->cP;
+  }
+
+  if (*rP->cP == '0')
+  {
+    ++rP->cP;
+  }
+  else if (readDigits(rP) == false)
+  {
+    parseError(rP, (startP == rP->cP)? "expected value" : "expected digits after -");
+  }
+
+  if (*rP->cP == '.')
+  {
+    ++rP->cP;
+    if (readDigits(rP) == false)
+    {
+      parseError(rP, "need at least one digit after '.'");
+    }
+  }
+
+  if ((*rP->cP == 'e') || (*rP->cP == 'E'))
+  {
+    ++rP->cP;
+    if ((*rP->cP == '+') || (*rP->cP == '-'))
+    {
+      ++rP->cP;
+    }
+
+    if (readDigits(rP) == false)
+    {
+      parseError(rP, "need at least one digit in exponent");
+    }
+  }
+
+  outP->assign(startP, rP->cP - startP);
+}
+
+
+
+/* ****************************************************************************
+*
+* readLiteral - read true, false or null, keeping its literal text
+*/
+static void readLiteral(JsonReader* rP, const char* literal, std::string* outP)
+{
+  size_t len = strlen(literal);
+
+  if (strncmp(rP->cP, literal, len) != 0)
+  {
+    std::string details = std::string("expected '") + literal + "'";
+    parseError(rP, details.c_str());
+  }
+
+  rP->cP += len;
+  outP->assign(literal, len);
+}
+
+
+
+/* ****************************************************************************
+*
+* readValueStart - read a scalar value or the start of an object/array
+*
+* For objects and arrays, *hasChildrenP tells whether they are empty or not
+* (if empty, the closing bracket is consumed too).
+*/
+static JsonValueKind readValueStart(JsonReader* rP, std::string* valueP, bool* hasChildrenP)
+{
+  char c = *rP->cP;
+
+  *hasChildrenP = false;
+
+  if ((c == '{') || (c == '['))
+  {
+    char close = (c == '{')? '}' : ']';
+
+    ++rP->cP;
+    skipWs(rP);
+    valueP->clear();
+
+    if (*rP->cP == close)
+    {
+      ++rP->cP;
+    }
+    else
+    {
+      *hasChildrenP = true;
+    }
+
+    return (c == '{')? JsonObject : JsonArray;
+  }
+
+  if      (c == '"')                                  readString(rP, valueP);
+  else if ((c == '-') || ((c >= '0') && (c <= '9')))  readNumber(rP, valueP);
+  else if (c == 't')                                  readLiteral(rP, "true", valueP);
+  else if (c == 'f')                                  readLiteral(rP, "false", valueP);
+  else if (c == 'n')                                  readLiteral(rP, "null", valueP);
+  else                                                parseError(rP, "expected value");
+
+  return JsonScalar;
+}
+
+
+
+/* ****************************************************************************
+*
+* readMemberName - read the name of the next member of a non-empty object
+*
+* Returns false at the end of the object/array (the closing bracket is consumed).
+* The first member is read with 'first' set, as there is no separator before it.
+*/
+static bool readMemberName(JsonReader* rP, JsonValueKind kind, bool first, std::string* nameP)
+{
+  skipWs(rP);
+
+  if (first == false)
+  {
+    char close = (kind == JsonObject)? '}' : ']';
+
+    if (*rP->cP == close)
+    {
+      ++rP->cP;
+      return false;
+    }
+
+    if (*rP->cP != ',')
+    {
+      parseError(rP, (kind == JsonObject)? "expected '}' or ','" : "expected ']' or ','");
+    }
+
+    ++rP->cP;
+    skipWs(rP);
+  }
+
+  if (kind == JsonArray)
+  {
+    nameP->clear();
+    return true;
+  }
+
+  if (*rP->cP != '"')
+  {
+    parseError(rP, "expected key string");
+  }
+
+  readString(rP, nameP);
+  skipWs(rP);
+
+  if (*rP->cP != ':')
+  {
+    parseError(rP, "expected ':'");
+  }
+
+  ++rP->cP;
+  skipWs(rP);
+
+  return true;
+}
+
+
+
 /* ****************************************************************************
 *
 * treat -
 */
 static bool treat
 (
-  ConnectionInfo*     ciP,
+  JsonReader*         rP,
   const std::string&  path,
-  const std::string&  value,
-  JsonNode*           parseVector,
-  ParseData*          parseDataP
+  const std::string&  value
 )
 {
+  ConnectionInfo* ciP = rP->ciP;
+
   LM_T(LmtTreat, ("Treating path '%s', value '%s'", path.c_str(), value.c_str()));
 
-  for (unsigned int ix = 0; parseVector[ix].path != "LAST"; ++ix)
+  if (rP->indexP->nodes == 0)
   {
-    //
-    // Before treating a node, a check is made that the value of the node has no forbidden
-    // characters.
-    // 
-    // For scopes, the check for forbiddenChars is postponed to the check() method of scope
-    //
-    if (!isScopeValue(path.c_str()))
-    {
-      if (forbiddenChars(value.c_str()) == true)
-      {
-        std::string details = std::string("found a forbidden value in '") + value + "'";
-          
-        alarmMgr.badInput(clientIp, details);
-        ciP->httpStatusCode = SccBadRequest;
-        ciP->answer = std::string("Illegal value for JSON field");
-        return false;
-      }
-    }
+    return false;
+  }
 
-    if (path == parseVector[ix].path)
+  //
+  // Before treating a node, a check is made that the value of the node has no forbidden
+  // characters.
+  //
+  // For scopes, the check for forbiddenChars is postponed to the check() method of scope
+  //
+  if (!isScopeValue(path.c_str()))
+  {
+    if (forbiddenChars(value.c_str()) == true)
     {
-      LM_T(LmtTreat, ("calling treat function for '%s': '%s'", path.c_str(), value.c_str()));
-      std::string res = parseVector[ix].treat(path, value, parseDataP);
-      LM_T(LmtTreat, ("called treat function for '%s'. result: '%s'", path.c_str(), res.c_str()));
+      std::string details = std::string("found a forbidden value in '") + value + "'";
 
-      return true;
+      alarmMgr.badInput(clientIp, details);
+      ciP->httpStatusCode = SccBadRequest;
+      ciP->answer = std::string("Illegal value for JSON field");
+      return false;
     }
   }
 
-  return false;
+  JsonNode* nodeP = nodeLookup(rP->parseVector, rP->indexP, path);
+
+  if (nodeP == NULL)
+  {
+    return false;
+  }
+
+  LM_T(LmtTreat, ("calling treat function for '%s': '%s'", path.c_str(), value.c_str()));
+  std::string res = nodeP->treat(path, value, rP->parseDataP);
+  LM_T(LmtTreat, ("called treat function for '%s'. result: '%s'", path.c_str(), res.c_str()));
+
+  return true;
 }
 
 
@@ -251,19 +819,21 @@ std::string nodeType(const std::string& nodeName, const std::string& value, orio
 /* ****************************************************************************
 *
 * eatCompound -
+*
+* Consume the value of a member of a compound (the reader is on the value), adding it to
+* 'containerP'. If 'containerP' is NULL, the value is the compound root.
 */
-void eatCompound
+static void eatCompound
 (
-  ConnectionInfo*                           ciP,
-  orion::CompoundValueNode*                 containerP,
-  boost::property_tree::ptree::value_type&  v,
-  const std::string&                        indent
+  JsonReader*                rP,
+  orion::CompoundValueNode*  containerP,
+  const std::string&         nodeName
 )
 {
-  std::string                  nodeName     = v.first.data();
-  std::string                  nodeValue    = v.second.data();
-  boost::property_tree::ptree  subtree1     = (boost::property_tree::ptree) v.second;
-  int                          noOfChildren = subtree1.size();
+  ConnectionInfo*  ciP = rP->ciP;
+  std::string      nodeValue;
+  bool             hasChildren;
+  JsonValueKind    kind = readValueStart(rP, &nodeValue, &hasChildren);
 
   if (containerP == NULL)
   {
@@ -291,12 +861,12 @@ void eatCompound
                               nodeValue.c_str(),
                               containerP->cpath()));
     }
-    else if ((nodeName == "") && (nodeValue == "") && (noOfChildren == 0))  // Unnamed String with EMPTY VALUE
+    else if ((nodeName == "") && (nodeValue == "") && (hasChildren == false))  // Unnamed String with EMPTY VALUE
     {
       LM_T(LmtCompoundValue, ("'Bad' input - looks like a container but it is an EMPTY STRING - no name, no value"));
       containerP->add(orion::ValueTypeString, "item", "");
     }
-    else if ((nodeName != "") && (nodeValue == "") && (noOfChildren == 0))  // Named Empty string
+    else if ((nodeName != "") && (nodeValue == "") && (hasChildren == false))  // Named Empty string
     {
       LM_T(LmtCompoundValue, ("Adding container '%s' under '%s'", nodeName.c_str(), containerP->cpath()));
       containerP = containerP->add(ValueTypeString, nodeName, "");
@@ -324,10 +894,16 @@ void eatCompound
       LM_T(LmtCompoundValue, ("IMPOSSIBLE !!!"));
   }
 
-  boost::property_tree::ptree subtree = (boost::property_tree::ptree) v.second;
-  BOOST_FOREACH(boost::property_tree::ptree::value_type &v2, subtree)
+  if (hasChildren == false)
   {
-    eatCompound(ciP, containerP, v2, indent + "  ");
+    return;
+  }
+
+  std::string childName;
+
+  for (bool first = true; readMemberName(rP, kind, first, &childName) == true; first = false)
+  {
+    eatCompound(rP, containerP, childName);
   }
 }
 
@@ -336,24 +912,24 @@ void eatCompound
 /* ****************************************************************************
 *
 * jsonParse -
+*
+* Treat a member of an object or array (the reader is on its value) and its children, if any.
 */
 static std::string jsonParse
 (
-  ConnectionInfo*                           ciP,
-  boost::property_tree::ptree::value_type&  v,
-  const std::string&                        _path,
-  JsonNode*                                 parseVector,
-  ParseData*                                parseDataP
+  JsonReader*         rP,
+  const std::string&  nodeName,
+  const std::string&  _path
 )
 {
-  std::string                     nodeName         = v.first.data();
-  std::string                     nodeValue        = v.second.data();
-  std::string                     arrayElementName = getArrayElementName(_path);
-  std::string                     path             = _path;
-  bool                            treated;
-
-  // If the node name is empty, boost will yield an empty name. This will happen only in the case of a vector.
-  // See: http://www.boost.org/doc/libs/1_41_0/doc/html/boost_propertytree/parsers.html#boost_propertytree.parsers.json_parser
+  ConnectionInfo*  ciP              = rP->ciP;
+  std::string      arrayElementName = getArrayElementName(_path);
+  std::string      path             = _path;
+  std::string      nodeValue;
+  bool             hasChildren;
+  bool             treated;
+
+  // Array items have no name
   if (nodeName != "")
   {
     // This detects whether we are trying to use an object within an object instead of an one-item array.
@@ -373,26 +949,38 @@ static std::string jsonParse
     path = path + "/" + arrayElementName;
   }
 
-  treated = treat(ciP, path, nodeValue, parseVector, parseDataP);
-
-
-  boost::property_tree::ptree subtree = (boost::property_tree::ptree) v.second;
-  int                         noOfChildren = subtree.size();
-  if ((isCompoundPath(path.c_str()) == true) && (nodeValue == "") && (noOfChildren != 0))
+  if (isCompoundPath(path.c_str()) && ((*rP->cP == '{') || (*rP->cP == '[')))
   {
+    const char*  valueStart = rP->cP;
+    std::string  ignored;
+    bool         isCompound;
 
-    LM_T(LmtCompoundValue, ("Calling eatCompound for '%s'", path.c_str()));
-    eatCompound(ciP, NULL, v, "");
-    compoundValueEnd(ciP, parseDataP);
+    // Peek if the object/array is empty: if not, the whole value is a compound
+    readValueStart(rP, &ignored, &isCompound);
+    rP->cP = valueStart;
 
-    if (ciP->httpStatusCode != SccOk)
+    if (isCompound)
     {
-      return ciP->answer;
-    }
+      treated = treat(rP, path, "");
 
-    return "OK";
+      LM_T(LmtCompoundValue, ("Calling eatCompound for '%s'", path.c_str()));
+      eatCompound(rP, NULL, nodeName);
+      compoundValueEnd(ciP, rP->parseDataP);
+
+      if (ciP->httpStatusCode != SccOk)
+      {
+        return ciP->answer;
+      }
+
+      return "OK";
+    }
   }
-  else if (treated == false)
+
+  JsonValueKind kind = readValueStart(rP, &nodeValue, &hasChildren);
+
+  treated = treat(rP, path, nodeValue);
+
+  if (treated == false)
   {
     ciP->httpStatusCode = SccBadRequest;
     if (ciP->answer == "")
@@ -405,15 +993,16 @@ static std::string jsonParse
     return ciP->answer;
   }
 
-  if (noOfChildren == 0)
+  if (hasChildren == false)
   {
     return "OK";
   }
 
-  subtree = (boost::property_tree::ptree) v.second;
-  BOOST_FOREACH(boost::property_tree::ptree::value_type &v2, subtree)
+  std::string childName;
+
+  for (bool first = true; readMemberName(rP, kind, first, &childName) == true; first = false)
   {
-    std::string out = jsonParse(ciP, v2, path, parseVector, parseDataP);
+    std::string out = jsonParse(rP, childName, path);
     if (out != "OK")
     {
       std::string details = std::string("JSON parse error: '") + out + "'";
@@ -440,27 +1029,60 @@ std::string jsonParse
   ParseData*          parseDataP
 )
 {
-  std::stringstream  ss;
-  ptree              tree;
-  ptree              subtree;
-  std::string        path;
-  struct timespec    start;
-  struct timespec    end;
+  JsonReader       reader;
+  JsonNodeIndex    localIndex;
+  std::string      nodeValue;
+  std::string      childName;
+  bool             hasChildren;
+  struct timespec  start;
+  struct timespec  end;
 
   if (timingStatistics)
   {
     clock_gettime(CLOCK_REALTIME, &start);
   }
 
-  ss << content;
-  read_json(ss, subtree);
+  reader.ciP          = ciP;
+  reader.parseVector  = parseVector;
+  reader.indexP       = NULL;
+  reader.parseDataP   = parseDataP;
+  reader.start        = content;
+  reader.cP           = content;
 
-  tree.put_child(requestType, subtree);
+  //
+  // Parse vectors not indexed by jsonParseIndex get an index for this parse only
+  //
+  std::map<const JsonNode*, JsonNodeIndex*>::const_iterator it = nodeIndexMap.find(parseVector);
+
+  if (it != nodeIndexMap.end())
+  {
+    reader.indexP = it->second;
+  }
+  else
+  {
+    nodeIndexBuild(parseVector, &localIndex);
+    reader.indexP = &localIndex;
+  }
 
-  // LM_T(LmtParse, ("parsing '%s'", content));
-  BOOST_FOREACH(boost::property_tree::ptree::value_type &v, tree.get_child(requestType))
+  // UTF-8 BOM
+  if (strncmp(reader.cP, "\xEF\xBB\xBF", 3) == 0)
   {
-    std::string res = jsonParse(ciP, v, path, parseVector, parseDataP);
+    reader.cP += 3;
+  }
+
+  skipWs(&reader);
+
+  // As with the boost parser, the payload must be an object or an array
+  if ((*reader.cP != '{') && (*reader.cP != '['))
+  {
+    parseError(&reader, "expected object or array");
+  }
+
+  JsonValueKind kind = readValueStart(&reader, &nodeValue, &hasChildren);
+
+  for (bool first = true; hasChildren && (readMemberName(&reader, kind, first, &childName) == true); first = false)
+  {
+    std::string res = jsonParse(&reader, childName, "");
     if (res != "OK")
     {
       std::string details = std::string("JSON parse error: '") + res + "'";
@@ -469,6 +1091,12 @@ std::string jsonParse
     }
   }
 
+  skipWs(&reader);
+  if (*reader.cP != 0)
+  {
+    parseError(&reader, "garbage after data");
+  }
+
   if (timingStatistics)
   {
     clock_gettime(CLOCK_REALTIME, &end);
@@ -46,4 +46,16 @@ extern std::string jsonParse
   ParseData*          reqDataP
 );
 
+
+
+/* ****************************************************************************
+*
+* jsonParseIndex - build the path index of a parse vector
+*
+* To be called before the broker starts serving requests (jsonRequestInit does it for all
+* the parse vectors of the NGSIv1 requests), as the indexes are read without any lock.
+* Parse vectors that are not indexed get a temporary index on each parse.
+*/
+extern void jsonParseIndex(JsonNode* parseVector);
+
 #endif  // SRC_LIB_JSONPARSE_JSONPARSE_H_
@@ -135,6 +135,23 @@ static JsonRequest jsonRequest[] =
 
 
 
+/* ****************************************************************************
+*
+* jsonRequestInit -
+*/
+void jsonRequestInit(void)
+{
+  for (unsigned int ix = 0; ix < sizeof(jsonRequest) / sizeof(jsonRequest[0]); ++ix)
+  {
+    if (jsonRequest[ix].parseVector != NULL)
+    {
+      jsonParseIndex(jsonRequest[ix].parseVector);
+    }
+  }
+}
+
+
+
 /* ****************************************************************************
 *
 * jsonRequestGet -
@@ -66,4 +66,12 @@ extern std::string jsonTreat
   JsonRequest**       reqPP
 );
 
+
+
+/* ****************************************************************************
+*
+* jsonRequestInit - index the parse vectors of all the requests
+*/
+extern void jsonRequestInit(void);
+
 #endif  // SRC_LIB_JSONPARSE_JSONREQUEST_H_
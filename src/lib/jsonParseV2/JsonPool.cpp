@@ -0,0 +1,65 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <new>
+
+#include "rapidjson/document.h"
+
+#include "common/limits.h"
+#include "common/Arena.h"
+#include "jsonParseV2/JsonPool.h"
+
+using namespace rapidjson;
+
+
+
+/* ****************************************************************************
+*
+* JsonPool::JsonPool - 
+*/
+JsonPool::JsonPool(Arena* arenaP): allocatorP(NULL)
+{
+  void* poolP = arenaP->alloc(JSON_V2_POOL_SIZE);
+
+  if (poolP != NULL)
+  {
+    allocatorP = new (storage) MemoryPoolAllocator<>(poolP, JSON_V2_POOL_SIZE);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* JsonPool::~JsonPool - 
+*
+* The chunks taken from the heap when the first one was not enough are freed here.
+*/
+JsonPool::~JsonPool()
+{
+  if (allocatorP != NULL)
+  {
+    allocatorP->~MemoryPoolAllocator<>();
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef SRC_LIB_JSONPARSEV2_JSONPOOL_H_
+#define SRC_LIB_JSONPARSEV2_JSONPOOL_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include "rapidjson/document.h"
+
+#include "common/Arena.h"
+
+
+
+/* ****************************************************************************
+*
+* JsonPool - memory pool of the DOM of an NGSIv2 payload
+*
+* The first chunk of the pool (JSON_V2_POOL_SIZE bytes) is taken from the request arena.
+* If the arena can't provide it, allocator() returns NULL, so that the document uses the
+* default rapidjson allocator:
+*
+*   JsonPool             pool(&ciP->arena);
+*   rapidjson::Document  document(pool.allocator());
+*
+* The pool must outlive the document.
+*/
+class JsonPool
+{
+ public:
+  explicit JsonPool(Arena* arenaP);
+  ~JsonPool();
+
+  rapidjson::MemoryPoolAllocator<>* allocator(void) { return allocatorP; }
+
+ private:
+  rapidjson::MemoryPoolAllocator<>*  allocatorP;
+  char                               storage[sizeof(rapidjson::MemoryPoolAllocator<>)] __attribute__((aligned(sizeof(double))));
+
+  JsonPool(const JsonPool&);
+  JsonPool& operator=(const JsonPool&);
+};
+
+#endif  // SRC_LIB_JSONPARSEV2_JSONPOOL_H_
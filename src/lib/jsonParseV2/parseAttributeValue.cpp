@@ -28,6 +28,7 @@
 #include "rest/ConnectionInfo.h"
 #include "rest/OrionError.h"
 #include "ngsi/ParseData.h"
+#include "jsonParseV2/JsonPool.h"
 #include "jsonParseV2/parseAttributeValue.h"
 #include "jsonParseV2/parseContextAttributeCompoundValue.h"
 
@@ -41,10 +42,11 @@ using namespace rapidjson;
 */
 std::string parseAttributeValue(ConnectionInfo* ciP, ContextAttribute* caP)
 {
-  Document    document;
-  OrionError  oe;
+  JsonPool               pool(&ciP->arena);
+  Document               document(pool.allocator());
+  OrionError             oe;
 
-  document.Parse(ciP->payload);
+  document.ParseInsitu(ciP->payload);
 
   if (document.HasParseError())
   {
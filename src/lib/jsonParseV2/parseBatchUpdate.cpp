@@ -28,6 +28,7 @@
 #include "rest/ConnectionInfo.h"
 #include "ngsi/ParseData.h"
 #include "ngsi/Request.h"
+#include "jsonParseV2/JsonPool.h"
 #include "jsonParseV2/jsonParseTypeNames.h"
 #include "jsonParseV2/parseEntityVector.h"
 #include "jsonParseV2/parseAttributeList.h"
@@ -43,9 +44,10 @@ using namespace rapidjson;
 */
 std::string parseBatchUpdate(ConnectionInfo* ciP, BatchUpdate* burP)
 {
-  Document document;
+  JsonPool               pool(&ciP->arena);
+  Document               document(pool.allocator());
 
-  document.Parse(ciP->payload);
+  document.ParseInsitu(ciP->payload);
 
   if (document.HasParseError())
   {
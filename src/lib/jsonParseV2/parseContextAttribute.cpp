@@ -29,6 +29,7 @@
 #include "ngsi/ContextAttribute.h"
 #include "parse/CompoundValueNode.h"
 #include "alarmMgr/alarmMgr.h"
+#include "jsonParseV2/JsonPool.h"
 #include "jsonParseV2/jsonParseTypeNames.h"
 #include "jsonParseV2/parseContextAttribute.h"
 #include "jsonParseV2/parseMetadataVector.h"
@@ -277,9 +278,10 @@ std::string parseContextAttribute(ConnectionInfo* ciP, const Value::ConstMemberI
 */
 std::string parseContextAttribute(ConnectionInfo* ciP, ContextAttribute* caP)
 {
-  Document  document;
+  JsonPool               pool(&ciP->arena);
+  Document               document(pool.allocator());
 
-  document.Parse(ciP->payload);
+  document.ParseInsitu(ciP->payload);
 
   if (document.HasParseError())
   {
@@ -27,6 +27,7 @@
 #include "rest/ConnectionInfo.h"
 #include "ngsi/ParseData.h"
 #include "ngsi/Request.h"
+#include "jsonParseV2/JsonPool.h"
 #include "jsonParseV2/jsonParseTypeNames.h"
 #include "jsonParseV2/parseEntity.h"
 #include "jsonParseV2/parseContextAttribute.h"
@@ -58,9 +59,10 @@ using namespace rapidjson;
 */
 std::string parseEntity(ConnectionInfo* ciP, Entity* eP, bool eidInURL)
 {
-  Document document;
+  JsonPool               pool(&ciP->arena);
+  Document               document(pool.allocator());
 
-  document.Parse(ciP->payload);
+  document.ParseInsitu(ciP->payload);
 
   if (document.HasParseError())
   {
@@ -33,6 +33,7 @@
 #include "rest/OrionError.h"
 #include "ngsi/ParseData.h"
 #include "ngsi/Request.h"
+#include "jsonParseV2/JsonPool.h"
 #include "jsonParseV2/jsonParseTypeNames.h"
 #include "jsonParseV2/jsonRequestTreat.h"
 #include "jsonParseV2/parseSubscription.h"
@@ -57,10 +58,11 @@ static std::string parseNotifyConditionVector(ConnectionInfo* ciP, SubscribeCont
 */
 std::string parseSubscription(ConnectionInfo* ciP, ParseData* parseDataP, JsonDelayedRelease* releaseP, bool update)
 {
-  Document                  document;
+  JsonPool                  pool(&ciP->arena);
+  Document                  document(pool.allocator());
   SubscribeContextRequest*  destination;
 
-  document.Parse(ciP->payload);
+  document.ParseInsitu(ciP->payload);
 
   if (update)
   {
@@ -45,6 +45,8 @@
 #include <sys/time.h>           /* gettimeofday                              */
 #include <time.h>               /* time, gmtime_r, ...                       */
 #include <sys/timeb.h>          /* timeb, ftime, ...                         */
+#include <sys/uio.h>            /* writev, struct iovec                      */
+#include <pthread.h>            /* pthread_create, pthread_key_create, ...   */
 
 #undef NDEBUG
 #include <assert.h>
@@ -276,6 +278,9 @@ do                                                \
 #define AUX_LEN          16
 #define LOG_PERM         0666
 #define LOG_MASK         0
+#define ASYNC_IOV_MAX    64        /* iovecs per writev of the async writer    */
+#define ASYNC_SLEEP      10000     /* usecs the async writer sleeps when idle  */
+#define ASYNC_FLUSH_MAX  200       /* max naps (of ASYNC_SLEEP) in lmAsyncFlush */
 
 
 
@@ -337,6 +342,41 @@ typedef struct Line
 
 
 
+/* ****************************************************************************
+*
+* AsyncBufferState -
+*/
+typedef enum AsyncBufferState
+{
+  AbUsed = 0,   /* owned by a running thread                              */
+  AbOrphan,     /* its thread is gone, the writer still has lines to take */
+  AbFree        /* empty, can be taken by a new thread                    */
+} AsyncBufferState;
+
+
+
+/* ****************************************************************************
+*
+* AsyncBuffer - log lines of a thread, waiting for the async writer
+*
+* There is a ring of bytes per log file descriptor. The thread owning the buffer is the only
+* one moving 'head' (after copying a line into the ring) and the writer thread is the only one
+* moving 'tail' (after writing the bytes), so no lock is needed.
+* head and tail grow forever, their position in the ring is (head & asyncRingMask).
+*/
+typedef struct AsyncBuffer
+{
+  char*                  ring[FDS_MAX];
+  volatile unsigned int  head[FDS_MAX];
+  volatile unsigned int  tail[FDS_MAX];
+  volatile int           state;
+  char*                  line;       /* scratch buffers of the owner thread */
+  char*                  format;
+  struct AsyncBuffer*    next;
+} AsyncBuffer;
+
+
+
 /******************************************************************************
 *
 * globals
@@ -379,6 +419,16 @@ static bool              doClear                = false;
 static int               fdNoOf                 = 0;
 static LmTracelevelName  userTracelevelName     = NULL;
 static int               lmSd                   = -1;
+static bool              asyncOn                = false;
+static unsigned int      asyncRingSize          = 0;
+static unsigned int      asyncRingMask          = 0;
+static AsyncBuffer*      asyncBufferList        = NULL;
+static pthread_key_t     asyncBufferKey;
+static bool              asyncKeyCreated        = false;
+static pthread_t         asyncWriterTid;
+static volatile bool     asyncStopping          = false;
+static long long         asyncDropped           = 0;
+static __thread AsyncBuffer* asyncBufferP        = NULL;
 
 
 
@@ -2194,120 +2244,694 @@ LmStatus lmPathRegister
 
 /* ****************************************************************************
 *
-* lmOut -
+* lmLineBuild - format the log line for the file descriptor 'index'
+*
+* Returns the length of the line, or -1 if nothing is to be written to the file descriptor.
 */
-LmStatus lmOut
+static int lmLineBuild
 (
+  int          index,
+  char*        line,
+  char*        format,
   char*        text,
   char         type,
   const char*  file,
   int          lineNo,
   const char*  fName,
   int          tLev,
-  const char*  stre,
-  bool         use_hook
+  const char*  stre
 )
 {
-  INIT_CHECK();
-  POINTER_CHECK(text);
+  if ((fds[index].type == Stdout) && (fds[index].onlyErrorAndVerbose == true))
+  {
+    if ((type == 'T') ||
+        (type == 'D') ||
+        (type == 'H') ||
+        (type == 'M') ||
+        (type == 't')
+      )
+    {
+      return -1;
+    }
+  }
 
-  int   i;
-  char* line = (char*) calloc(1, LINE_MAX);
-  int   sz;
-  char* format = (char*) calloc(1, FORMAT_LEN + 1);
-  char* tmP;
+  if (type == 'R')
+  {
+    if (text[1] != ':')
+    {
+      snprintf(line, LINE_MAX, "R: %s\n%c", text, 0);
+    }
+    else
+    {
+      snprintf(line, LINE_MAX, "%s\n%c", text, 0);
+    }
+  }
+  else
+  {
+    /* Danger: 'format' might be too short ... */
+    if (lmLineFix(index, format, FORMAT_LEN, type, file, lineNo, fName, tLev) == NULL)
+    {
+      return -1;
+    }
 
-  if ((line == NULL) || (format == NULL))
+    if ((strlen(format) + strlen(text) + strlen(line)) > LINE_MAX)
+    {
+      snprintf(line, LINE_MAX, "%s[%d]: %s\n%c", file, lineNo, "LM ERROR: LINE TOO LONG", 0);
+    }
+    else
+    {
+      snprintf(line, LINE_MAX, format, text);
+    }
+  }
+
+  if (stre != NULL)
   {
-    if (line   != NULL)   free(line);
-    if (format != NULL)   free(format);
+    strncat(line, stre, LINE_MAX - 1);
+  }
 
-    return LmsNull;
+  return strlen(line);
+}
+
+
+
+/* ****************************************************************************
+*
+* asyncBufferRelease - the thread owning the buffer is finishing
+*/
+static void asyncBufferRelease(void* vP)
+{
+  AsyncBuffer* abP = (AsyncBuffer*) vP;
+
+  __sync_synchronize();
+  abP->state = AbOrphan;
+}
+
+
+
+/* ****************************************************************************
+*
+* asyncBufferGet - the buffer of the calling thread
+*
+* The buffers of finished threads are reused, once the writer has emptied them.
+* New buffers are pushed at the head of the list, which is the only change to the list,
+* so the writer can walk it without lock.
+*/
+static AsyncBuffer* asyncBufferGet(void)
+{
+  if (asyncBufferP != NULL)
+  {
+    return asyncBufferP;
   }
 
-  tmP = strrchr((char*) file, '/');
-  if (tmP != NULL)
+  AsyncBuffer* abP;
+
+  for (abP = asyncBufferList; abP != NULL; abP = abP->next)
   {
-    file = &tmP[1];
+    if ((abP->state == AbFree) && __sync_bool_compare_and_swap(&abP->state, AbFree, AbUsed))
+    {
+      break;
+    }
   }
 
-  if (inSigHandler && (type != 'X' || type != 'x'))
+  if (abP == NULL)
   {
-    lmAddMsgBuf(text, type, file, lineNo, fName, tLev, (char*) stre);
-    free(line);
-    free(format);
+    abP = (AsyncBuffer*) calloc(1, sizeof(AsyncBuffer));
+    if (abP == NULL)
+    {
+      return NULL;
+    }
 
-    return LmsOk;
+    abP->line   = (char*) calloc(1, LINE_MAX);
+    abP->format = (char*) calloc(1, FORMAT_LEN + 1);
+    if ((abP->line == NULL) || (abP->format == NULL))
+    {
+      free(abP->line);
+      free(abP->format);
+      free(abP);
+      return NULL;
+    }
+
+    abP->state = AbUsed;
+    do
+    {
+      abP->next = asyncBufferList;
+    } while (!__sync_bool_compare_and_swap(&asyncBufferList, abP->next, abP));
   }
 
-  memset(format, 0, FORMAT_LEN + 1);
+  pthread_setspecific(asyncBufferKey, abP);
+  asyncBufferP = abP;
 
-  semTake();
+  return abP;
+}
 
-  if ((type != 'H') && lmOutHook && lmOutHookActive == true)
+
+
+/* ****************************************************************************
+*
+* asyncLinePut - copy a line into the ring of 'index' of the buffer
+*
+* If the line doesn't fit, it is dropped. The calling thread never waits for the writer.
+*/
+static void asyncLinePut(AsyncBuffer* abP, int index, const char* line, unsigned int len)
+{
+  if (abP->ring[index] == NULL)
   {
-    time_t secondsNow = time(NULL);
-    if (use_hook)
+    abP->ring[index] = (char*) malloc(asyncRingSize);
+    if (abP->ring[index] == NULL)
     {
-      lmOutHook(lmOutHookParam, text, type, secondsNow, 0, 0, file, lineNo, fName, tLev, stre);
+      __sync_fetch_and_add(&asyncDropped, 1);
+      return;
     }
   }
 
-  for (i = 0; i < FDS_MAX; i++)
+  unsigned int head = abP->head[index];
+  unsigned int tail = abP->tail[index];
+
+  if (len > asyncRingSize - (head - tail))
+  {
+    __sync_fetch_and_add(&asyncDropped, 1);
+    return;
+  }
+
+  unsigned int start = head & asyncRingMask;
+  unsigned int first = asyncRingSize - start;
+
+  if (first >= len)
+  {
+    memcpy(&abP->ring[index][start], line, len);
+  }
+  else
+  {
+    memcpy(&abP->ring[index][start], line, first);
+    memcpy(abP->ring[index], &line[first], len - first);
+  }
+
+  __sync_synchronize();  // the bytes must be in the ring before the writer sees the new head
+  abP->head[index] = head + len;
+}
+
+
+
+/* ****************************************************************************
+*
+* asyncOut - lmOut for asynchronous logging
+*/
+static LmStatus asyncOut
+(
+  AsyncBuffer* abP,
+  char*        text,
+  char         type,
+  const char*  file,
+  int          lineNo,
+  const char*  fName,
+  int          tLev,
+  const char*  stre
+)
+{
+  for (int i = 0; i < FDS_MAX; i++)
   {
     if (fds[i].state != Occupied)
     {
       continue;
     }
 
-    if ((fds[i].type == Stdout) && (fds[i].onlyErrorAndVerbose == true))
+    int sz = lmLineBuild(i, abP->line, abP->format, text, type, file, lineNo, fName, tLev, stre);
+
+    if (sz > 0)
+    {
+      asyncLinePut(abP, i, abP->line, sz);
+    }
+  }
+
+  __sync_fetch_and_add(&logLines, 1);
+
+  if (type == 'W')
+  {
+    if (warningFunction != NULL)
     {
-      if ((type == 'T') ||
-          (type == 'D') ||
-          (type == 'H') ||
-          (type == 'M') ||
-          (type == 't')
-        )
+      warningFunction(warningInput, text, (char*) stre);
+    }
+  }
+  else if ((type == 'E') || (type == 'P'))
+  {
+    if (errorFunction != NULL)
+    {
+      errorFunction(errorInput, text, (char*) stre);
+    }
+  }
+
+  // Log files are not cleared (see lmClear) in asynchronous mode, the writer thread may be writing them
+
+  return LmsOk;
+}
+
+
+
+/* ****************************************************************************
+*
+* asyncWrite - write all the lines of the rings of the file descriptor 'index'
+*
+* Returns the number of bytes taken from the rings.
+*/
+static unsigned int asyncWrite(int index)
+{
+  struct iovec  iov[ASYNC_IOV_MAX];
+  AsyncBuffer*  abV[ASYNC_IOV_MAX];
+  unsigned int  headV[ASYNC_IOV_MAX];
+  int           iovs    = 0;
+  int           buffers = 0;
+  unsigned int  total   = 0;
+  AsyncBuffer*  abP     = asyncBufferList;
+
+  while (true)
+  {
+    //
+    // Collect the pending bytes of buffers until the iovec is full (each ring may need two
+    // entries, if its bytes wrap around the end of the ring) or there are no more buffers
+    //
+    while ((abP != NULL) && (iovs + 2 <= ASYNC_IOV_MAX))
+    {
+      unsigned int head = abP->head[index];
+      unsigned int tail = abP->tail[index];
+
+      __sync_synchronize();  // read the bytes of the ring after its head
+
+      if (head != tail)
       {
-        continue;
+        unsigned int start = tail & asyncRingMask;
+        unsigned int len   = head - tail;
+        unsigned int first = asyncRingSize - start;
+
+        if (first > len)
+        {
+          first = len;
+        }
+
+        iov[iovs].iov_base = &abP->ring[index][start];
+        iov[iovs].iov_len  = first;
+        ++iovs;
+
+        if (first < len)
+        {
+          iov[iovs].iov_base = abP->ring[index];
+          iov[iovs].iov_len  = len - first;
+          ++iovs;
+        }
+
+        abV[buffers]   = abP;
+        headV[buffers] = head;
+        ++buffers;
+        total += len;
       }
+
+      abP = abP->next;
+    }
+
+    if (buffers == 0)
+    {
+      return total;
     }
 
-    if (type == 'R')
+    if (fds[index].state == Occupied)
     {
-      if (text[1] != ':')
+      ssize_t nb;
+      ssize_t sz = 0;
+
+      for (int ix = 0; ix < iovs; ++ix)
       {
-        snprintf(line, LINE_MAX, "R: %s\n%c", text, 0);
+        sz += iov[ix].iov_len;
       }
-      else
+
+      lseek(fds[index].fd, 0, SEEK_END);
+      nb = writev(fds[index].fd, iov, iovs);
+
+      if (nb == -1)
+      {
+        printf("LOG error: writev(%d): %s\n", fds[index].fd, strerror(errno));
+      }
+      else if (nb != sz)
       {
-        snprintf(line, LINE_MAX, "%s\n%c", text, 0);
+        printf("LOG error: written %d bytes only (wanted %d)\n", (int) nb, (int) sz);
       }
     }
-    else
+
+    //
+    // The bytes are taken from the rings, even if they couldn't be written,
+    // so that the threads can go on logging
+    //
+    __sync_synchronize();
+    for (int ix = 0; ix < buffers; ++ix)
+    {
+      abV[ix]->tail[index] = headV[ix];
+    }
+
+    iovs    = 0;
+    buffers = 0;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* asyncRecycle - buffers of finished threads, once empty, can be reused
+*/
+static void asyncRecycle(void)
+{
+  for (AsyncBuffer* abP = asyncBufferList; abP != NULL; abP = abP->next)
+  {
+    if (abP->state != AbOrphan)
+    {
+      continue;
+    }
+
+    bool empty = true;
+
+    for (int i = 0; i < FDS_MAX; i++)
     {
-      /* Danger: 'format' might be too short ... */
-      if (lmLineFix(i, format, FORMAT_LEN, type, file, lineNo, fName, tLev) == NULL)
+      if (abP->head[i] != abP->tail[i])
       {
-        continue;
+        empty = false;
       }
+    }
+
+    if (empty)
+    {
+      abP->state = AbFree;
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* asyncWriter - thread writing the lines of the async buffers to the log file descriptors
+*/
+static void* asyncWriter(void* vP)
+{
+  bool stopping = false;
+
+  while (true)
+  {
+    unsigned int bytes = 0;
+
+    for (int i = 0; i < FDS_MAX; i++)
+    {
+      bytes += asyncWrite(i);
+    }
+
+    asyncRecycle();
+
+    if (bytes != 0)
+    {
+      continue;
+    }
+
+    // Stopping (see lmAsyncStop): one more pass after asyncStopping is seen, for the lines put meanwhile
+    if (stopping)
+    {
+      break;
+    }
+
+    if (asyncStopping)
+    {
+      stopping = true;
+      __sync_synchronize();
+      continue;
+    }
+
+    usleep(ASYNC_SLEEP);
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncStart - start asynchronous logging
+*
+* From now on, log lines are written by a writer thread. Each thread keeps its lines in a
+* buffer of 'bufferSize' bytes (rounded up to a power of two) per log file descriptor;
+* lines that don't fit in the buffer are dropped (see lmAsyncDropped).
+*/
+LmStatus lmAsyncStart(unsigned int bufferSize)
+{
+  INIT_CHECK();
+
+  if (asyncOn == true)
+  {
+    return LmsOk;
+  }
+
+  asyncRingSize = 1024;
+  while ((asyncRingSize < bufferSize) && (asyncRingSize < 0x40000000))
+  {
+    asyncRingSize <<= 1;
+  }
+  asyncRingMask = asyncRingSize - 1;
 
-      if ((strlen(format) + strlen(text) + strlen(line)) > LINE_MAX)
+  // The key (and the buffers of the threads) are kept after lmAsyncStop, for a later lmAsyncStart
+  if (asyncKeyCreated == false)
+  {
+    if (pthread_key_create(&asyncBufferKey, asyncBufferRelease) != 0)
+    {
+      return LmsMalloc;
+    }
+
+    asyncKeyCreated = true;
+  }
+
+  asyncStopping = false;
+  if (pthread_create(&asyncWriterTid, NULL, asyncWriter, NULL) != 0)
+  {
+    return LmsMalloc;
+  }
+
+  __sync_synchronize();
+  asyncOn = true;
+
+  return LmsOk;
+}
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncFlush - wait (a bounded time) until the writer thread has written all log lines
+*/
+void lmAsyncFlush(void)
+{
+  if (asyncOn == false)
+  {
+    return;
+  }
+
+  for (int nap = 0; nap < ASYNC_FLUSH_MAX; ++nap)
+  {
+    bool empty = true;
+
+    for (AsyncBuffer* abP = asyncBufferList; abP != NULL; abP = abP->next)
+    {
+      for (int i = 0; i < FDS_MAX; i++)
       {
-        snprintf(line, LINE_MAX, "%s[%d]: %s\n%c", file, lineNo, "LM ERROR: LINE TOO LONG", 0);
+        if (abP->head[i] != abP->tail[i])
+        {
+          empty = false;
+        }
       }
-      else
+    }
+
+    if (empty)
+    {
+      return;
+    }
+
+    usleep(ASYNC_SLEEP);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncStop - stop asynchronous logging, after writing all log lines
+*
+* From now on, log lines are written synchronously again by the thread logging them.
+* The writer thread is stopped once it has emptied the buffers. Their rings are freed (they are
+* allocated again, with the size of the next lmAsyncStart) but the buffers are kept for the threads
+* owning them. Lines logged by other threads while lmAsyncStop runs may be lost, so it is meant to be
+* called when no other thread is logging, e.g. before exiting or at the end of a test.
+*/
+void lmAsyncStop(void)
+{
+  if (asyncOn == false)
+  {
+    return;
+  }
+
+  asyncOn = false;
+  __sync_synchronize();
+  asyncStopping = true;
+
+  pthread_join(asyncWriterTid, NULL);
+
+  for (AsyncBuffer* abP = asyncBufferList; abP != NULL; abP = abP->next)
+  {
+    for (int i = 0; i < FDS_MAX; i++)
+    {
+      free(abP->ring[i]);
+      abP->ring[i] = NULL;
+      abP->head[i] = 0;
+      abP->tail[i] = 0;
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncDropped - number of log lines dropped as the buffer of their thread was full
+*/
+long long lmAsyncDropped(void)
+{
+  return __sync_fetch_and_add(&asyncDropped, 0);
+}
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncBuffers - number of thread buffers of asynchronous logging (and how many of them are free)
+*/
+int lmAsyncBuffers(int* freeBuffersP)
+{
+  int buffers     = 0;
+  int freeBuffers = 0;
+
+  for (AsyncBuffer* abP = asyncBufferList; abP != NULL; abP = abP->next)
+  {
+    ++buffers;
+
+    if (abP->state == AbFree)
+    {
+      ++freeBuffers;
+    }
+  }
+
+  if (freeBuffersP != NULL)
+  {
+    *freeBuffersP = freeBuffers;
+  }
+
+  return buffers;
+}
+
+
+
+/* ****************************************************************************
+*
+* lmOut -
+*/
+LmStatus lmOut
+(
+  char*        text,
+  char         type,
+  const char*  file,
+  int          lineNo,
+  const char*  fName,
+  int          tLev,
+  const char*  stre,
+  bool         use_hook
+)
+{
+  INIT_CHECK();
+  POINTER_CHECK(text);
+
+  int   i;
+  char* line;
+  int   sz;
+  char* format;
+  char* tmP;
+
+  tmP = strrchr((char*) file, '/');
+  if (tmP != NULL)
+  {
+    file = &tmP[1];
+  }
+
+  if (inSigHandler && (type != 'X' || type != 'x'))
+  {
+    lmAddMsgBuf(text, type, file, lineNo, fName, tLev, (char*) stre);
+
+    return LmsOk;
+  }
+
+  //
+  // Asynchronous logging: the line is left in the buffer of the thread, without lock nor I/O.
+  // Exits and hooks/write functions go the synchronous way (exits after flushing the buffers)
+  //
+  if (asyncOn && (type != 'X') && (type != 'x') && !(lmOutHook && lmOutHookActive))
+  {
+    bool         writeFunctions = false;
+    AsyncBuffer* abP;
+
+    for (i = 0; i < FDS_MAX; i++)
+    {
+      if ((fds[i].state == Occupied) && (fds[i].write != NULL))
       {
-        snprintf(line, LINE_MAX, format, text);
+        writeFunctions = true;
       }
     }
 
-    if (stre != NULL)
+    if ((writeFunctions == false) && ((abP = asyncBufferGet()) != NULL))
     {
-      strncat(line, stre, LINE_MAX - 1);
+      return asyncOut(abP, text, type, file, lineNo, fName, tLev, stre);
     }
+  }
+  else if (asyncOn && ((type == 'X') || (type == 'x')))
+  {
+    lmAsyncFlush();
+  }
+
+  line   = (char*) calloc(1, LINE_MAX);
+  format = (char*) calloc(1, FORMAT_LEN + 1);
+
+  if ((line == NULL) || (format == NULL))
+  {
+    if (line   != NULL)   free(line);
+    if (format != NULL)   free(format);
 
-    sz = strlen(line);
+    return LmsNull;
+  }
+
+  memset(format, 0, FORMAT_LEN + 1);
+
+  semTake();
+
+  if ((type != 'H') && lmOutHook && lmOutHookActive == true)
+  {
+    time_t secondsNow = time(NULL);
+    if (use_hook)
+    {
+      lmOutHook(lmOutHookParam, text, type, secondsNow, 0, 0, file, lineNo, fName, tLev, stre);
+    }
+  }
+
+  for (i = 0; i < FDS_MAX; i++)
+  {
+    if (fds[i].state != Occupied)
+    {
+      continue;
+    }
+
+    if ((sz = lmLineBuild(i, line, format, text, type, file, lineNo, fName, tLev, stre)) == -1)
+    {
+      continue;
+    }
 
     if (fds[i].write != NULL)
     {
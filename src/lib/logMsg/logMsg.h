@@ -1776,6 +1776,46 @@ extern int lmLogLinesGet(void);
 
 
 
+/* ****************************************************************************
+*
+* lmAsyncStart -
+*/
+extern LmStatus lmAsyncStart(unsigned int bufferSize);
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncFlush -
+*/
+extern void lmAsyncFlush(void);
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncStop -
+*/
+extern void lmAsyncStop(void);
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncDropped -
+*/
+extern long long lmAsyncDropped(void);
+
+
+
+/* ****************************************************************************
+*
+* lmAsyncBuffers -
+*/
+extern int lmAsyncBuffers(int* freeBuffersP);
+
+
+
 /* ****************************************************************************
 *
 * lmTransactionReset -
@@ -1805,6 +1845,20 @@ inline void lmTransactionStart(const char* keyword, const char* ip, int port, co
 
 
 
+/* ****************************************************************************
+*
+* lmTransactionResume - go on with a transaction that was started by this thread, then left (lmTransactionReset)
+*/
+inline void lmTransactionResume(const char* _transactionId)
+{
+  snprintf(transactionId, sizeof(transactionId), "%s", _transactionId);
+  snprintf(service,       sizeof(service),       "pending");
+  snprintf(subService,    sizeof(subService),    "pending");
+  snprintf(fromIp,        sizeof(fromIp),        "pending");
+}
+
+
+
 /* ****************************************************************************
 *
 * lmTransactionSetService -
@@ -87,6 +87,7 @@ typedef enum TraceLevels
 
   /* MongoBackend (100-119) */
   LmtMongo = 100,
+  LmtMongoExplain,
 
   /* Cleanup (120-139) */
   LmtDestructor = 120,
@@ -122,6 +123,8 @@ typedef enum TraceLevels
   LmtSubCache = 210,
   LmtSubCacheMatch,
   LmtCacheSync,
+  LmtEntityCache,
+  LmtTypeCatalog,
 
   /* Others (>=230) */
   LmtCm = 230,
@@ -0,0 +1,450 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <math.h>
+#include <string>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/globals.h"
+#include "common/string.h"
+#include "mongoBackend/GeoFilter.h"
+
+
+
+/* ****************************************************************************
+*
+* DEGREES_PER_RADIAN - 
+*/
+#define DEGREES_PER_RADIAN   (180.0 / M_PI)
+
+
+
+/* ****************************************************************************
+*
+* distanceMeters - great-circle distance between two points (haversine formula)
+*/
+static double distanceMeters(const orion::Point& p1, const orion::Point& p2)
+{
+  double lat1 = p1.latitude()  / DEGREES_PER_RADIAN;
+  double lat2 = p2.latitude()  / DEGREES_PER_RADIAN;
+  double dLat = lat2 - lat1;
+  double dLon = (p2.longitude() - p1.longitude()) / DEGREES_PER_RADIAN;
+  double a    = sin(dLat / 2) * sin(dLat / 2) + cos(lat1) * cos(lat2) * sin(dLon / 2) * sin(dLon / 2);
+
+  if (a > 1)
+  {
+    a = 1;
+  }
+
+  return 2 * EARTH_RADIUS_METERS * asin(sqrt(a));
+}
+
+
+
+/* ****************************************************************************
+*
+* onSegment - is 'p' on the segment from 'a' to 'b'?
+*/
+static bool onSegment(const orion::Point& p, const orion::Point& a, const orion::Point& b)
+{
+  double cross = (b.longitude() - a.longitude()) * (p.latitude() - a.latitude()) -
+                 (b.latitude()  - a.latitude())  * (p.longitude() - a.longitude());
+
+  if (fabs(cross) > 1e-12)
+  {
+    return false;
+  }
+
+  return (p.latitude()  >= fmin(a.latitude(),  b.latitude()))  && (p.latitude()  <= fmax(a.latitude(),  b.latitude())) &&
+         (p.longitude() >= fmin(a.longitude(), b.longitude())) && (p.longitude() <= fmax(a.longitude(), b.longitude()));
+}
+
+
+
+/* ****************************************************************************
+*
+* insidePolygon - is 'p' inside the polygon or on its border?
+*
+* Ray casting: a point is inside if a ray from it crosses the border an odd number of times.
+* The border is checked apart, as ray casting is not stable for points on it.
+*/
+static bool insidePolygon(const orion::Point& p, const std::vector<orion::Point*>& vertexList)
+{
+  unsigned int  vertices = vertexList.size();
+  bool          inside   = false;
+
+  for (unsigned int ix = 0, jx = vertices - 1; ix < vertices; jx = ix++)
+  {
+    const orion::Point& a = *vertexList[ix];
+    const orion::Point& b = *vertexList[jx];
+
+    if (onSegment(p, a, b))
+    {
+      return true;
+    }
+
+    if ((a.latitude() > p.latitude()) != (b.latitude() > p.latitude()))
+    {
+      double lon = a.longitude() + (p.latitude() - a.latitude()) * (b.longitude() - a.longitude()) / (b.latitude() - a.latitude());
+
+      if (p.longitude() < lon)
+      {
+        inside = !inside;
+      }
+    }
+  }
+
+  return inside;
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoFilter::GeoFilter -
+*/
+GeoFilter::GeoFilter(): valid(false), bounded(false), minLat(0), maxLat(0), minLon(0), maxLon(0)
+{
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoFilter::~GeoFilter -
+*/
+GeoFilter::~GeoFilter()
+{
+  scope.release();
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoFilter::parse -
+*/
+bool GeoFilter::parse(const std::string& _geometry, const std::string& _coords, const std::string& _georel)
+{
+  std::string errorString;
+
+  geometry = _geometry;
+  coords   = _coords;
+  georel   = _georel;
+  valid    = false;
+  bounded  = false;
+
+  if (georel == "")
+  {
+    LM_T(LmtSubCache, ("no georel for geometry '%s'", geometry.c_str()));
+    return false;
+  }
+
+  if (scope.fill("v2", geometry, coords, georel, &errorString) != 0)
+  {
+    LM_T(LmtSubCache, ("invalid geo expression: %s", errorString.c_str()));
+    return false;
+  }
+
+  valid = true;
+  boundsSet();
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoFilter::boundsSet - the box outside which the filter never matches
+*/
+void GeoFilter::boundsSet(void)
+{
+  const orion::Georel& rel = scope.georel;
+
+  bounded = false;
+
+  if (rel.type == "disjoint")
+  {
+    return;
+  }
+
+  if (rel.type == "near")
+  {
+    if (rel.maxDistance < 0)
+    {
+      return;
+    }
+
+    //
+    // The circle of radius maxDistance around the point. Longitudes are not bounded if the
+    // circle reaches a pole or the antimeridian.
+    //
+    double dLat = rel.maxDistance / EARTH_RADIUS_METERS * DEGREES_PER_RADIAN;
+    double lat  = scope.point.latitude();
+    double lon  = scope.point.longitude();
+
+    minLat = lat - dLat;
+    maxLat = lat + dLat;
+    minLon = -180;
+    maxLon = 180;
+
+    if ((minLat > -90) && (maxLat < 90))
+    {
+      double dLon = dLat / cos(lat / DEGREES_PER_RADIAN);
+
+      if ((lon - dLon > -180) && (lon + dLon < 180))
+      {
+        minLon = lon - dLon;
+        maxLon = lon + dLon;
+      }
+    }
+
+    bounded = true;
+    return;
+  }
+
+  std::vector<orion::Point*>  pointV;
+  orion::Point                ll(scope.box.lowerLeft.latitude(),  scope.box.lowerLeft.longitude());
+  orion::Point                ur(scope.box.upperRight.latitude(), scope.box.upperRight.longitude());
+
+  if (scope.areaType == orion::PolygonType)
+  {
+    pointV = scope.polygon.vertexList;
+  }
+  else if (scope.areaType == orion::LineType)
+  {
+    pointV = scope.line.pointList;
+  }
+  else if (scope.areaType == orion::PointType)
+  {
+    pointV.push_back(&scope.point);
+  }
+  else if (scope.areaType == orion::BoxType)
+  {
+    pointV.push_back(&ll);
+    pointV.push_back(&ur);
+  }
+
+  if (pointV.size() == 0)
+  {
+    return;
+  }
+
+  minLat = maxLat = pointV[0]->latitude();
+  minLon = maxLon = pointV[0]->longitude();
+
+  for (unsigned int ix = 1; ix < pointV.size(); ++ix)
+  {
+    minLat = fmin(minLat, pointV[ix]->latitude());
+    maxLat = fmax(maxLat, pointV[ix]->latitude());
+    minLon = fmin(minLon, pointV[ix]->longitude());
+    maxLon = fmax(maxLon, pointV[ix]->longitude());
+  }
+
+  bounded = true;
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoFilter::inBounds - may the filter match 'location'?
+*/
+bool GeoFilter::inBounds(const orion::Point& location) const
+{
+  if (!valid)
+  {
+    return false;
+  }
+
+  if (!bounded)
+  {
+    return true;
+  }
+
+  return (location.latitude()  >= minLat) && (location.latitude()  <= maxLat) &&
+         (location.longitude() >= minLon) && (location.longitude() <= maxLon);
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoFilter::intersects - is 'location' in the area?
+*/
+bool GeoFilter::intersects(const orion::Point& location) const
+{
+  switch (scope.areaType)
+  {
+  case orion::PointType:
+    return (location.latitude() == scope.point.latitude()) && (location.longitude() == scope.point.longitude());
+
+  case orion::BoxType:
+    return (location.latitude()  >= scope.box.lowerLeft.latitude())  && (location.latitude()  <= scope.box.upperRight.latitude()) &&
+           (location.longitude() >= scope.box.lowerLeft.longitude()) && (location.longitude() <= scope.box.upperRight.longitude());
+
+  case orion::PolygonType:
+    return insidePolygon(location, scope.polygon.vertexList);
+
+  case orion::LineType:
+    for (unsigned int ix = 1; ix < scope.line.pointList.size(); ++ix)
+    {
+      if (onSegment(location, *scope.line.pointList[ix - 1], *scope.line.pointList[ix]))
+      {
+        return true;
+      }
+    }
+    return false;
+
+  default:
+    return false;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoFilter::match -
+*/
+bool GeoFilter::match(const orion::Point& location) const
+{
+  if (!inBounds(location))
+  {
+    return false;
+  }
+
+  const orion::Georel& rel = scope.georel;
+
+  if (rel.type == "near")
+  {
+    double distance = distanceMeters(location, scope.point);
+
+    if ((rel.maxDistance >= 0) && (distance > rel.maxDistance))
+    {
+      return false;
+    }
+
+    if ((rel.minDistance >= 0) && (distance < rel.minDistance))
+    {
+      return false;
+    }
+
+    return true;
+  }
+  else if ((rel.type == "intersects") || (rel.type == "coveredBy"))
+  {
+    return intersects(location);
+  }
+  else if (rel.type == "disjoint")
+  {
+    return !intersects(location);
+  }
+  else if (rel.type == "equals")
+  {
+    // A point location can only be equal to a point
+    return (scope.areaType == orion::PointType) && intersects(location);
+  }
+
+  return false;
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoFilter::match -
+*/
+bool GeoFilter::match(ContextElementResponse* cerP) const
+{
+  orion::Point location;
+
+  if (!geoFilterLocation(cerP->contextElement.contextAttributeVector, &location))
+  {
+    return false;
+  }
+
+  return match(location);
+}
+
+
+
+/* ****************************************************************************
+*
+* geoFilterCompile -
+*/
+GeoFilterP geoFilterCompile(const std::string& geometry, const std::string& coords, const std::string& georel)
+{
+  if (geometry == "")
+  {
+    return GeoFilterP();
+  }
+
+  GeoFilterP gfP(new GeoFilter());
+
+  if (gfP->parse(geometry, coords, georel) == false)
+  {
+    LM_T(LmtSubCache, ("invalid geo expression '%s'/'%s'/'%s', the filter will not match any entity",
+                       geometry.c_str(), coords.c_str(), georel.c_str()));
+  }
+
+  return gfP;
+}
+
+
+
+/* ****************************************************************************
+*
+* geoFilterLocation -
+*/
+bool geoFilterLocation(const ContextAttributeVector& caV, orion::Point* locationP)
+{
+  for (unsigned int ix = 0; ix < caV.size(); ++ix)
+  {
+    const ContextAttribute* caP = caV[ix];
+
+    if ((caP->getLocation("v1") == "") && (caP->type != GEO_POINT))
+    {
+      continue;
+    }
+
+    double lat;
+    double lon;
+
+    if (!string2coords(caP->stringValue, lat, lon))
+    {
+      return false;
+    }
+
+    locationP->latitudeSet(lat);
+    locationP->longitudeSet(lon);
+
+    return true;
+  }
+
+  return false;
+}
@@ -0,0 +1,112 @@
+#ifndef SRC_LIB_MONGOBACKEND_GEOFILTER_H_
+#define SRC_LIB_MONGOBACKEND_GEOFILTER_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+#include "orionTypes/areas.h"
+#include "ngsi/Scope.h"
+#include "ngsi/ContextElementResponse.h"
+
+
+
+/* ****************************************************************************
+*
+* GeoFilter - the geo part of a subscription expression (geometry, coords and georel), parsed
+*
+* The area is parsed (using Scope::fill) once and then evaluated in memory on the location
+* of the updated entities, any number of times.
+*
+* Only point locations are evaluated (the only kind of location the broker stores) and the
+* coordinates are taken as planar, except for the distances of 'near', which are computed
+* on the sphere, in meters.
+*
+* An entity without location never matches a geo filter, and neither does any entity if
+* the filter is not valid.
+*
+* If 'bounded' is true, the filter can only match locations inside the box given by
+* minLat/maxLat/minLon/maxLon (the bounding box of the area, or of the 'near' circle).
+* Filters that may match locations far away from its area (disjoint, near with only
+* minDistance) are not bounded.
+*/
+class GeoFilter
+{
+ public:
+  std::string  geometry;
+  std::string  coords;
+  std::string  georel;
+  Scope        scope;
+  bool         valid;
+
+  bool         bounded;
+  double       minLat;
+  double       maxLat;
+  double       minLon;
+  double       maxLon;
+
+  GeoFilter();
+  ~GeoFilter();
+
+  bool  parse(const std::string& _geometry, const std::string& _coords, const std::string& _georel);
+  bool  match(const orion::Point& location) const;
+  bool  match(ContextElementResponse* cerP) const;
+  bool  inBounds(const orion::Point& location) const;
+
+ private:
+  GeoFilter(const GeoFilter&);
+  GeoFilter& operator=(const GeoFilter&);
+
+  bool  intersects(const orion::Point& location) const;
+  void  boundsSet(void);
+};
+
+typedef boost::shared_ptr<GeoFilter> GeoFilterP;
+
+
+
+/* ****************************************************************************
+*
+* geoFilterCompile - parse the geo part of an expression, for it to be matched in memory
+*
+* Returns an empty pointer if 'geometry' is empty (no geo filter at all). If the expression
+* is not valid, the returned filter doesn't match any entity.
+*/
+extern GeoFilterP geoFilterCompile(const std::string& geometry, const std::string& coords, const std::string& georel);
+
+
+
+/* ****************************************************************************
+*
+* geoFilterLocation - the location of an entity, given its attributes
+*
+* The location attribute is either marked with the 'location' metadata (NGSIv1) or has
+* type geo:point (NGSIv2). Returns false if the entity has no (point) location.
+*/
+extern bool geoFilterLocation(const ContextAttributeVector& caV, orion::Point* locationP);
+
+#endif  // SRC_LIB_MONGOBACKEND_GEOFILTER_H_
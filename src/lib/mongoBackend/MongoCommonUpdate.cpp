@@ -23,6 +23,7 @@
 * Author: Fermín Galán
 *
 */
+#include <algorithm>
 #include <utility>
 #include <map>
 #include <string>
@@ -51,7 +52,12 @@
 #include "mongoBackend/MongoGlobal.h"
 #include "mongoBackend/connectionOperations.h"
 #include "mongoBackend/TriggeredSubscription.h"
+#include "mongoBackend/GeoFilter.h"
 #include "cache/subCache.h"
+#include "cache/entityCache.h"
+#include "cache/typeCatalog.h"
+#include "ngsiNotify/notifCoalesce.h"
+#include "ngsiNotify/notifPayloadCache.h"
 
 #include "ngsi/Scope.h"
 #include "rest/uriParamNames.h"
@@ -1256,21 +1262,22 @@ static bool addTriggeredSubscriptions_withCache
   std::map<string, TriggeredSubscription*>& subs,
   std::string&                              err,
   std::string                               tenant,
-  const std::vector<std::string>&           servicePathV
+  const std::vector<std::string>&           servicePathV,
+  const orion::Point*                       locationP
 )
 {  
   std::string   servicePath     = (servicePathV.size() > 0)? servicePathV[0] : "";
-  std::vector<CachedSubscription*>  subVec;
+  std::vector<CachedSubscriptionP>  subVec;
 
-  cacheSemTake(__FUNCTION__, "match subs for notifications");
-  subCacheMatch(tenant.c_str(), servicePath.c_str(), entityId.c_str(), entityType.c_str(), modifiedAttrs, &subVec);
+  // No cache semaphore needed, subCacheMatch works on a snapshot of the cache
+  subCacheMatch(tenant.c_str(), servicePath.c_str(), entityId.c_str(), entityType.c_str(), modifiedAttrs, &subVec, locationP);
 
   LM_T(LmtSubCache, ("%d subscriptions in cache match the update", subVec.size()));
 
   int now = getCurrentTime();
   for (unsigned int ix = 0; ix < subVec.size(); ++ix)
   {
-    CachedSubscription* cSubP = subVec[ix];
+    CachedSubscription* cSubP = subVec[ix].get();
 
     // Outdated subscriptions are skipped
     if (cSubP->expirationTime < now)
@@ -1327,13 +1334,16 @@ static bool addTriggeredSubscriptions_withCache
                                                            cSubP->subscriptionId,
                                                            cSubP->tenant);
 
-    sub->fillExpression(cSubP->expression.q, cSubP->expression.geometry, cSubP->expression.coords, cSubP->expression.georel);
+    sub->fillExpression(cSubP->expression.q,
+                        cSubP->expression.georel,
+                        cSubP->expression.geometry,
+                        cSubP->expression.coords,
+                        cSubP->stringFilterP,
+                        cSubP->geoFilterP);
 
     subs.insert(std::pair<string, TriggeredSubscription*>(cSubP->subscriptionId, sub));
   }
 
-  cacheSemGive(__FUNCTION__, "match subs for notifications");
-
   return true;
 }
 
@@ -1522,6 +1532,10 @@ static bool addTriggeredSubscriptions_noCache
 *
 * addTriggeredSubscriptions - 
 *
+* 'locationP' is the location of the entity after the update, if known. It is used by the
+* subscription cache to discard subscriptions whose area is far from the entity (the geo
+* filter of the subscriptions is evaluated in any case by processSubscriptions).
+*
 */
 static bool addTriggeredSubscriptions
 (
@@ -1531,7 +1545,8 @@ static bool addTriggeredSubscriptions
   std::map<string, TriggeredSubscription*>& subs,
   std::string&                              err,
   std::string                               tenant,
-  const std::vector<std::string>&           servicePathV
+  const std::vector<std::string>&           servicePathV,
+  const orion::Point*                       locationP = NULL
 )
 {
   extern bool noCache;
@@ -1542,7 +1557,7 @@ static bool addTriggeredSubscriptions
   }
   else
   {
-    return addTriggeredSubscriptions_withCache(entityId, entityType, modifiedAttrs, subs, err, tenant, servicePathV);
+    return addTriggeredSubscriptions_withCache(entityId, entityType, modifiedAttrs, subs, err, tenant, servicePathV, locationP);
   }
 }
 
@@ -1553,6 +1568,9 @@ static bool addTriggeredSubscriptions
 * This method returns true if the notification was actually send. Otherwise, false
 * is returned. This is used in the caller to know if lastNotification field in the
 * subscription document in csubs collection has to be modified or not.
+*
+* A notification held back to be coalesced is not sent yet, so false is returned for it
+* (see coalescedSubscriptionsNotified).
 */
 static bool processOnChangeConditionForUpdateContext
 (
@@ -1610,6 +1628,12 @@ static bool processOnChangeConditionForUpdateContext
   // FIXME: we use a proper origin name
   ncr.originator.set("localhost");
 
+  /* Within a coalescing update request, the notification is sent (and the subscription updated) at the end of the request */
+  if (notifCoalesceAdd(getNotifier(), &ncr, notifyUrl, tenant, xauthToken, format))
+  {
+    return false;
+  }
+
   getNotifier()->sendNotifyContextRequest(&ncr, notifyUrl, tenant, xauthToken, format);
   return true;
 }
@@ -1629,17 +1653,77 @@ void processOntimeIntervalCondition(const std::string& subId, int interval, cons
 
 /* ****************************************************************************
 *
-* matchExpression
+* subscriptionNotified - save lastNotification and count of a subscription that was notified
+*
+* 'cacheSubId' is the id of the subscription in the subscription cache, "" if it doesn't come
+* from the cache.
 */
-static bool matchExpression(ContextElementResponse* cerP, const std::string& q)
+static bool subscriptionNotified
+(
+  const std::string&  subId,
+  const std::string&  tenant,
+  const std::string&  cacheSubId,
+  const std::string&  cacheTenant,
+  std::string*        err
+)
 {
-  if (q == "")
+  long long  rightNow = getCurrentTime();
+  bool       ret      = true;
+
+  //
+  // If broker running without subscription cache, put lastNotificationTime and count in DB 
+  //
+  if (subCacheActive == false)
   {
-    return true;
+    BSONObj query  = BSON("_id" << OID(subId));
+    BSONObj update = BSON("$set" <<
+                          BSON(CSUB_LASTNOTIFICATION << rightNow) <<
+                          "$inc" << BSON(CSUB_COUNT << 1));
+
+    ret = collectionUpdate(getSubscribeContextCollectionName(tenant), query, update, false, err);
+  }
+
+
+  //
+  // Saving lastNotificationTime and count for cached subscription
+  //
+  if (cacheSubId != "")
+  {
+    CachedSubscriptionP  cSubP = subCacheItemLookup(cacheTenant.c_str(), cacheSubId.c_str());
+
+    if (cSubP.get() != NULL)
+    {
+      subCacheItemNotified(cSubP.get(), rightNow);
+
+      LM_T(LmtSubCache, ("set lastNotificationTime to %lu and count to %lu for '%s'", cSubP->lastNotificationTime, cSubP->count, cSubP->subscriptionId));
+    }
+    else
+    {
+      LM_E(("Runtime Error (cached subscription '%s' for tenant '%s' not found)", cacheSubId.c_str(), cacheTenant.c_str()));
+    }
   }
 
-  std::vector<BSONObj> filters;   // not really used, just to match qStringFilters signature
-  return qStringFilters(q, filters, cerP);
+  return ret;
+}
+
+
+
+/* ****************************************************************************
+*
+* coalescedSubscriptionsNotified - 
+*/
+void coalescedSubscriptionsNotified(const std::vector<std::string>& subIdV, const std::string& tenant)
+{
+  for (unsigned int ix = 0; ix < subIdV.size(); ++ix)
+  {
+    std::string err;
+
+    // With the subscription cache active, the triggered subscriptions come from it
+    if (!subscriptionNotified(subIdV[ix], tenant, subCacheActive? subIdV[ix] : "", tenant, &err))
+    {
+      LM_E(("Runtime Error (subscription '%s' not updated after its notification: %s)", subIdV[ix].c_str(), err.c_str()));
+    }
+  }
 }
 
 
@@ -1661,6 +1745,9 @@ static bool processSubscriptions
 
   *err = "";
 
+  /* All the notifications are built from notifyCerP, so those with the same format and attributes share the payload */
+  notifPayloadCacheBegin();
+
   for (std::map<string, TriggeredSubscription*>::iterator it = subs.begin(); it != subs.end(); ++it)
   {
     std::string             mapSubId  = it->first;
@@ -1688,14 +1775,22 @@ static bool processSubscriptions
       }
     }
 
-    /* Check 2: expression (q) */
-    if (!matchExpression(notifyCerP, trigs->expression.q))
+    /* Check 2: expression (q), already parsed */
+    StringFilter* sfP = trigs->expression.stringFilterP.get();
+
+    if ((sfP != NULL) && (sfP->match(notifyCerP) == false))
     {
       continue;
     }
 
-    /* Check 3: expression (georel, which also uses geometry and coords) */
-    // TBD (issue #1678)
+    /* Check 3: expression (georel, which also uses geometry and coords), already parsed */
+    GeoFilter* gfP = trigs->expression.geoFilterP.get();
+
+    if ((gfP != NULL) && (gfP->match(notifyCerP) == false))
+    {
+      LM_T(LmtSubCache, ("ignored '%s' due to georel", trigs->cacheSubId.c_str()));
+      continue;
+    }
 
     /* Send notification */
     LM_T(LmtSubCache, ("NOT ignored: %s", trigs->cacheSubId.c_str()));
@@ -1707,49 +1802,15 @@ static bool processSubscriptions
                                                  tenant,
                                                  xauthToken))
     {
-      long long rightNow = getCurrentTime();
-
-      //
-      // If broker running without subscription cache, put lastNotificationTime and count in DB 
-      //
-      if (subCacheActive == false)
-      {
-        BSONObj query  = BSON("_id" << OID(mapSubId));
-        BSONObj update = BSON("$set" <<
-                              BSON(CSUB_LASTNOTIFICATION << rightNow) <<
-                              "$inc" << BSON(CSUB_COUNT << 1));
-        
-        ret = collectionUpdate(getSubscribeContextCollectionName(tenant), query, update, false, err);
-      }
-
-
-      //
-      // Saving lastNotificationTime and count for cached subscription
-      //
-      if (trigs->cacheSubId != "")
+      if (!subscriptionNotified(mapSubId, tenant, trigs->cacheSubId, trigs->tenant, err))
       {
-        cacheSemTake(__FUNCTION__, "update lastNotificationTime for cached subscription");
-
-        CachedSubscription*  cSubP = subCacheItemLookup(trigs->tenant.c_str(), trigs->cacheSubId.c_str());
-
-        if (cSubP != NULL)
-        {
-          cSubP->lastNotificationTime = rightNow;
-          cSubP->count               += 1;
-
-          LM_T(LmtSubCache, ("set lastNotificationTime to %lu and count to %lu for '%s'", cSubP->lastNotificationTime, cSubP->count, cSubP->subscriptionId));
-        }
-        else
-        {
-          LM_E(("Runtime Error (cached subscription '%s' for tenant '%s' not found)",
-                trigs->cacheSubId.c_str(), trigs->tenant.c_str()));
-        }
-
-        cacheSemGive(__FUNCTION__, "update lastNotificationTime for cached subscription");
+        ret = false;
       }
     }
   }
 
+  notifPayloadCacheEnd();
+
   releaseTriggeredSubscriptions(subs);
 
   return ret;
@@ -2437,10 +2498,21 @@ static bool processContextAttributeVector
     }
   }
 
-  /* Add triggered ONCHANGE subscriptions */
-  std::string err;
+  /* Add triggered ONCHANGE subscriptions. The location used to pre-filter them is taken from notifyCerP
+   * (as GeoFilter::match does later), as coordLat/coordLong keep the old coordinates when a location
+   * attribute is updated */
+  std::string   err;
+  orion::Point  location;
+  bool          located = geoFilterLocation(notifyCerP->contextElement.contextAttributeVector, &location);
 
-  if (!addTriggeredSubscriptions(entityId, entityType, modifiedAttrs, subsToNotify, err, tenant, servicePathV))
+  if (!addTriggeredSubscriptions(entityId,
+                                 entityType,
+                                 modifiedAttrs,
+                                 subsToNotify,
+                                 err,
+                                 tenant,
+                                 servicePathV,
+                                 located? &location : NULL))
   {
     cerP->statusCode.fill(SccReceiverInternalError, err);
     return false;
@@ -2469,10 +2541,130 @@ static bool processContextAttributeVector
 }
 
 
+/* ****************************************************************************
+*
+* catalogAttrs - the attributes (name and type) of an entity document, for the type catalog
+*/
+static void catalogAttrs(const BSONObj& doc, TypeCatalogAttrs* attrsP)
+{
+  if (!doc.hasField(ENT_ATTRNAMES))
+  {
+    return;
+  }
+
+  BSONObj                   attrs = getObjectField(doc, ENT_ATTRS);
+  std::vector<BSONElement>  names = getField(doc, ENT_ATTRNAMES).Array();
+
+  for (unsigned int ix = 0; ix < names.size(); ++ix)
+  {
+    std::string name       = names[ix].String();
+    std::string effectName = dbDotEncode(name);
+
+    (*attrsP)[name] = attrs.hasField(effectName)? getStringField(getObjectField(attrs, effectName), ENT_ATTRS_TYPE) : "";
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* catalogChange - the type catalog change of an entity write (NULL documents for creation or removal)
+*/
+static TypeCatalogChange catalogChange(const BSONObj* oldDocP, const BSONObj* newDocP)
+{
+  TypeCatalogChange change;
+
+  if (!typeCatalogEnabled())
+  {
+    return change;
+  }
+
+  BSONObj id = getObjectField((oldDocP != NULL)? *oldDocP : *newDocP, "_id");
+
+  change.entityType  = id.hasField(ENT_ENTITY_TYPE)?  getStringField(id, ENT_ENTITY_TYPE)  : "";
+  change.servicePath = id.hasField(ENT_SERVICE_PATH)? getStringField(id, ENT_SERVICE_PATH) : "";
+
+  if (oldDocP != NULL)
+  {
+    change.existed = true;
+    catalogAttrs(*oldDocP, &change.oldAttrs);
+  }
+
+  if (newDocP != NULL)
+  {
+    change.exists = true;
+    catalogAttrs(*newDocP, &change.newAttrs);
+  }
+
+  return change;
+}
+
+
+
+/* ****************************************************************************
+*
+* catalogChangeUpdate - the type catalog change of an entity update, given the update operators
+*/
+static TypeCatalogChange catalogChangeUpdate
+(
+  const BSONObj&    r,
+  bool              replace,
+  const BSONObj&    toSetObj,
+  const BSONArray&  toPushArr,
+  const BSONArray&  toPullArr
+)
+{
+  TypeCatalogChange change = catalogChange(&r, NULL);
+
+  if (!change.existed)
+  {
+    return change;
+  }
+
+  change.exists = true;
+
+  if (!replace)
+  {
+    change.newAttrs = change.oldAttrs;
+  }
+
+  for (BSONObjIterator it(toPullArr); it.more();)
+  {
+    change.newAttrs.erase(it.next().String());
+  }
+
+  for (BSONObjIterator it(toPushArr); it.more();)
+  {
+    std::string name = it.next().String();
+
+    if (change.newAttrs.find(name) == change.newAttrs.end())
+    {
+      change.newAttrs[name] = "";
+    }
+  }
+
+  for (TypeCatalogAttrs::iterator it = change.newAttrs.begin(); it != change.newAttrs.end(); ++it)
+  {
+    std::string  field = replace? dbDotEncode(it->first) : std::string(ENT_ATTRS) + "." + dbDotEncode(it->first);
+    BSONElement  attr  = toSetObj.getField(field);
+
+    if ((attr.type() == Object) && attr.embeddedObject().hasField(ENT_ATTRS_TYPE))
+    {
+      it->second = getStringField(attr.embeddedObject(), ENT_ATTRS_TYPE);
+    }
+  }
+
+  return change;
+}
+
+
+
 /* ****************************************************************************
 *
 * createEntity -
 *
+* If deferredDocP is not NULL, the document is not inserted but returned in it, for
+* a later bulk insert (see updateBatchFlush)
 */
 static bool createEntity
 (
@@ -2482,7 +2674,8 @@ static bool createEntity
   std::string*                     errDetail,
   std::string                      tenant,
   const std::vector<std::string>&  servicePathV,
-  const std::string&               apiVersion
+  const std::string&               apiVersion,
+  BSONObj*                         deferredDocP = NULL
 )
 {
   LM_T(LmtMongo, ("Entity not found in '%s' collection, creating it", getEntitiesCollectionName(tenant).c_str()));
@@ -2490,7 +2683,10 @@ static bool createEntity
   /* Actually we don't know if this is the first entity (thus, the collection is being created) or not. However, we can
    * invoke ensureLocationIndex() in anycase, given that it is harmless in the case the collection and index already
    * exits (see docs.mongodb.org/manual/reference/method/db.collection.ensureIndex/)*/
-  ensureLocationIndex(tenant);
+  if (deferredDocP == NULL)
+  {
+    ensureLocationIndex(tenant);
+  }
 
   if (!legalIdUsage(attrsV))
   {
@@ -2600,11 +2796,23 @@ static bool createEntity
                                                 "coordinates" << BSON_ARRAY(coordLong << coordLat))));
   }
 
-  if (!collectionInsert(getEntitiesCollectionName(tenant), insertedDoc.obj(), errDetail))
+  BSONObj insertedObj = insertedDoc.obj();
+
+  if (deferredDocP != NULL)
+  {
+    *deferredDocP = insertedObj;
+    return true;
+  }
+
+  if (!collectionInsert(getEntitiesCollectionName(tenant), insertedObj, errDetail))
   {
     return false;
   }
 
+  // The entity could have been cached as "not found"
+  entityCacheInvalidate(tenant, eP->id);
+  typeCatalogApply(tenant, catalogChange(NULL, &insertedObj));
+
   return true;
 }
 
@@ -2654,6 +2862,8 @@ static bool removeEntity
     return false;
   }
 
+  entityCacheInvalidate(tenant, entityId);
+
   cerP->statusCode.fill(SccOk);
   return true;
 }
@@ -2755,6 +2965,112 @@ static bool forwardsPending(UpdateContextResponse* upcrsP)
   return false;
 }
 
+/* ****************************************************************************
+*
+* updateBatchAdd - add an entity write to the batch
+*
+* For inserts, 'query' is ignored
+*/
+static UpdateBatchItem* updateBatchAdd
+(
+  UpdateBatch*             batchP,
+  bool                     insert,
+  const BSONObj&           query,
+  const BSONObj&           doc,
+  const std::string&       entityId,
+  ContextElementResponse*  cerP,
+  HttpStatusCode           errorCode
+)
+{
+  UpdateBatchItem* itemP = new UpdateBatchItem();
+
+  itemP->entityId   = entityId;
+  itemP->cerP       = cerP;
+  itemP->errorCode  = errorCode;
+  itemP->notifyCerP = NULL;
+  itemP->written    = false;
+
+  batchP->items.push_back(itemP);
+
+  if (insert)
+  {
+    batchP->inserts.push_back(doc);
+    batchP->insertItems.push_back(itemP);
+  }
+  else
+  {
+    batchP->queries.push_back(query);
+    batchP->updates.push_back(doc);
+    batchP->updateItems.push_back(itemP);
+  }
+
+  return itemP;
+}
+
+
+
+/* ****************************************************************************
+*
+* updateBatchWritten - record the result of a bulk write in its items
+*/
+static void updateBatchWritten
+(
+  std::vector<UpdateBatchItem*>&  items,
+  unsigned int                    from,
+  const std::vector<bool>&        writtenV,
+  const std::string&              writeErr
+)
+{
+  for (unsigned int ix = 0; ix < writtenV.size(); ++ix)
+  {
+    UpdateBatchItem* itemP = items[from + ix];
+
+    itemP->written = writtenV[ix];
+    if (!itemP->written)
+    {
+      itemP->writeErr = writeErr;
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* updateBatchDone - send the notifications of a written item (or flag it if the write failed)
+*/
+static void updateBatchDone(UpdateBatchItem* itemP, const std::string& tenant, const std::string& xauthToken)
+{
+  entityCacheInvalidate(tenant, itemP->entityId);
+
+  if (!itemP->written)
+  {
+    itemP->cerP->statusCode.fill(itemP->errorCode, itemP->writeErr);
+  }
+  else
+  {
+    typeCatalogApply(tenant, itemP->catalogChange);
+
+    if (itemP->notifyCerP != NULL)
+    {
+      std::string err;
+
+      processSubscriptions(itemP->subsToNotify, itemP->notifyCerP, &err, tenant, xauthToken);
+    }
+  }
+
+  releaseTriggeredSubscriptions(itemP->subsToNotify);
+  if (itemP->notifyCerP != NULL)
+  {
+    itemP->notifyCerP->release();
+    delete itemP->notifyCerP;
+  }
+
+  delete itemP;
+}
+
+
+
 /* ****************************************************************************
 *
 * updateEntity -
@@ -2770,7 +3086,8 @@ static void updateEntity
   UpdateContextResponse*          responseP,
   bool*                           attributeAlreadyExistsError,
   std::string*                    attributeAlreadyExistsList,
-  const std::string&              apiVersion
+  const std::string&              apiVersion,
+  UpdateBatch*                    batchP
 )
 {
   // Used to accumulate error response information
@@ -2797,7 +3114,10 @@ static void updateEntity
   if (strcasecmp(action.c_str(), "delete") == 0 && ceP->contextAttributeVector.size() == 0)
   {
     LM_T(LmtServicePath, ("Removing entity"));
-    removeEntity(entityId, entityType, cerP, tenant, entitySPath);
+    if (removeEntity(entityId, entityType, cerP, tenant, entitySPath))
+    {
+      typeCatalogApply(tenant, catalogChange(&r, NULL));
+    }
     responseP->contextElementResponseVector.push_back(cerP);
     return;
   }
@@ -2950,8 +3270,9 @@ static void updateEntity
   BSONObj         toUnsetObj  = toUnset.obj();
   BSONArray       toPushArr   = toPush.arr();
   BSONArray       toPullArr   = toPull.arr();
+  bool            replace     = (strcasecmp(action.c_str(), "replace") == 0);
 
-  if (strcasecmp(action.c_str(), "replace") == 0)
+  if (replace)
   {
     // toSet: { A1: { ... }, A2: { ... } }
     int now = getCurrentTime();
@@ -3017,6 +3338,29 @@ static void updateEntity
   }
 
   std::string err;
+
+  //
+  // In a batch, the update and the notifications are done later, by updateBatchFlush()
+  //
+  if (batchP != NULL)
+  {
+    UpdateBatchItem* itemP = updateBatchAdd(batchP, false, query.obj(), updatedEntityObj, entityId, cerP, SccReceiverInternalError);
+
+    itemP->subsToNotify  = subsToNotify;
+    itemP->notifyCerP    = notifyCerP;
+    itemP->catalogChange = catalogChangeUpdate(r, replace, toSetObj, toPushArr, toPullArr);
+
+    searchContextProviders(tenant, servicePathV, *enP, ceP->contextAttributeVector, cerP);
+
+    if (cerP->statusCode.code == SccNone)
+    {
+      cerP->statusCode.fill(SccOk);
+    }
+    responseP->contextElementResponseVector.push_back(cerP);
+
+    return;
+  }
+
   if (!collectionUpdate(getEntitiesCollectionName(tenant), query.obj(), updatedEntityObj, false, &err))
   {
     cerP->statusCode.fill(SccReceiverInternalError, err);
@@ -3030,6 +3374,9 @@ static void updateEntity
     return;
   }
 
+  entityCacheInvalidate(tenant, entityId);
+  typeCatalogApply(tenant, catalogChangeUpdate(r, replace, toSetObj, toPushArr, toPullArr));
+
   /* Send notifications for each one of the ONCHANGE subscriptions accumulated by
    * previous addTriggeredSubscriptions() invocations */
   processSubscriptions(subsToNotify, notifyCerP, &err, tenant, xauthToken);
@@ -3059,40 +3406,280 @@ static void updateEntity
 
 /* ****************************************************************************
 *
-* contextElementPreconditionsCheck -
+* updateEntityFastAllowed -
+*
+* Checks if the request can be processed by updateEntityFast(), i.e. an NGSIv2 UPDATE of already
+* existing attributes, with neither metadata (so the metadata in DB is kept untouched and the attribute
+* effective name is the attribute name) nor location semantics (so the location field is not affected).
+* Null values are excluded as they cannot be told apart from missing values in the update condition.
 */
-static bool contextElementPreconditionsCheck
+static bool updateEntityFastAllowed
 (
-  ContextElement*         ceP,
-  UpdateContextResponse*  responseP,
-  const std::string&      action,
-  const std::string&      apiVersion
+  ContextElement*     ceP,
+  const std::string&  action,
+  const std::string&  apiVersion,
+  Ngsiv2Flavour       ngsiv2Flavour
 )
 {
-  /* Getting the entity in the request (helpful in other places) */
-  EntityId* enP = &ceP->entityId;
-
-  /* Checking there aren't duplicate attributes */
-  for (unsigned int ix = 0; ix < ceP->contextAttributeVector.size(); ++ix)
+  if ((apiVersion != "v2") || (strcasecmp(action.c_str(), "update") != 0) || (ngsiv2Flavour == NGSIV2_FLAVOUR_ONCREATE))
   {
-    std::string name = ceP->contextAttributeVector[ix]->name;
-    std::string id   = ceP->contextAttributeVector[ix]->getId();
-    for (unsigned int jx = ix + 1; jx < ceP->contextAttributeVector.size(); ++jx)
-    {
-      if ((name == ceP->contextAttributeVector[jx]->name) && (id == ceP->contextAttributeVector[jx]->getId()))
-      {
-        ContextAttribute* ca = new ContextAttribute(ceP->contextAttributeVector[ix]);
-        std::string details = std::string("duplicated attribute name: name=<") + name + "> id=<" + id + ">";
-        alarmMgr.badInput(clientIp, details);
-        buildGeneralErrorResponse(ceP, ca, responseP, SccInvalidModification,
-                                  "duplicated attribute /" + name + "/");
-        return false; // Error already in responseP
-      }
-    }
+    return false;
   }
 
-  /* Not supporting isPattern = true currently */
-  if (isTrue(enP->isPattern))
+  if (ceP->contextAttributeVector.size() == 0)
+  {
+    return false;
+  }
+
+  for (unsigned int ix = 0; ix < ceP->contextAttributeVector.size(); ++ix)
+  {
+    ContextAttribute* caP = ceP->contextAttributeVector[ix];
+
+    if ((caP->skip) || (caP->metadataVector.size() != 0) || (caP->getLocation(apiVersion) != ""))
+    {
+      return false;
+    }
+
+    if ((caP->compoundValueP == NULL) && (caP->valueType == ValueTypeNone))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* updateEntityFast -
+*
+* Single round-trip version of the count/query/updateEntity() sequence, for the requests
+* accepted by updateEntityFastAllowed(). The attributes are set in a findAndModify operation
+* which returns the entity as it was before the update, used to render the notifications
+* exactly as updateEntity() would.
+*
+* The operation is conditioned to the cases in which updateEntity() would do the same update:
+* all the attributes exist, none of them is the location attribute, no attribute in DB has
+* untyped metadata (which updateEntity() would rewrite with default type) and at least one
+* attribute actually changes. Otherwise, nothing is modified and false is returned, so the
+* caller goes on with the regular path (which deals with errors, CPrs, etc.).
+*
+* Note that, unlike in updateEntity(), the modification date of attributes that don't actually
+* change is also refreshed. That date is not exposed by the API.
+*
+* Returns true if the request was processed (successfully or not), false otherwise.
+*/
+static bool updateEntityFast
+(
+  const BSONObj&                  query,
+  ContextElement*                 ceP,
+  UpdateContextResponse*          responseP,
+  const std::string&              tenant,
+  const std::vector<std::string>& servicePathV,
+  const std::string&              xauthToken
+)
+{
+  BSONObjBuilder    q;
+  BSONObjBuilder    toSet;
+  BSONArrayBuilder  attrNames;
+  BSONArrayBuilder  changes;
+  bool              alwaysChanges = false;
+  int               now           = getCurrentTime();
+
+  q.appendElements(query);
+
+  for (unsigned int ix = 0; ix < ceP->contextAttributeVector.size(); ++ix)
+  {
+    ContextAttribute*  caP      = ceP->contextAttributeVector[ix];
+    std::string        attrPath = std::string(ENT_ATTRS) + "." + dbDotEncode(caP->name);
+    BSONObjBuilder     valueBuilder;
+
+    valueBson(caP, valueBuilder);
+
+    BSONObj      valueObj = valueBuilder.obj();
+    BSONElement  value    = valueObj.firstElement();
+
+    toSet.appendAs(value, attrPath + "." ENT_ATTRS_VALUE);
+    if (caP->type != "")
+    {
+      toSet.append(attrPath + "." ENT_ATTRS_TYPE, caP->type);
+    }
+    toSet.append(attrPath + "." ENT_ATTRS_MODIFICATION_DATE, now);
+
+    q.append(attrPath, BSON("$exists" << true));
+    q.append(attrPath + "." ENT_ATTRS_MD, BSON("$not" << BSON("$elemMatch" << BSON(ENT_ATTRS_MD_TYPE << BSON("$exists" << false)))));
+    attrNames.append(caP->name);
+
+    /* Actual update conditions, as in mergeAttrInfo() */
+    if (caP->compoundValueP != NULL)
+    {
+      alwaysChanges = true;
+    }
+    else
+    {
+      BSONObjBuilder ne;
+
+      if ((caP->valueType == ValueTypeString) && (caP->stringValue == ""))
+      {
+        // A missing value in DB is an implicit "", see attrValueChanges()
+        ne.append("$exists", true);
+      }
+      ne.appendAs(value, "$ne");
+      changes.append(BSON(attrPath + "." ENT_ATTRS_VALUE << ne.obj()));
+
+      if (caP->type != "")
+      {
+        changes.append(BSON(attrPath + "." ENT_ATTRS_TYPE << BSON("$ne" << caP->type)));
+      }
+    }
+  }
+
+  q.append(ENT_LOCATION "." ENT_LOCATION_ATTRNAME, BSON("$nin" << attrNames.arr()));
+  if (!alwaysChanges)
+  {
+    q.append("$or", changes.arr());
+  }
+  toSet.append(ENT_MODIFICATION_DATE, now);
+
+  BSONObj      cmd = BSON("findAndModify" << COL_ENTITIES <<
+                          "query"         << q.obj()      <<
+                          "update"        << BSON("$set" << toSet.obj()) <<
+                          "new"           << false);
+  BSONObj      result;
+  std::string  err;
+
+  if (!runCollectionCommand(composeDatabaseName(tenant), cmd, &result, &err))
+  {
+    buildGeneralErrorResponse(ceP, NULL, responseP, SccReceiverInternalError, err);
+    return true;
+  }
+
+  if (result.getField("ok").numberInt() != 1)
+  {
+    err = std::string("Database Error (findAndModify: ") + result.toString() + ")";
+    alarmMgr.dbError(err);
+    buildGeneralErrorResponse(ceP, NULL, responseP, SccReceiverInternalError, err);
+    return true;
+  }
+
+  if (!result.hasField("value") || (getField(result, "value").type() != Object))
+  {
+    LM_T(LmtMongo, ("fast update not applicable to entity '%s', using regular update", ceP->entityId.id.c_str()));
+    return false;
+  }
+
+  entityCacheInvalidate(tenant, ceP->entityId.id);
+
+  BSONObj      r           = getField(result, "value").embeddedObject();
+  BSONObj      idField     = getField(r, "_id").embeddedObject();
+  std::string  entityId    = getStringField(idField, ENT_ENTITY_ID);
+  std::string  entityType  = getStringField(idField, ENT_ENTITY_TYPE);
+  BSONObj      attrs       = getField(r, ENT_ATTRS).embeddedObject();
+
+  /* Only the types of the attributes may have changed */
+  TypeCatalogChange change = catalogChange(&r, &r);
+
+  for (unsigned int ix = 0; ix < ceP->contextAttributeVector.size(); ++ix)
+  {
+    if (change.exists && (ceP->contextAttributeVector[ix]->type != ""))
+    {
+      change.newAttrs[ceP->contextAttributeVector[ix]->name] = ceP->contextAttributeVector[ix]->type;
+    }
+  }
+  typeCatalogApply(tenant, change);
+
+  ContextElementResponse* cerP = new ContextElementResponse();
+  cerP->contextElement.entityId.fill(entityId, entityType, "false");
+
+  /* Build CER used for notifying (if needed), from the pre-image of the entity */
+  AttributeList            emptyAttrL;
+  ContextElementResponse*  notifyCerP = new ContextElementResponse(r, emptyAttrL);
+
+  notifyCerP->contextElement.creDate = r.hasField(ENT_CREATION_DATE) ? getLongField(r, ENT_CREATION_DATE) : -1;
+  notifyCerP->contextElement.modDate = now;
+
+  std::vector<std::string> modifiedAttrs;
+  for (unsigned int ix = 0; ix < ceP->contextAttributeVector.size(); ++ix)
+  {
+    ContextAttribute*  targetAttr = ceP->contextAttributeVector[ix];
+    ContextAttribute*  ca         = new ContextAttribute(targetAttr->name, targetAttr->type, "");
+    BSONObj            attr       = getField(attrs, dbDotEncode(targetAttr->name)).embeddedObject();
+
+    setResponseMetadata(targetAttr, ca);
+    cerP->contextElement.contextAttributeVector.push_back(ca);
+
+    bool actualUpdate = (targetAttr->compoundValueP != NULL) || attrValueChanges(attr, targetAttr) ||
+                        ((targetAttr->type != "") && (!attr.hasField(ENT_ATTRS_TYPE) ||
+                                                      getStringField(attr, ENT_ATTRS_TYPE) != targetAttr->type));
+    if (actualUpdate)
+    {
+      modifiedAttrs.push_back(targetAttr->name);
+    }
+
+    updateAttrInNotifyCer(notifyCerP, targetAttr, true);
+  }
+
+  std::map<string, TriggeredSubscription*> subsToNotify;
+  orion::Point                             location;
+  bool                                     located = geoFilterLocation(notifyCerP->contextElement.contextAttributeVector, &location);
+
+  if (!addTriggeredSubscriptions(entityId, entityType, modifiedAttrs, subsToNotify, err, tenant, servicePathV, located? &location : NULL))
+  {
+    cerP->statusCode.fill(SccReceiverInternalError, err);
+  }
+  else
+  {
+    processSubscriptions(subsToNotify, notifyCerP, &err, tenant, xauthToken);
+    cerP->statusCode.fill(SccOk);
+  }
+
+  releaseTriggeredSubscriptions(subsToNotify);
+  notifyCerP->release();
+  delete notifyCerP;
+
+  responseP->contextElementResponseVector.push_back(cerP);
+
+  return true;
+}
+
+/* ****************************************************************************
+*
+* contextElementPreconditionsCheck -
+*/
+static bool contextElementPreconditionsCheck
+(
+  ContextElement*         ceP,
+  UpdateContextResponse*  responseP,
+  const std::string&      action,
+  const std::string&      apiVersion
+)
+{
+  /* Getting the entity in the request (helpful in other places) */
+  EntityId* enP = &ceP->entityId;
+
+  /* Checking there aren't duplicate attributes */
+  for (unsigned int ix = 0; ix < ceP->contextAttributeVector.size(); ++ix)
+  {
+    std::string name = ceP->contextAttributeVector[ix]->name;
+    std::string id   = ceP->contextAttributeVector[ix]->getId();
+    for (unsigned int jx = ix + 1; jx < ceP->contextAttributeVector.size(); ++jx)
+    {
+      if ((name == ceP->contextAttributeVector[jx]->name) && (id == ceP->contextAttributeVector[jx]->getId()))
+      {
+        ContextAttribute* ca = new ContextAttribute(ceP->contextAttributeVector[ix]);
+        std::string details = std::string("duplicated attribute name: name=<") + name + "> id=<" + id + ">";
+        alarmMgr.badInput(clientIp, details);
+        buildGeneralErrorResponse(ceP, ca, responseP, SccInvalidModification,
+                                  "duplicated attribute /" + name + "/");
+        return false; // Error already in responseP
+      }
+    }
+  }
+
+  /* Not supporting isPattern = true currently */
+  if (isTrue(enP->isPattern))
   {
     buildGeneralErrorResponse(ceP, NULL, responseP, SccNotImplemented);
     return false;  // Error already in responseP
@@ -3149,7 +3736,8 @@ void processContextElement
   std::map<std::string, std::string>&  uriParams,   // FIXME P7: we need this to implement "restriction-based" filters
   const std::string&                   xauthToken,
   const std::string&                   apiVersion,
-  Ngsiv2Flavour                        ngsiv2Flavour
+  Ngsiv2Flavour                        ngsiv2Flavour,
+  UpdateBatch*                         batchP
 )
 {
   /* Check preconditions */
@@ -3212,13 +3800,69 @@ void processContextElement
 
   auto_ptr<DBClientCursor> cursor;
 
+  //
+  // The entities may be in the entity cache (the version is taken before reading from DB,
+  // so that the result is not cached if the entity is written meanwhile) or, in a batch,
+  // already read by updateBatchPrefetch(). In both cases, 'cached' is set
+  //
+  std::vector<BSONObj>  results;
+  std::string           queryString;
+  unsigned int          cacheVersion = 0;
+  bool                  cached       = false;
+
+  if ((batchP != NULL) && !isTrue(enP->isPattern))
+  {
+    if (batchP->processed.find(enP->id) != batchP->processed.end())
+    {
+      // The entity appears again in the batch: its pending writes are needed before reading it
+      updateBatchFlush(batchP, tenant, xauthToken);
+    }
+    else if (batchP->prefetchDone)
+    {
+      std::vector<BSONObj>& docs = batchP->prefetched[enP->id];
+
+      for (unsigned int ix = 0; ix < docs.size(); ++ix)
+      {
+        if ((enP->type == "") || (getStringField(getObjectField(docs[ix], "_id"), ENT_ENTITY_TYPE) == enP->type))
+        {
+          results.push_back(docs[ix]);
+        }
+      }
+      cached = true;
+    }
+
+    batchP->processed.insert(enP->id);
+  }
+
+  if (!cached && entityCacheEnabled())
+  {
+    queryString  = query.toString();
+    cacheVersion = entityCacheVersion(tenant, enP->id);
+    cached       = entityCacheLookup(tenant, enP->id, queryString, &results);
+  }
+
+  //
+  // The most common NGSIv2 updates are done in a single DB operation. If the entity type is known,
+  // at most one entity can match the query, so the count below is not needed either
+  //
+  bool fastUpdate = !cached && updateEntityFastAllowed(ceP, action, apiVersion, ngsiv2Flavour);
+
+  if (fastUpdate && (enP->type != "") && updateEntityFast(query, ceP, responseP, tenant, servicePathV, xauthToken))
+  {
+    return;
+  }
+
   // Several checkings related with NGSIv2
   if (apiVersion == "v2")
   {
     unsigned long long entitiesNumber;
     std::string        err;
 
-    if (!collectionCount(getEntitiesCollectionName(tenant), query, &entitiesNumber, &err))
+    if (cached)
+    {
+      entitiesNumber = results.size();
+    }
+    else if (!collectionCount(getEntitiesCollectionName(tenant), query, &entitiesNumber, &err))
     {
       buildGeneralErrorResponse(ceP, NULL, responseP, SccReceiverInternalError, err);
       return;
@@ -3247,59 +3891,71 @@ void processContextElement
       return;
     }
 
+    if (fastUpdate && (enP->type == "") && (entitiesNumber == 1) &&
+        updateEntityFast(query, ceP, responseP, tenant, servicePathV, xauthToken))
+    {
+      return;
+    }
   }
 
   std::string err;
 
-  TIME_STAT_MONGO_READ_WAIT_START();
-  DBClientBase* connection = getMongoConnection();
-  if (!collectionQuery(connection, getEntitiesCollectionName(tenant), query, &cursor, &err))
-  {
-    releaseMongoConnection(connection);
-    TIME_STAT_MONGO_READ_WAIT_STOP();
-    buildGeneralErrorResponse(ceP, NULL, responseP, SccReceiverInternalError, err);
-    return;
-  }
-  TIME_STAT_MONGO_READ_WAIT_STOP();
-
-  //
-  // Going through the list of found entities.
-  // As ServicePath cannot be modified, inside this loop nothing will be done
-  // about ServicePath (The ServicePath was present in the mongo query to obtain the list)
-  //
-  // FIXME P6: Once we allow for ServicePath to be modified, this loop must be looked at.
-  //
-
-  std::vector<BSONObj> results;
-  unsigned int         docs = 0;
-  while (moreSafe(cursor))
+  if (!cached)
   {
-    BSONObj r;
-    if (!nextSafeOrError(cursor, &r, &err))
+    TIME_STAT_MONGO_READ_WAIT_START();
+    DBClientBase* connection = getMongoConnection();
+    if (!collectionQuery(connection, getEntitiesCollectionName(tenant), query, &cursor, &err))
     {
-      LM_E(("Runtime Error (exception in nextSafe(): %s", err.c_str()));
-      continue;
+      releaseMongoConnection(connection);
+      TIME_STAT_MONGO_READ_WAIT_STOP();
+      buildGeneralErrorResponse(ceP, NULL, responseP, SccReceiverInternalError, err);
+      return;
     }
-    docs++;
-    LM_T(LmtMongo, ("retrieved document [%d]: '%s'", docs, r.toString().c_str()));
-
-    BSONElement idField = getField(r, "_id");
+    TIME_STAT_MONGO_READ_WAIT_STOP();
 
     //
-    // BSONElement::eoo returns true if 'not found', i.e. the field "_id" doesn't exist in 'sub'
+    // Going through the list of found entities.
+    // As ServicePath cannot be modified, inside this loop nothing will be done
+    // about ServicePath (The ServicePath was present in the mongo query to obtain the list)
     //
-    // Now, if 'r.getField("_id")' is not found, if we continue, calling embeddedObject() on it, then we get
-    // an exception and the broker crashes.
+    // FIXME P6: Once we allow for ServicePath to be modified, this loop must be looked at.
     //
-    if (idField.eoo() == true)
+
+    unsigned int docs = 0;
+    while (moreSafe(cursor))
     {
-      std::string details = std::string("error retrieving _id field in doc: '") + r.toString() + "'";
-      alarmMgr.dbError(details);
-      continue;
+      BSONObj r;
+      if (!nextSafeOrError(cursor, &r, &err))
+      {
+        LM_E(("Runtime Error (exception in nextSafe(): %s", err.c_str()));
+        continue;
+      }
+      docs++;
+      LM_T(LmtMongo, ("retrieved document [%d]: '%s'", docs, r.toString().c_str()));
+
+      BSONElement idField = getField(r, "_id");
+
+      //
+      // BSONElement::eoo returns true if 'not found', i.e. the field "_id" doesn't exist in 'sub'
+      //
+      // Now, if 'r.getField("_id")' is not found, if we continue, calling embeddedObject() on it, then we get
+      // an exception and the broker crashes.
+      //
+      if (idField.eoo() == true)
+      {
+        std::string details = std::string("error retrieving _id field in doc: '") + r.toString() + "'";
+        alarmMgr.dbError(details);
+        continue;
+      }
+      results.push_back(r);
+    }
+    releaseMongoConnection(connection);
+
+    if (entityCacheEnabled())
+    {
+      entityCacheInsert(tenant, enP->id, queryString, results, results.size(), cacheVersion);
     }
-    results.push_back(r);
   }
-  releaseMongoConnection(connection);
 
   LM_T(LmtServicePath, ("Docs found: %d", results.size()));
 
@@ -3320,7 +3976,8 @@ void processContextElement
                  responseP,
                  &attributeAlreadyExistsError,
                  &attributeAlreadyExistsList,
-                 apiVersion);
+                 apiVersion,
+                 batchP);
   }
 
   /*
@@ -3378,13 +4035,23 @@ void processContextElement
       std::string  errReason;
       std::string  errDetail;
       int          now = getCurrentTime();
+      BSONObj      insertedDoc;
 
-      if (!createEntity(enP, ceP->contextAttributeVector, now, &errDetail, tenant, servicePathV, apiVersion))
+      if (!createEntity(enP, ceP->contextAttributeVector, now, &errDetail, tenant, servicePathV, apiVersion, (batchP != NULL)? &insertedDoc : NULL))
       {
         cerP->statusCode.fill(SccInvalidParameter, errDetail);
       }
       else
       {
+        UpdateBatchItem* itemP = NULL;
+
+        // In a batch, the insert and the notifications are done later, by updateBatchFlush()
+        if (batchP != NULL)
+        {
+          itemP = updateBatchAdd(batchP, true, BSONObj(), insertedDoc, enP->id, cerP, SccInvalidParameter);
+          itemP->catalogChange = catalogChange(NULL, &insertedDoc);
+        }
+
         cerP->statusCode.fill(SccOk);
 
         /* Successful creation: send potential notifications */
@@ -3396,13 +4063,17 @@ void processContextElement
           attrNames.push_back(ceP->contextAttributeVector[ix]->name);
         }
 
+        orion::Point  location;
+        bool          located = geoFilterLocation(ceP->contextAttributeVector, &location);
+
         if (!addTriggeredSubscriptions(enP->id,
                                        enP->type,
                                        attrNames,
                                        subsToNotify,
                                        err,
                                        tenant,
-                                       servicePathV))
+                                       servicePathV,
+                                       located? &location : NULL))
         {
           releaseTriggeredSubscriptions(subsToNotify);
           cerP->statusCode.fill(SccReceiverInternalError, err);
@@ -3420,11 +4091,20 @@ void processContextElement
         notifyCerP->contextElement.modDate = now;
 
         notifyCerP->contextElement.entityId.servicePath = servicePathV.size() > 0? servicePathV[0] : "";
-        processSubscriptions(subsToNotify, notifyCerP, &errReason, tenant, xauthToken);
 
-        notifyCerP->release();
-        delete notifyCerP;
-        releaseTriggeredSubscriptions(subsToNotify);
+        if (itemP != NULL)
+        {
+          itemP->subsToNotify = subsToNotify;
+          itemP->notifyCerP   = notifyCerP;
+        }
+        else
+        {
+          processSubscriptions(subsToNotify, notifyCerP, &errReason, tenant, xauthToken);
+
+          notifyCerP->release();
+          delete notifyCerP;
+          releaseTriggeredSubscriptions(subsToNotify);
+        }
       }
 
       responseP->contextElementResponseVector.push_back(cerP);
@@ -3439,3 +4119,160 @@ void processContextElement
 
   // Response in responseP
 }
+
+
+
+/* ****************************************************************************
+*
+* updateBatchPrefetch -
+*
+* Reads from DB, in a single query, the entities that processContextElement() would read one
+* by one for each element of the batch (same servicePath and '?!exist=entity::type' filters, all
+* the entity ids in a $in). If the query fails, nothing is prefetched and the entities are read
+* one by one, as usual.
+*/
+void updateBatchPrefetch
+(
+  UpdateBatch*                         batchP,
+  ContextElementVector*                ceVP,
+  const std::string&                   tenant,
+  const std::vector<std::string>&      servicePathV,
+  std::map<std::string, std::string>&  uriParams
+)
+{
+  const std::string      idString          = "_id." ENT_ENTITY_ID;
+  const std::string      typeString        = "_id." ENT_ENTITY_TYPE;
+  const std::string      servicePathString = "_id." ENT_SERVICE_PATH;
+  BSONObjBuilder         bob;
+  BSONArrayBuilder       ids;
+  std::set<std::string>  idSet;
+
+  for (unsigned int ix = 0; ix < ceVP->size(); ++ix)
+  {
+    EntityId* enP = &(*ceVP)[ix]->entityId;
+
+    if (!isTrue(enP->isPattern) && (idSet.find(enP->id) == idSet.end()))
+    {
+      idSet.insert(enP->id);
+      ids.append(enP->id);
+    }
+  }
+
+  bob.append(idString, BSON("$in" << ids.arr()));
+
+  if (servicePathV.size() == 0)
+  {
+    bob.append(servicePathString, BSON("$exists" << false));
+  }
+  else
+  {
+    char path[SERVICE_PATH_MAX_TOTAL];
+
+    slashEscape(servicePathV[0].c_str(), path, sizeof(path));
+    bob.appendRegex(servicePathString, std::string("^") + path + "$");
+  }
+
+  if (uriParams[URI_PARAM_NOT_EXIST] == SCOPE_VALUE_ENTITY_TYPE)
+  {
+    bob.append(typeString, BSON("$exists" << false));
+  }
+
+  auto_ptr<DBClientCursor>  cursor;
+  std::string               err;
+
+  TIME_STAT_MONGO_READ_WAIT_START();
+  DBClientBase* connection = getMongoConnection();
+  if (!collectionQuery(connection, getEntitiesCollectionName(tenant), bob.obj(), &cursor, &err))
+  {
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_READ_WAIT_STOP();
+    return;
+  }
+  TIME_STAT_MONGO_READ_WAIT_STOP();
+
+  while (moreSafe(cursor))
+  {
+    BSONObj r;
+
+    if (!nextSafeOrError(cursor, &r, &err))
+    {
+      LM_E(("Runtime Error (exception in nextSafe(): %s", err.c_str()));
+      continue;
+    }
+
+    BSONElement idField = getField(r, "_id");
+
+    if (idField.eoo() == true)
+    {
+      std::string details = std::string("error retrieving _id field in doc: '") + r.toString() + "'";
+      alarmMgr.dbError(details);
+      continue;
+    }
+
+    batchP->prefetched[getStringField(idField.embeddedObject(), ENT_ENTITY_ID)].push_back(r.getOwned());
+  }
+  releaseMongoConnection(connection);
+
+  LM_T(LmtMongo, ("batch of %d entities: %d found", idSet.size(), batchP->prefetched.size()));
+
+  batchP->prefetchDone = true;
+}
+
+
+
+/* ****************************************************************************
+*
+* updateBatchFlush -
+*
+* Sends the pending writes of the batch to DB, in bulk write commands of up to
+* UPDATE_BATCH_MAX_WRITES writes, and then the notifications triggered by them.
+*
+* Bulk writes are unordered. Only the entities whose write failed (as reported by the
+* command, see collectionBulkInsert/collectionBulkUpdate) are flagged as failed and get
+* no notification. The notifications of the rest are sent once all the writes are done,
+* in the order of the elements in the request (as when they are processed one by one).
+*/
+void updateBatchFlush(UpdateBatch* batchP, const std::string& tenant, const std::string& xauthToken)
+{
+  std::string  collection = getEntitiesCollectionName(tenant);
+
+  if (batchP->inserts.size() > 0)
+  {
+    ensureLocationIndex(tenant);
+  }
+
+  for (unsigned int from = 0; from < batchP->inserts.size(); from += UPDATE_BATCH_MAX_WRITES)
+  {
+    unsigned int          to = std::min(from + UPDATE_BATCH_MAX_WRITES, (unsigned int) batchP->inserts.size());
+    std::vector<BSONObj>  docs(batchP->inserts.begin() + from, batchP->inserts.begin() + to);
+    std::vector<bool>     writtenV;
+    std::string           err;
+
+    collectionBulkInsert(collection, docs, &writtenV, &err);
+    updateBatchWritten(batchP->insertItems, from, writtenV, err);
+  }
+
+  for (unsigned int from = 0; from < batchP->updates.size(); from += UPDATE_BATCH_MAX_WRITES)
+  {
+    unsigned int          to = std::min(from + UPDATE_BATCH_MAX_WRITES, (unsigned int) batchP->updates.size());
+    std::vector<BSONObj>  queries(batchP->queries.begin() + from, batchP->queries.begin() + to);
+    std::vector<BSONObj>  docs(batchP->updates.begin() + from, batchP->updates.begin() + to);
+    std::vector<bool>     writtenV;
+    std::string           err;
+
+    collectionBulkUpdate(collection, queries, docs, false, &writtenV, &err);
+    updateBatchWritten(batchP->updateItems, from, writtenV, err);
+  }
+
+  for (unsigned int ix = 0; ix < batchP->items.size(); ++ix)
+  {
+    updateBatchDone(batchP->items[ix], tenant, xauthToken);
+  }
+
+  batchP->items.clear();
+  batchP->inserts.clear();
+  batchP->insertItems.clear();
+  batchP->queries.clear();
+  batchP->updates.clear();
+  batchP->updateItems.clear();
+}
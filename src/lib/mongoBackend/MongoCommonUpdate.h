@@ -26,11 +26,113 @@
 * Author: Fermín Galán
 */
 
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "rest/HttpStatusCode.h"
+#include "ngsi/ContextElementVector.h"
 #include "ngsi10/UpdateContextResponse.h"
+#include "mongoBackend/TriggeredSubscription.h"
+#include "cache/typeCatalog.h"
 #include "mongo/client/dbclient.h"
 
 using namespace mongo;
 
+
+
+/* ****************************************************************************
+*
+* UPDATE_BATCH_MAX_WRITES - maximum number of writes in a single bulk write command
+*
+* This is the maxWriteBatchSize of MongoDB, bigger bulk writes are rejected by the server
+*/
+#define UPDATE_BATCH_MAX_WRITES  1000
+
+
+
+/* ****************************************************************************
+*
+* UpdateBatchItem - an entity write pending in an UpdateBatch
+*
+* The notifications triggered by the write are sent (and the entity removed from the entity
+* cache and the change applied to the entity type catalog) once the write is done. If the write fails, the ContextElementResponse in the
+* response is flagged with 'errorCode' and 'writeErr'.
+*/
+typedef struct UpdateBatchItem
+{
+  std::string                                    entityId;
+  ContextElementResponse*                        cerP;
+  HttpStatusCode                                 errorCode;
+  bool                                           written;
+  std::string                                    writeErr;
+  std::map<std::string, TriggeredSubscription*>  subsToNotify;
+  ContextElementResponse*                        notifyCerP;
+  TypeCatalogChange                              catalogChange;
+} UpdateBatchItem;
+
+
+
+/* ****************************************************************************
+*
+* UpdateBatch -
+*
+* State shared by the processContextElement() calls of a multi-entity update: the target
+* entities are read from DB in a single query (updateBatchPrefetch) and the writes are
+* accumulated and sent to DB in bulk write commands (updateBatchFlush).
+*/
+typedef struct UpdateBatch
+{
+  bool                                          prefetchDone;
+  std::map<std::string, std::vector<BSONObj> >  prefetched;     // entity documents, by entity id
+  std::set<std::string>                         processed;      // entity ids already processed in the batch
+
+  std::vector<UpdateBatchItem*>                 items;          // in the order of the request
+  std::vector<BSONObj>                          inserts;
+  std::vector<UpdateBatchItem*>                 insertItems;
+  std::vector<BSONObj>                          queries;
+  std::vector<BSONObj>                          updates;
+  std::vector<UpdateBatchItem*>                 updateItems;
+
+  UpdateBatch(): prefetchDone(false) {}
+} UpdateBatch;
+
+
+
+/* ****************************************************************************
+*
+* updateBatchPrefetch -
+*/
+extern void updateBatchPrefetch
+(
+  UpdateBatch*                         batchP,
+  ContextElementVector*                ceVP,
+  const std::string&                   tenant,
+  const std::vector<std::string>&      servicePathV,
+  std::map<std::string, std::string>&  uriParams
+);
+
+
+
+/* ****************************************************************************
+*
+* updateBatchFlush -
+*/
+extern void updateBatchFlush(UpdateBatch* batchP, const std::string& tenant, const std::string& xauthToken);
+
+
+
+/* ****************************************************************************
+*
+* coalescedSubscriptionsNotified - update the subscriptions of the notifications sent by notifCoalesceFlush
+*
+* lastNotification and count are updated once per notification sent (not per entity in it).
+*/
+extern void coalescedSubscriptionsNotified(const std::vector<std::string>& subIdV, const std::string& tenant);
+
+
+
 /* ****************************************************************************
 *
 * processContextElement -
@@ -44,6 +146,7 @@ extern void processContextElement(ContextElement*                      ceP,
                                   std::map<std::string, std::string>&  uriParams,   // FIXME P7: we need this to implement "restriction-based" filters
                                   const std::string&                   xauthToken,
                                   const std::string&                   apiVersion    = "v1",
-                                  Ngsiv2Flavour                        ngsiV2Flavour = NGSIV2_NO_FLAVOUR);
+                                  Ngsiv2Flavour                        ngsiV2Flavour = NGSIV2_NO_FLAVOUR,
+                                  UpdateBatch*                         batchP        = NULL);
 
 #endif
@@ -39,7 +39,6 @@
 #include "common/globals.h"
 #include "common/sem.h"
 #include "common/string.h"
-#include "common/wsStrip.h"
 #include "common/statistics.h"
 #include "alarmMgr/alarmMgr.h"
 
@@ -53,6 +52,10 @@
 #include "mongoBackend/dbConstants.h"
 #include "mongoBackend/dbFieldEncoding.h"
 #include "mongoBackend/compoundResponses.h"
+#include "mongoBackend/StringFilter.h"
+#include "mongoBackend/jsonResponses.h"
+#include "mongoBackend/queryPlan.h"
+#include "cache/entityCache.h"
 
 #include "ngsi/EntityIdVector.h"
 #include "ngsi/AttributeList.h"
@@ -708,8 +711,10 @@ bool includedAttribute(const ContextRegistrationAttribute& attr, const Attribute
 *
 * fillQueryEntity -
 *
+* Patterns are given to appendRegexFilter(), so that the ones that are actually lists of
+* literal ids or prefixes use the _id.id index
 */
-static void fillQueryEntity(BSONArrayBuilder& ba, const EntityId* enP)
+static void fillQueryEntity(std::vector<BSONObj>& entV, const EntityId* enP)
 {
   BSONObjBuilder     ent;
   const std::string  idString          = "_id." ENT_ENTITY_ID;
@@ -717,7 +722,7 @@ static void fillQueryEntity(BSONArrayBuilder& ba, const EntityId* enP)
 
   if (enP->isPattern == "true")
   {
-    ent.appendRegex(idString, enP->id);
+    appendRegexFilter(&ent, idString, enP->id);
   }
   else
   {
@@ -730,7 +735,7 @@ static void fillQueryEntity(BSONArrayBuilder& ba, const EntityId* enP)
   }
 
   BSONObj entObj = ent.obj();
-  ba.append(entObj);
+  entV.push_back(entObj);
 
   LM_T(LmtMongo, ("Entity query token: '%s'", entObj.toString().c_str()));
 }
@@ -740,7 +745,7 @@ static void fillQueryEntity(BSONArrayBuilder& ba, const EntityId* enP)
 *
 * fillQueryServicePath -
 *
-* The regular expression for servicePath.
+* The filter for servicePath (see servicePathFilter() for details).
 *
 * If the servicePath is empty, then we return all entities, no matter their servicePath. This
 * can be seen as a query on "/#" considering that entities without servicePath are implicitly
@@ -748,71 +753,11 @@ static void fillQueryEntity(BSONArrayBuilder& ba, const EntityId* enP)
 */
 BSONObj fillQueryServicePath(const std::vector<std::string>& servicePath)
 {
-  /* Due to limitations in the BSONArrayBuilder class (that hopefully will be solved in legacy-1.0.0
-   * MongoDB driver) we need to compose the JSON string, then apply fromjson() function. Current
-   * implementation uses an array element for each regex tokens, but we could use only
-   * one element, concatenating all regex tokens using "|" (not sure what is more efficient from a
-   * computational point of view). However, note that we need the $in array as "null" has to be added
-   * as element in any case.
-   *
-   * More information on: http://stackoverflow.com/questions/24243276/include-regex-elements-in-bsonarraybuilder
-   *
-   */
-
-  std::string servicePathValue = "";
-
-  if (servicePath.size() > 0)
-  {
-    bool nullAdded = false;
-
-    servicePathValue += "{ $in: [ ";
-
-    for (unsigned int ix = 0 ; ix < servicePath.size(); ++ix)
-    {
-
-      //
-      // Add "null" in the following service path cases: / or /#. In order to avoid adding null
-      // several times, the nullAdded flag is used
-      //
-      if (!nullAdded && ((servicePath[ix] == "/") || (servicePath[ix] == "/#")))
-      {
-        servicePathValue += "null, ";
-        nullAdded = true;
-      }
-
-      char path[SERVICE_PATH_MAX_TOTAL * 2];
-      slashEscape(servicePath[ix].c_str(), path, sizeof(path));
-
-      if (path[strlen(path) - 1] == '#')
-      {
-        /* Remove '\/#' trailing part of the string */
-        int l = strlen(path);
-
-        path[l - 3] = 0;
-        servicePathValue += std::string("/^") + path + "$/, " + std::string("/^") + path + "\\/.*/";
-      }
-      else
-      {
-        servicePathValue += std::string("/^") + path + "$/";
-      }
-
-      /* Prepare concatenation for next token in regex */
-      if (ix < servicePath.size() - 1)
-      {
-        servicePathValue += std::string(", ");
-      }
-    }
+  BSONObj filter = servicePathFilter(servicePath);
 
-    servicePathValue += " ] }";
-    LM_T(LmtServicePath, ("Service Path JSON string: '%s'", servicePathValue.c_str()));
-  }
-  else
-  {
-    /* In this case, servicePath match any path, including the case of "null" */
-    servicePathValue = "{$in: [ /^\\/.*/, null] }";
-  }
+  LM_T(LmtServicePath, ("Service Path filter: '%s'", filter.toString().c_str()));
 
-  return fromjson(servicePathValue);
+  return filter;
 }
 
 
@@ -1000,16 +945,11 @@ static bool processAreaScopeV2(const Scope* scoP, BSONObj &areaQuery)
 }
 
 
-#define OPR_EXIST     "EXISTS"
-#define OPR_NOT_EXIST "NOT EXIST"
-
-
-
 /* ****************************************************************************
 *
 * rangeIsDates - are both values in a range expressing dates?
 */
-static bool rangeIsDates(char* rangeFrom, char* rangeTo, double* fromP, double* toP)
+static bool rangeIsDates(const std::string& rangeFrom, const std::string& rangeTo, double* fromP, double* toP)
 {
   double fromSeconds = 0;
   double toSeconds   = 0;
@@ -1027,286 +967,6 @@ static bool rangeIsDates(char* rangeFrom, char* rangeTo, double* fromP, double*
 
 
 
-/* *****************************************************************************
-*
-* matchFilter -
-*
-* Returns true if cerP match the "q token" based filter expressed in the parameters,
-* false otherwise.
-*
-*/
-static bool matchFilter
-(
-  char*                      left,
-  const std::string&         opr,
-  char*                      right,
-  char*                      rangeFrom,
-  char*                      rangeTo,
-  const std::vector<char*>&  valVector,
-  ContextElementResponse*    cerP,
-  int64_t                    seconds
-)
-{
-  /* First, look for unary operators */
-  if ((opr == OPR_EXIST) || (opr == OPR_NOT_EXIST))
-  {   
-    ContextAttribute* ca = cerP->contextElement.getAttribute(right);
-    bool exist = (ca != NULL);
-
-    /* This could be re-written as exist ^ (opr == OPR_NOT_EXIST) but the code
-     * would be harder to follow */
-    if (opr == OPR_EXIST)
-    {
-      return exist;
-    }
-    else   // opr == OPR_NOT_EXIST
-    {
-      return !exist;
-    }
-  }
-
-  /* For binary operators, the left side is the name of the attribute to check or the dateCreated/dateModified special keywords */
-  orion::ValueType valueType;
-  double           numberValue;
-  std::string      stringValue;
-
-  if (left == std::string(DATE_CREATED))
-  {
-    valueType   = orion::ValueTypeNumber;
-    numberValue = cerP->contextElement.creDate;
-  }
-  else if (left == std::string(DATE_MODIFIED))
-  {
-    valueType   = orion::ValueTypeNumber;
-    numberValue = cerP->contextElement.modDate;
-  }
-  else
-  {
-    ContextAttribute* caP = cerP->contextElement.getAttribute(left);
-
-    /* If the attribute does't exist, no need to go further: filter fails */
-    if (caP == NULL)
-    {
-      return false;
-    }
-
-    valueType   = caP->valueType;
-    numberValue = caP->numberValue;
-    stringValue = caP->stringValue;
-  }
-
-  if (opr == "==")
-  {
-    if (std::string(rangeFrom) != "")
-    {
-      double from;
-      double to;
-
-      //
-      // Ranges can only be used on numbers and dates
-      //
-      if ((rangeIsDates(rangeFrom, rangeTo, &from, &to) == false) && 
-          ((str2double(rangeFrom, &from) == false) || (str2double(rangeTo, &to) == false)))
-      {
-        return false;
-      }
-
-      return ((valueType == orion::ValueTypeNumber) && (numberValue >= from) && (numberValue <= to));
-    }
-    else if (valVector.size() > 0)
-    {
-      // the attribute value has to match at least one of the elements in the vector (OR)
-      for (unsigned int ix = 0; ix < valVector.size(); ++ix)
-      {
-        double d;
-
-        if (((d = parse8601Time(valVector[ix])) != -1) || (str2double(valVector[ix], &d)))
-        {
-          // number
-          if ((valueType == orion::ValueTypeNumber) && (numberValue == d))
-          {
-            return true;
-          }
-        }
-        else
-        {
-          // string
-          if ((valueType == orion::ValueTypeString) && (stringValue == valVector[ix]))
-          {
-            return true;
-          }
-        }
-      }
-      return false;
-    }
-    else
-    {
-      double d;
-      bool   isDate = false;
-
-      // Single value
-      if ((std::string(right) == "DATE") && (seconds != -1))
-      {
-        d      = seconds;
-        isDate = true;
-      }
-
-      if (isDate || str2double(right, &d))
-      {
-        // number
-        return ((valueType == orion::ValueTypeNumber) && (numberValue == d));
-      }
-      else
-      {
-        // string
-        return ((valueType == orion::ValueTypeString) && (stringValue == right));
-      }
-    }
-  }
-  else if (opr == "!=")
-  {
-    if (std::string(rangeFrom) != "")
-    {
-      double from;
-      double to;
-
-      //
-      // Ranges can only be used on numbers and dates
-      //
-      double fromSeconds;
-      double toSeconds;
-
-      if (((fromSeconds = parse8601Time(rangeFrom)) != -1) && ((toSeconds = parse8601Time(rangeTo)) != -1))
-      {
-        from = fromSeconds;
-        to   = toSeconds;
-      }
-      else if ((str2double(rangeFrom, &from) == false) || (str2double(rangeTo, &to) == false))
-      {
-        return false;
-      }
-
-      return ((valueType == orion::ValueTypeNumber) && ((numberValue < from) || (numberValue > to)));
-    }
-    else if (valVector.size() > 0)
-    {
-      // the attribute value has not to match any of the elements in the vector (AND)
-      for (unsigned int ix = 0; ix < valVector.size(); ++ix)
-      {
-        double d;
-
-        if (((d = parse8601Time(valVector[ix])) != -1) || (str2double(valVector[ix], &d)))
-        {
-          // number
-          if ((valueType == orion::ValueTypeNumber) && (numberValue == d))
-          {
-            return false;
-          }
-        }
-        else
-        {
-          // string
-          if ((valueType == orion::ValueTypeString) && (stringValue == valVector[ix]))
-          {
-            return false;
-          }
-        }
-      }
-      return true;
-    }
-    else
-    {
-      double d;
-      bool   isDate = false;
-
-      // Single value
-      if ((std::string(right) == "DATE") && (seconds != -1))
-      {
-        d      = seconds;
-        isDate = true;
-      }
-
-      if (isDate || str2double(right, &d))
-      {
-        // number
-        return !((valueType == orion::ValueTypeNumber) && (numberValue == d));
-      }
-      else
-      {
-        // string
-        return !((valueType == orion::ValueTypeString) && (stringValue == right));
-      }
-    }
-  }
-  else if (opr == ">")
-  {
-    double d;    
-
-    if ((std::string(right) == "DATE") && (seconds != -1))
-    {
-      d      = seconds;     
-    }
-    else if (str2double(right, &d) == false)
-    {
-      return false;
-    }
-
-    return ((valueType == orion::ValueTypeNumber) && (numberValue > d));
-  }
-  else if (opr == "<")
-  {
-    double d;
-
-    if ((std::string(right) == "DATE") && (seconds != -1))
-    {
-      d = seconds;
-    }
-    else if (str2double(right, &d) == false)
-    {
-      return false;
-    }
-
-    return ((valueType == orion::ValueTypeNumber) && (numberValue < d));
-  }
-  else if (opr == ">=")
-  {
-    double d;
-
-    if ((std::string(right) == "DATE") && (seconds != -1))
-    {
-      d = seconds;
-    }
-    else if (str2double(right, &d) == false)
-    {
-      return false;
-    }
-
-    return ((valueType == orion::ValueTypeNumber) && (numberValue >= d));
-  }
-  else if (opr == "<=")
-  {
-    double d;
-
-    if ((std::string(right) == "DATE") && (seconds != -1))
-    {
-      d = seconds;
-    }
-    else if (str2double(right, &d) == false)
-    {
-      return false;
-    }
-
-    return ((valueType == orion::ValueTypeNumber) && (numberValue <= d));
-  }
-  else
-  {
-    LM_E(("Runtime Error (unknown query operator: %s)", opr.c_str()));
-    return false;
-  }
-}
-
-
-
 /* *****************************************************************************
 *
 * addBsonFilter -
@@ -1316,14 +976,14 @@ static bool matchFilter
 */
 static bool addBsonFilter
 (
-  char*                      left,
-  const std::string&         opr,
-  char*                      right,
-  char*                      rangeFrom,
-  char*                      rangeTo,
-  const std::vector<char*>&  valVector,
-  std::vector<BSONObj>&      filters,
-  int64_t                    seconds
+  const std::string&               left,
+  const std::string&               opr,
+  const std::string&               right,
+  const std::string&               rangeFrom,
+  const std::string&               rangeTo,
+  const std::vector<std::string>&  valVector,
+  std::vector<BSONObj>&            filters,
+  int64_t                          seconds
 )
 {
   std::string    k;
@@ -1356,10 +1016,7 @@ static bool addBsonFilter
   // rangeFrom and rangeTo are treated separately, just in case some day we'd want to use 
   // some construction with only upper/lower limit.
   //
-  if (((right == NULL) || (*right == 0)) && 
-      (valVector.size() == 0) && 
-      ((rangeFrom == NULL) || (*rangeFrom == 0)) && 
-      ((rangeTo == NULL) || (*rangeTo == 0)))
+  if ((right == "") && (valVector.size() == 0) && (rangeFrom == "") && (rangeTo == ""))
   {
     return false;
   }
@@ -1372,7 +1029,7 @@ static bool addBsonFilter
       double to;
 
       if ((rangeIsDates(rangeFrom, rangeTo, &from, &to) == false) && 
-          ((str2double(rangeFrom, &from) == false) || (str2double(rangeTo, &to) == false)))
+          ((str2double(rangeFrom.c_str(), &from) == false) || (str2double(rangeTo.c_str(), &to) == false)))
       {
         return false;
       }
@@ -1389,7 +1046,7 @@ static bool addBsonFilter
       {
         double d;
 
-        if (((d = parse8601Time(valVector[ix])) != -1) || (str2double(valVector[ix], &d)))
+        if (((d = parse8601Time(valVector[ix])) != -1) || (str2double(valVector[ix].c_str(), &d)))
         {
           // number
           ba.append(d);
@@ -1417,34 +1074,34 @@ static bool addBsonFilter
       }
 
       // Single value
-      if (isDate || str2double(right, &d))
+      if (isDate || str2double(right.c_str(), &d))
       {
         // number
         bb.append("$in", BSON_ARRAY(d));
         bob.append(k, bb.obj());
         f = bob.obj();
       }
-      else if (*right == '\'')  // Forced string
+      else if (right[0] == '\'')  // Forced string
       {
-        ++right;
-        if (right[strlen(right) - 1] != '\'')
+        if ((right.size() < 2) || (right[right.size() - 1] != '\''))
         {
           alarmMgr.badInput(clientIp, "invalid expression - no ending single-quote in forced string");
           return false;
         }
-        right[strlen(right) - 1] = 0;
 
-        bb.append("$in", BSON_ARRAY(right));
+        std::string forced = right.substr(1, right.size() - 2);
+
+        bb.append("$in", BSON_ARRAY(forced));
         bob.append(k, bb.obj());
         f = bob.obj();
       }
       else
       {
-        if (strcmp(right, "true") == 0)
+        if (right == "true")
         {
           bb.append("$in", BSON_ARRAY(true));
         }
-        else if (strcmp(right, "false") == 0)
+        else if (right == "false")
         {
           bb.append("$in", BSON_ARRAY(false));
         }
@@ -1472,7 +1129,7 @@ static bool addBsonFilter
         from = fromSeconds;
         to   = toSeconds;
       }
-      else if ((str2double(rangeFrom, &from) == false) || (str2double(rangeTo, &to) == false))
+      else if ((str2double(rangeFrom.c_str(), &from) == false) || (str2double(rangeTo.c_str(), &to) == false))
       {
         return false;
       }
@@ -1490,7 +1147,7 @@ static bool addBsonFilter
       {
         double d;
 
-        if (((d = parse8601Time(valVector[ix])) != -1) || (str2double(valVector[ix], &d)))
+        if (((d = parse8601Time(valVector[ix])) != -1) || (str2double(valVector[ix].c_str(), &d)))
         {
           // number
           ba.append(d);
@@ -1518,35 +1175,34 @@ static bool addBsonFilter
       }
 
       // Single value
-      if (isDate || str2double(right, &d))
+      if (isDate || str2double(right.c_str(), &d))
       {
         // number
         bb.append("$exists", true).append("$nin", BSON_ARRAY(d));
         bob.append(k, bb.obj());
         f = bob.obj();
       }
-      else if (*right == '\'')  // Forced string
+      else if (right[0] == '\'')  // Forced string
       {
-        ++right;
-        if (right[strlen(right) - 1] != '\'')
+        if ((right.size() < 2) || (right[right.size() - 1] != '\''))
         {
           alarmMgr.badInput(clientIp, "invalid expression - no ending single-quote in forced string");
           return false;
         }
-        right[strlen(right) - 1] = 0;
 
+        std::string forced = right.substr(1, right.size() - 2);
 
-        bb.append("$exists", true).append("$nin", BSON_ARRAY(right));
+        bb.append("$exists", true).append("$nin", BSON_ARRAY(forced));
         bob.append(k, bb.obj());
         f = bob.obj();
       }
       else
       {
-        if (strcmp(right, "true") == 0)
+        if (right == "true")
         {
           bb.append("$exists", true).append("$nin", BSON_ARRAY(true));
         }
-        else if (strcmp(right, "false") == 0)
+        else if (right == "false")
         {
           bb.append("$exists", true).append("$nin", BSON_ARRAY(false));
         }
@@ -1568,7 +1224,7 @@ static bool addBsonFilter
     {
       d = seconds;
     }
-    else if (str2double(right, &d) == false)
+    else if (str2double(right.c_str(), &d) == false)
     {
       return false;
     }
@@ -1585,7 +1241,7 @@ static bool addBsonFilter
     {
       d = seconds;
     }
-    else if (str2double(right, &d) == false)
+    else if (str2double(right.c_str(), &d) == false)
     {
       return false;
     }
@@ -1602,7 +1258,7 @@ static bool addBsonFilter
     {
       d = seconds;
     }
-    else if (str2double(right, &d) == false)
+    else if (str2double(right.c_str(), &d) == false)
     {
       return false;
     }
@@ -1619,7 +1275,7 @@ static bool addBsonFilter
     {
       d = seconds;
     }
-    else if (str2double(right, &d) == false)
+    else if (str2double(right.c_str(), &d) == false)
     {
       return false;
     }
@@ -1658,284 +1314,40 @@ static bool addBsonFilter
 *
 * qStringFilters -
 *
-* FIXME P9: this function currently abuses of the std::string() wrapping for char* in order to
-* make comparisons work. An smarter solution could be developed.
-*
-* FIXME P7: actually, this functions behaviour depends on the presence of the cerP parameter, in particular
-*
-* - if cerP is NULL, then the output of this function is a set of BSON filters (in the filters vector) to
-*   be applied on MongoDB. The return value is not used. This is the typical use for queryContext and derived
-*   operations
-* - if cerP is not NULL, then the filters are evaluated in memory on the cerP. The return value is used to
-*   specify if cerP match the filter or not. The filters parameter is not used (although the caller needs to
-*   provide it in order to conform with function signature).
-*
-* I don't like too much to have a function with two quite parallel behaviours in the same logic. Probably a
-* smarter design would be to divide this function in two parts: one focused on string parsing and the other one
-* focused on applying filters to each different system (either in memory or as BSON).
-*
+* Parses the 'q' string and translates its tokens into BSON filters, to be applied on
+* MongoDB. This is the typical use for queryContext and derived operations. The
+* in-memory evaluation of 'q' on an entity (subscriptions) is done by StringFilter::match.
 */
-bool qStringFilters(const std::string& in, std::vector<BSONObj> &filters, ContextElementResponse* cerP)
+bool qStringFilters(const std::string& in, std::vector<BSONObj> &filters)
 {
-  //
-  // Initial Sanity check (of the entire string)
-  // - Not empty
-  // - Not just a single ';'
-  // - Not two ';' in a row
-  //
-  if ((in == "")  || 
-      (in == ";") ||
-      (strstr(in.c_str(), ";;") != NULL))
+  StringFilter sf;
+
+  if (sf.parse(in) == false)
   {
     return false;
   }
 
-  char* str         = strdup(in.c_str());
-  char* toFree      = str;
-  char* s;
-  char* saver;
-  bool  rightHandSideMandatory = true;
-  bool  leftHandSideMandatory  = true;
-  bool  retval                 = true;
-
-  while ((s = strtok_r(str, ";", &saver)) != NULL)
+  for (unsigned int ix = 0; ix < sf.filters.size(); ++ix)
   {
-    char*               left;
-    char*               op;
-    char*               right     = NULL;
-    char*               rangeFrom = (char*) "";
-    char*               rangeTo   = (char*) "";
-    std::vector<char*>  valVector;
+    const StringFilterItem& item = sf.filters[ix];
 
-    s = wsStrip(s);
-
-    //
-    // Rudimentary sanity checks (of *this* part of 'q')
-    //
-    // 1. If the 'q-part' is empty, error
-    // 2. If a range is present, the op MUST be either '==' OR '!=' 
-    //
-    if (*s == 0)
+    if (addBsonFilter(item.left, item.opr, item.right, item.rangeFrom, item.rangeTo, item.valVector, filters, item.seconds) == false)
     {
-      free(toFree);
       return false;
     }
-    else if (strstr(s, "..") != NULL)
-    {
-      if ((strstr(s, "==") == NULL) && (strstr(s, "!=") == NULL))
-      {
-        free(toFree);
-        return false;
-      }
-    }
+  }
 
-    left = s;
-    if ((op = (char*) strstr(s, "==")) != NULL)
-    {
-      *op = 0;
+  return true;
+}
 
-      right = &op[2];
-      op    = (char*) "==";
-    }
-    else if ((op = (char*) strstr(s, "!=")) != NULL)
-    {
-      *op = 0;
 
-      right = &op[2];
-      op    = (char*) "!=";
-    }
-    else if ((op = (char*) strstr(s, ">=")) != NULL)
-    {
-      *op = 0;
-
-      right = &op[2];
-      op    = (char*) ">=";
-    }
-    else if ((op = (char*) strstr(s, "<=")) != NULL)
-    {
-      *op = 0;
-
-      right = &op[2];
-      op    = (char*) "<=";
-    }
-    else if ((op = (char*) strstr(s, "<")) != NULL)
-    {
-      *op = 0;
-
-      right = &op[1];
-      op    = (char*) "<";
-    }
-    else if ((op = (char*) strstr(s, ">")) != NULL)
-    {
-      *op = 0;
-
-      right = &op[1];
-      op    = (char*) ">";
-    }
-    else if (s[0] == '!')
-    {
-      left  = (char*) "";
-      op    = (char*) OPR_NOT_EXIST;
-      right = wsStrip(&s[1]);
-      leftHandSideMandatory = false;
-    }
-    else
-    {
-      left  = (char*) "";
-      op    = (char*) OPR_EXIST;
-      right = wsStrip(s);
-      leftHandSideMandatory = false;
-    }
-
-    left  = wsStrip(left);
-    right = wsStrip(right);
-
-    //
-    // Sanity check for left-hand and right-hand non-empty
-    //
-    if ((rightHandSideMandatory == true) && (*right == 0))
-    {
-      free(toFree);
-      return false;
-    }
-
-    if ((leftHandSideMandatory == true) && (*left == 0))
-    {
-      free(toFree);
-      return false;
-    }
-
-    std::string opr = op;
-
-    if ((opr == "==") || (opr == "!="))
-    {
-      char* del;
-
-      //
-      // 1.  range?   A..B
-      // 2.  list?    A,B,C
-      // 2.1 if list, check single quotes
-      //
-
-      if ((del = strstr(right, "..")) != NULL)
-      {
-        *del = 0;
-        rangeFrom = right;
-        rangeTo   = &del[2];
-
-        right     = (char*) "";
-        rangeFrom = wsStrip(rangeFrom);
-        rangeTo   = wsStrip(rangeTo);
-      }
-      else if ((del = strstr(right, ",")) != NULL)
-      {
-        char* start         = right;
-        char* cP            = right;
-        bool  insideQuotes  = false;
-        bool  done          = false;
-
-        while (done == false)
-        {
-          if (*cP == '\'')
-          {
-            insideQuotes = (insideQuotes == true)? false : true;
-          }
-          else if ((*cP == ',') || (*cP == 0))
-          {
-            // 1. If end-of-string reached, then this is the last loop
-            if (*cP == 0)
-            {
-              done = true;
-            }
-
-
-            if (!insideQuotes)
-            {
-              //
-              // If we are inside single-quotes, then do nothing, just advance the char pointer (++cP)
-              // If not inside queotes, we are on a comma, so a new value is to be pushed onto the value vector.
-              //
-
-              // 2. Remove beginning quote, if there is one
-              if (*start == '\'')
-              {
-                *start = 0;
-                ++start;
-              }
-
-              // 3. Null-out the comma
-              *cP = 0;
-
-              // 4. Remove trailing quote, if there
-              if (cP[-1] == '\'')
-              {
-                cP[-1] = 0;
-              }
-
-              // 5. Push the value onto the vector of values
-              valVector.push_back(wsStrip(start));
-
-              // 6. Make point start to the beginning of the next value
-              start = &cP[1];
-            }
-          }
-
-          ++cP;
-        }
-
-        right = (char*) "";
-      }
-    }
-
-    str = NULL;  // So that strtok_r continues eating the initial string
-
-    //
-    // Is the right-hand-side a DATE?
-    // If so, convert it to unix seconds since epoch
-    //
-    int64_t seconds = -1;
-
-    if (right != NULL)
-    {
-      if ((seconds = parse8601Time(right)) != -1)
-      {
-        right = (char*) "DATE";  // value of the date is passed in 'seconds'
-      }
-    }
-
-
-    /* Build the BSON filter (or evaluate on cerP) */
-    if (cerP == NULL)
-    {
-      if (addBsonFilter(left, opr, right, rangeFrom, rangeTo, valVector, filters, seconds) == false)
-      {
-        retval = false;
-        break;
-      }
-    }
-    else
-    {
-      if (!matchFilter(left, opr, right, rangeFrom, rangeTo, valVector, cerP, seconds))
-      {
-        retval = false;
-        break;
-      }
-    }
-  }
-
-  free(toFree);
-
-  return retval;
-}
-
-
-/* *****************************************************************************
-*
-* addFilterScopes -
-*/
-static void addFilterScope(const Scope* scoP, std::vector<BSONObj> &filters)
-{
-  std::string entityTypeString = std::string("_id.") + ENT_ENTITY_TYPE;
+/* *****************************************************************************
+*
+* addFilterScopes -
+*/
+static void addFilterScope(const Scope* scoP, std::vector<BSONObj> &filters)
+{
+  std::string entityTypeString = std::string("_id.") + ENT_ENTITY_TYPE;
 
   if (scoP->type == SCOPE_FILTER_EXISTENCE)
   {
@@ -1983,44 +1395,27 @@ static std::string sortCriteria(const std::string& sortToken)
 
 /* ****************************************************************************
 *
-* entitiesQuery -
-*
-* This method is used by queryContext and subscribeContext (ONCHANGE conditions). It takes
-* a vector with entities and a vector with attributes as input and returns the corresponding
-* ContextElementResponseVector or error.
+* entitiesQueryBuild -
 *
-* Note the includeEmpty argument. This is used if we don't want the result to include empty
-* attributes, i.e. the ones that cause '<contextValue></contextValue>'. This is aimed at
-* subscribeContext case, as empty values can cause problems in the case of federating Context
-* Brokers (the notifyContext is processed as an updateContext and in the latter case, an
-* empty value causes an error)
+* Build the query (and sort order) of entitiesQuery. Returns false (setting *badInputP)
+* if the query cannot be built due to a bad input.
 */
-bool entitiesQuery
+static bool entitiesQueryBuild
 (
   const EntityIdVector&            enV,
   const AttributeList&             attrL,
   const Restriction&               res,
-  ContextElementResponseVector*    cerV,
-  std::string*                     err,
-  bool                             includeEmpty,
-  const std::string&               tenant,
   const std::vector<std::string>&  servicePath,
-  int                              offset,
-  int                              limit,
-  bool*                            limitReached,
-  long long*                       countP,
-  bool*                            badInputP,
   const std::string&               sortOrderList,
-  bool                             includeCreDate,
-  bool                             includeModDate,
-  const std::string&               apiVersion
+  Query*                           queryP,
+  std::string*                     err,
+  bool*                            badInputP
 )
 {
-
   /* Query structure is as follows
    *
    * {
-   *    "$or": [ ... ],            (always)
+   *    "$or": [ ... ],            (entities, unless there is only one of them)
    *    "_id.servicePath: { ... }  (always, in some cases using {$exists: false})
    *    "attrNames": { ... },      (only if attributes are used in the query)
    *    "location.coords": { ... } (only in the case of geo-queries)
@@ -2028,18 +1423,16 @@ bool entitiesQuery
    *
    */
 
-  BSONObjBuilder    finalQuery;
-  BSONArrayBuilder  orEnt;
+  BSONObjBuilder        finalQuery;
+  std::vector<BSONObj>  entV;
 
   /* Part 1: entities */
 
   for (unsigned int ix = 0; ix < enV.size(); ++ix)
   {
-    fillQueryEntity(orEnt, enV[ix]);
+    fillQueryEntity(entV, enV[ix]);
   }
 
-  /* The result of orEnt is appended to the final query */
-  finalQuery.append("$or", orEnt.arr());
 
   /* Part 2: service path */
   const std::string  servicePathString = "_id." ENT_SERVICE_PATH;
@@ -2124,20 +1517,46 @@ bool entitiesQuery
     }
   }
 
+  /* The entities are appended to the final query in a $or. A single entity doesn't need it,
+   * unless some filter is on the same fields */
+  bool flatEntity = (entV.size() == 1);
+
+  for (unsigned int ix = 0; flatEntity && (ix < filters.size()); ++ix)
+  {
+    for (BSONObj::iterator it = filters[ix].begin(); it.more();)
+    {
+      if (entV[0].hasField(it.next().fieldName()))
+      {
+        flatEntity = false;
+      }
+    }
+  }
+
+  if (flatEntity)
+  {
+    finalQuery.appendElements(entV[0]);
+  }
+  else
+  {
+    BSONArrayBuilder orEnt;
+
+    for (unsigned int ix = 0; ix < entV.size(); ++ix)
+    {
+      orEnt.append(entV[ix]);
+    }
+    finalQuery.append("$or", orEnt.arr());
+  }
+
   for (unsigned int ix = 0; ix < filters.size(); ++ix)
   {
     finalQuery.appendElements(filters[ix]);
   }
 
-  LM_T(LmtPagination, ("Offset: %d, Limit: %d, countP: %p", offset, limit, countP));
-
-  /* Do the query on MongoDB */
-  auto_ptr<DBClientCursor>  cursor;
-  Query                     query(finalQuery.obj());
+  *queryP = Query(finalQuery.obj());
 
   if (sortOrderList == "")
   {
-    query.sort(BSON(ENT_CREATION_DATE << 1));
+    queryP->sort(BSON(ENT_CREATION_DATE << 1));
   }
   else if ((sortOrderList == ORDER_BY_PROXIMITY))
   {
@@ -2170,89 +1589,180 @@ bool entitiesQuery
       sortOrder.append(sortCriteria(sortToken), sortDirection);
     }
 
-    query.sort(sortOrder.obj());
+    queryP->sort(sortOrder.obj());
   }
 
-  TIME_STAT_MONGO_READ_WAIT_START();
-  DBClientBase* connection = getMongoConnection();
-  if (!collectionRangedQuery(connection, getEntitiesCollectionName(tenant), query, limit, offset, &cursor, countP, err))
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* entitiesQuery -
+*
+* This method is used by queryContext and subscribeContext (ONCHANGE conditions). It takes
+* a vector with entities and a vector with attributes as input and returns the corresponding
+* ContextElementResponseVector or error.
+*
+* Note the includeEmpty argument. This is used if we don't want the result to include empty
+* attributes, i.e. the ones that cause '<contextValue></contextValue>'. This is aimed at
+* subscribeContext case, as empty values can cause problems in the case of federating Context
+* Brokers (the notifyContext is processed as an updateContext and in the latter case, an
+* empty value causes an error)
+*/
+bool entitiesQuery
+(
+  const EntityIdVector&            enV,
+  const AttributeList&             attrL,
+  const Restriction&               res,
+  ContextElementResponseVector*    cerV,
+  std::string*                     err,
+  bool                             includeEmpty,
+  const std::string&               tenant,
+  const std::vector<std::string>&  servicePath,
+  int                              offset,
+  int                              limit,
+  bool*                            limitReached,
+  long long*                       countP,
+  bool*                            badInputP,
+  const std::string&               sortOrderList,
+  bool                             includeCreDate,
+  bool                             includeModDate,
+  const std::string&               apiVersion
+)
+{
+
+  Query query;
+
+  if (!entitiesQueryBuild(enV, attrL, res, servicePath, sortOrderList, &query, err, badInputP))
   {
-    releaseMongoConnection(connection);
-    TIME_STAT_MONGO_READ_WAIT_STOP();
     return false;
   }
-  TIME_STAT_MONGO_READ_WAIT_STOP();
+
+  LM_T(LmtPagination, ("Offset: %d, Limit: %d, countP: %p", offset, limit, countP));
+
+  /* Queries on a single entity id may be resolved by the entity cache */
+  std::vector<BSONObj>  cachedDocs;
+  std::string           cacheKey;
+  unsigned int          cacheVersion = 0;
+  bool                  cacheable    = entityCacheEnabled() && (enV.size() == 1) && !isTrue(enV[0]->isPattern);
+  bool                  cached       = false;
+
+  if (cacheable)
+  {
+    char range[64];
+
+    snprintf(range, sizeof(range), "|%d|%d", offset, limit);
+    cacheKey     = query.toString() + range;
+    cacheVersion = entityCacheVersion(tenant, enV[0]->id);
+    cached       = entityCacheLookup(tenant, enV[0]->id, cacheKey, &cachedDocs, countP);
+  }
+
+  /* Do the query on MongoDB */
+  auto_ptr<DBClientCursor>  cursor;
+  DBClientBase*             connection = NULL;
+
+  if (!cached)
+  {
+    queryExplainTrace(getEntitiesCollectionName(tenant), query);
+
+    TIME_STAT_MONGO_READ_WAIT_START();
+    connection = getMongoConnection();
+    if (!collectionRangedQuery(connection, getEntitiesCollectionName(tenant), query, limit, offset, &cursor, countP, err))
+    {
+      releaseMongoConnection(connection);
+      TIME_STAT_MONGO_READ_WAIT_STOP();
+      return false;
+    }
+    TIME_STAT_MONGO_READ_WAIT_STOP();
+  }
 
   /* Process query result */
-  unsigned int docs = 0;
-  while (moreSafe(cursor))
+  unsigned int          docs = 0;
+  std::vector<BSONObj>  fetchedDocs;
+
+  while (cached? (docs < cachedDocs.size()) : moreSafe(cursor))
   {
     BSONObj  r;
-    try
+
+    if (cached)
     {
-      // nextSafeOrError cannot be used here, as AssertionException has a special treatment in this case
-      r = cursor->nextSafe();
+      r = cachedDocs[docs];
     }
-    catch (const AssertionException &e)
+    else
     {
-      std::string              exErr = e.what();
-      ContextElementResponse*  cer   = new ContextElementResponse();
+      try
+      {
+        // nextSafeOrError cannot be used here, as AssertionException has a special treatment in this case
+        r = cursor->nextSafe();
+      }
+      catch (const AssertionException &e)
+      {
+        std::string              exErr = e.what();
+        ContextElementResponse*  cer   = new ContextElementResponse();
 
-      //
-      // We can't return the error 'as is', as it may contain forbidden characters.
-      // So, we can just match the error and send a less descriptive text.
-      //
-      const char* invalidPolygon      = "Exterior shell of polygon is invalid";
-      const char* defaultErrorString  = "Error at querying MongoDB";
+        //
+        // We can't return the error 'as is', as it may contain forbidden characters.
+        // So, we can just match the error and send a less descriptive text.
+        //
+        const char* invalidPolygon      = "Exterior shell of polygon is invalid";
+        const char* defaultErrorString  = "Error at querying MongoDB";
 
-      alarmMgr.dbError(exErr);
+        alarmMgr.dbError(exErr);
 
-      if (strncmp(exErr.c_str(), invalidPolygon, strlen(invalidPolygon)) == 0)
-      {
-        exErr = invalidPolygon;
+        if (strncmp(exErr.c_str(), invalidPolygon, strlen(invalidPolygon)) == 0)
+        {
+          exErr = invalidPolygon;
+        }
+        else
+        {
+          exErr = defaultErrorString;
+        }
+
+        //
+        // It would be nice to fill in the entity but it is difficult to do this.
+        //
+        // Solution:
+        //   If the incoming entity-vector has only *one* entity, I simply fill it in with enV[0] and
+        //   if more than one entity is in the vector, an empty entity is returned.
+        //
+        if (enV.size() == 1)
+        {
+          cer->contextElement.entityId.fill(enV[0]);
+        }
+        else
+        {
+          cer->contextElement.entityId.fill("", "", "");
+        }
+
+        cer->statusCode.fill(SccReceiverInternalError, exErr);
+        cerV->push_back(cer);
+        return true;
       }
-      else
+      catch (const std::exception &e)
       {
-        exErr = defaultErrorString;
+        *err = e.what();
+        LM_E(("Runtime Error (exception in nextSafe(): %s)", e.what()));
+        releaseMongoConnection(connection);
+        return false;
       }
-
-      //
-      // It would be nice to fill in the entity but it is difficult to do this.
-      //
-      // Solution:
-      //   If the incoming entity-vector has only *one* entity, I simply fill it in with enV[0] and
-      //   if more than one entity is in the vector, an empty entity is returned.
-      //
-      if (enV.size() == 1)
+      catch (...)
       {
-        cer->contextElement.entityId.fill(enV[0]);
+        *err = "generic exception at nextSafe()";
+        LM_E(("Runtime Error (generic exception in nextSafe())"));
+        releaseMongoConnection(connection);
+        return false;
       }
-      else
+
+      alarmMgr.dbErrorReset();
+
+      if (cacheable)
       {
-        cer->contextElement.entityId.fill("", "", "");
+        fetchedDocs.push_back(r);
       }
-
-      cer->statusCode.fill(SccReceiverInternalError, exErr);
-      cerV->push_back(cer);
-      return true;
-    }
-    catch (const std::exception &e)
-    {
-      *err = e.what();
-      LM_E(("Runtime Error (exception in nextSafe(): %s)", e.what()));
-      releaseMongoConnection(connection);
-      return false;
-    }
-    catch (...)
-    {
-      *err = "generic exception at nextSafe()";
-      LM_E(("Runtime Error (generic exception in nextSafe())"));
-      releaseMongoConnection(connection);
-      return false;
     }
 
-    alarmMgr.dbErrorReset();
-
     // Build CER from BSON retrieved from DB
     docs++;
     LM_T(LmtMongo, ("retrieved document [%d]: '%s'", docs, r.toString().c_str()));
@@ -2284,7 +1794,16 @@ bool entitiesQuery
     cer->statusCode.fill(SccOk);
     cerV->push_back(cer);
   }
-  releaseMongoConnection(connection);
+
+  if (!cached)
+  {
+    releaseMongoConnection(connection);
+
+    if (cacheable)
+    {
+      entityCacheInsert(tenant, enV[0]->id, cacheKey, fetchedDocs, (countP != NULL)? *countP : -1, cacheVersion);
+    }
+  }
 
   /* If we have already reached the pagination limit with local entities, we have ended: no more "potential"
    * entities are added. Only if limitReached is being used, i.e. not NULL
@@ -2351,6 +1870,137 @@ bool entitiesQuery
 }
 
 
+
+/* ****************************************************************************
+*
+* entitiesQueryRender -
+*
+* Fast path of entitiesQuery for NGSIv2 entity queries: the entities found are rendered
+* as a JSON array straight from the cursor into *outP, without building the intermediate
+* ContextElementResponseVector.
+*
+* Returns false if the caller has to fall back to entitiesQuery, i.e. if the query cannot
+* be done or is not valid (*err may be set in that case) or if no entity was found (in
+* which case context providers could be involved).
+*
+* If streamPP is not NULL and the response grows beyond STREAM_RESPONSE_THRESHOLD, the
+* rendering stops there and a stream to render the rest of the entities (taking over what
+* was rendered so far) is returned in *streamPP. The cursor and its DB connection are
+* released before returning in any case, the stream reads the rest of the entities with
+* the same query, batch by batch.
+*/
+bool entitiesQueryRender
+(
+  const EntityIdVector&            enV,
+  const Restriction&               res,
+  const std::string&               tenant,
+  const std::vector<std::string>&  servicePath,
+  int                              offset,
+  int                              limit,
+  long long*                       countP,
+  const std::string&               sortOrderList,
+  bool                             includeCreDate,
+  bool                             includeModDate,
+  const std::string&               renderMode,
+  const std::string&               attrsFilter,
+  std::string*                     outP,
+  ResponseStream**                 streamPP,
+  std::string*                     err
+)
+{
+  AttributeList  attrL;
+  Query          query;
+  bool           badInput = false;
+
+  if (!entitiesQueryBuild(enV, attrL, res, servicePath, sortOrderList, &query, err, &badInput))
+  {
+    return false;
+  }
+
+  LM_T(LmtPagination, ("Offset: %d, Limit: %d, countP: %p", offset, limit, countP));
+
+  auto_ptr<DBClientCursor>  cursor;
+
+  queryExplainTrace(getEntitiesCollectionName(tenant), query);
+
+  TIME_STAT_MONGO_READ_WAIT_START();
+  DBClientBase* connection = getMongoConnection();
+  if (!collectionRangedQuery(connection, getEntitiesCollectionName(tenant), query, limit, offset, &cursor, countP, err))
+  {
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_READ_WAIT_STOP();
+    return false;
+  }
+  TIME_STAT_MONGO_READ_WAIT_STOP();
+
+  unsigned int docs     = 0;
+  bool         streamed = false;
+
+  outP->reserve(1024);
+  *outP = "[";
+
+  while (moreSafe(cursor))
+  {
+    BSONObj r;
+
+    try
+    {
+      r = cursor->nextSafe();
+    }
+    catch (const std::exception &e)
+    {
+      // AssertionException included: entitiesQuery knows how to report it
+      *err = e.what();
+      LM_T(LmtMongo, ("exception in nextSafe(), falling back to entitiesQuery: %s", e.what()));
+      releaseMongoConnection(connection);
+      return false;
+    }
+    catch (...)
+    {
+      *err = "generic exception at nextSafe()";
+      LM_T(LmtMongo, ("generic exception in nextSafe(), falling back to entitiesQuery"));
+      releaseMongoConnection(connection);
+      return false;
+    }
+
+    alarmMgr.dbErrorReset();
+
+    if (docs != 0)
+    {
+      *outP += ",";
+    }
+
+    docs++;
+    LM_T(LmtMongo, ("retrieved document [%d]: '%s'", docs, r.toString().c_str()));
+    entityJsonResponse(r, renderMode, attrsFilter, includeCreDate, includeModDate, outP);
+
+    // Too big to be kept in memory: the rest of the entities are rendered as the response is sent
+    if ((streamPP != NULL) && (outP->size() > STREAM_RESPONSE_THRESHOLD) && moreSafe(cursor))
+    {
+      LM_T(LmtMongo, ("streaming response after %d documents", docs));
+      streamed  = true;
+      *streamPP = new EntitiesJsonStream(getEntitiesCollectionName(tenant), query, offset + docs, (limit != 0)? limit - docs : 0,
+                                         renderMode, attrsFilter, includeCreDate, includeModDate, outP);
+      break;
+    }
+  }
+
+  // The cursor must be destroyed before its connection is given back to the pool
+  cursor.reset();
+  releaseMongoConnection(connection);
+
+  if (streamed)
+  {
+    return true;
+  }
+
+  *outP += "]";
+
+  return (docs != 0);
+}
+
+
+
 /* ****************************************************************************
 *
 * pruneContextElements -
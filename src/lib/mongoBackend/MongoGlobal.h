@@ -43,6 +43,7 @@
 #include "ngsi9/RegisterContextResponse.h"
 #include "ngsiNotify/Notifier.h"
 #include "rest/uriParamNames.h"
+#include "rest/ResponseStream.h"
 
 #include "mongoBackend/TriggeredSubscription.h"
 
@@ -275,6 +276,31 @@ extern bool entitiesQuery
   const std::string&               apiVersion     = "v1"
 );
 
+
+/* ****************************************************************************
+*
+* entitiesQueryRender -
+*
+*/
+extern bool entitiesQueryRender
+(
+  const EntityIdVector&            enV,
+  const Restriction&               res,
+  const std::string&               tenant,
+  const std::vector<std::string>&  servicePath,
+  int                              offset,
+  int                              limit,
+  long long*                       countP,
+  const std::string&               sortOrderList,
+  bool                             includeCreDate,
+  bool                             includeModDate,
+  const std::string&               renderMode,
+  const std::string&               attrsFilter,
+  std::string*                     outP,
+  ResponseStream**                 streamPP,
+  std::string*                     err
+);
+
 /* ****************************************************************************
 *
 * pruneContextElements -
@@ -452,6 +478,6 @@ extern void cprLookupByAttribute(EntityId&                          en,
 *
 * qStringFilters -
 */
-extern bool qStringFilters(const std::string& in, std::vector<BSONObj> &filters, ContextElementResponse* cerP = NULL);
+extern bool qStringFilters(const std::string& in, std::vector<BSONObj> &filters);
 
 #endif
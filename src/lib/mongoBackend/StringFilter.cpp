@@ -0,0 +1,558 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Ken Zangelin
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/globals.h"
+#include "common/string.h"
+#include "common/wsStrip.h"
+#include "orionTypes/OrionValueType.h"
+#include "mongoBackend/StringFilter.h"
+
+
+
+/* ****************************************************************************
+*
+* StringFilterItem::StringFilterItem -
+*/
+StringFilterItem::StringFilterItem():
+  seconds(-1),
+  rightIsNumber(false),
+  rightNumber(0),
+  rangeIsNumber(false),
+  rangeFromNumber(0),
+  rangeToNumber(0)
+{
+}
+
+
+
+/* ****************************************************************************
+*
+* StringFilterItem::compile - resolve the numeric values of the right-hand side
+*
+* Ranges can only be used on numbers and dates (both limits of the same kind). The
+* values of a list and the single value are numbers if they are dates or if they
+* parse as a float, strings otherwise.
+*/
+void StringFilterItem::compile(void)
+{
+  if ((right == "DATE") && (seconds != -1))
+  {
+    rightIsNumber = true;
+    rightNumber   = seconds;
+  }
+  else
+  {
+    rightIsNumber = str2double(right.c_str(), &rightNumber);
+  }
+
+  if (rangeFrom != "")
+  {
+    double fromSeconds;
+    double toSeconds;
+
+    if (((fromSeconds = parse8601Time(rangeFrom)) != -1) && ((toSeconds = parse8601Time(rangeTo)) != -1))
+    {
+      rangeIsNumber   = true;
+      rangeFromNumber = fromSeconds;
+      rangeToNumber   = toSeconds;
+    }
+    else
+    {
+      rangeIsNumber = str2double(rangeFrom.c_str(), &rangeFromNumber) && str2double(rangeTo.c_str(), &rangeToNumber);
+    }
+  }
+
+  valIsNumber.clear();
+  valNumber.clear();
+  for (unsigned int ix = 0; ix < valVector.size(); ++ix)
+  {
+    double d = 0;
+    bool   isNumber;
+
+    if ((d = parse8601Time(valVector[ix])) != -1)
+    {
+      isNumber = true;
+    }
+    else
+    {
+      isNumber = str2double(valVector[ix].c_str(), &d);
+    }
+
+    valIsNumber.push_back(isNumber);
+    valNumber.push_back(d);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* StringFilterItem::match -
+*
+* Returns true if cerP match the "q token", false otherwise.
+*/
+bool StringFilterItem::match(ContextElementResponse* cerP) const
+{
+  /* First, look for unary operators */
+  if ((opr == OPR_EXIST) || (opr == OPR_NOT_EXIST))
+  {
+    bool exist = (cerP->contextElement.getAttribute(right) != NULL);
+
+    return (opr == OPR_EXIST)? exist : !exist;
+  }
+
+  /* For binary operators, the left side is the name of the attribute to check or the dateCreated/dateModified special keywords */
+  orion::ValueType    valueType;
+  double              numberValue;
+  const std::string*  stringValueP = NULL;
+
+  if (left == DATE_CREATED)
+  {
+    valueType   = orion::ValueTypeNumber;
+    numberValue = cerP->contextElement.creDate;
+  }
+  else if (left == DATE_MODIFIED)
+  {
+    valueType   = orion::ValueTypeNumber;
+    numberValue = cerP->contextElement.modDate;
+  }
+  else
+  {
+    ContextAttribute* caP = cerP->contextElement.getAttribute(left);
+
+    /* If the attribute does't exist, no need to go further: filter fails */
+    if (caP == NULL)
+    {
+      return false;
+    }
+
+    valueType    = caP->valueType;
+    numberValue  = caP->numberValue;
+    stringValueP = &caP->stringValue;
+  }
+
+  bool isNumber = (valueType == orion::ValueTypeNumber);
+  bool isString = (valueType == orion::ValueTypeString) && (stringValueP != NULL);
+
+  if ((opr == "==") || (opr == "!="))
+  {
+    bool equal = false;
+
+    if (rangeFrom != "")
+    {
+      if (rangeIsNumber == false)
+      {
+        return false;
+      }
+
+      bool inRange = isNumber && (numberValue >= rangeFromNumber) && (numberValue <= rangeToNumber);
+      bool inverse = isNumber && ((numberValue < rangeFromNumber) || (numberValue > rangeToNumber));
+
+      return (opr == "==")? inRange : inverse;
+    }
+    else if (valVector.size() > 0)
+    {
+      // '==' if the value matches at least one of the elements in the vector (OR), '!=' if it matches none (AND)
+      for (unsigned int ix = 0; ix < valVector.size(); ++ix)
+      {
+        if (valIsNumber[ix])
+        {
+          equal = isNumber && (numberValue == valNumber[ix]);
+        }
+        else
+        {
+          equal = isString && (*stringValueP == valVector[ix]);
+        }
+
+        if (equal)
+        {
+          break;
+        }
+      }
+    }
+    else if (rightIsNumber)
+    {
+      equal = isNumber && (numberValue == rightNumber);
+    }
+    else
+    {
+      equal = isString && (*stringValueP == right);
+    }
+
+    return (opr == "==")? equal : !equal;
+  }
+
+  if (rightIsNumber == false)
+  {
+    return false;
+  }
+
+  if (opr == ">")
+  {
+    return isNumber && (numberValue > rightNumber);
+  }
+  else if (opr == "<")
+  {
+    return isNumber && (numberValue < rightNumber);
+  }
+  else if (opr == ">=")
+  {
+    return isNumber && (numberValue >= rightNumber);
+  }
+  else if (opr == "<=")
+  {
+    return isNumber && (numberValue <= rightNumber);
+  }
+
+  LM_E(("Runtime Error (unknown query operator: %s)", opr.c_str()));
+  return false;
+}
+
+
+
+/* ****************************************************************************
+*
+* StringFilter::StringFilter -
+*/
+StringFilter::StringFilter(): valid(false)
+{
+}
+
+
+
+/* ****************************************************************************
+*
+* StringFilter::parse -
+*
+* Splits 'in' into its "q tokens", returning false if 'in' isn't a valid q string.
+*/
+bool StringFilter::parse(const std::string& in)
+{
+  q     = in;
+  valid = false;
+  filters.clear();
+
+  //
+  // Initial Sanity check (of the entire string)
+  // - Not empty
+  // - Not just a single ';'
+  // - Not two ';' in a row
+  //
+  if ((in == "")  ||
+      (in == ";") ||
+      (strstr(in.c_str(), ";;") != NULL))
+  {
+    return false;
+  }
+
+  char* str         = strdup(in.c_str());
+  char* toFree      = str;
+  char* s;
+  char* saver;
+  bool  rightHandSideMandatory = true;
+  bool  leftHandSideMandatory  = true;
+
+  while ((s = strtok_r(str, ";", &saver)) != NULL)
+  {
+    char*               left;
+    char*               op;
+    char*               right     = NULL;
+    char*               rangeFrom = (char*) "";
+    char*               rangeTo   = (char*) "";
+    std::vector<char*>  valVector;
+
+    s = wsStrip(s);
+
+    //
+    // Rudimentary sanity checks (of *this* part of 'q')
+    //
+    // 1. If the 'q-part' is empty, error
+    // 2. If a range is present, the op MUST be either '==' OR '!='
+    //
+    if (*s == 0)
+    {
+      free(toFree);
+      return false;
+    }
+    else if (strstr(s, "..") != NULL)
+    {
+      if ((strstr(s, "==") == NULL) && (strstr(s, "!=") == NULL))
+      {
+        free(toFree);
+        return false;
+      }
+    }
+
+    left = s;
+    if ((op = (char*) strstr(s, "==")) != NULL)
+    {
+      *op = 0;
+
+      right = &op[2];
+      op    = (char*) "==";
+    }
+    else if ((op = (char*) strstr(s, "!=")) != NULL)
+    {
+      *op = 0;
+
+      right = &op[2];
+      op    = (char*) "!=";
+    }
+    else if ((op = (char*) strstr(s, ">=")) != NULL)
+    {
+      *op = 0;
+
+      right = &op[2];
+      op    = (char*) ">=";
+    }
+    else if ((op = (char*) strstr(s, "<=")) != NULL)
+    {
+      *op = 0;
+
+      right = &op[2];
+      op    = (char*) "<=";
+    }
+    else if ((op = (char*) strstr(s, "<")) != NULL)
+    {
+      *op = 0;
+
+      right = &op[1];
+      op    = (char*) "<";
+    }
+    else if ((op = (char*) strstr(s, ">")) != NULL)
+    {
+      *op = 0;
+
+      right = &op[1];
+      op    = (char*) ">";
+    }
+    else if (s[0] == '!')
+    {
+      left  = (char*) "";
+      op    = (char*) OPR_NOT_EXIST;
+      right = wsStrip(&s[1]);
+      leftHandSideMandatory = false;
+    }
+    else
+    {
+      left  = (char*) "";
+      op    = (char*) OPR_EXIST;
+      right = wsStrip(s);
+      leftHandSideMandatory = false;
+    }
+
+    left  = wsStrip(left);
+    right = wsStrip(right);
+
+    //
+    // Sanity check for left-hand and right-hand non-empty
+    //
+    if ((rightHandSideMandatory == true) && (*right == 0))
+    {
+      free(toFree);
+      return false;
+    }
+
+    if ((leftHandSideMandatory == true) && (*left == 0))
+    {
+      free(toFree);
+      return false;
+    }
+
+    std::string opr = op;
+
+    if ((opr == "==") || (opr == "!="))
+    {
+      char* del;
+
+      //
+      // 1.  range?   A..B
+      // 2.  list?    A,B,C
+      // 2.1 if list, check single quotes
+      //
+
+      if ((del = strstr(right, "..")) != NULL)
+      {
+        *del = 0;
+        rangeFrom = right;
+        rangeTo   = &del[2];
+
+        right     = (char*) "";
+        rangeFrom = wsStrip(rangeFrom);
+        rangeTo   = wsStrip(rangeTo);
+      }
+      else if ((del = strstr(right, ",")) != NULL)
+      {
+        char* start         = right;
+        char* cP            = right;
+        bool  insideQuotes  = false;
+        bool  done          = false;
+
+        while (done == false)
+        {
+          if (*cP == '\'')
+          {
+            insideQuotes = (insideQuotes == true)? false : true;
+          }
+          else if ((*cP == ',') || (*cP == 0))
+          {
+            // 1. If end-of-string reached, then this is the last loop
+            if (*cP == 0)
+            {
+              done = true;
+            }
+
+
+            if (!insideQuotes)
+            {
+              //
+              // If we are inside single-quotes, then do nothing, just advance the char pointer (++cP)
+              // If not inside queotes, we are on a comma, so a new value is to be pushed onto the value vector.
+              //
+
+              // 2. Remove beginning quote, if there is one
+              if (*start == '\'')
+              {
+                *start = 0;
+                ++start;
+              }
+
+              // 3. Null-out the comma
+              *cP = 0;
+
+              // 4. Remove trailing quote, if there
+              if (cP[-1] == '\'')
+              {
+                cP[-1] = 0;
+              }
+
+              // 5. Push the value onto the vector of values
+              valVector.push_back(wsStrip(start));
+
+              // 6. Make point start to the beginning of the next value
+              start = &cP[1];
+            }
+          }
+
+          ++cP;
+        }
+
+        right = (char*) "";
+      }
+    }
+
+    str = NULL;  // So that strtok_r continues eating the initial string
+
+    StringFilterItem item;
+
+    item.left      = left;
+    item.opr       = opr;
+    item.rangeFrom = rangeFrom;
+    item.rangeTo   = rangeTo;
+
+    for (unsigned int ix = 0; ix < valVector.size(); ++ix)
+    {
+      item.valVector.push_back(valVector[ix]);
+    }
+
+    //
+    // Is the right-hand-side a DATE?
+    // If so, convert it to unix seconds since epoch
+    //
+    if ((item.seconds = parse8601Time(right)) != -1)
+    {
+      item.right = "DATE";  // value of the date is passed in 'seconds'
+    }
+    else
+    {
+      item.right = right;
+    }
+
+    item.compile();
+    filters.push_back(item);
+  }
+
+  free(toFree);
+
+  valid = true;
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* StringFilter::match -
+*
+* Returns true if cerP match all the "q tokens" of the filter, false otherwise.
+* An invalid filter matches no entity.
+*/
+bool StringFilter::match(ContextElementResponse* cerP) const
+{
+  if (valid == false)
+  {
+    return false;
+  }
+
+  for (unsigned int ix = 0; ix < filters.size(); ++ix)
+  {
+    if (filters[ix].match(cerP) == false)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* stringFilterCompile -
+*/
+StringFilterP stringFilterCompile(const std::string& q)
+{
+  if (q == "")
+  {
+    return StringFilterP();
+  }
+
+  StringFilterP sfP(new StringFilter());
+
+  if (sfP->parse(q) == false)
+  {
+    LM_T(LmtSubCache, ("invalid q '%s', the filter will not match any entity", q.c_str()));
+  }
+
+  return sfP;
+}
@@ -0,0 +1,123 @@
+#ifndef SRC_LIB_MONGOBACKEND_STRINGFILTER_H_
+#define SRC_LIB_MONGOBACKEND_STRINGFILTER_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Ken Zangelin
+*/
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "ngsi/ContextElementResponse.h"
+
+
+
+/* ****************************************************************************
+*
+* Unary operators of a q token
+*/
+#define OPR_EXIST     "EXISTS"
+#define OPR_NOT_EXIST "NOT EXIST"
+
+
+
+/* ****************************************************************************
+*
+* StringFilterItem - one "q token", i.e. one of the ';'-separated parts of 'q'
+*
+* The right-hand side enters in 3 different ways:
+*   - right                normal case ("DATE" if a date, its value is then in 'seconds')
+*   - valVector            as a vector of values, in the case of 'X==a,b,c'
+*   - rangeFrom/rangeTo    as two values when '..' is used to denote a range
+*
+* For unary operators (OPR_EXIST and OPR_NOT_EXIST), 'left' is empty and the name
+* of the attribute is in 'right'.
+*
+* The numeric value of the right-hand side (a number or a date) is resolved when the
+* token is parsed, so that matching an entity needs no string conversions.
+*/
+class StringFilterItem
+{
+ public:
+  std::string               left;
+  std::string               opr;
+  std::string               right;
+  std::string               rangeFrom;
+  std::string               rangeTo;
+  std::vector<std::string>  valVector;
+  int64_t                   seconds;
+
+  bool                      rightIsNumber;
+  double                    rightNumber;
+  bool                      rangeIsNumber;
+  double                    rangeFromNumber;
+  double                    rangeToNumber;
+  std::vector<bool>         valIsNumber;
+  std::vector<double>       valNumber;
+
+  StringFilterItem();
+
+  void  compile(void);
+  bool  match(ContextElementResponse* cerP) const;
+};
+
+
+
+/* ****************************************************************************
+*
+* StringFilter - a 'q' string, parsed into its tokens
+*
+* A StringFilter is parsed once and then either translated into BSON filters (see
+* qStringFilters in MongoGlobal.cpp) or evaluated in memory on entities, any number
+* of times (the q expression of subscriptions, evaluated on every update).
+*/
+class StringFilter
+{
+ public:
+  std::string                    q;
+  std::vector<StringFilterItem>  filters;
+  bool                           valid;
+
+  StringFilter();
+
+  bool  parse(const std::string& in);
+  bool  match(ContextElementResponse* cerP) const;
+};
+
+typedef boost::shared_ptr<StringFilter> StringFilterP;
+
+
+
+/* ****************************************************************************
+*
+* stringFilterCompile - parse a q string, for it to be matched in memory
+*
+* Returns an empty pointer if 'q' is empty (no filter at all). If 'q' is not valid, the
+* returned filter doesn't match any entity.
+*/
+extern StringFilterP stringFilterCompile(const std::string& q);
+
+#endif  // SRC_LIB_MONGOBACKEND_STRINGFILTER_H_
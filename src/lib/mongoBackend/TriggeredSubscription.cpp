@@ -98,13 +98,26 @@ TriggeredSubscription::~TriggeredSubscription()
 * to keep expressions (an artifact for NGSI10) out of the constructor, in its independent fill
 * method
 *
+* If the already parsed q and geo filter (e.g. the ones of a cached subscription) are not
+* provided, they are parsed here.
+*
 */
-void TriggeredSubscription::fillExpression (const std::string& q, const std::string& georel, const std::string& geometry, const std::string& coords)
+void TriggeredSubscription::fillExpression
+(
+  const std::string&    q,
+  const std::string&    georel,
+  const std::string&    geometry,
+  const std::string&    coords,
+  const StringFilterP&  stringFilterP,
+  const GeoFilterP&     geoFilterP
+)
 {
-  expression.q        = q;
-  expression.georel   = georel;
-  expression.geometry = geometry;
-  expression.coords   = coords;
+  expression.q             = q;
+  expression.georel        = georel;
+  expression.geometry      = geometry;
+  expression.coords        = coords;
+  expression.stringFilterP = (stringFilterP.get() != NULL)? stringFilterP : stringFilterCompile(q);
+  expression.geoFilterP    = (geoFilterP.get()    != NULL)? geoFilterP    : geoFilterCompile(geometry, coords, georel);
 }
 
 
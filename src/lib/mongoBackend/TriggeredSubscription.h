@@ -29,6 +29,8 @@
 #include <string>
 #include "common/Format.h"
 #include "ngsi/AttributeList.h"
+#include "mongoBackend/StringFilter.h"
+#include "mongoBackend/GeoFilter.h"
 
 
 
@@ -62,6 +64,8 @@ class TriggeredSubscription
     std::string               geometry;
     std::string               coords;
     std::string               georel;
+    StringFilterP             stringFilterP;  // q, parsed (empty if no q)
+    GeoFilterP                geoFilterP;     // geometry, coords and georel, parsed (empty if no geometry)
    }                        expression;      // Only used by NGSIv2 subscription
 
   TriggeredSubscription(long long           _throttling,
@@ -78,7 +82,12 @@ class TriggeredSubscription
 
   ~TriggeredSubscription();
 
-  void fillExpression(const std::string& q, const std::string& georel, const std::string& geometry, const std::string& coords);
+  void fillExpression(const std::string&    q,
+                      const std::string&    georel,
+                      const std::string&    geometry,
+                      const std::string&    coords,
+                      const StringFilterP&  stringFilterP = StringFilterP(),
+                      const GeoFilterP&     geoFilterP    = GeoFilterP());
 
   std::string toString(const std::string& delimiter);
 };
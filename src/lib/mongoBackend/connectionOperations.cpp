@@ -54,6 +54,28 @@ bool collectionQuery
   std::auto_ptr<DBClientCursor>*  cursor,
   std::string*                    err
 )
+{
+  return collectionQuery(connection, col, q, BSONObj(), cursor, err);
+}
+
+
+
+/* ****************************************************************************
+*
+* collectionQuery -
+*
+* Same as the collectionQuery above, but only the fields in 'fields' (mongo projection)
+* are returned in the documents of the cursor. An empty 'fields' returns all fields.
+*/
+bool collectionQuery
+(
+  DBClientBase*                   connection,
+  const std::string&              col,
+  const BSONObj&                  q,
+  const BSONObj&                  fields,
+  std::auto_ptr<DBClientCursor>*  cursor,
+  std::string*                    err
+)
 {
   if (connection == NULL)
   {
@@ -66,7 +88,7 @@ bool collectionQuery
 
   try
   {
-    *cursor = connection->query(col.c_str(), q);
+    *cursor = connection->query(col.c_str(), q, 0, 0, fields.isEmpty()? NULL : &fields);
 
     // We have observed that in some cases of DB errors (e.g. the database daemon is down) instead of
     // raising an exception, the query() method sets the cursor to NULL. In this case, we raise the
@@ -431,6 +453,265 @@ bool collectionUpdate
 
 
 
+/* ****************************************************************************
+*
+* bulkWriteResult - check the result of a bulk write command
+*
+* Fills *writtenP (one item per write of the command): all the writes are flagged as
+* failed if the command failed as a whole, otherwise just those in 'writeErrors' (by
+* their 'index'), as the command is unordered and the rest of the writes are done anyway.
+*
+* Returns true if all the writes were done.
+*/
+static bool bulkWriteResult(const BSONObj& result, unsigned int writes, std::vector<bool>* writtenP)
+{
+  if (result.getField("ok").numberInt() != 1)
+  {
+    writtenP->assign(writes, false);
+    return false;
+  }
+
+  writtenP->assign(writes, true);
+
+  if (!result.hasField("writeErrors"))
+  {
+    return true;
+  }
+
+  std::vector<BSONElement> writeErrors = result.getField("writeErrors").Array();
+
+  for (unsigned int ix = 0; ix < writeErrors.size(); ++ix)
+  {
+    BSONObj       writeError = writeErrors[ix].embeddedObject();
+    unsigned int  index      = writeError.getIntField("index");
+
+    if (index < writes)
+    {
+      (*writtenP)[index] = false;
+    }
+    else
+    {
+      // Unknown write: better not to rely on any of them
+      LM_E(("Runtime Error (bad index in writeErrors of bulk write: %s)", writeError.toString().c_str()));
+      writtenP->assign(writes, false);
+      return false;
+    }
+  }
+
+  return false;
+}
+
+
+
+/* ****************************************************************************
+*
+* collectionBulkUpdate -
+*
+* Sends all the updates (queries[ix], docs[ix]) to the database in a single 'update'
+* write command (unordered), i.e. in a single round-trip, instead of one update() per
+* document.
+*
+* 'col' is the full namespace (database.collection), as for the rest of functions in this module.
+*
+* The writes done are flagged in *writtenP (see bulkWriteResult). If any of them failed,
+* false is returned and *err describes the errors.
+*/
+bool collectionBulkUpdate
+(
+  const std::string&           col,
+  const std::vector<BSONObj>&  queries,
+  const std::vector<BSONObj>&  docs,
+  bool                         upsert,
+  std::vector<bool>*           writtenP,
+  std::string*                 err
+)
+{
+  writtenP->assign(queries.size(), false);
+
+  if (queries.size() == 0)
+  {
+    return true;
+  }
+
+  std::string::size_type  dotPos = col.find('.');
+  std::string             db     = col.substr(0, dotPos);
+  std::string             coll   = col.substr(dotPos + 1);
+  BSONArrayBuilder        updates;
+  BSONObj                 result;
+
+  for (unsigned int ix = 0; ix < queries.size(); ++ix)
+  {
+    updates.append(BSON("q" << queries[ix] << "u" << docs[ix] << "upsert" << upsert << "multi" << false));
+  }
+
+  BSONObj command = BSON("update" << coll << "updates" << updates.arr() << "ordered" << false);
+
+  TIME_STAT_MONGO_WRITE_WAIT_START();
+  DBClientBase* connection = getMongoConnection();
+
+  if (connection == NULL)
+  {
+    TIME_STAT_MONGO_WRITE_WAIT_STOP();
+
+    LM_E(("Fatal Error (null DB connection)"));
+    *err = "null DB connection";
+    return false;
+  }
+
+  LM_T(LmtMongo, ("bulk update() in '%s' collection: %d updates, upsert=%s", col.c_str(), queries.size(), FT(upsert)));
+
+  try
+  {
+    connection->runCommand(db.c_str(), command, result);
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_WRITE_WAIT_STOP();
+  }
+  catch (const std::exception& e)
+  {
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_WRITE_WAIT_STOP();
+
+    std::string msg = std::string("collection: ") + col.c_str() +
+      " - bulk update(): " + command.toString() +
+      " - exception: " + e.what();
+    *err = "Database Error (" + msg + ")";
+    alarmMgr.dbError(msg);
+    return false;
+  }
+  catch (...)
+  {
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_WRITE_WAIT_STOP();
+
+    std::string msg = std::string("collection: ") + col.c_str() +
+      " - bulk update(): " + command.toString() +
+      " - exception: generic";
+    *err = "Database Error (" + msg + ")";
+    alarmMgr.dbError(msg);
+    return false;
+  }
+
+  if (!bulkWriteResult(result, queries.size(), writtenP))
+  {
+    std::string msg = std::string("collection: ") + col.c_str() +
+      " - bulk update(): " + command.toString() +
+      " - result: " + result.toString();
+    *err = "Database Error (" + msg + ")";
+    alarmMgr.dbError(msg);
+    return false;
+  }
+  alarmMgr.dbErrorReset();
+
+  LM_I(("Database Operation Successful (bulk update: %d updates)", queries.size()));
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* collectionBulkInsert -
+*
+* Sends all the documents to the database in a single 'insert' write command (unordered),
+* i.e. in a single round-trip, instead of one insert() per document.
+*
+* 'col' is the full namespace (database.collection), as for the rest of functions in this module.
+*
+* The writes done are flagged in *writtenP (see bulkWriteResult). If any of them failed,
+* false is returned and *err describes the errors.
+*/
+bool collectionBulkInsert
+(
+  const std::string&           col,
+  const std::vector<BSONObj>&  docs,
+  std::vector<bool>*           writtenP,
+  std::string*                 err
+)
+{
+  writtenP->assign(docs.size(), false);
+
+  if (docs.size() == 0)
+  {
+    return true;
+  }
+
+  std::string::size_type  dotPos = col.find('.');
+  std::string             db     = col.substr(0, dotPos);
+  std::string             coll   = col.substr(dotPos + 1);
+  BSONArrayBuilder        documents;
+  BSONObj                 result;
+
+  for (unsigned int ix = 0; ix < docs.size(); ++ix)
+  {
+    documents.append(docs[ix]);
+  }
+
+  BSONObj command = BSON("insert" << coll << "documents" << documents.arr() << "ordered" << false);
+
+  TIME_STAT_MONGO_WRITE_WAIT_START();
+  DBClientBase* connection = getMongoConnection();
+
+  if (connection == NULL)
+  {
+    TIME_STAT_MONGO_WRITE_WAIT_STOP();
+
+    LM_E(("Fatal Error (null DB connection)"));
+    *err = "null DB connection";
+    return false;
+  }
+
+  LM_T(LmtMongo, ("bulk insert() in '%s' collection: %d documents", col.c_str(), docs.size()));
+
+  try
+  {
+    connection->runCommand(db.c_str(), command, result);
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_WRITE_WAIT_STOP();
+  }
+  catch (const std::exception& e)
+  {
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_WRITE_WAIT_STOP();
+
+    std::string msg = std::string("collection: ") + col.c_str() +
+      " - bulk insert(): " + command.toString() +
+      " - exception: " + e.what();
+    *err = "Database Error (" + msg + ")";
+    alarmMgr.dbError(msg);
+    return false;
+  }
+  catch (...)
+  {
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_WRITE_WAIT_STOP();
+
+    std::string msg = std::string("collection: ") + col.c_str() +
+      " - bulk insert(): " + command.toString() +
+      " - exception: generic";
+    *err = "Database Error (" + msg + ")";
+    alarmMgr.dbError(msg);
+    return false;
+  }
+
+  if (!bulkWriteResult(result, docs.size(), writtenP))
+  {
+    std::string msg = std::string("collection: ") + col.c_str() +
+      " - bulk insert(): " + command.toString() +
+      " - result: " + result.toString();
+    *err = "Database Error (" + msg + ")";
+    alarmMgr.dbError(msg);
+    return false;
+  }
+  alarmMgr.dbErrorReset();
+
+  LM_I(("Database Operation Successful (bulk insert: %d documents)", docs.size()));
+
+  return true;
+}
+
+
+
 /* ****************************************************************************
 *
 * collectionRemove -
@@ -45,6 +45,21 @@ extern bool collectionQuery
   std::string*                    err
 );
 
+/* ****************************************************************************
+*
+* collectionQuery -
+*
+*/
+extern bool collectionQuery
+(
+  DBClientBase*                   connection,
+  const std::string&              col,
+  const BSONObj&                  q,
+  const BSONObj&                  fields,
+  std::auto_ptr<DBClientCursor>*  cursor,
+  std::string*                    err
+);
+
 /* ****************************************************************************
 *
 * collectionRangedQuery -
@@ -114,6 +129,34 @@ extern bool collectionUpdate
   std::string*        err
 );
 
+/* ****************************************************************************
+*
+* collectionBulkInsert -
+*
+*/
+extern bool collectionBulkInsert
+(
+  const std::string&           col,
+  const std::vector<BSONObj>&  docs,
+  std::vector<bool>*           writtenP,
+  std::string*                 err
+);
+
+/* ****************************************************************************
+*
+* collectionBulkUpdate -
+*
+*/
+extern bool collectionBulkUpdate
+(
+  const std::string&           col,
+  const std::vector<BSONObj>&  queries,
+  const std::vector<BSONObj>&  docs,
+  bool                         upsert,
+  std::vector<bool>*           writtenP,
+  std::string*                 err
+);
+
 /* ****************************************************************************
 *
 * collectionRemove -
@@ -91,6 +91,7 @@
 #define CSUB_COUNT              "count"
 #define CSUB_FORMAT             "format"
 #define CSUB_SERVICE_PATH       "servicePath"
+#define CSUB_MODIFICATION_DATE  "modDate"
 
 #define CASUB_EXPIRATION        "expiration"
 #define CASUB_REFERENCE         "reference"
@@ -0,0 +1,672 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/globals.h"
+#include "common/string.h"
+#include "common/limits.h"
+#include "common/sem.h"
+#include "common/statistics.h"
+#include "ngsi/Metadata.h"
+#include "mongoBackend/dbConstants.h"
+#include "mongoBackend/dbFieldEncoding.h"
+#include "mongoBackend/safeMongo.h"
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/connectionOperations.h"
+#include "mongoBackend/jsonResponses.h"
+
+using namespace mongo;
+
+
+
+/* ****************************************************************************
+*
+* AttributeRef - an attribute of the entity document, as found in the database
+*
+* For the "virtual" attributes dateCreated and dateModified, 'isDate' is set and
+* the value is in 'date'.
+*/
+typedef struct AttributeRef
+{
+  std::string  name;
+  std::string  mdId;
+  BSONObj      attr;
+  bool         isDate;
+  long long    date;
+} AttributeRef;
+
+
+
+/* ****************************************************************************
+*
+* elementLess - order of the attributes of an entity (that of their names in the database)
+*/
+static bool elementLess(const BSONElement& a, const BSONElement& b)
+{
+  return strcmp(a.fieldName(), b.fieldName()) < 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* stringAppend - 
+*/
+static inline void stringAppend(const std::string& s, std::string* outP)
+{
+  outP->push_back('"');
+  outP->append(s);
+  outP->push_back('"');
+}
+
+
+
+/* ****************************************************************************
+*
+* numberAppend - same format as toString(double)
+*/
+static inline void numberAppend(double d, std::string* outP)
+{
+  char buf[64];
+
+  snprintf(buf, sizeof(buf), "%g", d);
+  outP->append(buf);
+}
+
+
+
+/* ****************************************************************************
+*
+* compoundAppend - render a compound value, as CompoundValueNode::toJson does
+*
+* Only the BSON types that compoundObjectResponse/compoundVectorResponse accept are
+* rendered, the rest are skipped.
+*/
+static void compoundAppend(const BSONElement& be, std::string* outP)
+{
+  bool    isObject = (be.type() == Object);
+  BSONObj obj      = be.embeddedObject();
+  bool    first    = true;
+
+  outP->push_back(isObject? '{' : '[');
+
+  for (BSONObj::iterator i = obj.begin(); i.more();)
+  {
+    BSONElement e = i.next();
+
+    if ((e.type() != String) && (e.type() != Bool) && (e.type() != NumberDouble) && (e.type() != jstNULL) && (e.type() != Object) && (e.type() != Array))
+    {
+      LM_E(("Runtime Error (unknown BSON type: %d)", e.type()));
+      continue;
+    }
+
+    if (!first)
+    {
+      outP->push_back(',');
+    }
+    first = false;
+
+    if (isObject)
+    {
+      stringAppend(dbDotDecode(e.fieldName()), outP);
+      outP->push_back(':');
+    }
+
+    switch (e.type())
+    {
+    case String:
+      stringAppend(e.String(), outP);
+      break;
+
+    case Bool:
+      outP->append(e.Bool()? "true" : "false");
+      break;
+
+    case NumberDouble:
+      numberAppend(e.Number(), outP);
+      break;
+
+    case jstNULL:
+      outP->append("null");
+      break;
+
+    default:  // Object or Array
+      compoundAppend(e, outP);
+      break;
+    }
+  }
+
+  outP->push_back(isObject? '}' : ']');
+}
+
+
+
+/* ****************************************************************************
+*
+* valueAppend - render the value of an attribute, as ContextAttribute::toJson does
+*/
+static void valueAppend(const AttributeRef& ref, const std::string& type, std::string* outP)
+{
+  if (ref.isDate)
+  {
+    stringAppend(isodate2str(ref.date), outP);
+    return;
+  }
+
+  if (!ref.attr.hasField(ENT_ATTRS_VALUE))
+  {
+    outP->append("\"\"");
+    return;
+  }
+
+  BSONElement value = getField(ref.attr, ENT_ATTRS_VALUE);
+
+  switch (value.type())
+  {
+  case String:
+    stringAppend(value.String(), outP);
+    break;
+
+  case NumberDouble:
+  case NumberInt:
+    if (type == DATE_TYPE)
+    {
+      stringAppend(isodate2str((long long) value.Number()), outP);
+    }
+    else
+    {
+      numberAppend(value.Number(), outP);
+    }
+    break;
+
+  case Bool:
+    outP->append(value.Bool()? "true" : "false");
+    break;
+
+  case jstNULL:
+    outP->append("null");
+    break;
+
+  default:  // Object or Array
+    compoundAppend(value, outP);
+    break;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* metadataAppend - render the metadata of an attribute, as MetadataVector::toJson does
+*/
+static void metadataAppend(const AttributeRef& ref, std::string* outP)
+{
+  bool first = true;
+
+  if (ref.mdId != "")
+  {
+    outP->append("\"" NGSI_MD_ID "\":{\"type\":\"string\",\"value\":");
+    stringAppend(ref.mdId, outP);
+    outP->push_back('}');
+    first = false;
+  }
+
+  if (ref.isDate || !ref.attr.hasField(ENT_ATTRS_MD))
+  {
+    return;
+  }
+
+  std::vector<BSONElement> metadataV = getField(ref.attr, ENT_ATTRS_MD).Array();
+
+  for (unsigned int ix = 0; ix < metadataV.size(); ++ix)
+  {
+    BSONObj      md   = metadataV[ix].embeddedObject();
+    std::string  name = getStringField(md, ENT_ATTRS_MD_NAME);
+    std::string  type = md.hasField(ENT_ATTRS_MD_TYPE)? getStringField(md, ENT_ATTRS_MD_TYPE) : "";
+
+    if ((name == "value") || (name == "type"))
+    {
+      continue;
+    }
+
+    if (!first)
+    {
+      outP->push_back(',');
+    }
+    first = false;
+
+    stringAppend(name, outP);
+    outP->append(":{\"type\":");
+    stringAppend((type != "")? type : DEFAULT_TYPE, outP);
+    outP->append(",\"value\":");
+
+    BSONElement value = getField(md, ENT_ATTRS_MD_VALUE);
+
+    switch (value.type())
+    {
+    case String:
+      stringAppend(value.String(), outP);
+      break;
+
+    case NumberDouble:
+      numberAppend(value.Number(), outP);
+      break;
+
+    case Bool:
+      outP->append(value.Bool()? "true" : "false");
+      break;
+
+    case jstNULL:
+      outP->append("null");
+      break;
+
+    default:
+      LM_E(("Runtime Error (unknown metadata value value type in DB: %d)", value.type()));
+      outP->append("\"\"");
+      break;
+    }
+
+    outP->push_back('}');
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* attributeAppend - render an attribute, as ContextAttribute::toJson does
+*/
+static void attributeAppend(const AttributeRef& ref, const std::string& renderMode, bool isLastElement, std::string* outP)
+{
+  std::string type = ref.isDate? DATE_TYPE : getStringField(ref.attr, ENT_ATTRS_TYPE);
+
+  if ((renderMode == "values") || (renderMode == "keyValues"))
+  {
+    if (renderMode == "keyValues")
+    {
+      stringAppend(ref.name, outP);
+      outP->push_back(':');
+    }
+
+    valueAppend(ref, type, outP);
+  }
+  else
+  {
+    stringAppend(ref.name, outP);
+    outP->append(":{\"type\":");
+    stringAppend((type != "")? type : DEFAULT_TYPE, outP);
+    outP->append(",\"value\":");
+    valueAppend(ref, type, outP);
+    outP->append(",\"metadata\":{");
+    metadataAppend(ref, outP);
+    outP->append("}}");
+  }
+
+  if (!isLastElement)
+  {
+    outP->push_back(',');
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* attributeLookup - 
+*/
+static const AttributeRef* attributeLookup(const std::vector<AttributeRef>& refV, const std::string& name)
+{
+  for (unsigned int ix = 0; ix < refV.size(); ++ix)
+  {
+    if (refV[ix].name == name)
+    {
+      return &refV[ix];
+    }
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* attributesAppend - render the attributes of an entity, as ContextAttributeVector::toJson does
+*/
+static void attributesAppend(const std::vector<AttributeRef>& refV, const std::string& renderMode, const std::string& attrsFilter, std::string* outP)
+{
+  int validAttributes    = 0;
+  int renderedAttributes = 0;
+
+  if (attrsFilter == "")
+  {
+    for (unsigned int ix = 0; ix < refV.size(); ++ix)
+    {
+      if ((refV[ix].name != "id") && (refV[ix].name != "type"))
+      {
+        ++validAttributes;
+      }
+    }
+
+    for (unsigned int ix = 0; ix < refV.size(); ++ix)
+    {
+      if ((refV[ix].name == "id") || (refV[ix].name == "type"))
+      {
+        continue;
+      }
+
+      ++renderedAttributes;
+      attributeAppend(refV[ix], renderMode, renderedAttributes == validAttributes, outP);
+    }
+
+    return;
+  }
+
+  std::vector<std::string>          attrsV;
+  std::vector<const AttributeRef*>  filteredV;
+
+  stringSplit(attrsFilter, ',', attrsV);
+  for (unsigned int ix = 0; ix < attrsV.size(); ++ix)
+  {
+    const AttributeRef* refP = attributeLookup(refV, attrsV[ix]);
+
+    if (refP != NULL)
+    {
+      filteredV.push_back(refP);
+    }
+  }
+
+  for (unsigned int ix = 0; ix < filteredV.size(); ++ix)
+  {
+    attributeAppend(*filteredV[ix], renderMode, ix == filteredV.size() - 1, outP);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* entityJsonResponse - 
+*/
+void entityJsonResponse
+(
+  const BSONObj&      entityDoc,
+  const std::string&  renderMode,
+  const std::string&  attrsFilter,
+  bool                includeCreDate,
+  bool                includeModDate,
+  std::string*        outP
+)
+{
+  BSONObj                    id    = getField(entityDoc, "_id").embeddedObject();
+  BSONObj                    attrs = getField(entityDoc, ENT_ATTRS).embeddedObject();
+  std::vector<BSONElement>   attrV;
+  std::vector<AttributeRef>  refV;
+
+  for (BSONObj::iterator i = attrs.begin(); i.more();)
+  {
+    attrV.push_back(i.next());
+  }
+  std::sort(attrV.begin(), attrV.end(), elementLess);
+
+  for (unsigned int ix = 0; ix < attrV.size(); ++ix)
+  {
+    std::string   attrName = attrV[ix].fieldName();
+    AttributeRef  ref;
+
+    ref.name    = dbDotDecode(basePart(attrName));
+    ref.mdId    = idPart(attrName);
+    ref.attr    = attrV[ix].embeddedObject();
+    ref.isDate  = false;
+    ref.date    = 0;
+
+    if (ref.attr.hasField(ENT_ATTRS_VALUE))
+    {
+      BSONType type = getField(ref.attr, ENT_ATTRS_VALUE).type();
+
+      if ((type != String) && (type != NumberDouble) && (type != NumberInt) && (type != Bool) && (type != jstNULL) && (type != Object) && (type != Array))
+      {
+        LM_E(("Runtime Error (unknown attribute value type in DB: %d)", type));
+        continue;
+      }
+    }
+
+    refV.push_back(ref);
+  }
+
+  if (includeCreDate && entityDoc.hasField(ENT_CREATION_DATE))
+  {
+    AttributeRef ref;
+
+    ref.name    = DATE_CREATED;
+    ref.isDate  = true;
+    ref.date    = getIntOrLongFieldAsLong(entityDoc, ENT_CREATION_DATE);
+    refV.push_back(ref);
+  }
+
+  if (includeModDate && entityDoc.hasField(ENT_MODIFICATION_DATE))
+  {
+    AttributeRef ref;
+
+    ref.name    = DATE_MODIFIED;
+    ref.isDate  = true;
+    ref.date    = getIntOrLongFieldAsLong(entityDoc, ENT_MODIFICATION_DATE);
+    refV.push_back(ref);
+  }
+
+  if (renderMode == "values")
+  {
+    outP->push_back('[');
+    attributesAppend(refV, renderMode, attrsFilter, outP);
+    outP->push_back(']');
+
+    return;
+  }
+
+  std::string type = getStringField(id, ENT_ENTITY_TYPE);
+
+  outP->append("{\"id\":");
+  stringAppend(getStringField(id, ENT_ENTITY_ID), outP);
+  outP->append(",\"type\":");
+  stringAppend((type != "")? type : DEFAULT_TYPE, outP);
+
+  if (refV.size() != 0)
+  {
+    outP->push_back(',');
+    attributesAppend(refV, renderMode, attrsFilter, outP);
+  }
+
+  outP->push_back('}');
+}
+
+
+
+/* ****************************************************************************
+*
+* EntitiesJsonStream::EntitiesJsonStream -
+*
+* The content of *pendingP is taken over.
+*/
+EntitiesJsonStream::EntitiesJsonStream
+(
+  const std::string&  _collection,
+  const Query&        _query,
+  int                 _offset,
+  int                 _limit,
+  const std::string&  _renderMode,
+  const std::string&  _attrsFilter,
+  bool                _includeCreDate,
+  bool                _includeModDate,
+  std::string*        pendingP
+):
+  collection     (_collection),
+  query          (_query),
+  offset         (_offset),
+  limit          (_limit),
+  renderMode     (_renderMode),
+  attrsFilter    (_attrsFilter),
+  includeCreDate (_includeCreDate),
+  includeModDate (_includeModDate),
+  pendingIx      (0),
+  ended          (false)
+{
+  pending.swap(*pendingP);
+}
+
+
+
+/* ****************************************************************************
+*
+* EntitiesJsonStream::next - render the next batch of entities into 'pending'
+*
+* Closes the array after the last batch. Returns false on error.
+*/
+bool EntitiesJsonStream::next(void)
+{
+  int                       batch = ((limit != 0) && (limit < STREAM_BATCH_SIZE))? limit : STREAM_BATCH_SIZE;
+  int                       docs  = 0;
+  bool                      reqSemTaken;
+  std::string               err;
+  auto_ptr<DBClientCursor>  cursor;
+
+  pending.clear();
+  pendingIx = 0;
+
+  reqSemTake(__FUNCTION__, "streamed entities query", SemReadOp, &reqSemTaken);
+
+  TIME_STAT_MONGO_READ_WAIT_START();
+  DBClientBase* connection = getMongoConnection();
+  if (!collectionRangedQuery(connection, collection, query, batch, offset, &cursor, NULL, &err))
+  {
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_READ_WAIT_STOP();
+    reqSemGive(__FUNCTION__, "streamed entities query", reqSemTaken);
+    LM_E(("Runtime Error (%s, streamed response truncated)", err.c_str()));
+    return false;
+  }
+  TIME_STAT_MONGO_READ_WAIT_STOP();
+
+  while (moreSafe(cursor))
+  {
+    BSONObj r;
+
+    try
+    {
+      r = cursor->nextSafe();
+    }
+    catch (const std::exception& e)
+    {
+      LM_E(("Runtime Error (exception in nextSafe(), streamed response truncated: %s)", e.what()));
+      docs = -1;
+      break;
+    }
+    catch (...)
+    {
+      LM_E(("Runtime Error (generic exception in nextSafe(), streamed response truncated)"));
+      docs = -1;
+      break;
+    }
+
+    LM_T(LmtMongo, ("retrieved document: '%s'", r.toString().c_str()));
+
+    pending.push_back(',');
+    entityJsonResponse(r, renderMode, attrsFilter, includeCreDate, includeModDate, &pending);
+    ++docs;
+  }
+
+  // The cursor must be destroyed before its connection is given back to the pool
+  cursor.reset();
+  releaseMongoConnection(connection);
+  reqSemGive(__FUNCTION__, "streamed entities query", reqSemTaken);
+
+  if (docs == -1)
+  {
+    return false;
+  }
+
+  offset += docs;
+  ended   = (docs < batch);
+
+  if (limit != 0)
+  {
+    limit -= docs;
+    ended  = ended || (limit == 0);
+  }
+
+  if (ended)
+  {
+    pending.push_back(']');
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* EntitiesJsonStream::read -
+*/
+int EntitiesJsonStream::read(char* buf, int max)
+{
+  int n = 0;
+
+  while (n < max)
+  {
+    if (pendingIx == pending.size())
+    {
+      if (ended)
+      {
+        break;
+      }
+
+      if (!next())
+      {
+        return (n != 0)? n : -1;
+      }
+    }
+
+    int chunk = pending.size() - pendingIx;
+
+    if (chunk > max - n)
+    {
+      chunk = max - n;
+    }
+
+    memcpy(&buf[n], &pending[pendingIx], chunk);
+    pendingIx += chunk;
+    n         += chunk;
+  }
+
+  return n;
+}
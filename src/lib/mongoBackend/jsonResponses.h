@@ -0,0 +1,104 @@
+#ifndef SRC_LIB_MONGOBACKEND_JSONRESPONSES_H_
+#define SRC_LIB_MONGOBACKEND_JSONRESPONSES_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+
+#include "mongo/client/dbclient.h"
+
+#include "rest/ResponseStream.h"
+
+
+
+/* ****************************************************************************
+*
+* entityJsonResponse - render an entity document of the database as NGSIv2 JSON
+*
+* The entity is appended to 'outP' exactly as Entity::render would render it after
+* building a ContextElementResponse from the document, but without creating any of
+* the intermediate objects.
+*
+* 'renderMode' is "normalized", "keyValues" or "values", and 'attrsFilter' the value of
+* the URI param 'attrs' (a comma-separated list of attribute names, or "").
+*/
+extern void entityJsonResponse
+(
+  const mongo::BSONObj&  entityDoc,
+  const std::string&     renderMode,
+  const std::string&     attrsFilter,
+  bool                   includeCreDate,
+  bool                   includeModDate,
+  std::string*           outP
+);
+
+
+
+/* ****************************************************************************
+*
+* EntitiesJsonStream - the rest of a JSON array of entities, rendered from the database on demand
+*
+* 'pending' is what has already been rendered (typically the beginning of the array). The
+* rest of the entities (those of 'query' from 'offset' on, 'limit' at most, 0 meaning no limit)
+* are read in batches of STREAM_BATCH_SIZE entities as the payload is read, and rendered (see
+* entityJsonResponse). Each batch is read in full, under the request semaphore, and the DB
+* connection is given back to the pool before the batch is sent, so a slow client doesn't
+* keep a connection (nor a cursor) busy.
+*
+* As with pagination, the batches are not a snapshot: entities created or removed between two
+* batches may shift the rest of the response.
+*/
+class EntitiesJsonStream : public ResponseStream
+{
+ public:
+  EntitiesJsonStream(const std::string&   _collection,
+                     const mongo::Query&  _query,
+                     int                  _offset,
+                     int                  _limit,
+                     const std::string&   _renderMode,
+                     const std::string&   _attrsFilter,
+                     bool                 _includeCreDate,
+                     bool                 _includeModDate,
+                     std::string*         pendingP);
+
+  int read(char* buf, int max);
+
+ private:
+  bool next(void);
+
+  std::string   collection;
+  mongo::Query  query;
+  int           offset;
+  int           limit;
+  std::string   renderMode;
+  std::string   attrsFilter;
+  bool          includeCreDate;
+  bool          includeModDate;
+  std::string   pending;
+  unsigned int  pendingIx;
+  bool          ended;
+};
+
+#endif  // SRC_LIB_MONGOBACKEND_JSONRESPONSES_H_
@@ -138,7 +138,7 @@ static void setNotification(Subscription* s, const BSONObj& r, const std::string
   //
   // Check values from subscription cache, update object from cache-values if necessary
   //
-  CachedSubscription* cSubP = subCacheItemLookup(tenant.c_str(), s->id.c_str());
+  CachedSubscriptionP cSubP = subCacheItemLookup(tenant.c_str(), s->id.c_str());
   if (cSubP)
   {
     if (cSubP->lastNotificationTime > s->notification.lastNotification)
@@ -22,7 +22,10 @@
 *
 * Author: Fermín Galán
 */
+#include <string>
+#include <vector>
 
+#include "common/globals.h"
 #include "common/sem.h"
 
 #include "mongoBackend/mongoNotifyContext.h"
@@ -43,10 +46,19 @@ HttpStatusCode mongoNotifyContext
   const std::vector<std::string>&  servicePathV
 )
 {
-    bool reqSemTaken;
+    bool                      reqSemTaken;
+    std::vector<std::string>  entityKeys;
 
     reqSemTake(__FUNCTION__, "ngsi10 notification", SemWriteOp, &reqSemTaken);
 
+    for (unsigned int ix = 0; ix < requestP->contextElementResponseVector.size(); ++ix)
+    {
+      EntityId* enP = &requestP->contextElementResponseVector[ix]->contextElement.entityId;
+
+      entityKeys.push_back(isTrue(enP->isPattern)? "" : enP->id);
+    }
+    entitySemTake(__FUNCTION__, "ngsi10 notification", tenant, entityKeys);
+
     /* We ignore "subscriptionId" and "originator" in the request, as we don't have anything interesting
      * to do with them */
 
@@ -463,3 +463,90 @@ HttpStatusCode mongoQueryContext
     reqSemGive(__FUNCTION__, "ngsi10 query request", reqSemTaken);
     return SccOk;
 }
+
+
+
+/* ****************************************************************************
+*
+* mongoQueryContextRender -
+*
+* Fast path of mongoQueryContext for NGSIv2 entity queries, rendering the entities found
+* directly from the database into *outP (see entitiesQueryRender).
+*
+* Returns false if the request has to be processed by mongoQueryContext, e.g. because
+* no local entity was found or some registration matches the query (context providers
+* may be involved).
+*
+* If a stream is returned in *streamPP (big responses), the rest of the entities are read
+* from the database as the response is sent, i.e. after the request semaphore is given.
+*/
+bool mongoQueryContextRender
+(
+  QueryContextRequest*                 requestP,
+  const std::string&                   tenant,
+  const std::vector<std::string>&      servicePathV,
+  std::map<std::string, std::string>&  uriParams,
+  std::map<std::string, bool>&         options,
+  long long*                           countP,
+  const std::string&                   renderMode,
+  const std::string&                   attrsFilter,
+  std::string*                         outP,
+  ResponseStream**                     streamPP
+)
+{
+  int          offset         = atoi(uriParams[URI_PARAM_PAGINATION_OFFSET].c_str());
+  int          limit          = atoi(uriParams[URI_PARAM_PAGINATION_LIMIT].c_str());
+  std::string  sortOrderList  = uriParams[URI_PARAM_SORTED];
+  std::string  err;
+  bool         reqSemTaken;
+  bool         ok;
+
+  LM_T(LmtMongo, ("QueryContext Request (render fast path)"));
+
+  if (requestP->attributeList.size() != 0)
+  {
+    return false;
+  }
+
+  reqSemTake(__FUNCTION__, "ngsi10 query request", SemReadOp, &reqSemTaken);
+
+  //
+  // Context providers are added by mongoQueryContext (entities and attributes not found locally, and
+  // the <null> attributes special case), so the fast path is only taken if no registration matches
+  // the query. A DB error at registrationsQuery() also sends the request to mongoQueryContext.
+  //
+  ContextRegistrationResponseVector crrV;
+
+  if (!registrationsQuery(requestP->entityIdVector, requestP->attributeList, &crrV, &err, tenant, servicePathV, 0, 0, false) ||
+      (crrV.size() > 0))
+  {
+    crrV.release();
+    reqSemGive(__FUNCTION__, "ngsi10 query request", reqSemTaken);
+    return false;
+  }
+  crrV.release();
+
+  ok = entitiesQueryRender(requestP->entityIdVector,
+                           requestP->restriction,
+                           tenant,
+                           servicePathV,
+                           offset,
+                           limit,
+                           countP,
+                           sortOrderList,
+                           options[DATE_CREATED],
+                           options[DATE_MODIFIED],
+                           renderMode,
+                           attrsFilter,
+                           outP,
+                           streamPP,
+                           &err);
+  reqSemGive(__FUNCTION__, "ngsi10 query request", reqSemTaken);
+
+  if (!ok)
+  {
+    outP->clear();
+  }
+
+  return ok;
+}
@@ -30,6 +30,7 @@
 
 #include "ngsi10/QueryContextRequest.h"
 #include "ngsi10/QueryContextResponse.h"
+#include "rest/ResponseStream.h"
 
 
 
@@ -49,4 +50,24 @@ extern HttpStatusCode mongoQueryContext
   const std::string&                    apiVersion = "v1"
 );
 
+
+
+/* ****************************************************************************
+*
+* mongoQueryContextRender -
+*/
+extern bool mongoQueryContextRender
+(
+  QueryContextRequest*                  requestP,
+  const std::string&                    tenant,
+  const std::vector<std::string>&       servicePathV,
+  std::map<std::string, std::string>&   uriParams,
+  std::map<std::string, bool>&          options,
+  long long*                            countP,
+  const std::string&                    renderMode,
+  const std::string&                    attrsFilter,
+  std::string*                          outP,
+  ResponseStream**                      streamPP = NULL
+);
+
 #endif
@@ -34,7 +34,9 @@
 #include "mongoBackend/MongoGlobal.h"
 #include "mongoBackend/connectionOperations.h"
 #include "mongoBackend/safeMongo.h"
+#include "mongoBackend/dbFieldEncoding.h"
 #include "mongoBackend/mongoQueryTypes.h"
+#include "cache/typeCatalog.h"
 
 
 /* ****************************************************************************
@@ -122,6 +124,281 @@ static long long countEntities(const std::string& tenant, const std::vector<std:
 }
 
 
+/* ****************************************************************************
+*
+* groupKeyField - a string field of the _id of an aggregation $group result ("" if null)
+*/
+static std::string groupKeyField(const BSONObj& key, const std::string& field)
+{
+  if (key.hasField(field) && (key.getField(field).type() == String))
+  {
+    return key.getStringField(field);
+  }
+
+  return "";
+}
+
+
+
+/* ****************************************************************************
+*
+* catalogAttributeType -
+*
+* The type of an attribute of an entity type, in a servicePath ("" for the entities without
+* servicePath). As in attributeType(), if different entities have different types for the
+* attribute, one of them is returned.
+*/
+static std::string catalogAttributeType
+(
+  const std::string&  tenant,
+  const std::string&  servicePath,
+  const std::string&  entityType,
+  const std::string&  attrName
+)
+{
+  std::string     attrPath = std::string(ENT_ATTRS) + "." + dbDotEncode(attrName);
+  BSONObjBuilder  query;
+  BSONObj         doc;
+  std::string     err;
+
+  if (entityType == "")
+  {
+    query.append(C_ID_TYPE, BSON("$exists" << false));
+  }
+  else
+  {
+    query.append(C_ID_TYPE, entityType);
+  }
+
+  if (servicePath == "")
+  {
+    query.appendNull(C_ID_SERVICEPATH);
+  }
+  else
+  {
+    query.append(C_ID_SERVICEPATH, servicePath);
+  }
+
+  query.append(attrPath, BSON("$exists" << true));
+
+  if (!collectionFindOne(getEntitiesCollectionName(tenant), query.obj(), &doc, &err) || doc.isEmpty())
+  {
+    return "";
+  }
+
+  BSONObj attrs = getObjectField(doc, ENT_ATTRS);
+
+  return getStringField(getObjectField(attrs, dbDotEncode(attrName)), ENT_ATTRS_TYPE);
+}
+
+
+
+/* ****************************************************************************
+*
+* typeCatalogRead -
+*
+* Two aggregations are used, one counting the entities by servicePath and type and the other
+* counting the attributes by servicePath, type and attribute name:
+*
+* db.runCommand({aggregate: "entities",
+*                pipeline: [ {$group: {_id: {servicePath: "$_id.servicePath", type: "$_id.type"}, count: {$sum: 1}} } ]
+*              })
+*
+* db.runCommand({aggregate: "entities",
+*                pipeline: [ {$project: {_id: 1, "attrNames": 1} },
+*                            {$unwind: "$attrNames"},
+*                            {$group: {_id: {servicePath: "$_id.servicePath", type: "$_id.type", attr: "$attrNames"}, count: {$sum: 1}} }
+*                          ]
+*              })
+*
+* The attribute types are taken from the previous catalog of the tenant, if any, so the database is
+* only queried for the types of new attributes.
+*/
+static bool typeCatalogRead(const std::string& tenant, const TypeCatalog& previous, TypeCatalog* catalogP)
+{
+  BSONObj      result;
+  std::string  err;
+  std::string  db = composeDatabaseName(tenant);
+
+  BSONObj typesCmd = BSON("aggregate" << COL_ENTITIES <<
+                          "pipeline"  << BSON_ARRAY(
+                                                    BSON("$group" << BSON("_id"   << BSON("servicePath" << CS_ID_SERVICEPATH << "type" << CS_ID_ENTITY) <<
+                                                                          "count" << BSON("$sum" << 1)))
+                                                   )
+                         );
+
+  if (!runCollectionCommand(db, typesCmd, &result, &err) || !result.hasField("result"))
+  {
+    LM_E(("Runtime Error (type catalog of tenant '%s' could not be loaded: %s)", tenant.c_str(), err.c_str()));
+    return false;
+  }
+
+  std::vector<BSONElement> typesArray = getField(result, "result").Array();
+
+  for (unsigned int ix = 0; ix < typesArray.size(); ++ix)
+  {
+    BSONObj      item        = typesArray[ix].embeddedObject();
+    BSONObj      key         = getObjectField(item, "_id");
+    std::string  servicePath = groupKeyField(key, "servicePath");
+    std::string  entityType  = groupKeyField(key, "type");
+
+    (*catalogP)[servicePath][entityType].count = getField(item, "count").numberLong();
+  }
+
+  BSONObj attrsCmd = BSON("aggregate" << COL_ENTITIES <<
+                          "pipeline"  << BSON_ARRAY(
+                                                    BSON("$project" << BSON("_id" << 1 << ENT_ATTRNAMES << 1)) <<
+                                                    BSON("$unwind" << S_ATTRNAMES) <<
+                                                    BSON("$group" << BSON("_id"   << BSON("servicePath" << CS_ID_SERVICEPATH << "type" << CS_ID_ENTITY << "attr" << S_ATTRNAMES) <<
+                                                                          "count" << BSON("$sum" << 1)))
+                                                   )
+                         );
+
+  if (!runCollectionCommand(db, attrsCmd, &result, &err) || !result.hasField("result"))
+  {
+    LM_E(("Runtime Error (type catalog of tenant '%s' could not be loaded: %s)", tenant.c_str(), err.c_str()));
+    return false;
+  }
+
+  std::vector<BSONElement>            attrsArray = getField(result, "result").Array();
+  std::map<std::string, std::string>  knownTypes;  // "servicePath\0type\0attr" -> attribute type
+
+  for (TypeCatalog::const_iterator spIt = previous.begin(); spIt != previous.end(); ++spIt)
+  {
+    for (std::map<std::string, TypeCatalogEntry>::const_iterator tIt = spIt->second.begin(); tIt != spIt->second.end(); ++tIt)
+    {
+      for (std::map<std::string, TypeCatalogAttr>::const_iterator aIt = tIt->second.attrs.begin(); aIt != tIt->second.attrs.end(); ++aIt)
+      {
+        knownTypes[spIt->first + '\0' + tIt->first + '\0' + aIt->first] = aIt->second.type;
+      }
+    }
+  }
+
+  for (unsigned int ix = 0; ix < attrsArray.size(); ++ix)
+  {
+    BSONObj      item        = attrsArray[ix].embeddedObject();
+    BSONObj      key         = getObjectField(item, "_id");
+    std::string  servicePath = groupKeyField(key, "servicePath");
+    std::string  entityType  = groupKeyField(key, "type");
+    std::string  attrName    = groupKeyField(key, "attr");
+    std::string  typeKey     = servicePath + '\0' + entityType + '\0' + attrName;
+
+    if (knownTypes.find(typeKey) == knownTypes.end())
+    {
+      knownTypes[typeKey] = catalogAttributeType(tenant, servicePath, entityType, attrName);
+    }
+
+    TypeCatalogAttr& attr = (*catalogP)[servicePath][entityType].attrs[attrName];
+
+    attr.count = getField(item, "count").numberLong();
+    attr.type  = knownTypes[typeKey];
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoTypeCatalogLoad -
+*
+* The entity writes done while the database is read are replayed on the catalog read
+* (see typeCatalogSet).
+*/
+bool mongoTypeCatalogLoad(const std::string& tenant)
+{
+  TypeCatalog         previous;
+  TypeCatalog         catalog;
+  unsigned long long  start;
+
+  typeCatalogGet(tenant, &previous);
+
+  start = typeCatalogLoadStart(tenant);
+
+  if (!typeCatalogRead(tenant, previous, &catalog))
+  {
+    typeCatalogLoadAbort(tenant);
+    return false;
+  }
+
+  typeCatalogSet(tenant, &catalog, start);
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* catalogTypes - the entity types from the catalog (loading it if needed), false if not available
+*/
+static bool catalogTypes
+(
+  const std::string&                         tenant,
+  const std::vector<std::string>&            servicePathV,
+  std::map<std::string, TypeCatalogEntry>*   typesP
+)
+{
+  if (!typeCatalogEnabled())
+  {
+    return false;
+  }
+
+  if (!typeCatalogLoaded(tenant) && !mongoTypeCatalogLoad(tenant))
+  {
+    return false;
+  }
+
+  return typeCatalogTypes(tenant, servicePathV, typesP);
+}
+
+
+
+/* ****************************************************************************
+*
+* paginationStatusFill - status code of a paginated type query
+*/
+static void paginationStatusFill
+(
+  StatusCode*         scP,
+  unsigned int        returned,
+  unsigned int        total,
+  unsigned int        offset,
+  bool                details,
+  const std::string&  what
+)
+{
+  char detailsMsg[256];
+
+  if (returned > 0)
+  {
+    if (details)
+    {
+      snprintf(detailsMsg, sizeof(detailsMsg), "Count: %d", (int) total);
+      scP->fill(SccOk, detailsMsg);
+    }
+    else
+    {
+      scP->fill(SccOk);
+    }
+  }
+  else
+  {
+    if (details)
+    {
+      snprintf(detailsMsg, sizeof(detailsMsg), "Number of %s: %u. Offset is %u", what.c_str(), total, offset);
+      scP->fill(SccContextElementNotFound, detailsMsg);
+    }
+    else
+    {
+      scP->fill(SccContextElementNotFound);
+    }
+  }
+}
+
+
+
 /* ****************************************************************************
 *
 * mongoEntityTypes -
@@ -145,6 +422,44 @@ HttpStatusCode mongoEntityTypes
 
   reqSemTake(__FUNCTION__, "query types request", SemReadOp, &reqSemTaken);
 
+  std::map<std::string, TypeCatalogEntry> types;
+
+  if (catalogTypes(tenant, servicePathV, &types))
+  {
+    unsigned int                                      ix = 0;
+    std::map<std::string, TypeCatalogEntry>::iterator it;
+
+    for (it = types.begin(); (it != types.end()) && (ix < offset + limit); ++it, ++ix)
+    {
+      if (ix < offset)
+      {
+        continue;
+      }
+
+      EntityType* entityType = new EntityType(it->first);
+
+      entityType->count = it->second.count;
+      for (std::map<std::string, TypeCatalogAttr>::iterator aIt = it->second.attrs.begin(); aIt != it->second.attrs.end(); ++aIt)
+      {
+        entityType->contextAttributeVector.push_back(new ContextAttribute(aIt->first, aIt->second.type, ""));
+      }
+
+      responseP->entityTypeVector.push_back(entityType);
+    }
+
+    if (types.size() == 0)
+    {
+      responseP->statusCode.fill(SccContextElementNotFound);
+    }
+    else
+    {
+      paginationStatusFill(&responseP->statusCode, responseP->entityTypeVector.size(), types.size(), offset, details, "types");
+    }
+
+    reqSemGive(__FUNCTION__, "query types request", reqSemTaken);
+    return SccOk;
+  }
+
   /* Compose query based on this aggregation command:  
    *
    * db.runCommand({aggregate: "entities",
@@ -267,31 +582,7 @@ HttpStatusCode mongoEntityTypes
     responseP->entityTypeVector.push_back(entityType);
   }
 
-  char detailsMsg[256];
-  if (responseP->entityTypeVector.size() > 0)
-  {
-    if (details)
-    {
-      snprintf(detailsMsg, sizeof(detailsMsg), "Count: %d", (int) resultsArray.size());
-      responseP->statusCode.fill(SccOk, detailsMsg);
-    }
-    else
-    {
-      responseP->statusCode.fill(SccOk);
-    }
-  }
-  else
-  {
-    if (details)
-    {      
-      snprintf(detailsMsg, sizeof(detailsMsg), "Number of types: %zu. Offset is %u", resultsArray.size(), offset);
-      responseP->statusCode.fill(SccContextElementNotFound, detailsMsg);
-    }
-    else
-    {
-      responseP->statusCode.fill(SccContextElementNotFound);
-    }
-  }
+  paginationStatusFill(&responseP->statusCode, responseP->entityTypeVector.size(), resultsArray.size(), offset, details, "types");
 
   reqSemGive(__FUNCTION__, "query types request", reqSemTaken);
 
@@ -327,6 +618,37 @@ HttpStatusCode mongoAttributesForEntityType
 
   reqSemTake(__FUNCTION__, "query types attributes request", SemReadOp, &reqSemTaken);
 
+  std::map<std::string, TypeCatalogEntry> types;
+
+  if (catalogTypes(tenant, servicePathV, &types))
+  {
+    TypeCatalogEntry&                                 entry = types[entityType];
+    unsigned int                                      ix    = 0;
+    std::map<std::string, TypeCatalogAttr>::iterator  it;
+
+    responseP->entityType.count = entry.count;
+
+    for (it = entry.attrs.begin(); (it != entry.attrs.end()) && (ix < offset + limit); ++it, ++ix)
+    {
+      if (ix >= offset)
+      {
+        responseP->entityType.contextAttributeVector.push_back(new ContextAttribute(it->first, it->second.type, ""));
+      }
+    }
+
+    if (entry.attrs.size() == 0)
+    {
+      responseP->statusCode.fill(SccContextElementNotFound);
+    }
+    else
+    {
+      paginationStatusFill(&responseP->statusCode, responseP->entityType.contextAttributeVector.size(), entry.attrs.size(), offset, details, "attributes");
+    }
+
+    reqSemGive(__FUNCTION__, "query types request", reqSemTaken);
+    return SccOk;
+  }
+
 
   /* Compose query based on this aggregation command:   
    *
@@ -405,31 +727,7 @@ HttpStatusCode mongoAttributesForEntityType
     responseP->entityType.contextAttributeVector.push_back(ca);
   }
 
-  char detailsMsg[256];
-  if (responseP->entityType.contextAttributeVector.size() > 0)
-  {
-    if (details)
-    {
-      snprintf(detailsMsg, sizeof(detailsMsg), "Count: %d", (int) resultsArray.size());
-      responseP->statusCode.fill(SccOk, detailsMsg);
-    }
-    else
-    {
-      responseP->statusCode.fill(SccOk);
-    }
-  }
-  else
-  {
-    if (details)
-    {
-      snprintf(detailsMsg, sizeof(detailsMsg), "Number of attributes: %zu. Offset is %u", resultsArray.size(), offset);
-      responseP->statusCode.fill(SccContextElementNotFound, detailsMsg);
-    }
-    else
-    {
-      responseP->statusCode.fill(SccContextElementNotFound);
-    }
-  }
+  paginationStatusFill(&responseP->statusCode, responseP->entityType.contextAttributeVector.size(), resultsArray.size(), offset, details, "attributes");
 
   reqSemGive(__FUNCTION__, "query types request", reqSemTaken);
 
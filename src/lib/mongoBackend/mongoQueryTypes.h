@@ -37,12 +37,13 @@
 
 
 /* Some string tokens used for aggregation commands */
-const std::string C_ID_ENTITY      = std::string("_id.") + "type";
-const std::string C_ID_SERVICEPATH = std::string("_id.") + "servicePath";
-const std::string CS_ID_ENTITY     = std::string("$_id.") + "type";
-const std::string C_ID_NAME        = std::string("_id.") + "name";
-const std::string C_ID_TYPE        = std::string("_id.") + "type";
-const std::string S_ATTRNAMES      = std::string("$") + ENT_ATTRNAMES;
+const std::string C_ID_ENTITY       = std::string("_id.") + "type";
+const std::string C_ID_SERVICEPATH  = std::string("_id.") + "servicePath";
+const std::string CS_ID_SERVICEPATH = std::string("$_id.") + "servicePath";
+const std::string CS_ID_ENTITY      = std::string("$_id.") + "type";
+const std::string C_ID_NAME         = std::string("_id.") + "name";
+const std::string C_ID_TYPE         = std::string("_id.") + "type";
+const std::string S_ATTRNAMES       = std::string("$") + ENT_ATTRNAMES;
 
 
 /* ****************************************************************************
@@ -70,4 +71,10 @@ extern HttpStatusCode mongoAttributesForEntityType
   std::map<std::string, std::string>&   uriParams
 );
 
+/* ****************************************************************************
+*
+* mongoTypeCatalogLoad - read the entity type catalog of a tenant from DB (see cache/typeCatalog.h)
+*/
+extern bool mongoTypeCatalogLoad(const std::string& tenant);
+
 #endif
@@ -84,6 +84,8 @@ HttpStatusCode mongoRegisterContext
     }
 
     /* It is not a new registration, so it should be an update */
+    entitySemTake(__FUNCTION__, "ngsi9 register request", tenant, std::vector<std::string>(1, requestP->registrationId.get()));
+
     BSONObj     reg;
     std::string err;
     OID         id;
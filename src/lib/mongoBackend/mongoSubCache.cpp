@@ -23,6 +23,8 @@
 * Author: Ken Zangelin
 */
 #include <string>
+#include <vector>
+#include <map>
 #include <regex.h>
 
 #include "mongo/client/dbclient.h"
@@ -48,7 +50,9 @@ using namespace mongo;
 
 /* ****************************************************************************
 *
-* mongoSubCacheItemInsert - 
+* mongoSubCacheItemCreate - 
+*
+* Creates a CachedSubscription from a subscription document, without inserting it in the cache.
 *
 * RETURN VALUES
 *   0:  all OK
@@ -58,10 +62,10 @@ using namespace mongo;
 *  -4:  The vector of notify-conditions is empty
 *
 *
-* Note that the 'count' of the inserted subscription is set to ZERO.
+* Note that the 'count' of the created subscription is set to ZERO.
 *
 */
-int mongoSubCacheItemInsert(const char* tenant, const BSONObj& sub)
+int mongoSubCacheItemCreate(const char* tenant, const BSONObj& sub, CachedSubscription** cSubPP)
 {
   //
   // 01. Check validity of subP parameter 
@@ -107,8 +111,20 @@ int mongoSubCacheItemInsert(const char* tenant, const BSONObj& sub)
   cSubP->throttling            = sub.hasField(CSUB_THROTTLING)?       getIntOrLongFieldAsLong(sub, CSUB_THROTTLING)       : -1;
   cSubP->expirationTime        = sub.hasField(CSUB_EXPIRATION)?       getIntOrLongFieldAsLong(sub, CSUB_EXPIRATION)       : 0;
   cSubP->lastNotificationTime  = sub.hasField(CSUB_LASTNOTIFICATION)? getIntOrLongFieldAsLong(sub, CSUB_LASTNOTIFICATION) : -1;
+  cSubP->modificationTime      = sub.hasField(CSUB_MODIFICATION_DATE)? getIntOrLongFieldAsLong(sub, CSUB_MODIFICATION_DATE) : 0;
   cSubP->count                 = 0;
-  cSubP->next                  = NULL;
+
+  if (sub.hasField(CSUB_EXPR))
+  {
+    BSONObj expression = sub.getObjectField(CSUB_EXPR);
+
+    cSubP->expression.q        = expression.hasField(CSUB_EXPR_Q)?      expression.getStringField(CSUB_EXPR_Q)      : "";
+    cSubP->expression.geometry = expression.hasField(CSUB_EXPR_GEOM)?   expression.getStringField(CSUB_EXPR_GEOM)   : "";
+    cSubP->expression.coords   = expression.hasField(CSUB_EXPR_COORDS)? expression.getStringField(CSUB_EXPR_COORDS) : "";
+    cSubP->expression.georel   = expression.hasField(CSUB_EXPR_GEOREL)? expression.getStringField(CSUB_EXPR_GEOREL) : "";
+    cSubP->stringFilterP       = stringFilterCompile(cSubP->expression.q);
+    cSubP->geoFilterP          = geoFilterCompile(cSubP->expression.geometry, cSubP->expression.coords, cSubP->expression.georel);
+  }
 
   LM_T(LmtSubCache, ("set lastNotificationTime to %lu for '%s' (from DB)", cSubP->lastNotificationTime, cSubP->subscriptionId));
 
@@ -191,13 +207,38 @@ int mongoSubCacheItemInsert(const char* tenant, const BSONObj& sub)
     return -4;
   }
 
-  subCacheItemInsert(cSubP);
+  *cSubPP = cSubP;
 
   return 0;
 }
 
 
 
+/* ****************************************************************************
+*
+* mongoSubCacheItemInsert - 
+*
+* RETURN VALUES
+*   0:  all OK
+*  <0:  see mongoSubCacheItemCreate
+*
+* Note that the 'count' of the inserted subscription is set to ZERO.
+*/
+int mongoSubCacheItemInsert(const char* tenant, const BSONObj& sub)
+{
+  CachedSubscription*  cSubP = NULL;
+  int                  r     = mongoSubCacheItemCreate(tenant, sub, &cSubP);
+
+  if (r == 0)
+  {
+    subCacheItemInsert(cSubP);
+  }
+
+  return r;
+}
+
+
+
 /* ****************************************************************************
 *
 * mongoSubCacheItemInsert - 
@@ -314,12 +355,14 @@ int mongoSubCacheItemInsert
   cSubP->throttling            = sub.hasField(CSUB_THROTTLING)?       getIntOrLongFieldAsLong(sub, CSUB_THROTTLING) : -1;
   cSubP->expirationTime        = expirationTime;
   cSubP->lastNotificationTime  = lastNotificationTime;
+  cSubP->modificationTime      = sub.hasField(CSUB_MODIFICATION_DATE)? getIntOrLongFieldAsLong(sub, CSUB_MODIFICATION_DATE) : 0;
   cSubP->count                 = 0;
   cSubP->expression.q          = q;
   cSubP->expression.geometry   = geometry;
   cSubP->expression.coords     = coords;
   cSubP->expression.georel     = georel;
-  cSubP->next                  = NULL;
+  cSubP->stringFilterP         = stringFilterCompile(q);
+  cSubP->geoFilterP            = geoFilterCompile(geometry, coords, georel);
 
   LM_T(LmtSubCache, ("set lastNotificationTime to %lu for '%s' (from DB)", cSubP->lastNotificationTime, cSubP->subscriptionId));
 
@@ -442,6 +485,152 @@ void mongoSubCacheRefresh(const std::string& database)
 
 
 
+/* ****************************************************************************
+*
+* mongoSubCacheDelta -
+*
+* Reads the changes in the csubs collection of a database, to be applied incrementally
+* to the subscription cache by subCacheSync. The cache itself is not touched.
+*
+* 1. The ONCHANGE subscriptions modified (CSUB_MODIFICATION_DATE) at 'since' or later are
+*    returned as new CachedSubscriptions in 'changedV' (owned by the caller from now on).
+* 2. For every ONCHANGE subscription in the database, its lastNotification is returned
+*    in 'presentV' (subscriptionId -> lastNotification). Only _id and lastNotification are
+*    read from DB in this second query.
+*    Cached subscriptions not in 'presentV' have been removed from the database.
+*
+* RETURN VALUE
+*   false if any of the two queries fails, in that case the delta must not be applied
+*/
+bool mongoSubCacheDelta
+(
+  const std::string&                  database,
+  long long                           since,
+  std::vector<CachedSubscription*>*   changedV,
+  std::map<std::string, long long>*   presentV
+)
+{
+  std::string               tenant      = tenantFromDb(database);
+  std::string               collection  = getSubscribeContextCollectionName(tenant);
+  BSONObj                   changedQ    = BSON(CSUB_CONDITIONS "." CSUB_CONDITIONS_TYPE << ON_CHANGE_CONDITION <<
+                                               CSUB_MODIFICATION_DATE << BSON("$gte" << since));
+  BSONObj                   presentQ    = BSON(CSUB_CONDITIONS "." CSUB_CONDITIONS_TYPE << ON_CHANGE_CONDITION);
+  BSONObj                   presentF    = BSON("_id" << 1 << CSUB_LASTNOTIFICATION << 1);
+  auto_ptr<DBClientCursor>  cursor;
+  std::string               err;
+
+  LM_T(LmtSubCache, ("Getting subscription cache delta for DB '%s' since %lu", database.c_str(), since));
+
+  //
+  // 1. Created/modified subscriptions
+  //
+  TIME_STAT_MONGO_READ_WAIT_START();
+  DBClientBase* connection = getMongoConnection();
+  if (collectionQuery(connection, collection, changedQ, &cursor, &err) != true)
+  {
+    releaseMongoConnection(connection);
+    TIME_STAT_MONGO_READ_WAIT_STOP();
+    return false;
+  }
+  TIME_STAT_MONGO_READ_WAIT_STOP();
+
+  while (moreSafe(cursor))
+  {
+    BSONObj              sub;
+    CachedSubscription*  cSubP = NULL;
+
+    if (!nextSafeOrError(cursor, &sub, &err))
+    {
+      LM_E(("Runtime Error (exception in nextSafe(): %s", err.c_str()));
+      continue;
+    }
+
+    if (mongoSubCacheItemCreate(tenant.c_str(), sub, &cSubP) == 0)
+    {
+      changedV->push_back(cSubP);
+    }
+  }
+
+
+  //
+  // 2. Ids (and lastNotification) of all the subscriptions in DB
+  //
+  if (collectionQuery(connection, collection, presentQ, presentF, &cursor, &err) != true)
+  {
+    releaseMongoConnection(connection);
+    return false;
+  }
+
+  while (moreSafe(cursor))
+  {
+    BSONObj      sub;
+    BSONElement  idField;
+
+    if (!nextSafeOrError(cursor, &sub, &err))
+    {
+      LM_E(("Runtime Error (exception in nextSafe(): %s", err.c_str()));
+      releaseMongoConnection(connection);
+      return false;
+    }
+
+    idField = sub.getField("_id");
+    if (idField.eoo() == true)
+    {
+      continue;
+    }
+
+    (*presentV)[idField.OID().toString()] = sub.hasField(CSUB_LASTNOTIFICATION)? getIntOrLongFieldAsLong(sub, CSUB_LASTNOTIFICATION) : -1;
+  }
+  releaseMongoConnection(connection);
+
+  LM_T(LmtSubCache, ("DB '%s': %d subscriptions changed, %d subscriptions in DB", database.c_str(), changedV->size(), presentV->size()));
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* mongoSubCacheUpdate - update subscriptions in mongo with count and lastNotificationTime
+*
+* All the updates for the tenant are sent in a single bulk write.
+* As in the single-subscription version of this function, lastNotification is only
+* updated if the saved value is newer than the one in the database.
+*/
+void mongoSubCacheUpdate(const std::string& tenant, const std::vector<CachedSubSaved*>& savedV)
+{
+  std::string           collection  = getSubscribeContextCollectionName(tenant);
+  std::vector<BSONObj>  conditions;
+  std::vector<BSONObj>  updates;
+  std::vector<bool>     writtenV;
+  std::string           err;
+
+  for (unsigned int ix = 0; ix < savedV.size(); ++ix)
+  {
+    CachedSubSaved* cssP = savedV[ix];
+
+    if (cssP->count != 0)
+    {
+      conditions.push_back(BSON("_id" << OID(cssP->subscriptionId)));
+      updates.push_back(BSON("$inc" << BSON(CSUB_COUNT << cssP->count)));
+    }
+
+    if (cssP->lastNotificationTime != 0)
+    {
+      conditions.push_back(BSON("_id" << OID(cssP->subscriptionId) << CSUB_LASTNOTIFICATION << BSON("$lt" << cssP->lastNotificationTime)));
+      updates.push_back(BSON("$set" << BSON(CSUB_LASTNOTIFICATION << cssP->lastNotificationTime)));
+    }
+  }
+
+  if (collectionBulkUpdate(collection, conditions, updates, false, &writtenV, &err) != true)
+  {
+    LM_E(("Internal Error (error updating 'count' and 'lastNotification' for subscriptions: %s)", err.c_str()));
+  }
+}
+
+
+
 /* ****************************************************************************
 *
 * mongoSubCacheUpdate - update subscription in mongo with count and lastNotificationTime
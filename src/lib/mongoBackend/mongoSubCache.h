@@ -27,14 +27,25 @@
 */
 #include <string>
 #include <vector>
+#include <map>
 #include <regex.h>
 
 #include "mongo/client/dbclient.h"
 
+#include "cache/subCache.h"
+
 using namespace mongo;
 
 
 
+/* ****************************************************************************
+*
+* mongoSubCacheItemCreate - 
+*/
+extern int mongoSubCacheItemCreate(const char* tenant, const BSONObj& sub, CachedSubscription** cSubPP);
+
+
+
 /* ****************************************************************************
 *
 * mongoSubCacheItemInsert - 
@@ -71,6 +82,28 @@ extern void mongoSubCacheRefresh(const std::string& database);
 
 
 
+/* ****************************************************************************
+*
+* mongoSubCacheDelta - 
+*/
+extern bool mongoSubCacheDelta
+(
+  const std::string&                  database,
+  long long                           since,
+  std::vector<CachedSubscription*>*   changedV,
+  std::map<std::string, long long>*   presentV
+);
+
+
+
+/* ****************************************************************************
+*
+* mongoSubCacheUpdate - 
+*/
+extern void mongoSubCacheUpdate(const std::string& tenant, const std::vector<CachedSubSaved*>& savedV);
+
+
+
 /* ****************************************************************************
 *
 * mongoSubCacheUpdate - 
@@ -177,6 +177,9 @@ HttpStatusCode mongoSubscribeContext
     /* Adding format to use in notifications */
     sub.append(CSUB_FORMAT, notifyFormatAsString);
 
+    /* Modification date, used by the incremental synchronization of the subscription cache */
+    sub.append(CSUB_MODIFICATION_DATE, (long long) getCurrentTime());
+
     /* Insert document in database */
     std::string err;
     if (!collectionInsert(getSubscribeContextCollectionName(tenant), sub.obj(), &err))
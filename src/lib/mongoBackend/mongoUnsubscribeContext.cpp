@@ -50,6 +50,7 @@ HttpStatusCode mongoUnsubscribeContext(UnsubscribeContextRequest* requestP, Unsu
     std::string  err;
 
     reqSemTake(__FUNCTION__, "ngsi10 unsubscribe request", SemWriteOp, &reqSemTaken);
+    entitySemTake(__FUNCTION__, "ngsi10 unsubscribe request", tenant, std::vector<std::string>(1, requestP->subscriptionId.get()));
 
     LM_T(LmtMongo, ("Unsubscribe Context"));
 
@@ -120,11 +121,16 @@ HttpStatusCode mongoUnsubscribeContext(UnsubscribeContextRequest* requestP, Unsu
 
     cacheSemTake(__FUNCTION__, "Removing subscription from cache");
 
-    CachedSubscription* cSubP = subCacheItemLookup(tenant.c_str(), requestP->subscriptionId.get().c_str());
+    CachedSubscriptionP cSubP = subCacheItemLookup(tenant.c_str(), requestP->subscriptionId.get().c_str());
 
-    if (cSubP != NULL)
+    if (cSubP.get() != NULL)
     {
-      subCacheItemRemove(cSubP);
+      subCacheItemRemove(cSubP.get());
+    }
+    else
+    {
+      // Not in the cache, but a sync in progress may have read it from DB
+      subCacheTombstoneAdd(tenant.c_str(), requestP->subscriptionId.get().c_str());
     }
 
     cacheSemGive(__FUNCTION__, "Removing subscription from cache");
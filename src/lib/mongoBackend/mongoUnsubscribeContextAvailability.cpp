@@ -53,6 +53,7 @@ HttpStatusCode mongoUnsubscribeContextAvailability
   std::string err;
 
   reqSemTake(__FUNCTION__, "ngsi9 unsubscribe request", SemWriteOp, &reqSemTaken);
+  entitySemTake(__FUNCTION__, "ngsi9 unsubscribe request", tenant, std::vector<std::string>(1, requestP->subscriptionId.get()));
 
   LM_T(LmtMongo, ("Unsubscribe Context Availability"));
 
@@ -24,6 +24,7 @@
 */
 #include <string.h>
 #include <map>
+#include <vector>
 #include <string>
 
 #include "logMsg/logMsg.h"
@@ -40,6 +41,7 @@
 #include "ngsi10/UpdateContextRequest.h"
 #include "ngsi10/UpdateContextResponse.h"
 #include "ngsi/NotifyCondition.h"
+#include "ngsiNotify/notifCoalesce.h"
 #include "rest/HttpStatusCode.h"
 
 
@@ -60,10 +62,20 @@ HttpStatusCode mongoUpdateContext
   Ngsiv2Flavour                         ngsiv2Flavour
 )
 {
-    bool reqSemTaken;
+    bool                      reqSemTaken;
+    std::vector<std::string>  entityKeys;
 
     reqSemTake(__FUNCTION__, "ngsi10 update request", SemWriteOp, &reqSemTaken);
 
+    /* Under the 'entity' request policy, only updates of the same entities are serialized (patterns: all of them) */
+    for (unsigned int ix = 0; ix < requestP->contextElementVector.size(); ++ix)
+    {
+      EntityId* enP = &requestP->contextElementVector[ix]->entityId;
+
+      entityKeys.push_back(isTrue(enP->isPattern)? "" : enP->id);
+    }
+    entitySemTake(__FUNCTION__, "ngsi10 update request", tenant, entityKeys);
+
     /* Check that the service path vector has only one element, returning error otherwise */
     if (servicePathV.size() > 1)
     {
@@ -76,6 +88,25 @@ HttpStatusCode mongoUpdateContext
     }
     else
     {
+        /* With -notifCoalesce, the notifications triggered by the whole request are sent at the end */
+        if (notifCoalesce)
+        {
+          notifCoalesceBegin();
+        }
+
+        //
+        // NGSIv2 multi-entity updates (e.g. POST /v2/op/update) are processed as a batch: all the entities
+        // are read in a single query and written in bulk, sending the notifications afterwards
+        //
+        UpdateBatch   batch;
+        UpdateBatch*  batchP = NULL;
+
+        if ((apiVersion == "v2") && (requestP->contextElementVector.size() > 1))
+        {
+          batchP = &batch;
+          updateBatchPrefetch(batchP, &requestP->contextElementVector, tenant, servicePathV, uriParams);
+        }
+
         /* Process each ContextElement */
         for (unsigned int ix = 0; ix < requestP->contextElementVector.size(); ++ix)
         {
@@ -87,13 +118,27 @@ HttpStatusCode mongoUpdateContext
                                 uriParams,
                                 xauthToken,
                                 apiVersion,
-                                ngsiv2Flavour);
+                                ngsiv2Flavour,
+                                batchP);
+        }
+
+        if (batchP != NULL)
+        {
+          updateBatchFlush(batchP, tenant, xauthToken);
         }
 
         /* Note that although individual processContextElements() invocations return ConnectionError, this
            error gets "encapsulated" in the StatusCode of the corresponding ContextElementResponse and we
            consider the overall mongoUpdateContext() as OK. */
         responseP->errorCode.fill(SccOk);
+
+        if (notifCoalesce)
+        {
+          std::vector<std::string> subIdV;
+
+          notifCoalesceFlush(getNotifier(), &subIdV);
+          coalescedSubscriptionsNotified(subIdV, tenant);
+        }
     }    
     reqSemGive(__FUNCTION__, "ngsi10 update request", reqSemTaken);
     
@@ -57,7 +57,8 @@ HttpStatusCode mongoUpdateContextAvailabilitySubscription
   bool reqSemTaken;
 
   LM_T(LmtMongo, ("Update Context Subscription, notifyFormat: '%s'", formatToString(notifyFormat)));
-  reqSemTake(__FUNCTION__, "ngsi9 update subscription request", SemWriteOp, &reqSemTaken);  
+  reqSemTake(__FUNCTION__, "ngsi9 update subscription request", SemWriteOp, &reqSemTaken);
+  entitySemTake(__FUNCTION__, "ngsi9 update subscription request", tenant, std::vector<std::string>(1, requestP->subscriptionId.get()));
 
   /* Look for document */
   BSONObj     sub;
@@ -63,6 +63,7 @@ HttpStatusCode mongoUpdateContextSubscription
   bool          reqSemTaken;
 
   reqSemTake(__FUNCTION__, "ngsi10 update subscription request", SemWriteOp, &reqSemTaken);
+  entitySemTake(__FUNCTION__, "ngsi10 update subscription request", tenant, std::vector<std::string>(1, requestP->subscriptionId.get()));
 
   /* Look for document */
   BSONObj     sub;
@@ -317,12 +318,14 @@ HttpStatusCode mongoUpdateContextSubscription
   //
   // Update from cached value, if applicable
   //
-  CachedSubscription*  cSubP                = subCacheItemLookup(tenant.c_str(), requestP->subscriptionId.get().c_str());
+  CachedSubscriptionP  cSubP                = subCacheItemLookup(tenant.c_str(), requestP->subscriptionId.get().c_str());
   long long            lastNotificationTime = 0;
+  long long            cachedCount          = 0;
 
-  if (cSubP != NULL)
+  if (cSubP.get() != NULL)
   {
-    count                += cSubP->count;
+    cachedCount           = cSubP->count;
+    count                += cachedCount;
     lastNotificationTime  = cSubP->lastNotificationTime;
   }
 
@@ -334,10 +337,10 @@ HttpStatusCode mongoUpdateContextSubscription
     //
     // Update sub-cache
     //
-    if (cSubP != NULL)
+    if (cSubP.get() != NULL)
     {
-      cSubP->count                 += 1; // 'count' to be reset later if DB operation OK
-      cSubP->lastNotificationTime  = lastNotificationTime;
+      subCacheItemNotified(cSubP.get(), lastNotificationTime);
+      cachedCount += 1;  // 'count' to be decreased later if DB operation OK
     }
 
     newSub.append(CSUB_LASTNOTIFICATION, lastNotificationTime);
@@ -378,6 +381,9 @@ HttpStatusCode mongoUpdateContextSubscription
   /* Adding format to use in notifications */
   newSub.append(CSUB_FORMAT, std::string(formatToString(notifyFormat)));
 
+  /* Modification date, used by the incremental synchronization of the subscription cache */
+  newSub.append(CSUB_MODIFICATION_DATE, (long long) getCurrentTime());
+
   /* Update document in MongoDB */
   BSONObj  newSubObject = newSub.obj();
   if (!collectionUpdate(getSubscribeContextCollectionName(tenant), BSON("_id" << OID(requestP->subscriptionId.get())), newSubObject, false, &err))
@@ -387,9 +393,13 @@ HttpStatusCode mongoUpdateContextSubscription
     return SccOk;
   }
 
-  if (cSubP != NULL)
+  if (cSubP.get() != NULL)
   {
-    cSubP->count = 0; // New 'count' has been sent to DB - must be reset here
+    //
+    // The 'count' sent to DB must be removed from the cached one. Notifications sent since the
+    // lookup (the cache is not locked) are kept, as they are not included in what was sent to DB
+    //
+    __sync_fetch_and_sub(&cSubP->count, cachedCount);
   }
 
   // Duration and throttling are optional parameters, they are only added in the case they were used for update
@@ -425,8 +435,9 @@ HttpStatusCode mongoUpdateContextSubscription
   //   3. Old subwas in cache, new sub DOES NOT enter cache
   //   4. Old sub was NOT in cache, new sub DOES NOT enter cache
   //
-  // This is resolved by two separate functions, one that removes the old one, if found (subCacheItemLookup+subCacheItemRemove), 
-  // and the other one that inserts the sub, IF it should be inserted (subCacheItemInsert).
+  // This is resolved by two separate functions, one that inserts the sub, IF it should be inserted (subCacheItemInsert),
+  // replacing the old one in a single step, so that readers of the cache never miss the subscription,
+  // and the other one that removes the old one, if found and not replaced (subCacheItemLookup+subCacheItemRemove).
   // If inserted, subCacheUpdateStatisticsIncrement is called to update the statistics counter of insertions.
   //
 
@@ -438,7 +449,7 @@ HttpStatusCode mongoUpdateContextSubscription
   cSubP = subCacheItemLookup(tenant.c_str(), requestP->subscriptionId.get().c_str());
 
   char* subscriptionId   = (char*) requestP->subscriptionId.get().c_str();
-  char* servicePath      = (char*) ((cSubP == NULL)? "" : cSubP->servicePath);
+  char* servicePath      = (char*) ((cSubP.get() == NULL)? "" : cSubP->servicePath);
 
   LM_T(LmtSubCache, ("update: %s", newSubObject.toString().c_str()));
 
@@ -453,15 +464,19 @@ HttpStatusCode mongoUpdateContextSubscription
                                           requestP->expression.coords,
                                           requestP->expression.georel);
 
-  if (cSubP != NULL)
+  if (mscInsert == 0)  // 0: Insertion was really made (and the old sub, if any, replaced)
+  {
+    subCacheUpdateStatisticsIncrement();
+  }
+  else if (cSubP.get() != NULL)
   {
     LM_T(LmtSubCache, ("Calling subCacheItemRemove"));
-    subCacheItemRemove(cSubP);
+    subCacheItemRemove(cSubP.get());
   }
-
-  if (mscInsert == 0)  // 0: Insertion was really made
+  else
   {
-    subCacheUpdateStatisticsIncrement();
+    // The old sub, in DB before the update, must not be brought to the cache by a sync in progress
+    subCacheTombstoneAdd(tenant.c_str(), subscriptionId);
   }
 
   cacheSemGive(__FUNCTION__, "Updating cached subscription");
@@ -0,0 +1,312 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/string.h"
+#include "mongoBackend/connectionOperations.h"
+#include "mongoBackend/queryPlan.h"
+
+using namespace mongo;
+
+
+
+/* ****************************************************************************
+*
+* REGEX_META - regex metacharacters (the ones escaped by regexEscape)
+*/
+#define REGEX_META  ".[]{}()*+?|^$\\"
+
+
+
+/* ****************************************************************************
+*
+* regexLiteral -
+*
+* Parses the literal string starting at regex[*posP], unescaping '\<metachar>' sequences, and
+* stopping at the first unescaped metacharacter. Returns false if an escape sequence
+* doesn't stand for a literal character (e.g. '\d').
+*/
+static bool regexLiteral(const std::string& regex, unsigned int* posP, std::string* literalP)
+{
+  unsigned int pos = *posP;
+
+  *literalP = "";
+
+  while (pos < regex.size())
+  {
+    char c = regex[pos];
+
+    if (c == '\\')
+    {
+      if ((pos + 1 >= regex.size()) || (regex[pos + 1] == 0) || (strchr(REGEX_META "/-", regex[pos + 1]) == NULL))
+      {
+        return false;
+      }
+
+      *literalP += regex[pos + 1];
+      pos += 2;
+    }
+    else if ((c == 0) || (strchr(REGEX_META, c) != NULL))
+    {
+      break;
+    }
+    else
+    {
+      *literalP += c;
+      ++pos;
+    }
+  }
+
+  *posP = pos;
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* regexLiterals -
+*/
+bool regexLiterals(const std::string& regex, std::vector<std::string>* literalsP)
+{
+  unsigned int pos = 0;
+
+  literalsP->clear();
+
+  while (pos < regex.size())
+  {
+    std::string literal;
+
+    if (regex[pos] != '^')
+    {
+      return false;
+    }
+    ++pos;
+
+    if (!regexLiteral(regex, &pos, &literal) || (pos >= regex.size()) || (regex[pos] != '$'))
+    {
+      return false;
+    }
+    ++pos;
+
+    literalsP->push_back(literal);
+
+    if (pos < regex.size())
+    {
+      if ((regex[pos] != '|') || (pos + 1 == regex.size()))
+      {
+        return false;
+      }
+      ++pos;
+    }
+  }
+
+  return literalsP->size() > 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* regexPrefix -
+*/
+bool regexPrefix(const std::string& regex, std::string* prefixP)
+{
+  unsigned int pos = 1;
+
+  if ((regex.size() < 2) || (regex[0] != '^') || !regexLiteral(regex, &pos, prefixP))
+  {
+    return false;
+  }
+
+  /* Trailing '.*' matches anything (including nothing), so it doesn't change the match */
+  return (prefixP->size() > 0) && ((pos == regex.size()) || (regex.substr(pos) == ".*"));
+}
+
+
+
+/* ****************************************************************************
+*
+* prefixUpperBound -
+*
+* The lowest string greater than all the strings starting with 'prefix'. Only done for
+* printable ASCII prefixes, so that the bound is also a valid UTF-8 string.
+*/
+static bool prefixUpperBound(const std::string& prefix, std::string* boundP)
+{
+  for (unsigned int ix = 0; ix < prefix.size(); ++ix)
+  {
+    if ((prefix[ix] < 0x20) || (prefix[ix] > 0x7E))
+    {
+      return false;
+    }
+  }
+
+  if (prefix[prefix.size() - 1] == 0x7E)
+  {
+    return false;
+  }
+
+  *boundP = prefix;
+  (*boundP)[boundP->size() - 1] += 1;
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* appendRegexFilter -
+*/
+void appendRegexFilter(BSONObjBuilder* bobP, const std::string& field, const std::string& regex)
+{
+  std::vector<std::string>  literals;
+  std::string               prefix;
+  std::string               bound;
+
+  if (regexLiterals(regex, &literals))
+  {
+    if (literals.size() == 1)
+    {
+      bobP->append(field, literals[0]);
+    }
+    else
+    {
+      BSONArrayBuilder ba;
+
+      for (unsigned int ix = 0; ix < literals.size(); ++ix)
+      {
+        ba.append(literals[ix]);
+      }
+      bobP->append(field, BSON("$in" << ba.arr()));
+    }
+  }
+  else if (regexPrefix(regex, &prefix) && prefixUpperBound(prefix, &bound))
+  {
+    bobP->append(field, BSON("$gte" << prefix << "$lt" << bound));
+  }
+  else
+  {
+    bobP->appendRegex(field, regex);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* servicePathFilter -
+*
+* A servicePath ending in '/#' matches the path itself and all its descendants (the latter by
+* means of an anchored prefix regex, which MongoDB resolves with index bounds). The rest of
+* servicePaths are exact values. Entities without servicePath are in the default servicePath
+* ("/"), so null is added for "/" and "/#".
+*
+* If the servicePath vector is empty, then all entities match, no matter their servicePath.
+*/
+BSONObj servicePathFilter(const std::vector<std::string>& servicePathV)
+{
+  BSONObjBuilder  values;
+  unsigned int    n = 0;
+  char            key[16];
+
+  if (servicePathV.size() == 0)
+  {
+    snprintf(key, sizeof(key), "%u", n++);
+    values.appendRegex(key, "^/");
+    snprintf(key, sizeof(key), "%u", n++);
+    values.appendNull(key);
+  }
+
+  bool nullAdded = false;
+
+  for (unsigned int ix = 0; ix < servicePathV.size(); ++ix)
+  {
+    const std::string& servicePath = servicePathV[ix];
+
+    if (!nullAdded && ((servicePath == "/") || (servicePath == "/#")))
+    {
+      snprintf(key, sizeof(key), "%u", n++);
+      values.appendNull(key);
+      nullAdded = true;
+    }
+
+    if ((servicePath.size() >= 2) && (servicePath.substr(servicePath.size() - 2) == "/#"))
+    {
+      std::string path = servicePath.substr(0, servicePath.size() - 2);
+
+      snprintf(key, sizeof(key), "%u", n++);
+      values.append(key, path);
+      snprintf(key, sizeof(key), "%u", n++);
+      values.appendRegex(key, std::string("^") + regexEscape(path) + "/");
+    }
+    else
+    {
+      snprintf(key, sizeof(key), "%u", n++);
+      values.append(key, servicePath);
+    }
+  }
+
+  BSONObjBuilder filter;
+
+  filter.appendArray("$in", values.obj());
+
+  return filter.obj();
+}
+
+
+
+/* ****************************************************************************
+*
+* queryExplainTrace -
+*/
+void queryExplainTrace(const std::string& col, const Query& query)
+{
+  if (!lmTraceIsSet(LmtMongoExplain))
+  {
+    return;
+  }
+
+  Query        explainQuery(query.obj);
+  BSONObj      plan;
+  std::string  err;
+
+  explainQuery.explain();
+
+  if (!collectionFindOne(col, explainQuery.obj, &plan, &err))
+  {
+    LM_T(LmtMongoExplain, ("explain of query on '%s' failed: %s", col.c_str(), err.c_str()));
+    return;
+  }
+
+  LM_T(LmtMongoExplain, ("explain of query on '%s': %s", col.c_str(), plan.toString().c_str()));
+}
@@ -0,0 +1,86 @@
+#ifndef SRC_LIB_MONGOBACKEND_QUERYPLAN_H_
+#define SRC_LIB_MONGOBACKEND_QUERYPLAN_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "mongo/client/dbclient.h"
+
+
+
+/* ****************************************************************************
+*
+* regexLiterals -
+*
+* If 'regex' only matches a list of literal strings (i.e. it is like '^a$|^b$|^c$'),
+* the strings are returned in literalsP (unescaped) and true is returned
+*/
+extern bool regexLiterals(const std::string& regex, std::vector<std::string>* literalsP);
+
+
+
+/* ****************************************************************************
+*
+* regexPrefix -
+*
+* If 'regex' only matches the strings starting with a literal prefix (i.e. it is like '^abc'
+* or '^abc.*'), the prefix is returned in prefixP (unescaped) and true is returned
+*/
+extern bool regexPrefix(const std::string& regex, std::string* prefixP);
+
+
+
+/* ****************************************************************************
+*
+* appendRegexFilter -
+*
+* Appends to bobP a filter on 'field' equivalent to the regex, using index-friendly
+* equality, $in or range predicates when possible (the regex itself otherwise)
+*/
+extern void appendRegexFilter(mongo::BSONObjBuilder* bobP, const std::string& field, const std::string& regex);
+
+
+
+/* ****************************************************************************
+*
+* servicePathFilter -
+*
+* Filter on _id.servicePath for the servicePaths of a query (see fillQueryServicePath)
+*/
+extern mongo::BSONObj servicePathFilter(const std::vector<std::string>& servicePathV);
+
+
+
+/* ****************************************************************************
+*
+* queryExplainTrace -
+*
+* With trace level LmtMongoExplain, traces the plan used by the DB for the query (i.e. its explain)
+*/
+extern void queryExplainTrace(const std::string& col, const mongo::Query& query);
+
+#endif  // SRC_LIB_MONGOBACKEND_QUERYPLAN_H_
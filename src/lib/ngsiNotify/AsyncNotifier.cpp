@@ -0,0 +1,608 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include <curl/curl.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/clockFunctions.h"
+#include "common/statistics.h"
+#include "common/limits.h"
+#include "alarmMgr/alarmMgr.h"
+
+#include "rest/httpRequestSend.h"
+#include "ngsiNotify/QueueStatistics.h"
+#include "ngsiNotify/AsyncNotifier.h"
+
+
+
+/* ****************************************************************************
+*
+* ASYNC_NOTIF_WAIT_MS - maximum time an event loop sleeps with nothing to do
+*/
+#define ASYNC_NOTIF_WAIT_MS 1000
+
+
+
+/* ****************************************************************************
+*
+* AsyncTransfer - state of a notification being sent, kept as CURLOPT_PRIVATE
+*/
+typedef struct AsyncTransfer
+{
+  SenderThreadParams*  params;
+  struct curl_slist*   headers;
+  std::string          url;
+  char                 transactionId[64];
+} AsyncTransfer;
+
+
+
+/* ****************************************************************************
+*
+* class AsyncNotifierLoop - one event loop, with its own curl multi handle
+*
+* Other threads hand notifications over with push(), which wakes the loop up by writing
+* into a pipe whose read end is polled together with the sockets of the transfers.
+* Easy handles are reused from transfer to transfer, so the connection cache of the
+* multi handle keeps connections to receivers alive.
+*/
+class AsyncNotifierLoop
+{
+public:
+  AsyncNotifierLoop(volatile int* _inProgressP);
+  ~AsyncNotifierLoop();
+  int  start(void);
+  void push(SenderThreadParams* params);
+private:
+  static void* run(void* vP);
+  void         loop(void);
+  void         wait(void);
+  void         pendingTake(void);
+  void         transferAdd(SenderThreadParams* params);
+  void         transferDone(CURL* curl, CURLcode res);
+  void         transferEnd(SenderThreadParams* params);
+
+  CURLM*                           multi;
+  int                              wakePipe[2];
+  volatile int                     wakeupPending;
+  pthread_mutex_t                  pendingMutex;
+  std::deque<SenderThreadParams*>  pending;
+  std::vector<CURL*>               freeHandles;
+  int                              running;
+  volatile int*                    inProgressP;
+};
+
+
+
+/* ****************************************************************************
+*
+* discardCallback - the response of a notification is not used
+*/
+static size_t discardCallback(void* contents, size_t size, size_t nmemb, void* userp)
+{
+  return size * nmemb;
+}
+
+
+
+/* ****************************************************************************
+*
+* urlGet - the URL of a notification, as used for alarms
+*/
+static std::string urlGet(SenderThreadParams* params)
+{
+  char portV[STRING_SIZE_FOR_INT];
+
+  snprintf(portV, sizeof(portV), "%d", params->port);
+  return params->ip + ":" + portV + params->resource;
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifierLoop::AsyncNotifierLoop -
+*/
+AsyncNotifierLoop::AsyncNotifierLoop(volatile int* _inProgressP): multi(NULL), wakeupPending(0), running(0), inProgressP(_inProgressP)
+{
+  wakePipe[0] = -1;
+  wakePipe[1] = -1;
+  pthread_mutex_init(&pendingMutex, NULL);
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifierLoop::~AsyncNotifierLoop -
+*
+* Event loops run for the whole life of the broker; this only cleans up a loop that
+* could not be started.
+*/
+AsyncNotifierLoop::~AsyncNotifierLoop()
+{
+  if (multi != NULL)
+  {
+    curl_multi_cleanup(multi);
+  }
+
+  if (wakePipe[0] != -1)
+  {
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+  }
+
+  pthread_mutex_destroy(&pendingMutex);
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifierLoop::start -
+*/
+int AsyncNotifierLoop::start(void)
+{
+  pthread_t tid;
+  int       rc;
+
+  if ((multi = curl_multi_init()) == NULL)
+  {
+    LM_E(("Runtime Error (curl_multi_init)"));
+    return -1;
+  }
+
+#if LIBCURL_VERSION_NUM >= 0x071e00
+  curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long) ASYNC_NOTIF_MAX_HOST_CONNECTIONS);
+#endif
+
+  if (pipe(wakePipe) != 0)
+  {
+    LM_E(("Runtime Error (pipe: %s)", strerror(errno)));
+    return -1;
+  }
+
+  fcntl(wakePipe[0], F_SETFL, fcntl(wakePipe[0], F_GETFL) | O_NONBLOCK);
+  fcntl(wakePipe[1], F_SETFL, fcntl(wakePipe[1], F_GETFL) | O_NONBLOCK);
+
+  if ((rc = pthread_create(&tid, NULL, run, this)) != 0)
+  {
+    return rc;
+  }
+
+  pthread_detach(tid);
+  return 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifierLoop::push - hand a notification over to the event loop
+*
+* The pipe is written only if the loop hasn't been woken up already since it last
+* took the pending notifications.
+*/
+void AsyncNotifierLoop::push(SenderThreadParams* params)
+{
+  pthread_mutex_lock(&pendingMutex);
+  pending.push_back(params);
+  pthread_mutex_unlock(&pendingMutex);
+
+  if (__sync_bool_compare_and_swap(&wakeupPending, 0, 1))
+  {
+    char c = 0;
+
+    if (write(wakePipe[1], &c, 1) != 1)
+    {
+      LM_E(("Runtime Error (error waking up notification event loop: %s)", strerror(errno)));
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifierLoop::run -
+*/
+void* AsyncNotifierLoop::run(void* vP)
+{
+  ((AsyncNotifierLoop*) vP)->loop();
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifierLoop::loop -
+*/
+void AsyncNotifierLoop::loop(void)
+{
+  for (;;)
+  {
+    CURLMsg*  msg;
+    int       msgsInQueue;
+
+    wait();
+    pendingTake();
+
+    curl_multi_perform(multi, &running);
+
+    while ((msg = curl_multi_info_read(multi, &msgsInQueue)) != NULL)
+    {
+      if (msg->msg == CURLMSG_DONE)
+      {
+        transferDone(msg->easy_handle, msg->data.result);
+      }
+    }
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifierLoop::wait - wait for activity on the transfers or for new notifications
+*
+* libcurl older than 7.28.0 lacks curl_multi_wait, select() is used instead.
+*/
+void AsyncNotifierLoop::wait(void)
+{
+  char buf[64];
+
+#if LIBCURL_VERSION_NUM >= 0x071c00
+  struct curl_waitfd  wakeFd;
+  int                 numFds;
+
+  wakeFd.fd      = wakePipe[0];
+  wakeFd.events  = CURL_WAIT_POLLIN;
+  wakeFd.revents = 0;
+
+  curl_multi_wait(multi, &wakeFd, 1, ASYNC_NOTIF_WAIT_MS, &numFds);
+#else
+  fd_set          readFds;
+  fd_set          writeFds;
+  fd_set          excFds;
+  int             maxFd   = -1;
+  long            timeout = -1;
+  struct timeval  tv;
+
+  FD_ZERO(&readFds);
+  FD_ZERO(&writeFds);
+  FD_ZERO(&excFds);
+
+  curl_multi_fdset(multi, &readFds, &writeFds, &excFds, &maxFd);
+  curl_multi_timeout(multi, &timeout);
+
+  if ((timeout < 0) || (timeout > ASYNC_NOTIF_WAIT_MS))
+  {
+    timeout = ASYNC_NOTIF_WAIT_MS;
+  }
+
+  if ((maxFd == -1) && (running != 0))
+  {
+    // curl has no sockets to wait on yet (e.g. resolving), retry soon
+    timeout = 10;
+  }
+
+  FD_SET(wakePipe[0], &readFds);
+  if (wakePipe[0] > maxFd)
+  {
+    maxFd = wakePipe[0];
+  }
+
+  tv.tv_sec  = timeout / 1000;
+  tv.tv_usec = (timeout % 1000) * 1000;
+
+  select(maxFd + 1, &readFds, &writeFds, &excFds, &tv);
+#endif
+
+  while (read(wakePipe[0], buf, sizeof(buf)) > 0)
+  {
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifierLoop::pendingTake - start the transfers of the pending notifications
+*/
+void AsyncNotifierLoop::pendingTake(void)
+{
+  std::deque<SenderThreadParams*> taken;
+
+  __sync_bool_compare_and_swap(&wakeupPending, 1, 0);
+
+  pthread_mutex_lock(&pendingMutex);
+  taken.swap(pending);
+  pthread_mutex_unlock(&pendingMutex);
+
+  for (unsigned int ix = 0; ix < taken.size(); ++ix)
+  {
+    transferAdd(taken[ix]);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifierLoop::transferAdd -
+*/
+void AsyncNotifierLoop::transferAdd(SenderThreadParams* params)
+{
+  struct timespec  now;
+  struct timespec  howlong;
+  CURL*            curl;
+  AsyncTransfer*   transferP;
+  int              outgoingMsgSize;
+  int              r;
+
+  QueueStatistics::incOut();
+  clock_gettime(CLOCK_REALTIME, &now);
+  clock_difftime(&now, &params->timeStamp, &howlong);
+  QueueStatistics::addTimeInQWithSize(&howlong, *inProgressP);
+
+  strncpy(transactionId, params->transactionId, sizeof(transactionId));
+
+  LM_T(LmtNotifier, ("async sending to: host='%s', port=%d, verb=%s, tenant='%s', service-path: '%s', xauthToken: '%s', path='%s', content-type: %s",
+                     params->ip.c_str(),
+                     params->port,
+                     params->verb.c_str(),
+                     params->tenant.c_str(),
+                     params->servicePath.c_str(),
+                     params->xauthToken.c_str(),
+                     params->resource.c_str(),
+                     params->content_type.c_str()));
+
+  if (simulatedNotification)
+  {
+    LM_T(LmtNotifier, ("simulatedNotification is 'true', skipping outgoing request"));
+    ++noOfSimulatedNotifications;
+    transferEnd(params);
+    return;
+  }
+
+  if (freeHandles.empty())
+  {
+    if ((curl = curl_easy_init()) == NULL)
+    {
+      LM_E(("Runtime Error (curl_easy_init)"));
+      QueueStatistics::incSentError();
+      transferEnd(params);
+      return;
+    }
+  }
+  else
+  {
+    curl = freeHandles.back();
+    freeHandles.pop_back();
+  }
+
+  transferP         = new AsyncTransfer();
+  transferP->params = params;
+
+  lmTransactionStart("to", params->ip.c_str(), params->port, params->resource.c_str());
+  strncpy(transferP->transactionId, transactionId, sizeof(transferP->transactionId));
+
+  r = httpRequestPrepare(curl,
+                         params->ip,
+                         params->port,
+                         params->protocol,
+                         params->verb,
+                         params->tenant,
+                         params->servicePath,
+                         params->xauthToken,
+                         params->resource,
+                         params->content_type,
+                         params->content,
+                         true,
+                         "",
+                         -1,
+                         &transferP->headers,
+                         &transferP->url,
+                         &outgoingMsgSize);
+
+  if (r != 0)
+  {
+    QueueStatistics::incSentError();
+    alarmMgr.notificationError(urlGet(params), "notification failure for async sender");
+    lmTransactionEnd();
+
+    curl_easy_reset(curl);
+    freeHandles.push_back(curl);
+    delete transferP;
+    transferEnd(params);
+    return;
+  }
+
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discardCallback);
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, (char*) transferP);
+
+  LM_T(LmtClientOutputPayload, ("Sending message to HTTP server: sending message of %d bytes to HTTP server", outgoingMsgSize));
+  curl_multi_add_handle(multi, curl);
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifierLoop::transferDone -
+*/
+void AsyncNotifierLoop::transferDone(CURL* curl, CURLcode res)
+{
+  AsyncTransfer*       transferP = NULL;
+  SenderThreadParams*  params;
+
+  curl_easy_getinfo(curl, CURLINFO_PRIVATE, (char**) &transferP);
+  params = transferP->params;
+
+  strncpy(transactionId, transferP->transactionId, sizeof(transactionId));
+
+  if (res != CURLE_OK)
+  {
+    //
+    // NOTE: same log line as in httpRequestSendWithCurl, used by the functional tests
+    //       in cases/880_timeout_for_forward_and_notifications/
+    //
+    alarmMgr.notificationError(transferP->url, "(curl_easy_perform failed: " + std::string(curl_easy_strerror(res)) + ")");
+    QueueStatistics::incSentError();
+  }
+  else
+  {
+    LM_I(("Notification Successfully Sent to %s", transferP->url.c_str()));
+    statisticsUpdate(NotifyContextSent, params->format);
+    QueueStatistics::incSentOK();
+    alarmMgr.notificationErrorReset(urlGet(params));
+  }
+
+  lmTransactionEnd();
+
+  curl_multi_remove_handle(multi, curl);
+  curl_slist_free_all(transferP->headers);
+  curl_easy_reset(curl);
+  freeHandles.push_back(curl);
+
+  delete transferP;
+  transferEnd(params);
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifierLoop::transferEnd - a notification is no longer in progress
+*/
+void AsyncNotifierLoop::transferEnd(SenderThreadParams* params)
+{
+  delete params;
+  __sync_fetch_and_sub(inProgressP, 1);
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifier::AsyncNotifier -
+*/
+AsyncNotifier::AsyncNotifier(size_t _maxInProgress, int numThreads): maxInProgress(_maxInProgress), inProgress(0)
+{
+  LM_T(LmtNotifier, ("Setting up event loops for async notifications"));
+
+  for (int ix = 0; ix < numThreads; ++ix)
+  {
+    loops.push_back(new AsyncNotifierLoop(&inProgress));
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifier::~AsyncNotifier -
+*/
+AsyncNotifier::~AsyncNotifier()
+{
+  for (unsigned int ix = 0; ix < loops.size(); ++ix)
+  {
+    delete loops[ix];
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifier::start -
+*/
+int AsyncNotifier::start()
+{
+  for (unsigned int ix = 0; ix < loops.size(); ++ix)
+  {
+    int rc = loops[ix]->start();
+
+    if (rc != 0)
+    {
+      return rc;
+    }
+  }
+
+  return 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* AsyncNotifier::sendNotifyContextRequest -
+*
+* The event loop of a notification is selected by the receiver (host and port), so that
+* its connections can be reused by all the notifications it gets.
+*/
+void AsyncNotifier::sendNotifyContextRequest(NotifyContextRequest* ncr, const std::string& url, const std::string& tenant, const std::string& xauthToken, Format format)
+{
+  SenderThreadParams* params = senderThreadParamsBuild(ncr, url, tenant, xauthToken, format);
+
+  if (params == NULL)
+  {
+    return;
+  }
+
+  if ((size_t) __sync_add_and_fetch(&inProgress, 1) > maxInProgress)
+  {
+    __sync_fetch_and_sub(&inProgress, 1);
+    QueueStatistics::incReject();
+
+    LM_E(("Runtime Error (notification queue is full)"));
+    delete params;
+
+    return;
+  }
+
+  QueueStatistics::incIn();
+
+  unsigned int hash = params->port;
+  for (unsigned int ix = 0; ix < params->ip.size(); ++ix)
+  {
+    hash = hash * 31 + (unsigned char) params->ip[ix];
+  }
+
+  loops[hash % loops.size()]->push(params);
+}
@@ -0,0 +1,74 @@
+#ifndef SRC_LIB_NGSINOTIFY_ASYNCNOTIFIER_H
+#define SRC_LIB_NGSINOTIFY_ASYNCNOTIFIER_H
+
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "ngsiNotify/Notifier.h"
+#include "ngsiNotify/senderThread.h"
+
+// default maximum number of notifications in progress (pending + in-flight)
+#define DEFAULT_ASYNC_NOTIF_QS 10000
+// default number of event-loop threads
+#define DEFAULT_ASYNC_NOTIF_TN 2
+
+// maximum number of parallel connections of an event loop to the same receiver
+#define ASYNC_NOTIF_MAX_HOST_CONNECTIONS 64
+
+
+
+class AsyncNotifierLoop;
+
+
+
+/* ****************************************************************************
+*
+* class AsyncNotifier -
+*
+* Notifier for '-notificationMode async'. Notifications are sent by a few event-loop
+* threads, each one driving any number of concurrent requests with a curl multi handle.
+* Connections to receivers are kept alive and reused, and all notifications to the same
+* receiver (host:port) go through the same event loop, so that its connections are shared.
+*
+* At most 'maxInProgress' notifications can be waiting or in-flight at the same time;
+* notifications beyond that limit are rejected, as with a full threadpool queue.
+*/
+class AsyncNotifier : public Notifier
+{
+public:
+  AsyncNotifier(size_t maxInProgress, int numThreads);
+  ~AsyncNotifier();
+  void sendNotifyContextRequest(NotifyContextRequest* ncr, const std::string& url, const std::string& tenant, const std::string& xauthToken, Format format);
+  int start();
+private:
+  std::vector<AsyncNotifierLoop*>  loops;
+  size_t                           maxInProgress;
+  volatile int                     inProgress;
+};
+
+#endif // SRC_LIB_NGSINOTIFY_ASYNCNOTIFIER_H
@@ -0,0 +1,395 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "common/TimerWheel.h"
+#include "ngsiNotify/onTimeIntervalThread.h"
+#include "ngsiNotify/IntervalScheduler.h"
+
+
+
+/* ****************************************************************************
+*
+* IntervalTimer - an ONTIMEINTERVAL condition in the wheel
+*/
+class IntervalTimer : public TimerWheelEntry
+{
+ public:
+  unsigned int            id;
+  OnIntervalThreadParams  params;
+  bool                    queued;    // a job including the timer is waiting for a worker
+  int                     running;   // number of workers processing the timer right now
+  bool                    removed;   // unscheduled while running, the last worker frees it
+};
+
+
+
+/* ****************************************************************************
+*
+* IntervalJob - the timers of the same tenant expired in the same tick
+*
+* Timers are referred by id, as they may be removed while the job waits in the queue.
+*/
+typedef struct IntervalJob
+{
+  std::string                tenant;
+  std::vector<unsigned int>  timerIds;
+} IntervalJob;
+
+
+
+/* ****************************************************************************
+*
+* Scheduler state, protected by 'mtx'
+*/
+static pthread_once_t                              once    = PTHREAD_ONCE_INIT;
+static pthread_mutex_t                             mtx     = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t                              jobCond = PTHREAD_COND_INITIALIZER;
+static TimerWheel*                                 wheel   = NULL;
+static unsigned int                                nextId  = 1;
+static std::map<unsigned int, IntervalTimer*>      timers;
+static std::multimap<std::string, unsigned int>    timersBySub;
+static std::deque<IntervalJob>                     jobs;
+
+
+
+/* ****************************************************************************
+*
+* monotonicSeconds -
+*/
+static unsigned long long monotonicSeconds(long* nsecP = NULL)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  if (nsecP != NULL)
+  {
+    *nsecP = ts.tv_nsec;
+  }
+
+  return ts.tv_sec;
+}
+
+
+
+/* ****************************************************************************
+*
+* nextAlignedTick - next multiple of the interval, strictly after 'now'
+*/
+static unsigned long long nextAlignedTick(unsigned long long now, int interval)
+{
+  return (now / interval + 1) * interval;
+}
+
+
+
+/* ****************************************************************************
+*
+* jobsPush - queue the jobs for a set of timers, one job per tenant
+*
+* Timers still queued or being processed from a previous tick are skipped, so a slow
+* database doesn't make the work for a subscription pile up. Must be called with 'mtx' taken.
+*/
+static void jobsPush(const std::vector<IntervalTimer*>& timerV)
+{
+  std::map<std::string, unsigned int>  jobIx;
+  unsigned int                         pushed = 0;
+
+  for (unsigned int ix = 0; ix < timerV.size(); ++ix)
+  {
+    IntervalTimer* timerP = timerV[ix];
+
+    if (timerP->queued || (timerP->running > 0))
+    {
+      LM_T(LmtNotifier, ("ONTIMEINTERVAL notification for %s skipped, previous one still in progress", timerP->params.subId.c_str()));
+      continue;
+    }
+
+    std::map<std::string, unsigned int>::iterator it = jobIx.find(timerP->params.tenant);
+
+    if (it == jobIx.end())
+    {
+      IntervalJob job;
+
+      job.tenant = timerP->params.tenant;
+      jobs.push_back(job);
+      it = jobIx.insert(std::pair<std::string, unsigned int>(job.tenant, jobs.size() - 1)).first;
+      ++pushed;
+    }
+
+    jobs[it->second].timerIds.push_back(timerP->id);
+    timerP->queued = true;
+  }
+
+  if (pushed == 1)
+  {
+    pthread_cond_signal(&jobCond);
+  }
+  else if (pushed > 1)
+  {
+    pthread_cond_broadcast(&jobCond);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* tickThread - advance the wheel every second and queue the expired timers
+*/
+static void* tickThread(void* p)
+{
+  std::vector<TimerWheelEntry*>  expired;
+  std::vector<IntervalTimer*>    timerV;
+
+  while (true)
+  {
+    long nsec;
+
+    monotonicSeconds(&nsec);
+    usleep((1000000000L - nsec) / 1000 + 1);
+
+    unsigned long long now = monotonicSeconds();
+
+    expired.clear();
+    timerV.clear();
+
+    pthread_mutex_lock(&mtx);
+    wheel->advance(now, &expired);
+
+    for (unsigned int ix = 0; ix < expired.size(); ++ix)
+    {
+      IntervalTimer* timerP = (IntervalTimer*) expired[ix];
+
+      wheel->add(timerP, nextAlignedTick(now, timerP->params.interval));
+      timerV.push_back(timerP);
+    }
+
+    jobsPush(timerV);
+    pthread_mutex_unlock(&mtx);
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* workerThread - run the queries and notifications of the queued jobs
+*/
+static void* workerThread(void* p)
+{
+  while (true)
+  {
+    std::vector<IntervalTimer*>           timerV;
+    std::vector<OnIntervalThreadParams*>  paramsV;
+    std::string                           tenant;
+
+    pthread_mutex_lock(&mtx);
+    while (jobs.empty())
+    {
+      pthread_cond_wait(&jobCond, &mtx);
+    }
+
+    IntervalJob& job = jobs.front();
+
+    tenant = job.tenant;
+    for (unsigned int ix = 0; ix < job.timerIds.size(); ++ix)
+    {
+      std::map<unsigned int, IntervalTimer*>::iterator it = timers.find(job.timerIds[ix]);
+
+      // Timers removed since the job was queued are gone from the map
+      if (it != timers.end())
+      {
+        IntervalTimer* timerP = it->second;
+
+        timerP->queued = false;
+        timerP->running++;
+        timerV.push_back(timerP);
+        paramsV.push_back(&timerP->params);
+      }
+    }
+    jobs.pop_front();
+    pthread_mutex_unlock(&mtx);
+
+    if (!paramsV.empty())
+    {
+      // params are safe to use unlocked: a timer being run is not freed, see intervalSchedulerRemove
+      onTimeIntervalNotify(tenant, paramsV);
+    }
+
+    pthread_mutex_lock(&mtx);
+    for (unsigned int ix = 0; ix < timerV.size(); ++ix)
+    {
+      timerV[ix]->running--;
+
+      if (timerV[ix]->removed && (timerV[ix]->running == 0))
+      {
+        delete timerV[ix];
+      }
+    }
+    pthread_mutex_unlock(&mtx);
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* schedulerStart -
+*/
+static void schedulerStart(void)
+{
+  pthread_t  tid;
+  int        ret;
+
+  wheel = new TimerWheel(monotonicSeconds());
+
+  for (int ix = 0; ix < INTERVAL_SCHEDULER_WORKERS; ++ix)
+  {
+    if ((ret = pthread_create(&tid, NULL, workerThread, NULL)) != 0)
+    {
+      LM_E(("Runtime Error (error creating ONTIMEINTERVAL worker thread: %d)", ret));
+      continue;
+    }
+    pthread_detach(tid);
+  }
+
+  if ((ret = pthread_create(&tid, NULL, tickThread, NULL)) != 0)
+  {
+    LM_E(("Runtime Error (error creating ONTIMEINTERVAL tick thread: %d)", ret));
+    return;
+  }
+  pthread_detach(tid);
+}
+
+
+
+/* ****************************************************************************
+*
+* intervalSchedulerAdd -
+*/
+void intervalSchedulerAdd(const OnIntervalThreadParams& params)
+{
+  std::vector<IntervalTimer*> timerV;
+
+  pthread_once(&once, schedulerStart);
+
+  IntervalTimer* timerP = new IntervalTimer();
+
+  timerP->params          = params;
+  timerP->params.interval = (params.interval < 1)? 1 : params.interval;
+  timerP->queued          = false;
+  timerP->running         = 0;
+  timerP->removed         = false;
+
+  pthread_mutex_lock(&mtx);
+
+  timerP->id = nextId++;
+  timers[timerP->id] = timerP;
+  timersBySub.insert(std::pair<std::string, unsigned int>(params.subId, timerP->id));
+
+  // First notification right away, the next ones aligned to the interval
+  wheel->add(timerP, nextAlignedTick(wheel->current(), timerP->params.interval));
+  timerV.push_back(timerP);
+  jobsPush(timerV);
+
+  pthread_mutex_unlock(&mtx);
+
+  LM_T(LmtNotifier, ("ONTIMEINTERVAL condition scheduled for %s (interval: %d)", params.subId.c_str(), timerP->params.interval));
+}
+
+
+
+/* ****************************************************************************
+*
+* intervalSchedulerRemove -
+*
+* The callers hold the request semaphore, which the workers need to run the notifications,
+* so the notifications in progress are not waited for: a timer being run is just marked as
+* removed, and the last worker running it frees it.
+*/
+void intervalSchedulerRemove(const std::string& subId)
+{
+  pthread_mutex_lock(&mtx);
+
+  std::pair<std::multimap<std::string, unsigned int>::iterator, std::multimap<std::string, unsigned int>::iterator> ii = timersBySub.equal_range(subId);
+
+  for (std::multimap<std::string, unsigned int>::iterator it = ii.first; it != ii.second; ++it)
+  {
+    std::map<unsigned int, IntervalTimer*>::iterator tIt = timers.find(it->second);
+
+    if (tIt != timers.end())
+    {
+      IntervalTimer* timerP = tIt->second;
+
+      wheel->remove(timerP);
+      timers.erase(tIt);
+
+      // Queued jobs refer to the timer by id, so they won't find it any more
+      if (timerP->running > 0)
+      {
+        timerP->removed = true;
+      }
+      else
+      {
+        delete timerP;
+      }
+    }
+  }
+  timersBySub.erase(subId);
+
+  pthread_mutex_unlock(&mtx);
+}
+
+
+
+/* ****************************************************************************
+*
+* intervalSchedulerSize -
+*/
+unsigned int intervalSchedulerSize(void)
+{
+  unsigned int size;
+
+  pthread_mutex_lock(&mtx);
+  size = timers.size();
+  pthread_mutex_unlock(&mtx);
+
+  return size;
+}
@@ -0,0 +1,69 @@
+#ifndef SRC_LIB_NGSINOTIFY_INTERVALSCHEDULER_H_
+#define SRC_LIB_NGSINOTIFY_INTERVALSCHEDULER_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+
+#include "ngsiNotify/OnIntervalThreadParams.h"
+
+// number of threads running the ONTIMEINTERVAL queries and notifications
+#define INTERVAL_SCHEDULER_WORKERS 4
+
+
+
+/* ****************************************************************************
+*
+* intervalSchedulerAdd - schedule the ONTIMEINTERVAL notifications of a subscription
+*
+* All ONTIMEINTERVAL conditions are driven by a single timing wheel, instead of one thread
+* (and one stack) per condition. The first notification is sent right away and the next ones
+* are aligned to multiples of the interval, so that subscriptions with the same interval
+* are processed in the same tick and share the database queries for the same entities.
+*
+* The scheduler (a tick thread and INTERVAL_SCHEDULER_WORKERS workers) is started on first use.
+*/
+extern void intervalSchedulerAdd(const OnIntervalThreadParams& params);
+
+
+
+/* ****************************************************************************
+*
+* intervalSchedulerRemove - unschedule all the ONTIMEINTERVAL conditions of a subscription
+*
+* Notifications already in progress for the subscription are not waited for (they finish
+* on their own), so this never blocks.
+*/
+extern void intervalSchedulerRemove(const std::string& subId);
+
+
+
+/* ****************************************************************************
+*
+* intervalSchedulerSize - number of ONTIMEINTERVAL conditions scheduled
+*/
+extern unsigned int intervalSchedulerSize(void);
+
+#endif  // SRC_LIB_NGSINOTIFY_INTERVALSCHEDULER_H_
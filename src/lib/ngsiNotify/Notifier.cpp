@@ -22,6 +22,8 @@
 *
 * Author: Fermin Galan
 */
+#include <pthread.h>
+
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
 
@@ -32,8 +34,9 @@
 
 #include "ngsi10/NotifyContextRequest.h"
 #include "rest/httpRequestSend.h"
-#include "ngsiNotify/onTimeIntervalThread.h"
+#include "ngsiNotify/IntervalScheduler.h"
 #include "ngsiNotify/senderThread.h"
+#include "ngsiNotify/notifPayloadCache.h"
 #include "ngsiNotify/Notifier.h"
 
 
@@ -65,8 +68,6 @@ Notifier::~Notifier (void)
 */
 void Notifier::sendNotifyContextRequest(NotifyContextRequest* ncr, const std::string& url, const std::string& tenant, const std::string& xauthToken, Format format)
 {
-    ConnectionInfo ci;
-
     //
     // Creating the value of the Fiware-ServicePath HTTP header.
     // This is a comma-separated list of the service-paths in the same order as the entities come in the payload
@@ -96,8 +97,7 @@ void Notifier::sendNotifyContextRequest(NotifyContextRequest* ncr, const std::st
       spathList = "";
     }
     
-    ci.outFormat = format;
-    std::string payload = ncr->render(&ci, NotifyContext, "");
+    std::string payload = notifPayloadRender(ncr, format);
 
     /* Parse URL */
     std::string  host;
@@ -251,92 +251,29 @@ void Notifier::sendNotifyContextAvailabilityRequest(NotifyContextAvailabilityReq
 /* ****************************************************************************
 *
 * Notifier::createIntervalThread -
+*
+* Despite the name (kept for the sake of the mongoBackend mocks), no thread is created:
+* the condition is scheduled in the shared ONTIMEINTERVAL scheduler.
 */
-void Notifier::createIntervalThread(const std::string& subId, int interval, const std::string& tenant) {
-
-    /* Create params dynamically. Note that the first action that thread does
-     * if */
-    ThreadData td;
-    td.params = new OnIntervalThreadParams();
-    td.params->tenant = tenant;
-    td.params->subId = subId;
-    td.params->interval = interval;
-    td.params->notifier = this;
-
-    int ret = pthread_create(&(td.tid), NULL, startOnIntervalThread, td.params);
-    if (ret != 0)
-    {
-      LM_E(("Runtime Error (error creating thread: %d)", ret));
-      return;
-    }
+void Notifier::createIntervalThread(const std::string& subId, int interval, const std::string& tenant)
+{
+  OnIntervalThreadParams params;
 
-    pthread_detach(td.tid);
+  params.tenant   = tenant;
+  params.subId    = subId;
+  params.interval = interval;
+  params.notifier = this;
 
-    /* Put the id in the list associate to subId */
-    LM_T(LmtNotifier, ("created thread: %lu", (unsigned long) td.tid));
-    this->threadsMap.insert(std::pair<std::string,ThreadData>(subId,td));
+  intervalSchedulerAdd(params);
 }
 
+
+
 /* ****************************************************************************
 *
 * Notifier::destroyOntimeIntervalThreads -
 */
-void Notifier::destroyOntimeIntervalThreads(const std::string& subId) {
-
-    std::vector<pthread_t> canceled;
-
-    /* Get all the ThreadParams associated to the given subId. Inspired in
-     * http://advancedcppwithexamples.blogspot.com.es/2009/04/example-of-c-multimap.html
-     */
-    std::pair<std::multimap<std::string, ThreadData>::iterator, std::multimap<std::string, ThreadData>::iterator> ii;
-    std::multimap<std::string, ThreadData>::iterator it;
-    ii = this->threadsMap.equal_range(subId);
-    for (it = ii.first; it != ii.second; ++it) {
-
-        ThreadData td = it->second;
-
-        /* Destroy thread */        
-        int ret = pthread_cancel(td.tid);
-        if (ret != 0)
-        {
-          LM_E(("Runtime Error (error canceling thread %lu: %d)", (unsigned long) td.tid, ret));
-          return;
-        }
-
-        /* Note that we do the cancelation in parallel, storing the thread ID. This
-         * vector is processed afterwards to wait for every thread to finish */
-        canceled.push_back(td.tid);
-
-        /* Release memory */
-        delete td.params;
-
-    }
-
-    /* Remove key from the hashmap */
-    threadsMap.erase(subId);
-
-    /* Wait for all the cancelation to end */
-    for (unsigned int ix = 0; ix < canceled.size(); ++ix) {
-        void* res;
-
-        /* pthread_join in blocking */
-        int ret = pthread_join(canceled[ix], &res);
-        if (ret != 0)
-        {
-          LM_E(("Runtime Error (error joining thread %lu: %d)", (unsigned long) canceled[ix], ret));
-          return;
-        }
-
-        if (res == PTHREAD_CANCELED)
-        {
-            LM_T(LmtNotifier, ("canceled thread: %lu", (unsigned long) canceled[ix]));
-        }
-        else
-        {
-          LM_E(("Runtime Error (unexpected error: thread can not be canceled)"));
-          return;
-        }
-    }
-
-    canceled.clear();
+void Notifier::destroyOntimeIntervalThreads(const std::string& subId)
+{
+  intervalSchedulerRemove(subId);
 }
@@ -25,21 +25,50 @@
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
 
-#include "common/string.h"
-#include "alarmMgr/alarmMgr.h"
-
+#include "common/SyncQOverflow.h"
+#include "common/RingQOverflow.h"
 #include "ngsiNotify/QueueStatistics.h"
 #include "ngsiNotify/QueueNotifier.h"
 
 
 
+/* ****************************************************************************
+*
+* queueCreate -
+*/
+static QueueOverflow<SenderThreadParams*>* queueCreate(size_t queueSize, bool lockFree)
+{
+  if (lockFree)
+  {
+    return new RingQOverflow<SenderThreadParams*>(queueSize);
+  }
+
+  return new SyncQOverflow<SenderThreadParams*>(queueSize);
+}
+
+
+
 /* ****************************************************************************
 *
 * QueueNotifier::Notifier -
+*
+* If 'lockFree' is set, the queue is a lock-free ring buffer (RingQOverflow) instead of
+* a mutex-protected std::queue (SyncQOverflow)
 */
-QueueNotifier::QueueNotifier(size_t queueSize, int numThreads): queue(queueSize), workers(&queue, numThreads)
+QueueNotifier::QueueNotifier(size_t queueSize, int numThreads, bool lockFree): queue(queueCreate(queueSize, lockFree)), workers(queue, numThreads)
 {
-  LM_T(LmtNotifier,("Setting up queue and threads for notifications"));
+  LM_T(LmtNotifier,("Setting up %squeue and threads for notifications", lockFree? "lock-free " : ""));
+}
+
+
+
+/* ****************************************************************************
+*
+* QueueNotifier::~QueueNotifier -
+*/
+QueueNotifier::~QueueNotifier()
+{
+  delete queue;
 }
 
 
@@ -61,82 +90,14 @@ int QueueNotifier::start()
 */
 void QueueNotifier::sendNotifyContextRequest(NotifyContextRequest* ncr, const std::string& url, const std::string& tenant, const std::string& xauthToken, Format format)
 {
-  ConnectionInfo ci;
-
-  //
-  // FIXME P5: analyze how much of the code of this function is the same than in Notifier::sendNotifyContextRequest
-  // and could be refactored to common functions
-  //
-
-  //
-  // Creating the value of the Fiware-ServicePath HTTP header.
-  // This is a comma-separated list of the service-paths in the same order as the entities come in the payload
-  //
-  std::string spathList;
-  bool atLeastOneNotDefault = false;
-  for (unsigned int ix = 0; ix < ncr->contextElementResponseVector.size(); ++ix)
-  {
-    EntityId* eP = &ncr->contextElementResponseVector[ix]->contextElement.entityId;
-
-    if (spathList != "")
-    {
-      spathList += ",";
-    }
-    spathList += eP->servicePath;
-    atLeastOneNotDefault = atLeastOneNotDefault || (eP->servicePath != "/");
-  }
+  SenderThreadParams* params = senderThreadParamsBuild(ncr, url, tenant, xauthToken, format);
 
-  //
-  // FIXME P8: the stuff about atLeastOneNotDefault was added after PR #729, which makes "/" the default servicePath in
-  // request not having that header. However, this causes as side-effect that a
-  // "Fiware-ServicePath: /" or "Fiware-ServicePath: /,/" header is added in notifications, thus breaking several tests harness.
-  // Given that the "clean" implementation of Fiware-ServicePath propagation will be implemented
-  // soon (it has been scheduled for version 0.19.0, see https://github.com/telefonicaid/fiware-orion/issues/714)
-  // we introduce the atLeastOneNotDefault hack. Once #714 gets implemented,
-  // this FIXME will be removed (and all the test harness adjusted, if needed)
-  //
-  if (!atLeastOneNotDefault)
+  if (params == NULL)
   {
-    spathList = "";
-  }
-
-  ci.outFormat = format;
-  std::string payload = ncr->render(&ci, NotifyContext, "");
-
-  /* Parse URL */
-  std::string  host;
-  int          port;
-  std::string  uriPath;
-  std::string  protocol;
-
-  if (!parseUrl(url, host, port, uriPath, protocol))
-  {
-    std::string details = std::string("sending NotifyContextRequest: malformed URL: '") + url + "'";
-    alarmMgr.badInput(clientIp, details);
-
     return;
   }
 
-  /* Set Content-Type depending on the format */
-  std::string content_type = (format == XML)? "application/xml" : "application/json";
-
-  SenderThreadParams* params = new SenderThreadParams();
-  params->ip            = host;
-  params->port          = port;
-  params->protocol      = protocol;
-  params->verb          = "POST";
-  params->tenant        = tenant;
-  params->servicePath   = spathList;
-  params->xauthToken    = xauthToken;
-  params->resource      = uriPath;
-  params->content_type  = content_type;
-  params->content       = payload;
-  params->format        = format;
-  strncpy(params->transactionId, transactionId, sizeof(params->transactionId));
-
-  clock_gettime(CLOCK_REALTIME, &params->timeStamp);
-
-  bool enqueued = queue.try_push(params);
+  bool enqueued = queue->try_push(params);
   if (!enqueued)
   {
    QueueStatistics::incReject();
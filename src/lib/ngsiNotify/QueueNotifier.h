@@ -28,7 +28,7 @@
 */
 
 
-#include "common/SyncQOverflow.h"
+#include "common/QueueOverflow.h"
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
 #include "ngsiNotify/Notifier.h"
@@ -47,11 +47,12 @@
 class QueueNotifier : public Notifier
 {
 public:
-  QueueNotifier(size_t queueSize, int numThreads);
+  QueueNotifier(size_t queueSize, int numThreads, bool lockFree = false);
+  ~QueueNotifier();
   void sendNotifyContextRequest(NotifyContextRequest* ncr, const std::string& url, const std::string& tenant, const std::string& xauthToken, Format format);
   int start();
 private:
- SyncQOverflow<SenderThreadParams*> queue;
+ QueueOverflow<SenderThreadParams*>* queue;
  QueueWorkers workers;
 
 };
@@ -39,14 +39,6 @@
 
 
 
-/* ****************************************************************************
-*
-* workerFunc - prototype
-*/
-static void* workerFunc(void* pSyncQ);
-
-
-
 /* ****************************************************************************
 *
 * QueueWorkers::start() -
@@ -56,7 +48,7 @@ int QueueWorkers::start()
   for (int i = 0; i < numberOfThreads; ++i)
   {
     pthread_t tid;
-    int rc = pthread_create(&tid, NULL, workerFunc, pQueue);
+    int rc = pthread_create(&tid, NULL, workerFunc, this);
     if (rc != 0)
     {
       return rc;
@@ -67,11 +59,19 @@ int QueueWorkers::start()
 
 /* ****************************************************************************
 *
-* QueueWorkers::start() -
+* QueueWorkers::workerFunc -
+*
+* Notifications are taken from the queue in batches, but no more than the fair share
+* of a worker, so that other workers are not left idle while a batch waits to be sent.
+*
+* The size of the queue (for the fair share and the queue statistics) is the one given by
+* popBatch, so the queue is not locked again to read it.
 */
-static void *workerFunc(void* pSyncQ)
+void* QueueWorkers::workerFunc(void* vP)
 {
-  SyncQOverflow<SenderThreadParams*> *queue = (SyncQOverflow<SenderThreadParams*> *) pSyncQ;
+  QueueWorkers*                        workersP = (QueueWorkers*) vP;
+  QueueOverflow<SenderThreadParams*>*  queue    = workersP->pQueue;
+  SenderThreadParams*                  paramsV[QUEUE_WORKERS_BATCH_MAX];
   CURL *curl;
 
   // Initialize curl context
@@ -83,81 +83,95 @@ static void *workerFunc(void* pSyncQ)
     pthread_exit(NULL);
   }
 
+  size_t left = 0;
+
   for (;;)
   {
-    SenderThreadParams* params = queue->pop();
-    struct timespec     now;
-    struct timespec     howlong;
-    size_t              estimatedQSize;
-
-    QueueStatistics::incOut();
-    clock_gettime(CLOCK_REALTIME, &now);
-    clock_difftime(&now, &params->timeStamp, &howlong);
-    estimatedQSize = queue->size();
-    QueueStatistics::addTimeInQWithSize(&howlong, estimatedQSize);
-
-    strncpy(transactionId, params->transactionId, sizeof(transactionId));
-
-    LM_T(LmtNotifier, ("worker sending to: host='%s', port=%d, verb=%s, tenant='%s', service-path: '%s', xauthToken: '%s', path='%s', content-type: %s",
-                       params->ip.c_str(),
-                       params->port,
-                       params->verb.c_str(),
-                       params->tenant.c_str(),
-                       params->servicePath.c_str(),
-                       params->xauthToken.c_str(),
-                       params->resource.c_str(),
-                       params->content_type.c_str()));
-
-    if (simulatedNotification)
+    size_t batchMax = 1 + left / workersP->numberOfThreads;
+
+    if (batchMax > QUEUE_WORKERS_BATCH_MAX)
     {
-      LM_T(LmtNotifier, ("simulatedNotification is 'true', skipping outgoing request"));
-      __sync_fetch_and_add(&noOfSimulatedNotifications, 1);
+      batchMax = QUEUE_WORKERS_BATCH_MAX;
     }
-    else // we'll send the notification
+
+    size_t n = queue->popBatch(paramsV, batchMax, &left);
+
+    for (size_t ix = 0; ix < n; ++ix)
     {
-      std::string  out;
-      int          r;
-
-      r =  httpRequestSendWithCurl(curl,
-                                   params->ip,
-                                   params->port,
-                                   params->protocol,
-                                   params->verb,
-                                   params->tenant,
-                                   params->servicePath,
-                                   params->xauthToken,
-                                   params->resource,
-                                   params->content_type,
-                                   params->content,
-                                   true,
-                                   NOTIFICATION_WAIT_MODE,
-                                   &out);
-
-      //
-      // FIXME: ok and error counter should be incremented in the other notification modes (generalizing the concept, i.e.
-      // not as member of QueueStatistics:: which seems to be tied to just the threadpool notification mode)
-      //
-      char portV[STRING_SIZE_FOR_INT];
-      snprintf(portV, sizeof(portV), "%d", params->port);
-      std::string url = params->ip + ":" + portV + params->resource;
-
-      if (r == 0)
+      SenderThreadParams* params = paramsV[ix];
+      struct timespec     now;
+      struct timespec     howlong;
+      size_t              estimatedQSize;
+
+      QueueStatistics::incOut();
+      clock_gettime(CLOCK_REALTIME, &now);
+      clock_difftime(&now, &params->timeStamp, &howlong);
+      estimatedQSize = left + (n - ix - 1);  // the rest of the batch is still waiting
+      QueueStatistics::addTimeInQWithSize(&howlong, estimatedQSize);
+
+      strncpy(transactionId, params->transactionId, sizeof(transactionId));
+
+      LM_T(LmtNotifier, ("worker sending to: host='%s', port=%d, verb=%s, tenant='%s', service-path: '%s', xauthToken: '%s', path='%s', content-type: %s",
+                         params->ip.c_str(),
+                         params->port,
+                         params->verb.c_str(),
+                         params->tenant.c_str(),
+                         params->servicePath.c_str(),
+                         params->xauthToken.c_str(),
+                         params->resource.c_str(),
+                         params->content_type.c_str()));
+
+      if (simulatedNotification)
       {
-        statisticsUpdate(NotifyContextSent, params->format);
-        QueueStatistics::incSentOK();
-        alarmMgr.notificationErrorReset(url);
+        LM_T(LmtNotifier, ("simulatedNotification is 'true', skipping outgoing request"));
+        ++noOfSimulatedNotifications;
       }
-      else
+      else // we'll send the notification
       {
-        QueueStatistics::incSentError();
-        alarmMgr.notificationError(url, "notification failure for queue worker");
+        std::string  out;
+        int          r;
+
+        r =  httpRequestSendWithCurl(curl,
+                                     params->ip,
+                                     params->port,
+                                     params->protocol,
+                                     params->verb,
+                                     params->tenant,
+                                     params->servicePath,
+                                     params->xauthToken,
+                                     params->resource,
+                                     params->content_type,
+                                     params->content,
+                                     true,
+                                     NOTIFICATION_WAIT_MODE,
+                                     &out);
+
+        //
+        // FIXME: ok and error counter should be incremented in the other notification modes (generalizing the concept, i.e.
+        // not as member of QueueStatistics:: which seems to be tied to just the threadpool notification mode)
+        //
+        char portV[STRING_SIZE_FOR_INT];
+        snprintf(portV, sizeof(portV), "%d", params->port);
+        std::string url = params->ip + ":" + portV + params->resource;
+
+        if (r == 0)
+        {
+          statisticsUpdate(NotifyContextSent, params->format);
+          QueueStatistics::incSentOK();
+          alarmMgr.notificationErrorReset(url);
+        }
+        else
+        {
+          QueueStatistics::incSentError();
+          alarmMgr.notificationError(url, "notification failure for queue worker");
+        }
       }
-    }
 
-    // Free params memory
-    delete params;
+      // Free params memory
+      delete params;
 
-    // Reset curl for next iteration
-    curl_easy_reset(curl);
+      // Reset curl for next iteration
+      curl_easy_reset(curl);
+    }
   }
 }
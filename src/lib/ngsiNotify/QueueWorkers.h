@@ -25,16 +25,20 @@
 * Author: Orion dev team
 */
 
-#include "common/SyncQOverflow.h"
+#include "common/QueueOverflow.h"
 #include "ngsiNotify/senderThread.h"
 
+// maximum number of notifications a worker takes from the queue at a time
+#define QUEUE_WORKERS_BATCH_MAX 16
+
 class QueueWorkers
 {
 public:
-  QueueWorkers(SyncQOverflow<SenderThreadParams*> *pQ, int numThreads): pQueue(pQ), numberOfThreads(numThreads) {}
+  QueueWorkers(QueueOverflow<SenderThreadParams*> *pQ, int numThreads): pQueue(pQ), numberOfThreads(numThreads) {}
   int start();
 private:
-    SyncQOverflow<SenderThreadParams*> *pQueue;
+    static void* workerFunc(void* vP);
+    QueueOverflow<SenderThreadParams*> *pQueue;
     int numberOfThreads;
 };
 
@@ -0,0 +1,223 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+#include <map>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "ngsiNotify/notifCoalesce.h"
+
+
+
+/* ****************************************************************************
+*
+* CoalescedNotification - a notification being coalesced
+*
+* 'entityIx' maps an entity (id, type and service path) to its position in the
+* contextElementResponseVector of 'ncr'.
+*/
+typedef struct CoalescedNotification
+{
+  NotifyContextRequest                 ncr;
+  std::string                          url;
+  std::string                          tenant;
+  std::string                          xauthToken;
+  Format                               format;
+  std::map<std::string, unsigned int>  entityIx;
+} CoalescedNotification;
+
+
+
+/* ****************************************************************************
+*
+* CoalesceBuffer - the notifications coalesced by a thread, in order of arrival
+*/
+typedef struct CoalesceBuffer
+{
+  std::vector<CoalescedNotification*>     notifV;
+  std::map<std::string, unsigned int>     notifIx;
+  std::vector<std::string>                sentSubIdV;   // subscription of each notification sent
+} CoalesceBuffer;
+
+
+
+/* ****************************************************************************
+*
+* coalesceBufferP - the buffer of the calling thread, NULL when not coalescing
+*/
+static __thread CoalesceBuffer* coalesceBufferP = NULL;
+
+
+
+/* ****************************************************************************
+*
+* coalescedSend -
+*/
+static void coalescedSend(Notifier* notifierP, CoalesceBuffer* bufP, CoalescedNotification* cnP)
+{
+  LM_T(LmtNotifier, ("sending coalesced notification for subscription '%s' with %d entities",
+                     cnP->ncr.subscriptionId.get().c_str(),
+                     cnP->ncr.contextElementResponseVector.size()));
+
+  notifierP->sendNotifyContextRequest(&cnP->ncr, cnP->url, cnP->tenant, cnP->xauthToken, cnP->format);
+  bufP->sentSubIdV.push_back(cnP->ncr.subscriptionId.get());
+
+  cnP->ncr.release();
+  cnP->entityIx.clear();
+}
+
+
+
+/* ****************************************************************************
+*
+* notifCoalesceBegin -
+*/
+void notifCoalesceBegin(void)
+{
+  if (coalesceBufferP == NULL)
+  {
+    coalesceBufferP = new CoalesceBuffer();
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* notifCoalesceAdd -
+*/
+bool notifCoalesceAdd
+(
+  Notifier*              notifierP,
+  NotifyContextRequest*  ncrP,
+  const std::string&     url,
+  const std::string&     tenant,
+  const std::string&     xauthToken,
+  Format                 format
+)
+{
+  CoalesceBuffer*         bufP = coalesceBufferP;
+  CoalescedNotification*  cnP;
+
+  if (bufP == NULL)
+  {
+    return false;
+  }
+
+  std::string                                    key = ncrP->subscriptionId.get() + '|' + url;
+  std::map<std::string, unsigned int>::iterator  it  = bufP->notifIx.find(key);
+
+  if (it == bufP->notifIx.end())
+  {
+    cnP = new CoalescedNotification();
+
+    cnP->ncr.subscriptionId.set(ncrP->subscriptionId.get());
+    cnP->ncr.originator.set(ncrP->originator.get());
+    cnP->url        = url;
+    cnP->tenant     = tenant;
+    cnP->xauthToken = xauthToken;
+    cnP->format     = format;
+
+    bufP->notifIx[key] = bufP->notifV.size();
+    bufP->notifV.push_back(cnP);
+  }
+  else
+  {
+    cnP = bufP->notifV[it->second];
+  }
+
+  for (unsigned int ix = 0; ix < ncrP->contextElementResponseVector.size(); ++ix)
+  {
+    ContextElementResponse*  cerP      = ncrP->contextElementResponseVector[ix]->clone();
+    EntityId*                enP       = &cerP->contextElement.entityId;
+    std::string              entityKey = enP->id + '|' + enP->type + '|' + enP->servicePath;
+
+    std::map<std::string, unsigned int>::iterator  eIt = cnP->entityIx.find(entityKey);
+
+    if (eIt != cnP->entityIx.end())
+    {
+      // Already notified entity: the new context element replaces the old one
+      ContextElementResponse* oldP = cnP->ncr.contextElementResponseVector.vec[eIt->second];
+
+      oldP->release();
+      delete oldP;
+      cnP->ncr.contextElementResponseVector.vec[eIt->second] = cerP;
+      continue;
+    }
+
+    if (cnP->ncr.contextElementResponseVector.size() >= NOTIF_COALESCE_MAX_ENTITIES)
+    {
+      coalescedSend(notifierP, bufP, cnP);
+    }
+
+    cnP->entityIx[entityKey] = cnP->ncr.contextElementResponseVector.size();
+    cnP->ncr.contextElementResponseVector.push_back(cerP);
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* notifCoalesceFlush -
+*/
+int notifCoalesceFlush(Notifier* notifierP, std::vector<std::string>* subIdV)
+{
+  CoalesceBuffer*  bufP = coalesceBufferP;
+  int              sent = 0;
+
+  if (bufP == NULL)
+  {
+    return 0;
+  }
+
+  coalesceBufferP = NULL;
+
+  for (unsigned int ix = 0; ix < bufP->notifV.size(); ++ix)
+  {
+    CoalescedNotification* cnP = bufP->notifV[ix];
+
+    if (cnP->ncr.contextElementResponseVector.size() != 0)
+    {
+      coalescedSend(notifierP, bufP, cnP);
+      ++sent;
+    }
+
+    delete cnP;
+  }
+
+  if (subIdV != NULL)
+  {
+    subIdV->insert(subIdV->end(), bufP->sentSubIdV.begin(), bufP->sentSubIdV.end());
+  }
+
+  delete bufP;
+
+  return sent;
+}
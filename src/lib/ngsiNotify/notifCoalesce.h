@@ -0,0 +1,90 @@
+#ifndef SRC_LIB_NGSINOTIFY_NOTIFCOALESCE_H_
+#define SRC_LIB_NGSINOTIFY_NOTIFCOALESCE_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "common/Format.h"
+#include "ngsi10/NotifyContextRequest.h"
+#include "ngsiNotify/Notifier.h"
+
+
+
+/* ****************************************************************************
+*
+* NOTIF_COALESCE_MAX_ENTITIES - maximum number of entities in a coalesced notification
+*/
+#define NOTIF_COALESCE_MAX_ENTITIES 1000
+
+
+
+/* ****************************************************************************
+*
+* notifCoalesceBegin - start coalescing the notifications of the calling thread
+*
+* Between notifCoalesceBegin and notifCoalesceFlush, notifications added with
+* notifCoalesceAdd are held back, and all the notifications for the same subscription
+* (and reference) are merged into a single NotifyContextRequest, with one context
+* element per entity (the last one notified, if an entity is notified more than once).
+*/
+extern void notifCoalesceBegin(void);
+
+
+
+/* ****************************************************************************
+*
+* notifCoalesceAdd - add a notification to the ones being coalesced
+*
+* The context elements of 'ncrP' are copied, so the caller keeps the ownership of 'ncrP'.
+* Returns false (nothing done) if the calling thread is not coalescing notifications,
+* in which case the notification is to be sent as usual.
+*/
+extern bool notifCoalesceAdd
+(
+  Notifier*              notifierP,
+  NotifyContextRequest*  ncrP,
+  const std::string&     url,
+  const std::string&     tenant,
+  const std::string&     xauthToken,
+  Format                 format
+);
+
+
+
+/* ****************************************************************************
+*
+* notifCoalesceFlush - send the coalesced notifications and stop coalescing
+*
+* Returns the number of notifications sent. If 'subIdV' is not NULL, the subscription
+* of each notification sent since notifCoalesceBegin (a notification reaching
+* NOTIF_COALESCE_MAX_ENTITIES is sent before the flush) is added to it, so that the
+* caller updates the count and last notification time of the subscription once per
+* notification.
+*/
+extern int notifCoalesceFlush(Notifier* notifierP, std::vector<std::string>* subIdV);
+
+#endif  // SRC_LIB_NGSINOTIFY_NOTIFCOALESCE_H_
@@ -0,0 +1,185 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+
+#include <string>
+#include <map>
+
+#include "logMsg/logMsg.h"
+#include "logMsg/traceLevels.h"
+
+#include "rest/ConnectionInfo.h"
+#include "ngsiNotify/notifPayloadCache.h"
+
+
+
+/* ****************************************************************************
+*
+* SUBID_PLACEHOLDER - rendered in place of the subscriptionId, to find where it goes
+*/
+#define SUBID_PLACEHOLDER  "@@orionSubscriptionId@@"
+
+
+
+/* ****************************************************************************
+*
+* PayloadTemplate - a rendered payload, split at the subscriptionId
+*
+* If the placeholder is not found exactly once (e.g. it is also in an attribute value),
+* the payload is not spliceable and notifications are rendered as usual.
+*/
+typedef struct PayloadTemplate
+{
+  bool         spliceable;
+  std::string  prefix;
+  std::string  suffix;
+} PayloadTemplate;
+
+
+
+/* ****************************************************************************
+*
+* payloadCacheP - the cache of the calling thread, NULL when not caching
+*/
+static __thread std::map<std::string, PayloadTemplate>* payloadCacheP = NULL;
+
+
+
+/* ****************************************************************************
+*
+* notifPayloadCacheBegin - 
+*/
+void notifPayloadCacheBegin(void)
+{
+  if (payloadCacheP == NULL)
+  {
+    payloadCacheP = new std::map<std::string, PayloadTemplate>();
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* payloadKey - what makes a difference in the payload of a notification, but the subscriptionId
+*/
+static std::string payloadKey(NotifyContextRequest* ncrP, Format format)
+{
+  char         buf[64];
+  std::string  key;
+
+  snprintf(buf, sizeof(buf), "%d", format);
+  key = std::string(buf) + '\0' + ncrP->originator.get();
+
+  for (unsigned int ix = 0; ix < ncrP->contextElementResponseVector.size(); ++ix)
+  {
+    ContextElementResponse* cerP = ncrP->contextElementResponseVector[ix];
+    EntityId*               eP   = &cerP->contextElement.entityId;
+
+    snprintf(buf, sizeof(buf), "%d", cerP->statusCode.code);
+    key += '\0' + eP->id + '\0' + eP->type + '\0' + eP->isPattern + '\0' + eP->servicePath + '\0' + buf;
+
+    for (unsigned int aIx = 0; aIx < cerP->contextElement.contextAttributeVector.size(); ++aIx)
+    {
+      snprintf(buf, sizeof(buf), ",%p", (void*) cerP->contextElement.contextAttributeVector[aIx]);
+      key += buf;
+    }
+  }
+
+  return key;
+}
+
+
+
+/* ****************************************************************************
+*
+* notifPayloadRender - 
+*/
+std::string notifPayloadRender(NotifyContextRequest* ncrP, Format format)
+{
+  ConnectionInfo ci;
+
+  ci.outFormat = format;
+
+  if (payloadCacheP == NULL)
+  {
+    return ncrP->render(&ci, NotifyContext, "");
+  }
+
+  std::string                                       key = payloadKey(ncrP, format);
+  std::map<std::string, PayloadTemplate>::iterator  it  = payloadCacheP->find(key);
+
+  if (it == payloadCacheP->end())
+  {
+    std::string      subId = ncrP->subscriptionId.get();
+    PayloadTemplate  pt;
+
+    ncrP->subscriptionId.set(SUBID_PLACEHOLDER);
+    std::string payload = ncrP->render(&ci, NotifyContext, "");
+    ncrP->subscriptionId.set(subId);
+
+    size_t pos = payload.find(SUBID_PLACEHOLDER);
+
+    pt.spliceable = (pos != std::string::npos) && (payload.find(SUBID_PLACEHOLDER, pos + 1) == std::string::npos);
+    if (pt.spliceable)
+    {
+      pt.prefix = payload.substr(0, pos);
+      pt.suffix = payload.substr(pos + sizeof(SUBID_PLACEHOLDER) - 1);
+    }
+
+    it = payloadCacheP->insert(std::make_pair(key, pt)).first;
+  }
+  else
+  {
+    LM_T(LmtNotifier, ("reusing rendered notification payload for subscription '%s'", ncrP->subscriptionId.get().c_str()));
+  }
+
+  if (!it->second.spliceable)
+  {
+    return ncrP->render(&ci, NotifyContext, "");
+  }
+
+  std::string subId = ncrP->subscriptionId.get();
+  std::string payload;
+
+  payload.reserve(it->second.prefix.size() + subId.size() + it->second.suffix.size());
+  payload += it->second.prefix;
+  payload += subId;
+  payload += it->second.suffix;
+
+  return payload;
+}
+
+
+
+/* ****************************************************************************
+*
+* notifPayloadCacheEnd - 
+*/
+void notifPayloadCacheEnd(void)
+{
+  delete payloadCacheP;
+  payloadCacheP = NULL;
+}
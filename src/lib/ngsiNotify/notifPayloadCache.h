@@ -0,0 +1,66 @@
+#ifndef SRC_LIB_NGSINOTIFY_NOTIFPAYLOADCACHE_H_
+#define SRC_LIB_NGSINOTIFY_NOTIFPAYLOADCACHE_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+
+#include "common/Format.h"
+#include "ngsi10/NotifyContextRequest.h"
+
+
+
+/* ****************************************************************************
+*
+* notifPayloadCacheBegin - start reusing the notification payloads rendered by the calling thread
+*
+* Between notifPayloadCacheBegin and notifPayloadCacheEnd, notifPayloadRender renders each
+* different notification (format, entities and attributes) only once: the notifications that
+* differ only in the subscriptionId get a copy of the already rendered payload, with their
+* own subscriptionId spliced in.
+*
+* The notifications are told apart by their ContextAttribute pointers, so, while caching, the
+* attributes being notified must be neither modified nor freed (which is the case of the
+* notifications triggered by the update of an entity, see processSubscriptions).
+*/
+extern void notifPayloadCacheBegin(void);
+
+
+
+/* ****************************************************************************
+*
+* notifPayloadRender - render a NotifyContextRequest, using the cache if active
+*/
+extern std::string notifPayloadRender(NotifyContextRequest* ncrP, Format format);
+
+
+
+/* ****************************************************************************
+*
+* notifPayloadCacheEnd - stop caching and free the cached payloads
+*/
+extern void notifPayloadCacheEnd(void);
+
+#endif  // SRC_LIB_NGSINOTIFY_NOTIFPAYLOADCACHE_H_
@@ -23,14 +23,15 @@
 * Author: Fermin Galan
 */
 #include <string>
+#include <vector>
+#include <map>
 #include <stdio.h>
-#include <unistd.h>      // needed for sleep in Debian 7
+#include <string.h>
 
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
 
 #include "common/globals.h"
-#include "common/sem.h"
 #include "mongoBackend/MongoGlobal.h"
 #include "mongoBackend/mongoOntimeintervalOperations.h"
 #include "ngsi/Duration.h"
@@ -44,131 +45,128 @@
 
 /* ****************************************************************************
 *
-* doNotification -
+* queryKey - key identifying the query of a subscription (entities and attributes)
 */
-static void doNotification(OnIntervalThreadParams* params, const std::string& tenant)
+static std::string queryKey(const ContextSubscriptionInfo& csi)
 {
-    std::string err;
+  std::string key;
 
-    /* Get document from database. Note that although we can include some parameters in
-     * OnIntervalThreadParams coming for the csubs document at thread creation time
-     * from mongoBackend, we always needs that to get fresh lastNotification */
-    ContextSubscriptionInfo csi;
-    if (mongoGetContextSubscriptionInfo(params->subId, &csi, &err, tenant) != SccOk)
+  for (unsigned int ix = 0; ix < csi.entityIdVector.size(); ++ix)
+  {
+    EntityId* enP = csi.entityIdVector[ix];
+
+    key += enP->id + '\x01' + enP->type + '\x01' + enP->isPattern + '\x02';
+  }
+
+  key += '\x03';
+
+  for (unsigned int ix = 0; ix < csi.attributeList.size(); ++ix)
+  {
+    key += csi.attributeList[ix] + '\x01';
+  }
+
+  return key;
+}
+
+
+
+/* ****************************************************************************
+*
+* onTimeIntervalNotify -
+*
+* The subscriptions are read from database (we always need a fresh lastNotification, so the
+* information at scheduling time is not enough), and those to be notified are grouped by
+* entities and attributes, so the context elements are queried once per group.
+*/
+void onTimeIntervalNotify(const std::string& tenant, const std::vector<OnIntervalThreadParams*>& paramsV)
+{
+  std::string                                           err;
+  std::vector<ContextSubscriptionInfo>                  csiV(paramsV.size());
+  std::map<std::string, std::vector<unsigned int> >     groups;
+  int                                                   current = getCurrentTime();
+
+  strncpy(transactionId, "N/A", sizeof(transactionId));
+
+  for (unsigned int ix = 0; ix < paramsV.size(); ++ix)
+  {
+    ContextSubscriptionInfo* csiP = &csiV[ix];
+
+    LM_T(LmtNotifier, ("ONTIMEINTERVAL notification wakes up (%s)", paramsV[ix]->subId.c_str()));
+
+    if (mongoGetContextSubscriptionInfo(paramsV[ix]->subId, csiP, &err, tenant) != SccOk)
     {
       //
       // FIXME P6: mongoGetContextSubscriptionInfo ALWAYS returns SccOk
       //           github issue #575.
-      //           If it didn't we would have a leak right here, as mongoGetContextSubscriptionInfo
-      //           allocates entities and pushes them to 'csi', which is lost leaving this function.
       //
       alarmMgr.dbError("error invoking mongoGetContextSubscriptionInfo");
-      return;
+      continue;
     }
     alarmMgr.dbErrorReset();
 
-    int current = getCurrentTime();
+    /* Send notification only if subscription is not expired ... */
+    if (current >= csiP->expiration)
+    {
+      continue;
+    }
 
-    /* Send notification (only if subscription is not expired and there is actual data)*/
-    if (current < csi.expiration)
+    /* ... and throttling allows it (only if throttling is used and at least one notification has been sent) */
+    if (csiP->throttling >= 0 && csiP->lastNotification >= 0 && csiP->lastNotification + csiP->throttling >= current)
     {
-        /* Throttling check (only if throttling is used and at least one notification has been sent) */
-        if (csi.throttling < 0 || csi.lastNotification < 0 || csi.lastNotification + csi.throttling <  current)
-        {
-            /* Query database for data */
-            NotifyContextRequest ncr;
-
-            // FIXME P7: mongoGetContextElementResponses ALWAYS returns SccOk !!!
-            if (mongoGetContextElementResponses(csi.entityIdVector, csi.attributeList, &(ncr.contextElementResponseVector), &err, tenant) != SccOk)
-            {
-              csi.release();
-              ncr.contextElementResponseVector.release();
-              alarmMgr.dbError("error invoking mongoGetContextElementResponses");
-              return;
-            }
-            alarmMgr.dbErrorReset();
-
-            if (ncr.contextElementResponseVector.size() > 0)
-            {
-                /* Complete NotifyContextRequest */
-                // FIXME: implement a proper originator string
-                ncr.originator.set("localhost");
-                ncr.subscriptionId.set(params->subId);
-
-                // Update database fields due to new notification
-                HttpStatusCode s = mongoUpdateCsubNewNotification(params->subId, &err, tenant);
-                if (s == SccOk)
-                {
-                  // FIXME P6: Note that the X-Auth-Token is left blank in this case.
-                  //           In the future, the ONTIMEINTERVAL notification struture *could* include it
-                  //           (and a TRUST_TOKEN to re-negotiate X-Auth-Token if it gets expired)"
-                  //
-                  params->notifier->sendNotifyContextRequest(&ncr, csi.url, tenant, "", csi.format);
-                }
-
-                ncr.contextElementResponseVector.release();
-                csi.release();
-            }
-            else
-            {
-              LM_T(LmtNotifier, ("notification not sent due to empty context elements response vector)"));
-            }
-        }
-        else
-        {
-          LM_T(LmtNotifier, ("notification not sent due to throttling (current time: %d)", current));
-        }
+      LM_T(LmtNotifier, ("notification not sent due to throttling (current time: %d)", current));
+      continue;
     }
 
-    //
-    // FIXME P3: mongoGetContextSubscriptionInfo allocates an EntityId and pushes it to csi.
-    //           github issue #576.
-    //           Here that entity is released, but this is running in a separate thread.
-    //           Sometimes, when the broker is killed, this thread is inside the mongoGetContextSubscriptionInfo
-    //           and the new entityId is considered a memory leak by valgrind.
-    //           This is no mempry leak, Everything is under control, but as Jenkins complains about a leak,
-    //           it is annoying.
-    //           What we need to do is to make the broker die in a more controlled manner, making the threads
-    //           exit and wait for them to exit, before the broker itself exits.
-    //           This should be done when receiving an /exit (only valid for DEBUG compilations).
-    //
-    csi.release();
-}
+    groups[queryKey(*csiP)].push_back(ix);
+  }
 
-/* ****************************************************************************
-*
-* startOnIntervalThread -
-*
-* About pthread_setcancelstate:
-* The problem with this ontimeinterval subscription thread is that during valgrind tests,
-* the broker if started and killed and if this thread is running, it it sometimes cancelled 
-* with buffers allocated and valgrind will flag this as a memory leak.
-* Using the function pthread_setcancelstate, we can decide when the thread is cancelable and
-* thus avoid to be cancelled with memory allocated.
-* The function 'doNotification' allocates and releases its own memory buffers so if this thread
-* is never cancelled inside 'doNotification', this "false leak" should disappear.
-* 
-*/
-void* startOnIntervalThread(void* p)
-{
-  OnIntervalThreadParams* params = (OnIntervalThreadParams*) p;
-  int                     oldState;
+  for (std::map<std::string, std::vector<unsigned int> >::iterator it = groups.begin(); it != groups.end(); ++it)
+  {
+    const std::vector<unsigned int>&  members = it->second;
+    ContextSubscriptionInfo*          csiP    = &csiV[members[0]];
+    NotifyContextRequest              ncr;
 
-  pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, &oldState);
+    /* Query database for data (only once for all the subscriptions in the group) */
+    // FIXME P7: mongoGetContextElementResponses ALWAYS returns SccOk !!!
+    if (mongoGetContextElementResponses(csiP->entityIdVector, csiP->attributeList, &(ncr.contextElementResponseVector), &err, tenant) != SccOk)
+    {
+      ncr.contextElementResponseVector.release();
+      alarmMgr.dbError("error invoking mongoGetContextElementResponses");
+      continue;
+    }
+    alarmMgr.dbErrorReset();
 
-  while (true)
-  {
-    strncpy(transactionId, "N/A", sizeof(transactionId));
-    LM_T(LmtNotifier, ("ONTIMEINTERVAL thread wakes up (%s)", params->subId.c_str()));
+    if (ncr.contextElementResponseVector.size() == 0)
+    {
+      LM_T(LmtNotifier, ("notification not sent due to empty context elements response vector)"));
+      continue;
+    }
 
-    // Do the work (we put this in a function as error conditions would produce an
-    // early interruption of the process)
-    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &oldState);
-    doNotification(params, params->tenant);
-    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &oldState);
+    // FIXME: implement a proper originator string
+    ncr.originator.set("localhost");
 
-    sleep(params->interval);
+    for (unsigned int mIx = 0; mIx < members.size(); ++mIx)
+    {
+      OnIntervalThreadParams*  params = paramsV[members[mIx]];
+
+      ncr.subscriptionId.set(params->subId);
+
+      // Update database fields due to new notification
+      if (mongoUpdateCsubNewNotification(params->subId, &err, tenant) == SccOk)
+      {
+        // FIXME P6: Note that the X-Auth-Token is left blank in this case.
+        //           In the future, the ONTIMEINTERVAL notification struture *could* include it
+        //           (and a TRUST_TOKEN to re-negotiate X-Auth-Token if it gets expired)"
+        //
+        params->notifier->sendNotifyContextRequest(&ncr, csiV[members[mIx]].url, tenant, "", csiV[members[mIx]].format);
+      }
+    }
+
+    ncr.contextElementResponseVector.release();
   }
 
-  return NULL;
+  for (unsigned int ix = 0; ix < csiV.size(); ++ix)
+  {
+    csiV[ix].release();
+  }
 }
@@ -27,11 +27,16 @@
 */
 
 #include <string>
+#include <vector>
+
+#include "ngsiNotify/OnIntervalThreadParams.h"
+
+
 
 /* ****************************************************************************
 *
-* startOnIntervalThread -
+* onTimeIntervalNotify - send the ONTIMEINTERVAL notifications of a set of subscriptions of a tenant
 */
-extern void* startOnIntervalThread(void* params);
+extern void onTimeIntervalNotify(const std::string& tenant, const std::vector<OnIntervalThreadParams*>& paramsV);
 
 #endif
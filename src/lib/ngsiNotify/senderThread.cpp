@@ -25,12 +25,107 @@
 
 #include "common/statistics.h"
 #include "common/limits.h"
+#include "common/string.h"
 #include "alarmMgr/alarmMgr.h"
 #include "rest/httpRequestSend.h"
+#include "ngsiNotify/notifPayloadCache.h"
 #include "ngsiNotify/senderThread.h"
 
 
 
+/* ****************************************************************************
+*
+* senderThreadParamsBuild - render a notification and prepare its sending
+*
+* Used by the notifiers that queue notifications to be sent by other threads (the
+* timestamp for queue statistics is set here). Returns NULL if the URL is malformed.
+*/
+SenderThreadParams* senderThreadParamsBuild
+(
+  NotifyContextRequest*  ncr,
+  const std::string&     url,
+  const std::string&     tenant,
+  const std::string&     xauthToken,
+  Format                 format
+)
+{
+  //
+  // FIXME P5: analyze how much of the code of this function is the same than in Notifier::sendNotifyContextRequest
+  // and could be refactored to common functions
+  //
+
+  //
+  // Creating the value of the Fiware-ServicePath HTTP header.
+  // This is a comma-separated list of the service-paths in the same order as the entities come in the payload
+  //
+  std::string spathList;
+  bool atLeastOneNotDefault = false;
+  for (unsigned int ix = 0; ix < ncr->contextElementResponseVector.size(); ++ix)
+  {
+    EntityId* eP = &ncr->contextElementResponseVector[ix]->contextElement.entityId;
+
+    if (spathList != "")
+    {
+      spathList += ",";
+    }
+    spathList += eP->servicePath;
+    atLeastOneNotDefault = atLeastOneNotDefault || (eP->servicePath != "/");
+  }
+
+  //
+  // FIXME P8: the stuff about atLeastOneNotDefault was added after PR #729, which makes "/" the default servicePath in
+  // request not having that header. However, this causes as side-effect that a
+  // "Fiware-ServicePath: /" or "Fiware-ServicePath: /,/" header is added in notifications, thus breaking several tests harness.
+  // Given that the "clean" implementation of Fiware-ServicePath propagation will be implemented
+  // soon (it has been scheduled for version 0.19.0, see https://github.com/telefonicaid/fiware-orion/issues/714)
+  // we introduce the atLeastOneNotDefault hack. Once #714 gets implemented,
+  // this FIXME will be removed (and all the test harness adjusted, if needed)
+  //
+  if (!atLeastOneNotDefault)
+  {
+    spathList = "";
+  }
+
+  std::string payload = notifPayloadRender(ncr, format);
+
+  /* Parse URL */
+  std::string  host;
+  int          port;
+  std::string  uriPath;
+  std::string  protocol;
+
+  if (!parseUrl(url, host, port, uriPath, protocol))
+  {
+    std::string details = std::string("sending NotifyContextRequest: malformed URL: '") + url + "'";
+    alarmMgr.badInput(clientIp, details);
+
+    return NULL;
+  }
+
+  /* Set Content-Type depending on the format */
+  std::string content_type = (format == XML)? "application/xml" : "application/json";
+
+  SenderThreadParams* params = new SenderThreadParams();
+  params->ip            = host;
+  params->port          = port;
+  params->protocol      = protocol;
+  params->verb          = "POST";
+  params->tenant        = tenant;
+  params->servicePath   = spathList;
+  params->xauthToken    = xauthToken;
+  params->resource      = uriPath;
+  params->content_type  = content_type;
+  params->content       = payload;
+  params->format        = format;
+  strncpy(params->transactionId, transactionId, sizeof(params->transactionId));
+
+  clock_gettime(CLOCK_REALTIME, &params->timeStamp);
+
+  return params;
+}
+
+
+
 /* ****************************************************************************
 *
 * startSenderThread -
@@ -84,7 +179,7 @@ void* startSenderThread(void* p)
     else
     {
       LM_T(LmtNotifier, ("simulatedNotification is 'true', skipping outgoing request"));
-      __sync_fetch_and_add(&noOfSimulatedNotifications, 1);
+      ++noOfSimulatedNotifications;
       alarmMgr.notificationError(url, "notification failure for sender-thread");
     }
 
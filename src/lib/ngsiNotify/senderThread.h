@@ -26,6 +26,7 @@
 #include <string>
 
 #include "common/Format.h"
+#include "ngsi10/NotifyContextRequest.h"
 
 
 
@@ -60,6 +61,21 @@ typedef struct SenderThreadParams
 
 
 
+/* ****************************************************************************
+*
+* senderThreadParamsBuild -
+*/
+extern SenderThreadParams* senderThreadParamsBuild
+(
+  NotifyContextRequest*  ncr,
+  const std::string&     url,
+  const std::string&     tenant,
+  const std::string&     xauthToken,
+  Format                 format
+);
+
+
+
 /* ****************************************************************************
 *
 * startSenderThread -
@@ -33,12 +33,14 @@
 
 #include "logMsg/logMsg.h"
 
+#include "common/Arena.h"
 #include "common/Format.h"
 #include "parse/CompoundValueNode.h"
 #include "rest/HttpStatusCode.h"
 #include "rest/mhd.h"
 #include "rest/Verb.h"
 #include "rest/HttpHeaders.h"
+#include "rest/ResponseStream.h"
 #include "ngsi/Request.h"
 
 struct ParseData;
@@ -69,7 +71,8 @@ public:
     inCompoundValue        (false),
     compoundValueP         (NULL),
     compoundValueRoot      (NULL),
-    httpStatusCode         (SccOk)
+    httpStatusCode         (SccOk),
+    responseStreamP        (NULL)
   {
     memset(payloadWord, 0, sizeof(payloadWord));
   }
@@ -91,7 +94,8 @@ public:
     inCompoundValue        (false),
     compoundValueP         (NULL),
     compoundValueRoot      (NULL),
-    httpStatusCode         (SccOk)
+    httpStatusCode         (SccOk),
+    responseStreamP        (NULL)
   {
     memset(payloadWord, 0, sizeof(payloadWord));
   }
@@ -116,7 +120,8 @@ public:
     inCompoundValue        (false),
     compoundValueP         (NULL),
     compoundValueRoot      (NULL),
-    httpStatusCode         (SccOk)
+    httpStatusCode         (SccOk),
+    responseStreamP        (NULL)
   {
 
     memset(payloadWord, 0, sizeof(payloadWord));
@@ -134,6 +139,9 @@ public:
     if (compoundValueRoot != NULL)
       delete compoundValueRoot;
 
+    if (responseStreamP != NULL)
+      delete responseStreamP;
+
     servicePathV.clear();
   }
 
@@ -174,9 +182,13 @@ public:
   HttpStatusCode            httpStatusCode;
   std::vector<std::string>  httpHeader;
   std::vector<std::string>  httpHeaderValue;
+  ResponseStream*           responseStreamP;  // If not NULL, the payload is streamed from here
 
   // Timing
   struct timespec           reqStartTime;
+
+  // Memory that lives as long as the request (released when the ConnectionInfo is deleted)
+  Arena                     arena;
 };
 
 
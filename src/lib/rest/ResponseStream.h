@@ -0,0 +1,56 @@
+#ifndef SRC_LIB_REST_RESPONSESTREAM_H_
+#define SRC_LIB_REST_RESPONSESTREAM_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+
+
+
+/* ****************************************************************************
+*
+* ResponseStream - source of the payload of a streamed response
+*
+* When a service routine sets ConnectionInfo::responseStreamP, restReply sends the
+* response with chunked encoding, pulling the payload from the stream as the client
+* reads it, instead of sending the string returned by the service routine.
+*
+* restReply takes over the stream; it is deleted once the response has been sent
+* (or the connection is closed).
+*/
+class ResponseStream
+{
+ public:
+  virtual ~ResponseStream() {}
+
+  //
+  // read - copy up to 'max' bytes of payload into 'buf'
+  //
+  // Returns the number of bytes copied (at least one), 0 at the end of the payload,
+  // or -1 if the payload cannot be completed (the connection is then closed).
+  //
+  virtual int read(char* buf, int max) = 0;
+};
+
+#endif  // SRC_LIB_REST_RESPONSESTREAM_H_
@@ -0,0 +1,314 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <strings.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "rest/RestService.h"
+#include "rest/RestRouter.h"
+
+
+
+/* ****************************************************************************
+*
+* CaseInsensitiveLess - URL components are matched ignoring case
+*/
+struct CaseInsensitiveLess
+{
+  bool operator()(const std::string& a, const std::string& b) const
+  {
+    return strcasecmp(a.c_str(), b.c_str()) < 0;
+  }
+};
+
+
+
+/* ****************************************************************************
+*
+* RouteNode - 
+*
+* A node of the routing trie at depth N stands for the first N components of a URL.
+* 'serviceV' holds (in ascending order) the indexes of the service vector items with
+* exactly N components that end in the node.
+*/
+typedef struct RouteNode
+{
+  std::map<std::string, RouteNode*, CaseInsensitiveLess>  childMap;
+  RouteNode*                                              wildcardP;
+  std::vector<int>                                        serviceV;
+
+  RouteNode(): wildcardP(NULL) {}
+
+  ~RouteNode()
+  {
+    for (std::map<std::string, RouteNode*, CaseInsensitiveLess>::iterator it = childMap.begin(); it != childMap.end(); ++it)
+    {
+      delete it->second;
+    }
+
+    delete wildcardP;
+  }
+} RouteNode;
+
+
+
+/* ****************************************************************************
+*
+* RestRouter - 
+*
+* Items with 'components == 0' match URLs of any length and are kept apart, in 'anyLengthV'.
+*/
+typedef struct RestRouter
+{
+  RouteNode         root;
+  std::vector<int>  anyLengthV;
+} RestRouter;
+
+
+
+/* ****************************************************************************
+*
+* router - the router of the service vector compiled by restRouterCompile
+*
+* Both are set before the broker starts serving requests and never modified afterwards,
+* so lookups read them without any lock.
+*/
+static RestService*  routerServiceV = NULL;
+static RestRouter*   router         = NULL;
+
+
+
+/* ****************************************************************************
+*
+* verbMatch - 
+*/
+static inline bool verbMatch(const RestService& service, const std::string& verb)
+{
+  return (service.verb == "*") || (service.verb == verb);
+}
+
+
+
+/* ****************************************************************************
+*
+* routeFind - depth-first search of the lowest matching index below a node
+*
+* Both the literal and the wildcard edge may lead to a match, e.g. '/v2/entities/E1'
+* matches {"v2", "entities", "*"} but also {"v2", "*", "*"}, so both branches are searched
+* and the lowest index wins, as in a linear scan of the service vector.
+*/
+static void routeFind
+(
+  RestService*                     serviceV,
+  const RouteNode*                 nodeP,
+  const std::string&               verb,
+  const std::vector<std::string>&  compV,
+  unsigned int                     depth,
+  int*                             bestP
+)
+{
+  if (depth == compV.size())
+  {
+    for (unsigned int ix = 0; ix < nodeP->serviceV.size(); ++ix)
+    {
+      int serviceIx = nodeP->serviceV[ix];
+
+      if ((*bestP != -1) && (serviceIx > *bestP))
+      {
+        break;
+      }
+
+      if (verbMatch(serviceV[serviceIx], verb))
+      {
+        *bestP = serviceIx;
+        break;
+      }
+    }
+
+    return;
+  }
+
+  std::map<std::string, RouteNode*, CaseInsensitiveLess>::const_iterator it = nodeP->childMap.find(compV[depth]);
+
+  if (it != nodeP->childMap.end())
+  {
+    routeFind(serviceV, it->second, verb, compV, depth + 1, bestP);
+  }
+
+  if (nodeP->wildcardP != NULL)
+  {
+    routeFind(serviceV, nodeP->wildcardP, verb, compV, depth + 1, bestP);
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* anyLengthMatch - match of an item with 'components == 0'
+*/
+static bool anyLengthMatch(const RestService& service, const std::vector<std::string>& compV)
+{
+  unsigned int maxComps = sizeof(service.compV) / sizeof(service.compV[0]);
+
+  if (compV.size() > maxComps)
+  {
+    return false;
+  }
+
+  for (unsigned int compNo = 0; compNo < compV.size(); ++compNo)
+  {
+    if (service.compV[compNo] == "*")
+    {
+      continue;
+    }
+
+    if (strcasecmp(service.compV[compNo].c_str(), compV[compNo].c_str()) != 0)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* linearLookup - lookup in a service vector that has not been compiled
+*/
+static int linearLookup(RestService* serviceV, const std::string& verb, const std::vector<std::string>& compV)
+{
+  int components = compV.size();
+
+  for (int ix = 0; serviceV[ix].treat != NULL; ++ix)
+  {
+    if ((serviceV[ix].components != 0) && (serviceV[ix].components != components))
+    {
+      continue;
+    }
+
+    if (verbMatch(serviceV[ix], verb) && anyLengthMatch(serviceV[ix], compV))
+    {
+      return ix;
+    }
+  }
+
+  return -1;
+}
+
+
+
+/* ****************************************************************************
+*
+* restRouterCompile - 
+*/
+void restRouterCompile(RestService* serviceV)
+{
+  RestRouter* routerP = new RestRouter();
+
+  for (int ix = 0; serviceV[ix].treat != NULL; ++ix)
+  {
+    if (serviceV[ix].components == 0)
+    {
+      routerP->anyLengthV.push_back(ix);
+      continue;
+    }
+
+    RouteNode* nodeP = &routerP->root;
+
+    for (int compNo = 0; compNo < serviceV[ix].components; ++compNo)
+    {
+      const std::string& comp = serviceV[ix].compV[compNo];
+
+      if (comp == "*")
+      {
+        if (nodeP->wildcardP == NULL)
+        {
+          nodeP->wildcardP = new RouteNode();
+        }
+
+        nodeP = nodeP->wildcardP;
+      }
+      else
+      {
+        RouteNode*& childP = nodeP->childMap[comp];
+
+        if (childP == NULL)
+        {
+          childP = new RouteNode();
+        }
+
+        nodeP = childP;
+      }
+    }
+
+    nodeP->serviceV.push_back(ix);
+  }
+
+  delete router;
+
+  router         = routerP;
+  routerServiceV = serviceV;
+}
+
+
+
+/* ****************************************************************************
+*
+* restRouterLookup - 
+*/
+int restRouterLookup(RestService* serviceV, const std::string& verb, const std::vector<std::string>& compV)
+{
+  if (serviceV != routerServiceV)
+  {
+    return linearLookup(serviceV, verb, compV);
+  }
+
+  int best = -1;
+
+  routeFind(serviceV, &router->root, verb, compV, 0, &best);
+
+  for (unsigned int ix = 0; ix < router->anyLengthV.size(); ++ix)
+  {
+    int serviceIx = router->anyLengthV[ix];
+
+    if ((best != -1) && (serviceIx > best))
+    {
+      break;
+    }
+
+    if (verbMatch(serviceV[serviceIx], verb) && anyLengthMatch(serviceV[serviceIx], compV))
+    {
+      best = serviceIx;
+      break;
+    }
+  }
+
+  return best;
+}
@@ -0,0 +1,60 @@
+#ifndef SRC_LIB_REST_RESTROUTER_H_
+#define SRC_LIB_REST_RESTROUTER_H_
+
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "rest/RestService.h"
+
+
+
+/* ****************************************************************************
+*
+* restRouterCompile - build the routing trie of a service vector
+*
+* restInit compiles the service vector of the broker, before any request is served. The
+* trie is never modified afterwards, so lookups don't take any lock. Not thread-safe: a
+* new compilation replaces (and frees) the previous one.
+*/
+extern void restRouterCompile(RestService* serviceV);
+
+
+
+/* ****************************************************************************
+*
+* restRouterLookup - find the service that treats a request
+*
+* Returns the index of the first item in 'serviceV' that matches the verb and the URL
+* components (the same item a linear scan of the vector would find), or -1 if none does.
+* For the compiled service vector (see restRouterCompile), the lookup walks the trie one URL
+* component at a time, following both the literal and the wildcard ('*') edges, so its cost
+* depends on the depth of the URL and not on the size of the service vector. Any other service
+* vector (e.g. those of the unit tests) is scanned linearly.
+*/
+extern int restRouterLookup(RestService* serviceV, const std::string& verb, const std::vector<std::string>& compV);
+
+#endif  // SRC_LIB_REST_RESTROUTER_H_
@@ -43,6 +43,7 @@
 #include "rest/ConnectionInfo.h"
 #include "rest/OrionError.h"
 #include "rest/RestService.h"
+#include "rest/RestRouter.h"
 #include "rest/restReply.h"
 #include "rest/rest.h"
 #include "rest/uriParamNames.h"
@@ -385,38 +386,11 @@ std::string restService(ConnectionInfo* ciP, RestService* serviceV)
 
   components = stringSplit(ciP->url, '/', compV);
 
-  for (unsigned int ix = 0; serviceV[ix].treat != NULL; ++ix)
-  {
-    if ((serviceV[ix].components != 0) && (serviceV[ix].components != components))
-    {
-      continue;
-    }
-
-    if ((ciP->method != serviceV[ix].verb) && (serviceV[ix].verb != "*"))
-    {
-      continue;
-    }
+  int ix = restRouterLookup(serviceV, ciP->method, compV);
 
+  if (ix != -1)
+  {
     strncpy(ciP->payloadWord, serviceV[ix].payloadWord.c_str(), sizeof(ciP->payloadWord));
-    bool match = true;
-    for (int compNo = 0; compNo < components; ++compNo)
-    {
-      if (serviceV[ix].compV[compNo] == "*")
-      {
-        continue;
-      }
-
-      if (strcasecmp(serviceV[ix].compV[compNo].c_str(), compV[compNo].c_str()) != 0)
-      {
-        match = false;
-        break;
-      }
-    }
-
-    if (match == false)
-    {
-      continue;
-    }
 
     if ((ciP->payload != NULL) && (ciP->payloadSize != 0) && (ciP->payload[0] != 0) && (serviceV[ix].verb != "*"))
     {
@@ -460,6 +434,11 @@ std::string restService(ConnectionInfo* ciP, RestService* serviceV)
     }
     statisticsUpdate(serviceV[ix].request, ciP->inFormat);
 
+    if (timingStatistics)
+    {
+      threadLastTimeStat.requestType = serviceV[ix].request;
+    }
+
     // Tenant to connectionInfo
     ciP->tenant = ciP->tenantFromHttpHeader;
     lmTransactionSetService(ciP->tenant.c_str());
@@ -551,6 +530,19 @@ std::string restService(ConnectionInfo* ciP, RestService* serviceV)
     return response;
   }
 
+  //
+  // The payload word of the error is taken from the last service with the same verb and
+  // number of components, if any (this is what the linear scan of the service vector did)
+  //
+  for (int sIx = 0; serviceV[sIx].treat != NULL; ++sIx)
+  {
+    if (((serviceV[sIx].components == 0) || (serviceV[sIx].components == components)) &&
+        ((ciP->method == serviceV[sIx].verb) || (serviceV[sIx].verb == "*")))
+    {
+      strncpy(ciP->payloadWord, serviceV[sIx].payloadWord.c_str(), sizeof(ciP->payloadWord));
+    }
+  }
+
   std::string details = std::string("service '") + ciP->url + "' not recognized";
   alarmMgr.badInput(clientIp, details);
 
@@ -30,6 +30,7 @@
 #include <netdb.h>                              // gethostbyname
 #include <arpa/inet.h>                          // inet_ntoa
 #include <netinet/tcp.h>                        // TCP_NODELAY
+#include <time.h>
 #include <curl/curl.h>
 
 #include <string>
@@ -133,18 +134,18 @@ static char* curlVersionGet(char* buf, int bufLen)
 
 /* ****************************************************************************
 *
-* httpRequestSendWithCurl -
+* httpRequestPrepare -
 *
-* The waitForResponse arguments specifies if the method has to wait for response
-* before return. If this argument is false, the return string is ""
+* Checks the parameters of an outgoing HTTP request and sets up the curl handle to send it
+* (URL, verb, headers, payload and timeout). Used by httpRequestSendWithCurl and by senders
+* that perform the request on their own (e.g. with a curl multi handle).
 *
-* NOTE
-* We are using a hybrid approach, consisting in a static thread-local buffer of a
-* small size that copes with most notifications to avoid expensive
-* calloc/free syscalls if the notification payload is not very large.
+* The headers (*headersP) are to be freed by the caller (curl_slist_free_all) once the request
+* is done, and 'content' must be kept untouched until then, as curl doesn't copy it.
+* The full URL of the request is returned in *urlP.
 *
 * RETURN VALUES
-*   httpRequestSendWithCurl returns 0 on success and a negative number on failure:
+*   0 on success and a negative number on failure (the same as httpRequestSendWithCurl):
 *     -1: Invalid port
 *     -2: Invalid IP
 *     -3: Invalid verb
@@ -152,11 +153,10 @@ static char* curlVersionGet(char* buf, int bufLen)
 *     -5: No Content-Type BUT content present
 *     -6: Content-Type present but there is no content
 *     -7: Total outgoing message size is too big
-*     -9: Error making HTTP request
 */
-int httpRequestSendWithCurl
+int httpRequestPrepare
 (
-   CURL                   *curl,
+   CURL*                  curl,
    const std::string&     _ip,
    unsigned short         port,
    const std::string&     protocol,
@@ -168,23 +168,20 @@ int httpRequestSendWithCurl
    const std::string&     orig_content_type,
    const std::string&     content,
    bool                   useRush,
-   bool                   waitForResponse,
-   std::string*           outP,
    const std::string&     acceptFormat,
-   long                   timeoutInMilliseconds
+   long                   timeoutInMilliseconds,
+   struct curl_slist**    headersP,
+   std::string*           urlP,
+   int*                   outgoingMsgSizeP
 )
 {
   char                       portAsString[STRING_SIZE_FOR_INT];
-  static unsigned long long  callNo             = 0;
-  std::string                result;
   std::string                ip                 = _ip;
   struct curl_slist*         headers            = NULL;
-  MemoryStruct*              httpResponse       = NULL;
-  CURLcode                   res;
   int                        outgoingMsgSize       = 0;
   std::string                content_type(orig_content_type);
 
-  ++callNo;
+  *headersP = NULL;
 
   // For content-type application/json we add charset=utf-8
   if (orig_content_type == "application/json")
@@ -197,70 +194,43 @@ int httpRequestSendWithCurl
     timeoutInMilliseconds = defaultTimeout;
   }
 
-  lmTransactionStart("to", ip.c_str(), port, resource.c_str());
-
   // Preconditions check
   if (port == 0)
   {
     LM_E(("Runtime Error (port is ZERO)"));
-    lmTransactionEnd();
-
-    *outP = "error";
     return -1;
   }
 
   if (ip.empty())
   {
     LM_E(("Runtime Error (ip is empty)"));
-    lmTransactionEnd();
-
-    *outP = "error";
     return -2;
   }
 
   if (verb.empty())
   {
     LM_E(("Runtime Error (verb is empty)"));
-    lmTransactionEnd();
-
-    *outP = "error";
     return -3;
   }
 
   if (resource.empty())
   {
     LM_E(("Runtime Error (resource is empty)"));
-    lmTransactionEnd();
-
-    *outP = "error";
     return -4;
   }
 
   if ((content_type.empty()) && (!content.empty()))
   {
     LM_E(("Runtime Error (Content-Type is empty but there is actual content)"));
-    lmTransactionEnd();
-
-    *outP = "error";
     return -5;
   }
 
   if ((!content_type.empty()) && (content.empty()))
   {
     LM_E(("Runtime Error (Content-Type non-empty but there is no content)"));
-    lmTransactionEnd();
-
-    *outP = "error";
     return -6;
   }
 
-
-
-  // Allocate to hold HTTP response
-  httpResponse = new MemoryStruct;
-  httpResponse->memory = (char*) malloc(1); // will grow as needed
-  httpResponse->size = 0; // no data at this point
-
   //
   // Rush
   // Every call to httpRequestSend specifies whether RUSH should be used or not.
@@ -377,12 +347,6 @@ int httpRequestSendWithCurl
     LM_E(("Runtime Error (HTTP request to send is too large: %d bytes)", outgoingMsgSize));
 
     curl_slist_free_all(headers);
-
-    free(httpResponse->memory);
-    delete httpResponse;
-
-    lmTransactionEnd();
-    *outP = "error";
     return -7;
   }
 
@@ -404,8 +368,6 @@ int httpRequestSendWithCurl
   curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L); // Allow redirection (?)
   curl_easy_setopt(curl, CURLOPT_HEADER, 1); // Activate include the header in the body output
   curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers); // Put headers in place
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &writeMemoryCallback); // Send data here
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*) httpResponse); // Custom data for response handling
 
   //
   // There is a known problem in libcurl (see http://stackoverflow.com/questions/9191668/error-longjmp-causes-uninitialized-stack-frame)
@@ -426,6 +388,103 @@ int httpRequestSendWithCurl
     curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeoutInMilliseconds);
   }
 
+  *headersP         = headers;
+  *urlP             = url;
+  *outgoingMsgSizeP = outgoingMsgSize;
+
+  return 0;
+}
+
+
+
+/* ****************************************************************************
+*
+* httpRequestSendWithCurl -
+*
+* The waitForResponse arguments specifies if the method has to wait for response
+* before return. If this argument is false, the return string is ""
+*
+* NOTE
+* We are using a hybrid approach, consisting in a static thread-local buffer of a
+* small size that copes with most notifications to avoid expensive
+* calloc/free syscalls if the notification payload is not very large.
+*
+* RETURN VALUES
+*   httpRequestSendWithCurl returns 0 on success and a negative number on failure:
+*     -1: Invalid port
+*     -2: Invalid IP
+*     -3: Invalid verb
+*     -4: Invalid resource
+*     -5: No Content-Type BUT content present
+*     -6: Content-Type present but there is no content
+*     -7: Total outgoing message size is too big
+*     -9: Error making HTTP request
+*/
+int httpRequestSendWithCurl
+(
+   CURL                   *curl,
+   const std::string&     ip,
+   unsigned short         port,
+   const std::string&     protocol,
+   const std::string&     verb,
+   const std::string&     tenant,
+   const std::string&     servicePath,
+   const std::string&     xauthToken,
+   const std::string&     resource,
+   const std::string&     content_type,
+   const std::string&     content,
+   bool                   useRush,
+   bool                   waitForResponse,
+   std::string*           outP,
+   const std::string&     acceptFormat,
+   long                   timeoutInMilliseconds
+)
+{
+  static unsigned long long  callNo             = 0;
+  struct curl_slist*         headers            = NULL;
+  MemoryStruct*              httpResponse       = NULL;
+  std::string                url;
+  CURLcode                   res;
+  int                        outgoingMsgSize    = 0;
+  int                        r;
+
+  ++callNo;
+
+  lmTransactionStart("to", ip.c_str(), port, resource.c_str());
+
+  r = httpRequestPrepare(curl,
+                         ip,
+                         port,
+                         protocol,
+                         verb,
+                         tenant,
+                         servicePath,
+                         xauthToken,
+                         resource,
+                         content_type,
+                         content,
+                         useRush,
+                         acceptFormat,
+                         timeoutInMilliseconds,
+                         &headers,
+                         &url,
+                         &outgoingMsgSize);
+
+  if (r != 0)
+  {
+    lmTransactionEnd();
+
+    *outP = "error";
+    return r;
+  }
+
+  // Allocate to hold HTTP response
+  httpResponse = new MemoryStruct;
+  httpResponse->memory = (char*) malloc(1); // will grow as needed
+  httpResponse->size = 0; // no data at this point
+
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &writeMemoryCallback); // Send data here
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*) httpResponse); // Custom data for response handling
 
   // Synchronous HTTP request
   LM_T(LmtClientOutputPayload, ("Sending message %lu to HTTP server: sending message of %d bytes to HTTP server", callNo, outgoingMsgSize));
@@ -531,3 +590,281 @@ int httpRequestSend
   release_curl_context(&cc);
   return response;
 }
+
+
+
+/* ****************************************************************************
+*
+* HTTP_MULTI_WAIT_MS - maximum time to wait for activity in httpRequestSendMulti in one go
+*/
+#define HTTP_MULTI_WAIT_MS  100
+
+
+
+/* ****************************************************************************
+*
+* multiWait - wait for activity in the transfers of a multi handle
+*/
+static void multiWait(CURLM* multi, int running)
+{
+#if LIBCURL_VERSION_NUM >= 0x071c00
+  int numFds;
+
+  curl_multi_wait(multi, NULL, 0, HTTP_MULTI_WAIT_MS, &numFds);
+#else
+  fd_set          readFds;
+  fd_set          writeFds;
+  fd_set          excFds;
+  int             maxFd   = -1;
+  long            timeout = -1;
+  struct timeval  tv;
+
+  FD_ZERO(&readFds);
+  FD_ZERO(&writeFds);
+  FD_ZERO(&excFds);
+
+  curl_multi_fdset(multi, &readFds, &writeFds, &excFds, &maxFd);
+  curl_multi_timeout(multi, &timeout);
+
+  if ((timeout < 0) || (timeout > HTTP_MULTI_WAIT_MS))
+  {
+    timeout = HTTP_MULTI_WAIT_MS;
+  }
+
+  if ((maxFd == -1) && (running != 0))
+  {
+    // curl has no sockets to wait on yet (e.g. resolving), retry soon
+    timeout = 10;
+  }
+
+  tv.tv_sec  = timeout / 1000;
+  tv.tv_usec = (timeout % 1000) * 1000;
+
+  select(maxFd + 1, &readFds, &writeFds, &excFds, &tv);
+#endif
+}
+
+
+
+/* ****************************************************************************
+*
+* multiDoneRead - take the result of the transfers of a multi handle that are done
+*/
+static void multiDoneRead(CURLM* multi)
+{
+  CURLMsg* msgP;
+  int      left;
+
+  while ((msgP = curl_multi_info_read(multi, &left)) != NULL)
+  {
+    if (msgP->msg != CURLMSG_DONE)
+    {
+      continue;
+    }
+
+    char* privateP = NULL;
+
+    curl_easy_getinfo(msgP->easy_handle, CURLINFO_PRIVATE, &privateP);
+    ((HttpRequest*) privateP)->result = (msgP->data.result == CURLE_OK)? 0 : msgP->data.result;
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* httpRequestSendMulti -
+*
+* Send a set of requests concurrently and wait for all the responses, so the time spent is
+* that of the slowest request, not the sum of all of them. The timeout applies to the whole
+* set: requests not finished when it expires fail as timed out.
+*
+* As with httpRequestSend, each request is a transaction of its own in the log. As they are
+* in progress at the same time, the transaction of each request is left once the request has
+* been sent and resumed when its result is taken.
+*
+* A single request is just sent with httpRequestSend.
+*/
+void httpRequestSendMulti(const std::vector<HttpRequest*>& requestV, long timeoutInMilliseconds)
+{
+  if (requestV.size() == 1)
+  {
+    HttpRequest* reqP = requestV[0];
+
+    reqP->result = httpRequestSend(reqP->ip,
+                                   reqP->port,
+                                   reqP->protocol,
+                                   reqP->verb,
+                                   reqP->tenant,
+                                   reqP->servicePath,
+                                   reqP->xauthToken,
+                                   reqP->resource,
+                                   reqP->contentType,
+                                   reqP->content,
+                                   false,
+                                   true,
+                                   &reqP->out,
+                                   reqP->acceptFormat,
+                                   timeoutInMilliseconds);
+    return;
+  }
+
+  if (requestV.size() == 0)
+  {
+    return;
+  }
+
+  if (timeoutInMilliseconds == -1)
+  {
+    timeoutInMilliseconds = defaultTimeout;
+  }
+
+  CURLM*                            multi = curl_multi_init();
+  std::vector<CURL*>                curlV(requestV.size(), (CURL*) NULL);
+  std::vector<struct curl_slist*>   headersV(requestV.size(), (struct curl_slist*) NULL);
+  std::vector<MemoryStruct>         responseV(requestV.size());
+  std::vector<std::string>          urlV(requestV.size());
+  std::vector<std::string>          transactionV(requestV.size());
+  int                               running = 0;
+
+  for (unsigned int ix = 0; ix < requestV.size(); ++ix)
+  {
+    HttpRequest*  reqP            = requestV[ix];
+    int           outgoingMsgSize = 0;
+
+    responseV[ix].memory = NULL;
+    responseV[ix].size   = 0;
+
+    lmTransactionStart("to", reqP->ip.c_str(), reqP->port, reqP->resource.c_str());
+
+    if ((multi == NULL) || ((curlV[ix] = curl_easy_init()) == NULL))
+    {
+      LM_E(("Runtime Error (could not init libcurl)"));
+      lmTransactionEnd();
+      reqP->out    = "error";
+      reqP->result = -8;
+      continue;
+    }
+
+    reqP->result = httpRequestPrepare(curlV[ix],
+                                      reqP->ip,
+                                      reqP->port,
+                                      reqP->protocol,
+                                      reqP->verb,
+                                      reqP->tenant,
+                                      reqP->servicePath,
+                                      reqP->xauthToken,
+                                      reqP->resource,
+                                      reqP->contentType,
+                                      reqP->content,
+                                      false,
+                                      reqP->acceptFormat,
+                                      timeoutInMilliseconds,
+                                      &headersV[ix],
+                                      &urlV[ix],
+                                      &outgoingMsgSize);
+
+    if (reqP->result != 0)
+    {
+      lmTransactionEnd();
+      reqP->out = "error";
+      curl_easy_cleanup(curlV[ix]);
+      curlV[ix] = NULL;
+      continue;
+    }
+
+    responseV[ix].memory = (char*) malloc(1);  // will grow as needed
+
+    curl_easy_setopt(curlV[ix], CURLOPT_WRITEFUNCTION, &writeMemoryCallback);
+    curl_easy_setopt(curlV[ix], CURLOPT_WRITEDATA, (void*) &responseV[ix]);
+    curl_easy_setopt(curlV[ix], CURLOPT_PRIVATE, (char*) reqP);
+
+    reqP->result = -9;  // until the transfer completes successfully
+    curl_multi_add_handle(multi, curlV[ix]);
+
+    LM_T(LmtClientOutputPayload, ("Sending message to HTTP server %s: sending message of %d bytes", urlV[ix].c_str(), outgoingMsgSize));
+
+    transactionV[ix] = transactionId;
+    lmTransactionReset();
+  }
+
+  //
+  // Drive all the transfers until they are done. Each one has the timeout set in httpRequestPrepare,
+  // but as all of them start at the same time, that is also the timeout of the whole set.
+  // The deadline here is just a safety net on top of that.
+  //
+  struct timespec start;
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  //
+  // Transfers may be done after any call to curl_multi_perform, including the first one
+  // (e.g. a connection refused), so the messages are read after each of them
+  //
+  if (multi != NULL)
+  {
+    curl_multi_perform(multi, &running);
+    multiDoneRead(multi);
+  }
+
+  while (running > 0)
+  {
+    multiWait(multi, running);
+    curl_multi_perform(multi, &running);
+    multiDoneRead(multi);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    long elapsed = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+
+    if ((timeoutInMilliseconds > 0) && (elapsed > timeoutInMilliseconds + HTTP_MULTI_WAIT_MS))
+    {
+      LM_W(("Runtime Error (deadline of %ld ms reached with %d requests in progress)", timeoutInMilliseconds, running));
+      break;
+    }
+  }
+
+  for (unsigned int ix = 0; ix < requestV.size(); ++ix)
+  {
+    HttpRequest* reqP = requestV[ix];
+
+    if (curlV[ix] == NULL)
+    {
+      continue;
+    }
+
+    lmTransactionResume(transactionV[ix].c_str());
+
+    if (reqP->result == 0)
+    {
+      LM_I(("Notification Successfully Sent to %s", urlV[ix].c_str()));
+      reqP->out.assign(responseV[ix].memory, responseV[ix].size);
+    }
+    else
+    {
+      //
+      // NOTE: This log line is used by the functional tests in cases/880_timeout_for_forward_and_notifications/
+      //       So, this line should not be removed/altered, at least not without also modifying the functests.
+      //
+      CURLcode    res    = (reqP->result > 0)? (CURLcode) reqP->result : CURLE_OPERATION_TIMEDOUT;
+      std::string reason = curl_easy_strerror(res);
+
+      alarmMgr.notificationError(urlV[ix], "(curl_easy_perform failed: " + reason + ")");
+      reqP->out    = "notification failure";
+      reqP->result = -9;
+    }
+
+    curl_multi_remove_handle(multi, curlV[ix]);
+    curl_easy_cleanup(curlV[ix]);
+    curl_slist_free_all(headersV[ix]);
+    free(responseV[ix].memory);
+
+    lmTransactionEnd();
+  }
+
+  if (multi != NULL)
+  {
+    curl_multi_cleanup(multi);
+  }
+}
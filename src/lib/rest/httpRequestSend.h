@@ -51,6 +51,33 @@ extern int httpRequestConnect(const std::string& host, unsigned short port);
 
 
 
+/* ****************************************************************************
+*
+* httpRequestPrepare -
+*/
+extern int httpRequestPrepare
+(
+  CURL*                  curl,
+  const std::string&     ip,
+  unsigned short         port,
+  const std::string&     protocol,
+  const std::string&     verb,
+  const std::string&     tenant,
+  const std::string&     servicePath,
+  const std::string&     xauthToken,
+  const std::string&     resource,
+  const std::string&     content_type,
+  const std::string&     content,
+  bool                   useRush,
+  const std::string&     acceptFormat,
+  long                   timeoutInMilliseconds,
+  struct curl_slist**    headersP,
+  std::string*           urlP,
+  int*                   outgoingMsgSizeP
+);
+
+
+
 /* ****************************************************************************
 *
 * httpRequestSend - 
@@ -100,4 +127,39 @@ extern int httpRequestSendWithCurl
   long                   timeoutInMilliseconds = -1
 );
 
+
+
+/* ****************************************************************************
+*
+* HttpRequest - a request for httpRequestSendMulti
+*
+* 'result' and 'out' are the return value and the output (response headers and payload)
+* as httpRequestSend would have given for the request.
+*/
+typedef struct HttpRequest
+{
+  std::string     ip;
+  unsigned short  port;
+  std::string     protocol;
+  std::string     verb;
+  std::string     tenant;
+  std::string     servicePath;
+  std::string     xauthToken;
+  std::string     resource;
+  std::string     contentType;
+  std::string     content;
+  std::string     acceptFormat;
+
+  int             result;
+  std::string     out;
+} HttpRequest;
+
+
+
+/* ****************************************************************************
+*
+* httpRequestSendMulti -
+*/
+extern void httpRequestSendMulti(const std::vector<HttpRequest*>& requestV, long timeoutInMilliseconds = -1);
+
 #endif  // SRC_LIB_REST_HTTPREQUESTSEND_H_
@@ -45,7 +45,9 @@
 #include "alarmMgr/alarmMgr.h"
 
 #include "parse/forbiddenChars.h"
+#include "jsonParse/jsonRequest.h"
 #include "rest/RestService.h"
+#include "rest/RestRouter.h"
 #include "rest/rest.h"
 #include "rest/restReply.h"
 #include "rest/OrionError.h"
@@ -474,11 +476,6 @@ static void requestCompleted
   ConnectionInfo*  ciP      = (ConnectionInfo*) *con_cls;
   struct timespec  reqEndTime;
 
-  if ((ciP->payload != NULL) && (ciP->payload != static_buffer))
-  {
-    free(ciP->payload);
-  }
-
   *con_cls = NULL;
 
   lmTransactionEnd();  // Incoming REST request ends
@@ -495,34 +492,11 @@ static void requestCompleted
   // Statistics
   //
   // Flush this requests timing measures onto a global var to be read by "GET /statistics".
-  // Also, increment the accumulated measures.
+  // Also, increment the accumulated measures and the latency histograms (no lock is taken).
   //
   if (timingStatistics)
   {
-    timeStatSemTake(__FUNCTION__, "updating statistics");
-
-    memcpy(&lastTimeStat, &threadLastTimeStat, sizeof(lastTimeStat));
-
-    //
-    // "Fix" mongoBackendTime
-    //   Substract times waiting at mongo driver operation (in mongo[Read|Write|Command]WaitTime counters) so mongoBackendTime
-    //   contains at the end the time passed in our logic, i.e. a kind of "self-time" for mongoBackend
-    //
-    clock_subtime(&threadLastTimeStat.mongoBackendTime, &threadLastTimeStat.mongoReadWaitTime);
-    clock_subtime(&threadLastTimeStat.mongoBackendTime, &threadLastTimeStat.mongoWriteWaitTime);
-    clock_subtime(&threadLastTimeStat.mongoBackendTime, &threadLastTimeStat.mongoCommandWaitTime);
-
-    clock_addtime(&accTimeStat.jsonV1ParseTime,       &threadLastTimeStat.jsonV1ParseTime);
-    clock_addtime(&accTimeStat.jsonV2ParseTime,       &threadLastTimeStat.jsonV2ParseTime);
-    clock_addtime(&accTimeStat.mongoBackendTime,      &threadLastTimeStat.mongoBackendTime);
-    clock_addtime(&accTimeStat.mongoWriteWaitTime,    &threadLastTimeStat.mongoWriteWaitTime);
-    clock_addtime(&accTimeStat.mongoReadWaitTime,     &threadLastTimeStat.mongoReadWaitTime);
-    clock_addtime(&accTimeStat.mongoCommandWaitTime,  &threadLastTimeStat.mongoCommandWaitTime);
-    clock_addtime(&accTimeStat.renderTime,            &threadLastTimeStat.renderTime);
-    clock_addtime(&accTimeStat.reqTime,               &threadLastTimeStat.reqTime);
-    clock_addtime(&accTimeStat.xmlParseTime,          &threadLastTimeStat.xmlParseTime);
-
-    timeStatSemGive(__FUNCTION__, "updating statistics");
+    timingStatisticsUpdate(&threadLastTimeStat);
   }
 }
 
@@ -1095,7 +1069,7 @@ static int connectionTreat
 
     //
     // First call with payload - use the thread variable "static_buffer" if possible,
-    // otherwise allocate a bigger buffer
+    // otherwise allocate a bigger buffer from the arena of the request
     //
     // FIXME P1: This could be done in "Part I" instead, saving an "if" for each "Part II" call
     //           Once we *really* look to scratch some efficiency, this change should be made.
@@ -1104,7 +1078,7 @@ static int connectionTreat
     {
       if (ciP->httpHeaders.contentLength > STATIC_BUFFER_SIZE)
       {
-        ciP->payload = (char*) malloc(ciP->httpHeaders.contentLength + 1);
+        ciP->payload = (char*) ciP->arena.alloc(ciP->httpHeaders.contentLength + 1);
       }
       else
       {
@@ -1413,6 +1387,9 @@ void restInit
   rushHost         = _rushHost;
   rushPort         = _rushPort;
 
+  restRouterCompile(restServiceV);
+  jsonRequestInit();
+
   strncpy(restAllowedOrigin, _allowedOrigin, sizeof(restAllowedOrigin));
 
   strncpy(bindIp, LOCAL_IP_V4, MAX_LEN_IP - 1);
@@ -49,29 +49,96 @@
 #include "rest/mhd.h"
 #include "rest/OrionError.h"
 #include "rest/restReply.h"
+#include "rest/ResponseStream.h"
 #include "logMsg/traceLevels.h"
 
 
 
 static int replyIx = 0;
 
+
+
+/* ****************************************************************************
+*
+* STREAM_BLOCK_SIZE - size of the chunks of a streamed response
+*/
+#define STREAM_BLOCK_SIZE (32 * 1024)
+
+
+
+/* ****************************************************************************
+*
+* streamRead - MHD_ContentReaderCallback for streamed responses
+*/
+static ssize_t streamRead(void* cls, uint64_t pos, char* buf, size_t max)
+{
+  ResponseStream*  streamP = (ResponseStream*) cls;
+  int              n       = streamP->read(buf, (int) max);
+
+  if (n == 0)
+  {
+    return MHD_CONTENT_READER_END_OF_STREAM;
+  }
+  else if (n < 0)
+  {
+    return MHD_CONTENT_READER_END_WITH_ERROR;
+  }
+
+  return n;
+}
+
+
+
+/* ****************************************************************************
+*
+* streamFree - MHD_ContentReaderFreeCallback for streamed responses
+*/
+static void streamFree(void* cls)
+{
+  delete (ResponseStream*) cls;
+}
+
+
+
 /* ****************************************************************************
 *
 * restReply - 
+*
+* If ciP->responseStreamP is set, the payload is taken from the stream (chunked
+* encoding) and 'answer' is ignored.
 */
 void restReply(ConnectionInfo* ciP, const std::string& answer)
 {
   MHD_Response*  response;
+  bool           streamed = (ciP->responseStreamP != NULL);
 
   ++replyIx;
-  LM_T(LmtServiceOutPayload, ("Response %d: responding with %d bytes, Status Code %d", replyIx, answer.length(), ciP->httpStatusCode));
-  LM_T(LmtServiceOutPayload, ("Response payload: '%s'", answer.c_str()));
 
-  response = MHD_create_response_from_buffer(answer.length(), (void*) answer.c_str(), MHD_RESPMEM_MUST_COPY);
-  if (!response)
+  if (streamed)
+  {
+    LM_T(LmtServiceOutPayload, ("Response %d: responding with streamed payload, Status Code %d", replyIx, ciP->httpStatusCode));
+
+    response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, STREAM_BLOCK_SIZE, streamRead, ciP->responseStreamP, streamFree);
+    if (!response)
+    {
+      LM_E(("Runtime Error (MHD_create_response_from_callback FAILED)"));
+      return;
+    }
+
+    // From now on, the stream belongs to the response
+    ciP->responseStreamP = NULL;
+  }
+  else
   {
-    LM_E(("Runtime Error (MHD_create_response_from_buffer FAILED)"));
-    return;
+    LM_T(LmtServiceOutPayload, ("Response %d: responding with %d bytes, Status Code %d", replyIx, answer.length(), ciP->httpStatusCode));
+    LM_T(LmtServiceOutPayload, ("Response payload: '%s'", answer.c_str()));
+
+    response = MHD_create_response_from_buffer(answer.length(), (void*) answer.c_str(), MHD_RESPMEM_MUST_COPY);
+    if (!response)
+    {
+      LM_E(("Runtime Error (MHD_create_response_from_buffer FAILED)"));
+      return;
+    }
   }
 
   for (unsigned int hIx = 0; hIx < ciP->httpHeader.size(); ++hIx)
@@ -79,7 +146,7 @@ void restReply(ConnectionInfo* ciP, const std::string& answer)
     MHD_add_response_header(response, ciP->httpHeader[hIx].c_str(), ciP->httpHeaderValue[hIx].c_str());
   }
 
-  if (answer != "")
+  if ((answer != "") || streamed)
   {
     if (ciP->outFormat == XML)
     {
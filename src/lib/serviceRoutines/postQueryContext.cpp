@@ -73,21 +73,22 @@ static char* jsonPayloadClean(const char* payload)
 
 /* ****************************************************************************
 *
-* queryForward - 
+* queryForwardRequest - 
 *
 * An entity/attribute has been found on some context provider.
 * We need to forward the query request to the context provider, indicated in qcrsP->contextProvider
 *
 * 1. Parse the providing application to extract IP, port and URI-path
 * 2. Render the string of the request we want to forward
-* 3. Send the request to the providing application (and await the response)
-* 4. Parse the response and fill in a binary QueryContextResponse
-* 5. Fill in the response from the redirection into the response of this function
-* 6. 'Fix' StatusCode
-* 7. Freeing memory
+* 3. Prepare the request to the providing application
 *
+* The requests of all the context providers are then sent at the same time (httpRequestSendMulti)
+* and the responses are treated by queryForwardResponse.
 *
-* FIXME P5: The function 'queryForward' is implemented to pick the format (XML or JSON) based on the
+* Returns false if the request cannot be forwarded (the error is already in qcrsP)
+*
+*
+* FIXME P5: The function 'queryForwardRequest' is implemented to pick the format (XML or JSON) based on the
 *           count of the Format for all the participating attributes. If we have more attributes 'preferring'
 *           XML than JSON, the forward is done in XML, etc. This is all OK.
 *           What is not OK is that the Accept HTTP header is set to the same format as the Content-Type HTTP Header.
@@ -95,7 +96,7 @@ static char* jsonPayloadClean(const char* payload)
 *           the forward message with an Acceot header of XML/JSON and then at reading the response, instead of 
 *           throwing away the HTTP headers, we could read the "Content-Type" and do the parse according the Content-Type.
 */
-static void queryForward(ConnectionInfo* ciP, QueryContextRequest* qcrP, Format format, QueryContextResponse* qcrsP)
+static bool queryForwardRequest(ConnectionInfo* ciP, QueryContextRequest* qcrP, Format format, QueryContextResponse* qcrsP, HttpRequest* reqP)
 {
   std::string     ip;
   std::string     protocol;
@@ -116,7 +117,7 @@ static void queryForward(ConnectionInfo* ciP, QueryContextRequest* qcrP, Format
     //  SccBadRequest should have been returned before, when it was registered!
     //
     qcrsP->errorCode.fill(SccContextElementNotFound, "");
-    return;
+    return false;
   }
 
 
@@ -134,40 +135,56 @@ static void queryForward(ConnectionInfo* ciP, QueryContextRequest* qcrP, Format
     {
       LM_E(("Runtime Error (error rendering forward-request)"));
       qcrsP->errorCode.fill(SccContextElementNotFound, "");
-      return;
+      return false;
     }
   }
 
   //
-  // 3. Send the request to the Context Provider (and await the reply)
+  // 3. Prepare the request to the Context Provider
   // FIXME P7: Should Rush be used?
   //
-  std::string     verb         = "POST";
-  std::string     resource     = prefix + "/queryContext";
-  std::string     tenant       = ciP->tenant;
-  std::string     servicePath  = (ciP->httpHeaders.servicePathReceived == true)? ciP->httpHeaders.servicePath : "";
-  std::string     mimeType     = (format == XML)? "application/xml" : "application/json";
-  std::string     out;
-  int             r;
+  std::string mimeType = (format == XML)? "application/xml" : "application/json";
+
+  reqP->ip            = ip;
+  reqP->port          = port;
+  reqP->protocol      = protocol;
+  reqP->verb          = "POST";
+  reqP->tenant        = ciP->tenant;
+  reqP->servicePath   = (ciP->httpHeaders.servicePathReceived == true)? ciP->httpHeaders.servicePath : "";
+  reqP->xauthToken    = ciP->httpHeaders.xauthToken;
+  reqP->resource      = prefix + "/queryContext";
+  reqP->contentType   = mimeType;
+  reqP->content       = payload;
+  reqP->acceptFormat  = mimeType;
 
   LM_T(LmtCPrForwardRequestPayload, ("forward queryContext request payload: %s", payload.c_str()));
 
-  r = httpRequestSend(ip,
-                      port,
-                      protocol,
-                      verb,
-                      tenant,
-                      servicePath,
-                      ciP->httpHeaders.xauthToken,
-                      resource,
-                      mimeType,
-                      payload,
-                      false,
-                      true,
-                      &out,
-                      mimeType);
-
-  if (r != 0)
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* queryForwardResponse -
+*
+* Treat the response of a context provider to a forwarded request (see queryForwardRequest)
+*
+* 1. Check the result of the request
+* 2. Parse the response and fill in a binary QueryContextResponse
+* 3. Fill in the response from the redirection into the response of this function
+* 4. 'Fix' StatusCode
+* 5. Freeing memory
+*/
+static void queryForwardResponse(ConnectionInfo* ciP, HttpRequest* reqP, Format format, QueryContextResponse* qcrsP)
+{
+  //
+  // 1. Check the result of the request
+  //
+  const std::string&  out = reqP->out;
+  char*               cleanPayload;
+
+  if (reqP->result != 0)
   {
     qcrsP->errorCode.fill(SccContextElementNotFound, "error forwarding query");
     LM_W(("Runtime Error (error forwarding 'Query' to providing application)"));
@@ -178,7 +195,7 @@ static void queryForward(ConnectionInfo* ciP, QueryContextRequest* qcrP, Format
 
 
   //
-  // 4. Parse the response and fill in a binary QueryContextResponse
+  // 2. Parse the response and fill in a binary QueryContextResponse
   //
   std::string  s;
   std::string  errorMsg;
@@ -235,13 +252,13 @@ static void queryForward(ConnectionInfo* ciP, QueryContextRequest* qcrP, Format
 
 
   //
-  // 5. Fill in the response from the redirection into the response of this function
+  // 3. Fill in the response from the redirection into the response of this function
   //
   qcrsP->fill(&parseData.qcrs.res);
 
 
   //
-  // 6. 'Fix' StatusCode
+  // 4. 'Fix' StatusCode
   //
   if (qcrsP->errorCode.code == SccNone)
   {
@@ -255,7 +272,7 @@ static void queryForward(ConnectionInfo* ciP, QueryContextRequest* qcrP, Format
 
   
   //
-  // 7. Freeing memory
+  // 5. Freeing memory
   //
   parseData.qcr.res.release();
   parseData.qcrs.res.release();
@@ -531,15 +548,15 @@ std::string postQueryContext
   }
 
   //
-  // Now, forward the Query requests, each in a separate thread (to be implemented) and
-  // await all the responses.
-  // Actually, if there is only ONE forward to be done then there is no reason to
-  // do the forward in a separate shell. Better to do it inside the current thread.
+  // Now, forward the Query requests and await all the responses.
+  // All the requests are sent at the same time, so the time to wait is that of the slowest
+  // context provider. The responses are kept in the order of requestV.
   //
   // If providingApplication is empty then that part of the query has been performed already, locally.
-  // 
   //
-  QueryContextResponse* qP;
+  std::vector<HttpRequest*>           httpRequestV;
+  std::vector<QueryContextResponse*>  forwardResponseV;
+  QueryContextResponse*               qP;
 
   for (unsigned int fIx = 0; fIx < requestV.size() && fIx < cprForwardLimit; ++fIx)
   {
@@ -549,9 +566,20 @@ std::string postQueryContext
       continue;
     }
 
+    HttpRequest* httpRequestP = new HttpRequest();
+
     qP = new QueryContextResponse();
     qP->errorCode.fill(SccOk);
-    queryForward(ciP, requestV[fIx], requestV.format(), qP);
+
+    if (queryForwardRequest(ciP, requestV[fIx], requestV.format(), qP, httpRequestP) == true)
+    {
+      httpRequestV.push_back(httpRequestP);
+      forwardResponseV.push_back(qP);
+    }
+    else
+    {
+      delete httpRequestP;
+    }
 
     //
     // Now, each ContextElementResponse of qP should be tested to see whether there
@@ -559,6 +587,14 @@ std::string postQueryContext
     responseV.push_back(qP);
   }
 
+  httpRequestSendMulti(httpRequestV);
+
+  for (unsigned int ix = 0; ix < httpRequestV.size(); ++ix)
+  {
+    queryForwardResponse(ciP, httpRequestV[ix], requestV.format(), forwardResponseV[ix]);
+    delete httpRequestV[ix];
+  }
+
   std::string detailsString  = ciP->uriParam[URI_PARAM_PAGINATION_DETAILS];
   bool        details        = (strcasecmp("on", detailsString.c_str()) == 0)? true : false;
 
@@ -585,3 +621,68 @@ std::string postQueryContext
 
   return answer;
 }
+
+
+
+/* ****************************************************************************
+*
+* postQueryContextRender -
+*
+* Fast path of postQueryContext for NGSIv2 entity queries (GET /v2/entities and POST /v2/op/query):
+* the response is rendered directly from the entity documents in the database (see
+* mongoQueryContextRender). Big responses are streamed (ciP->responseStreamP).
+*
+* Returns false if the request must go through postQueryContext.
+*/
+bool postQueryContextRender(ConnectionInfo* ciP, ParseData* parseDataP, std::string* answerP)
+{
+  std::string      renderMode = "normalized";
+  long long        count      = 0;
+  long long*       countP     = NULL;
+  ResponseStream*  streamP    = NULL;
+  bool             ok;
+
+  if (ciP->uriParamOptions["keyValues"] == true)
+  {
+    renderMode = "keyValues";
+  }
+  else if (ciP->uriParamOptions["values"] == true)
+  {
+    renderMode = "values";
+  }
+
+  if (ciP->uriParamOptions["count"])
+  {
+    countP = &count;
+  }
+
+  TIMED_MONGO(ok = mongoQueryContextRender(&parseDataP->qcr.res,
+                                           ciP->tenant,
+                                           ciP->servicePathV,
+                                           ciP->uriParam,
+                                           ciP->uriParamOptions,
+                                           countP,
+                                           renderMode,
+                                           ciP->uriParam["attrs"],
+                                           answerP,
+                                           &streamP));
+
+  if (!ok)
+  {
+    return false;
+  }
+
+  if (countP != NULL)
+  {
+    char cV[32];
+
+    snprintf(cV, sizeof(cV), "%llu", *countP);
+    ciP->httpHeader.push_back("X-Total-Count");
+    ciP->httpHeaderValue.push_back(cV);
+  }
+
+  ciP->responseStreamP = streamP;
+  ciP->httpStatusCode  = SccOk;
+
+  return true;
+}
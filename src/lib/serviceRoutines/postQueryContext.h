@@ -45,4 +45,12 @@ extern std::string postQueryContext
   ParseData*                 parseDataP
 );
 
+
+
+/* ****************************************************************************
+*
+* postQueryContextRender - 
+*/
+extern bool postQueryContextRender(ConnectionInfo* ciP, ParseData* parseDataP, std::string* answerP);
+
 #endif  // SRC_LIB_SERVICEROUTINES_POSTQUERYCONTEXT_H_
@@ -97,21 +97,22 @@ static bool forwardsPending(UpdateContextResponse* upcrsP)
 
 /* ****************************************************************************
 *
-* updateForward - 
+* updateForwardRequest - 
 *
 * An entity/attribute has been found on some context provider.
 * We need to forward the update request to the context provider, indicated in upcrsP->contextProvider
 *
 * 1. Parse the providing application to extract IP, port and URI-path
 * 2. Render the string of the request we want to forward
-* 3. Send the request to the providing application (and await the response)
-* 4. Parse the response and fill in a binary UpdateContextResponse
-* 5. Fill in the response from the redirection into the response of this function
-* 6. 'Fix' StatusCode
-* 7. Freeing memory
+* 3. Prepare the request to the providing application
 *
+* The requests of all the context providers are then sent at the same time (httpRequestSendMulti)
+* and the responses are treated by updateForwardResponse.
 *
-* FIXME P5: The function 'updateForward' is implemented to pick the format (XML or JSON) based on the
+* Returns false if the request cannot be forwarded (the error is already in upcrsP)
+*
+*
+* FIXME P5: The function 'updateForwardRequest' is implemented to pick the format (XML or JSON) based on the
 *           count of the Format for all the participating attributes. If we have more attributes 'preferring'
 *           XML than JSON, the forward is done in XML, etc. This is all OK.
 *           What is not OK is that the Accept HTTP header is set to the same format as the Content-Type HTTP Header.
@@ -119,7 +120,7 @@ static bool forwardsPending(UpdateContextResponse* upcrsP)
 *           the forward message with an Acceot header of XML/JSON and then at reading the response, instead of 
 *           throwing away the HTTP headers, we could read the "Content-Type" and do the parse according the Content-Type.
 */
-static void updateForward(ConnectionInfo* ciP, UpdateContextRequest* upcrP, UpdateContextResponse* upcrsP, Format format)
+static bool updateForwardRequest(ConnectionInfo* ciP, UpdateContextRequest* upcrP, UpdateContextResponse* upcrsP, Format format, HttpRequest* reqP)
 {
   std::string      ip;
   std::string      protocol;
@@ -140,7 +141,7 @@ static void updateForward(ConnectionInfo* ciP, UpdateContextRequest* upcrP, Upda
     //  SccBadRequest should have been returned before, when it was registered!
     //
     upcrsP->errorCode.fill(SccContextElementNotFound, "");
-    return;
+    return false;
   }
 
 
@@ -164,41 +165,57 @@ static void updateForward(ConnectionInfo* ciP, UpdateContextRequest* upcrP, Upda
     {
       LM_E(("Runtime Error (error rendering forward-request)"));
       upcrsP->errorCode.fill(SccContextElementNotFound, "");
-      return;
+      return false;
     }
   }
 
 
   //
-  // 3. Send the request to the Context Provider (and await the reply)
+  // 3. Prepare the request to the Context Provider
   // FIXME P7: Should Rush be used?
   //
-  std::string     verb         = "POST";
-  std::string     resource     = prefix + "/updateContext";
-  std::string     tenant       = ciP->tenant;
-  std::string     servicePath  = (ciP->httpHeaders.servicePathReceived == true)? ciP->httpHeaders.servicePath : "";
-  std::string     mimeType     = (format == XML)? "application/xml" : "application/json";
-  std::string     out;
-  int             r;
+  std::string mimeType = (format == XML)? "application/xml" : "application/json";
+
+  reqP->ip            = ip;
+  reqP->port          = port;
+  reqP->protocol      = protocol;
+  reqP->verb          = "POST";
+  reqP->tenant        = ciP->tenant;
+  reqP->servicePath   = (ciP->httpHeaders.servicePathReceived == true)? ciP->httpHeaders.servicePath : "";
+  reqP->xauthToken    = ciP->httpHeaders.xauthToken;
+  reqP->resource      = prefix + "/updateContext";
+  reqP->contentType   = mimeType;
+  reqP->content       = cleanPayload;
+  reqP->acceptFormat  = mimeType;
 
   LM_T(LmtCPrForwardRequestPayload, ("forward updateContext request payload: %s", payload.c_str()));
 
-  r = httpRequestSend(ip,
-                      port,
-                      protocol,
-                      verb,
-                      tenant,
-                      servicePath,
-                      ciP->httpHeaders.xauthToken,
-                      resource,
-                      mimeType,
-                      cleanPayload,
-                      false,
-                      true,
-                      &out,
-                      mimeType);
-
-  if (r != 0)
+  return true;
+}
+
+
+
+/* ****************************************************************************
+*
+* updateForwardResponse -
+*
+* Treat the response of a context provider to a forwarded request (see updateForwardRequest)
+*
+* 1. Check the result of the request
+* 2. Parse the response and fill in a binary UpdateContextResponse
+* 3. Fill in the response from the redirection into the response of this function
+* 4. 'Fix' StatusCode
+* 5. Freeing memory
+*/
+static void updateForwardResponse(ConnectionInfo* ciP, HttpRequest* reqP, Format format, UpdateContextResponse* upcrsP)
+{
+  //
+  // 1. Check the result of the request
+  //
+  const std::string&  out = reqP->out;
+  char*               cleanPayload;
+
+  if (reqP->result != 0)
   {
     upcrsP->errorCode.fill(SccContextElementNotFound, "error forwarding update");
     LM_E(("Runtime Error (error forwarding 'Update' to providing application)"));
@@ -209,7 +226,7 @@ static void updateForward(ConnectionInfo* ciP, UpdateContextRequest* upcrP, Upda
 
 
   //
-  // 4. Parse the response and fill in a binary UpdateContextResponse
+  // 2. Parse the response and fill in a binary UpdateContextResponse
   //
   std::string  s;
   std::string  errorMsg;
@@ -268,13 +285,13 @@ static void updateForward(ConnectionInfo* ciP, UpdateContextRequest* upcrP, Upda
 
 
   //
-  // 5. Fill in the response from the redirection into the response of this function
+  // 3. Fill in the response from the redirection into the response of this function
   //
   upcrsP->fill(&parseData.upcrs.res);
 
 
   //
-  // 6. 'Fix' StatusCode
+  // 4. 'Fix' StatusCode
   //
   if (upcrsP->errorCode.code == SccNone)
   {
@@ -288,7 +305,7 @@ static void updateForward(ConnectionInfo* ciP, UpdateContextRequest* upcrP, Upda
 
   
   //
-  // 7. Freeing memory
+  // 5. Freeing memory
   //
   parseData.upcr.res.release();
   parseData.upcrs.res.release();
@@ -680,9 +697,13 @@ std::string postUpdateContext
 
 
   //
-  // Calling each of the Context Providers, merging their results into the
-  // total response 'response'
+  // Calling all the Context Providers at the same time, merging their results into the
+  // total response 'response' (in the order of requestV)
   //
+  std::vector<HttpRequest*>            httpRequestV;       // requests to be sent
+  std::vector<HttpRequest*>            forwardRequestV;    // per forward (NULL if it cannot be sent)
+  std::vector<UpdateContextResponse*>  forwardResponseV;   // per forward
+  std::vector<Format>                  forwardFormatV;     // per forward
 
   for (unsigned int ix = 0; ix < requestV.size() && ix < cprForwardLimit; ++ix)
   {
@@ -692,15 +713,40 @@ std::string postUpdateContext
       continue;
     }
 
-    UpdateContextResponse upcrs;
-    Format                format = requestV[ix]->format();
+    UpdateContextResponse*  upcrsP       = new UpdateContextResponse();
+    HttpRequest*            httpRequestP = new HttpRequest();
+    Format                  format       = requestV[ix]->format();
+
+    if (updateForwardRequest(ciP, requestV[ix], upcrsP, format, httpRequestP) == true)
+    {
+      httpRequestV.push_back(httpRequestP);
+    }
+    else
+    {
+      delete httpRequestP;
+      httpRequestP = NULL;
+    }
+
+    forwardRequestV.push_back(httpRequestP);
+    forwardResponseV.push_back(upcrsP);
+    forwardFormatV.push_back(format);
+  }
+
+  httpRequestSendMulti(httpRequestV);
 
-    updateForward(ciP, requestV[ix], &upcrs, format);
+  for (unsigned int ix = 0; ix < forwardResponseV.size(); ++ix)
+  {
+    if (forwardRequestV[ix] != NULL)
+    {
+      updateForwardResponse(ciP, forwardRequestV[ix], forwardFormatV[ix], forwardResponseV[ix]);
+      delete forwardRequestV[ix];
+    }
 
     //
     // Add the result from the forwarded update to the total response in 'response'
     //
-    response.merge(&upcrs);
+    response.merge(forwardResponseV[ix]);
+    delete forwardResponseV[ix];
   }
 
   TIMED_RENDER(answer = response.render(ciP, UpdateContext, ""));
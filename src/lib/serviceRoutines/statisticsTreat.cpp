@@ -130,9 +130,7 @@ static void resetStatistics(void)
   QueueStatistics::reset();
 
   semTimeReqReset();
-  semTimeTransReset();
   semTimeCacheReset();
-  semTimeTimeStatReset();
   mongoPoolConnectionSemWaitingTimeReset();
   mutexTimeCCReset();
 
@@ -143,7 +141,7 @@ static void resetStatistics(void)
 *
 *  - addUserCounter
 */
-inline void renderUsedCounter(JsonHelper* js, const std::string& field, int counter)
+inline void renderUsedCounter(JsonHelper* js, const std::string& field, long long counter)
 {
   if (counter != -1)
   {
@@ -236,10 +234,8 @@ std::string renderSemWaitStats(void)
 
   jh.addFloat("request",           semTimeReqGet());
   jh.addFloat("dbConnectionPool",  mongoPoolConnectionSemWaitingTimeGet());
-  jh.addFloat("transaction",       semTimeTransGet());
   jh.addFloat("subCache",          semTimeCacheGet());
   jh.addFloat("connectionContext", mutexTimeCCGet());
-  jh.addFloat("timeStat",          semTimeTimeStatGet());
 
   return jh.str();
 }
@@ -321,7 +317,7 @@ std::string statisticsTreat
   {
     js.addRaw("timing", renderTimingStatistics());
   }
-  if ((notifQueueStatistics) && (strcmp(notificationMode, "threadpool") == 0))
+  if ((notifQueueStatistics) && ((strcmp(notificationMode, "threadpool") == 0) || (strcmp(notificationMode, "async") == 0)))
   {
     js.addRaw("notifQueue", renderNotifQueueStats());
   }
@@ -331,9 +327,13 @@ std::string statisticsTreat
   js.addNumber("uptime_in_secs", now - startTime);
   js.addNumber("measuring_interval_in_secs", now - statisticsTime);
 
-  // Special case: simulated notifications
-  int nSimNotif = __sync_fetch_and_add(&noOfSimulatedNotifications, 0);
-  renderUsedCounter(&js, "simulatedNotifications", nSimNotif);
+  renderUsedCounter(&js, "simulatedNotifications", noOfSimulatedNotifications);
+
+  // Log lines dropped by asynchronous logging (-logAsync), as the log buffer of their thread was full
+  if (lmAsyncDropped() != 0)
+  {
+    js.addNumber("droppedLogLines", lmAsyncDropped());
+  }
 
   ciP->httpStatusCode = SccOk;
   return js.str();
@@ -378,9 +378,7 @@ std::string statisticsCacheTreat
   int   cacheItems  = 0;
   char  listBuffer[1024];
 
-  cacheSemTake(__FUNCTION__, "statisticsCacheTreat");
   subCacheStatisticsGet(&mscRefreshs, &mscInserts, &mscRemoves, &mscUpdates, &cacheItems, listBuffer, sizeof(listBuffer));
-  cacheSemGive(__FUNCTION__, "statisticsCacheTreat");
 
   js.addString("ids", listBuffer);    // FIXME P10: this seems not printing anything... is listBuffer working fine?
   js.addNumber("refresh", mscRefreshs);
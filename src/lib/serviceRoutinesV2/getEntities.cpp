@@ -63,7 +63,7 @@
 *   - type=TYPE1,TYPE2,...TYPEN
 *
 * 01. Fill in QueryContextRequest
-* 02. Call standard op postQueryContext
+* 02. Render the local entities (fast path) or call standard op postQueryContext
 * 03. Render Entities response
 * 04. Cleanup and return result
 */
@@ -97,8 +97,8 @@ std::string getEntities
   {
     pattern = "";
 
-    // FIXME P5: a more efficient query could be possible (this ends as a regex
-    // at MongoDB and regex are *expensive* in performance terms)
+    // The ids are escaped, so that they are literal ids. Such pattern is not used as a regex
+    // at MongoDB, but as a $in of the ids (see appendRegexFilter)
     std::vector<std::string> idsV;
 
     stringSplit(id, ',', idsV);
@@ -114,7 +114,7 @@ std::string getEntities
         pattern += "^";
       }
 
-      pattern += idsV[ix] + "$";
+      pattern += regexEscape(idsV[ix]) + "$";
     }
   }
   else if (idPattern != "")
@@ -223,7 +223,16 @@ std::string getEntities
   }
 
 
-  // 02. Call standard op postQueryContext
+  // 02. Fast path: render the local entities directly from the database.
+  //     If context providers could be involved (no local entity found), or in case of error,
+  //     the standard op postQueryContext is used instead
+  if (postQueryContextRender(ciP, parseDataP, &answer))
+  {
+    parseDataP->qcr.res.release();
+    return answer;
+  }
+
+  // Call standard op postQueryContext
   answer = postQueryContext(ciP, components, compV, parseDataP);
 
   if (ciP->httpStatusCode != SccOk)
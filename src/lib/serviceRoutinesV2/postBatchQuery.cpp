@@ -68,6 +68,13 @@ std::string postBatchQuery
   qcrP->fill(bqP);
   bqP->release();  // qcrP just 'took over' the data from bqP, bqP no longer needed
 
+  // Fast path: render the local entities directly from the database
+  if (postQueryContextRender(ciP, parseDataP, &answer))
+  {
+    parseDataP->qcr.res.release();
+    return answer;
+  }
+
   answer = postQueryContext(ciP, components, compV, parseDataP);
 
   if (ciP->httpStatusCode != SccOk)
@@ -0,0 +1,127 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "mongo/client/dbclient.h"
+
+#include "cache/entityCache.h"
+
+using mongo::BSONObj;
+
+
+
+/* ****************************************************************************
+*
+* entityDocs - 
+*/
+static std::vector<BSONObj> entityDocs(const std::string& id)
+{
+  std::vector<BSONObj> docs;
+
+  docs.push_back(BSON("_id" << BSON("id" << id << "type" << "T") << "attrNames" << BSON_ARRAY("A1")));
+
+  return docs;
+}
+
+
+
+/* ****************************************************************************
+*
+* lookupAndInvalidate -
+*/
+TEST(entityCache, lookupAndInvalidate)
+{
+  std::vector<BSONObj>  docs;
+  long long             count;
+  unsigned int          version;
+
+  entityCacheInit(1024 * 1024);
+
+  version = entityCacheVersion("t1", "E1");
+  entityCacheInsert("t1", "E1", "q1", entityDocs("E1"), -1, version);
+
+  EXPECT_TRUE(entityCacheLookup("t1", "E1", "q1", &docs));
+  ASSERT_EQ(1, docs.size());
+  EXPECT_EQ("E1", docs[0].getObjectField("_id").getStringField("id"));
+
+  // Different tenant, different query or count needed (but not known): not found
+  EXPECT_FALSE(entityCacheLookup("t2", "E1", "q1", &docs));
+  EXPECT_FALSE(entityCacheLookup("t1", "E1", "q2", &docs));
+  EXPECT_FALSE(entityCacheLookup("t1", "E1", "q1", &docs, &count));
+
+  // Not found entities are cached too
+  entityCacheInsert("t1", "E2", "q1", std::vector<BSONObj>(), 0, entityCacheVersion("t1", "E2"));
+  EXPECT_TRUE(entityCacheLookup("t1", "E2", "q1", &docs, &count));
+  EXPECT_EQ(0, docs.size());
+  EXPECT_EQ(0, count);
+
+  // A write drops all the results of the entity, and only them
+  entityCacheInsert("t1", "E1", "q2", entityDocs("E1"), 1, version);
+  entityCacheInvalidate("t1", "E1");
+  EXPECT_FALSE(entityCacheLookup("t1", "E1", "q1", &docs));
+  EXPECT_FALSE(entityCacheLookup("t1", "E1", "q2", &docs));
+  EXPECT_TRUE(entityCacheLookup("t1", "E2", "q1", &docs));
+
+  // A result read before the write is not cached
+  entityCacheInsert("t1", "E1", "q1", entityDocs("E1"), -1, version);
+  EXPECT_FALSE(entityCacheLookup("t1", "E1", "q1", &docs));
+
+  entityCacheClear();
+  EXPECT_FALSE(entityCacheLookup("t1", "E2", "q1", &docs));
+  EXPECT_EQ(0, entityCacheSize());
+
+  entityCacheInit(0);
+}
+
+
+
+/* ****************************************************************************
+*
+* memoryLimit -
+*/
+TEST(entityCache, memoryLimit)
+{
+  std::vector<BSONObj>  docs;
+  char                  id[16];
+
+  entityCacheInit(16 * 1024);
+
+  for (int ix = 0; ix < 1000; ++ix)
+  {
+    snprintf(id, sizeof(id), "E%d", ix);
+    entityCacheInsert("", id, "q", entityDocs(id), -1, entityCacheVersion("", id));
+  }
+
+  EXPECT_LE(entityCacheSize(), 16 * 1024);
+
+  // The most recently used ones are kept
+  EXPECT_TRUE(entityCacheLookup("", "E999", "q", &docs));
+  EXPECT_FALSE(entityCacheLookup("", "E0", "q", &docs));
+
+  entityCacheInit(0);
+  EXPECT_FALSE(entityCacheLookup("", "E999", "q", &docs));
+}
@@ -0,0 +1,100 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "cache/geoIndex.h"
+
+
+
+/* ****************************************************************************
+*
+* query - number of boxes of the index containing lat/lon
+*/
+static unsigned int query(const GeoIndex& index, double lat, double lon)
+{
+  std::vector<CachedSubscription*> result;
+
+  index.query(lat, lon, &result);
+
+  return result.size();
+}
+
+
+
+/* ****************************************************************************
+*
+* geoIndex_query -
+*
+* A grid of 100x100 boxes of 1x1 degree, plus a big box covering the whole grid
+*/
+TEST(geoIndex, query)
+{
+  GeoIndex                          index;
+  std::vector<CachedSubscription*>  result;
+  CachedSubscription*               big = (CachedSubscription*) 1;
+
+  for (int lat = 0; lat < 100; ++lat)
+  {
+    for (int lon = 0; lon < 100; ++lon)
+    {
+      GeoIndexBox box = { lat + 0.1, lat + 0.9, lon + 0.1, lon + 0.9 };
+
+      index.add((CachedSubscription*) (long) (1000 + lat * 100 + lon), box);
+    }
+  }
+
+  GeoIndexBox bigBox = { 0, 100, 0, 100 };
+  index.add(big, bigBox);
+
+  EXPECT_TRUE(index.dirty());
+  EXPECT_EQ(10001, index.size());
+
+  // A dirty index returns all of its entries
+  EXPECT_EQ(10001, query(index, 50.5, 50.5));
+
+  index.build();
+  EXPECT_FALSE(index.dirty());
+
+  index.query(42.5, 17.5, &result);
+  ASSERT_EQ(2, result.size());
+  EXPECT_TRUE(std::find(result.begin(), result.end(), (CachedSubscription*) (long) (1000 + 42 * 100 + 17)) != result.end());
+  EXPECT_TRUE(std::find(result.begin(), result.end(), big) != result.end());
+
+  EXPECT_EQ(1, query(index, 42.95, 17.5));
+  EXPECT_EQ(0, query(index, 142.5, 17.5));
+
+  index.remove(big);
+  index.build();
+  EXPECT_EQ(10000, index.size());
+  EXPECT_EQ(1, query(index, 42.5, 17.5));
+  EXPECT_EQ(0, query(index, 42.95, 17.5));
+
+  GeoIndex empty;
+  empty.build();
+  EXPECT_EQ(0, query(empty, 0, 0));
+}
@@ -0,0 +1,430 @@
+/*
+*
+* Copyright 2015 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Ken Zangelin
+*/
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "gtest/gtest.h"
+
+#include "logMsg/logMsg.h"
+#include "common/clockFunctions.h"
+#include "ngsi/NotifyCondition.h"
+#include "cache/subCache.h"
+
+
+
+/* ****************************************************************************
+*
+* subCreate -
+*
+* Create a CachedSubscription for the default tenant and service path "/", with
+* one entity and one ONCHANGE condition over 'condAttr' (ONANYCHANGE if empty).
+*/
+static CachedSubscription* subCreate
+(
+  const std::string&  subId,
+  const std::string&  entityId,
+  const std::string&  entityType,
+  const std::string&  isPattern,
+  const std::string&  condAttr
+)
+{
+  CachedSubscription* cSubP = new CachedSubscription();
+  NotifyCondition*    ncP   = new NotifyCondition();
+
+  cSubP->tenant               = NULL;
+  cSubP->servicePath          = strdup("/");
+  cSubP->subscriptionId       = strdup(subId.c_str());
+  cSubP->reference            = strdup("http://localhost:1028/notify");
+  cSubP->throttling           = -1;
+  cSubP->expirationTime       = 0x7FFFFFFF;
+  cSubP->lastNotificationTime = 0;
+  cSubP->count                = 0;
+  cSubP->modificationTime     = 0;
+  cSubP->notifyFormat         = JSON;
+
+  cSubP->entityIdInfos.push_back(new EntityInfo(entityId, entityType, isPattern));
+
+  ncP->type = ON_CHANGE_CONDITION;
+  if (condAttr != "")
+  {
+    ncP->condValueList.push_back(condAttr);
+  }
+  cSubP->notifyConditionVector.push_back(ncP);
+
+  return cSubP;
+}
+
+
+
+/* ****************************************************************************
+*
+* match -
+*/
+static int match(const char* entityId, const char* entityType, const char* attr)
+{
+  std::vector<CachedSubscriptionP> subV;
+
+  subCacheMatch("", "/", entityId, entityType, attr, &subV);
+
+  return subV.size();
+}
+
+
+
+/* ****************************************************************************
+*
+* subCache_match -
+*/
+TEST(subCache, match)
+{
+  subCacheInit();
+
+  subCacheItemInsert(subCreate("51307b66f481db11bf860001", "E1",  "T1", "false", "A1"));
+  subCacheItemInsert(subCreate("51307b66f481db11bf860002", "E.*", "T1", "true",  "A1"));
+  subCacheItemInsert(subCreate("51307b66f481db11bf860003", "E.*", "",   "true",  ""));
+  subCacheItemInsert(subCreate("51307b66f481db11bf860004", "E2",  "",   "false", "A2"));
+
+  EXPECT_EQ(3, match("E1", "T1", "A1"));
+  EXPECT_EQ(3, match("E1", "",   "A1"));
+  EXPECT_EQ(1, match("E1", "T2", "A1"));
+  EXPECT_EQ(1, match("E1", "T1", "A3"));
+  EXPECT_EQ(2, match("E2", "T2", "A2"));
+  EXPECT_EQ(0, match("X1", "T1", "A2"));
+
+  CachedSubscriptionP cSubP = subCacheItemLookup("", "51307b66f481db11bf860002");
+  ASSERT_TRUE(cSubP.get() != NULL);
+  EXPECT_STREQ("51307b66f481db11bf860002", cSubP->subscriptionId);
+
+  EXPECT_EQ(0, subCacheItemRemove(cSubP.get()));
+  EXPECT_TRUE(subCacheItemLookup("", "51307b66f481db11bf860002").get() == NULL);
+  EXPECT_EQ(2, match("E1", "T1", "A1"));
+  EXPECT_EQ(3, subCacheItems());
+
+  subCacheDestroy();
+  EXPECT_EQ(0, match("E1", "T1", "A1"));
+  EXPECT_EQ(0, subCacheItems());
+}
+
+
+
+/* ****************************************************************************
+*
+* geoMatch - match an update of attribute A1 of an entity of type T1 located at lat/lon
+*/
+static int geoMatch(const char* entityId, double lat, double lon)
+{
+  std::vector<CachedSubscriptionP>  subV;
+  std::vector<std::string>          attrV;
+  orion::Point                      location(lat, lon);
+
+  attrV.push_back("A1");
+  subCacheMatch("", "/", entityId, "T1", attrV, &subV, &location);
+
+  return subV.size();
+}
+
+
+
+/* ****************************************************************************
+*
+* subCache_geoMatch -
+*
+* One patterned subscription per 1x1 degree square of a 20x20 grid, plus a subscription
+* without geo filter and one with a disjoint (unbounded) geo filter
+*/
+TEST(subCache, geoMatch)
+{
+  subCacheInit();
+
+  for (int lat = 0; lat < 20; ++lat)
+  {
+    for (int lon = 0; lon < 20; ++lon)
+    {
+      char                subId[32];
+      char                coords[64];
+      CachedSubscription* cSubP;
+
+      snprintf(subId, sizeof(subId), "%024d", lat * 20 + lon);
+      snprintf(coords, sizeof(coords), "%d,%d;%d,%d", lat, lon, lat + 1, lon + 1);
+
+      cSubP = subCreate(subId, "E.*", "T1", "true", "A1");
+      cSubP->geoFilterP = geoFilterCompile("box", coords, "coveredBy");
+      subCacheItemInsert(cSubP);
+    }
+  }
+
+  subCacheItemInsert(subCreate("51307b66f481db11bf860001", "E1", "T1", "false", "A1"));
+
+  CachedSubscription* disjointP = subCreate("51307b66f481db11bf860002", "E1", "T1", "false", "A1");
+  disjointP->geoFilterP = geoFilterCompile("box", "0,0;10,10", "disjoint");
+  subCacheItemInsert(disjointP);
+
+  // E1 at (5.5, 7.5): the box of the square + the subscription without geo filter + the disjoint
+  // one (not bounded, its geo filter is evaluated later, in processSubscriptions)
+  EXPECT_EQ(3, geoMatch("E1", 5.5, 7.5));
+
+  // Outside the grid: the subscription without geo filter + the disjoint one
+  EXPECT_EQ(2, geoMatch("E1", 30.5, 7.5));
+  EXPECT_EQ(0, geoMatch("E2", 30.5, 7.5));
+
+  // Location unknown: all the subscriptions for E1 are candidates
+  EXPECT_EQ(402, match("E1", "T1", "A1"));
+
+  subCacheDestroy();
+}
+
+
+
+/* ****************************************************************************
+*
+* concurrentReader -
+*
+* Matches an update of E1/A1 until 'done' is set, counting the times no subscription
+* matches (there is always one in the cache) and the notifications (subCacheItemNotified)
+*/
+static volatile bool  done;
+static volatile int   misses;
+static volatile int   notified;
+
+static void* concurrentReader(void* vP)
+{
+  while (done == false)
+  {
+    std::vector<CachedSubscriptionP> subV;
+
+    subCacheMatch("", "/", "E1", "T1", "A1", &subV);
+
+    if (subV.size() == 0)
+    {
+      __sync_fetch_and_add(&misses, 1);
+      continue;
+    }
+
+    subCacheItemNotified(subV[0].get(), 1);
+    __sync_fetch_and_add(&notified, 1);
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* subCache_concurrentMatch -
+*
+* Readers match while the subscription they match is being replaced and other subscriptions
+* are inserted and removed. Readers never wait for the writer and must always find the
+* subscription, as a replacement is published in a single step.
+*/
+TEST(subCache, concurrentMatch)
+{
+  const int  readers = 4;
+  pthread_t  tid[readers];
+
+  subCacheInit();
+  subCacheItemInsert(subCreate("51307b66f481db11bf860001", "E1", "T1", "false", "A1"));
+
+  done     = false;
+  misses   = 0;
+  notified = 0;
+
+  for (int ix = 0; ix < readers; ++ix)
+  {
+    pthread_create(&tid[ix], NULL, concurrentReader, NULL);
+  }
+
+  for (int ix = 0; ix < 2000; ++ix)
+  {
+    char subId[32];
+
+    snprintf(subId, sizeof(subId), "%024d", ix);
+
+    subCacheItemInsert(subCreate("51307b66f481db11bf860001", "E1", "T1", "false", "A1"));
+    subCacheItemInsert(subCreate(subId, "E2", "T1", "false", "A1"));
+
+    CachedSubscriptionP cSubP = subCacheItemLookup("", subId);
+    EXPECT_TRUE(cSubP.get() != NULL);
+    EXPECT_EQ(0, subCacheItemRemove(cSubP.get()));
+  }
+
+  done = true;
+  for (int ix = 0; ix < readers; ++ix)
+  {
+    pthread_join(tid[ix], NULL);
+  }
+
+  EXPECT_EQ(0, misses);
+  EXPECT_GT(notified, 0);
+  EXPECT_EQ(1, subCacheItems());
+
+  subCacheDestroy();
+}
+
+
+
+/* ****************************************************************************
+*
+* subCache_deltaApply -
+*
+* Changes read from DB by a sync: 01 removed from DB, 02 modified in DB, 03 read from DB but
+* removed by this broker before the changes are applied, 04 created in DB and 05 as 03 but
+* not in the cache. Neither 03 nor 05 must be brought back to the cache.
+*/
+TEST(subCache, deltaApply)
+{
+  std::vector<CachedSubscription*>        changedV;
+  std::map<std::string, long long>        presentV;
+  std::map<std::string, CachedSubSaved*>  savedV;
+  CachedSubSaved                          saved;
+  CachedSubscription*                     cSubP;
+
+  subCacheInit();
+  subCacheItemInsert(subCreate("51307b66f481db11bf860001", "E1", "T1", "false", "A1"));
+  subCacheItemInsert(subCreate("51307b66f481db11bf860002", "E1", "T1", "false", "A1"));
+  subCacheItemInsert(subCreate("51307b66f481db11bf860003", "E1", "T1", "false", "A1"));
+  subCacheItemLookup("", "51307b66f481db11bf860002")->count = 3;
+
+  savedV["51307b66f481db11bf860001"] = &saved;
+  savedV["51307b66f481db11bf860002"] = &saved;
+  savedV["51307b66f481db11bf860003"] = &saved;
+
+  cSubP = subCreate("51307b66f481db11bf860002", "E2", "T1", "false", "A1");
+  cSubP->modificationTime = 10;
+  changedV.push_back(cSubP);
+  changedV.push_back(subCreate("51307b66f481db11bf860003", "E1", "T1", "false", "A1"));
+  changedV.push_back(subCreate("51307b66f481db11bf860004", "E1", "T1", "false", "A1"));
+  changedV.push_back(subCreate("51307b66f481db11bf860005", "E1", "T1", "false", "A1"));
+
+  presentV["51307b66f481db11bf860002"] = 0;
+  presentV["51307b66f481db11bf860003"] = 0;
+  presentV["51307b66f481db11bf860004"] = 100;
+  presentV["51307b66f481db11bf860005"] = 0;
+
+  // Removed by this broker after the sync read them
+  EXPECT_EQ(0, subCacheItemRemove(subCacheItemLookup("", "51307b66f481db11bf860003").get()));
+  subCacheTombstoneAdd("", "51307b66f481db11bf860005");
+
+  subCacheDeltaApply("", changedV, presentV, savedV);
+
+  EXPECT_TRUE(subCacheItemLookup("", "51307b66f481db11bf860001").get() == NULL);
+  EXPECT_TRUE(subCacheItemLookup("", "51307b66f481db11bf860003").get() == NULL);
+  EXPECT_TRUE(subCacheItemLookup("", "51307b66f481db11bf860005").get() == NULL);
+  EXPECT_EQ(2, subCacheItems());
+
+  // 02 is replaced, keeping the local count
+  EXPECT_EQ(1, match("E2", "T1", "A1"));
+  EXPECT_EQ(3, subCacheItemLookup("", "51307b66f481db11bf860002")->count);
+
+  cSubP = subCacheItemLookup("", "51307b66f481db11bf860004").get();
+  ASSERT_TRUE(cSubP != NULL);
+  EXPECT_EQ(100, cSubP->lastNotificationTime);
+
+  // A subscription inserted again by this broker is no longer skipped
+  subCacheItemInsert(subCreate("51307b66f481db11bf860003", "E1", "T1", "false", "A1"));
+  changedV.clear();
+  cSubP = subCreate("51307b66f481db11bf860003", "E3", "T1", "false", "A1");
+  cSubP->modificationTime = 20;
+  changedV.push_back(cSubP);
+  presentV["51307b66f481db11bf860003"] = 0;
+
+  subCacheDeltaApply("", changedV, presentV, savedV);
+  EXPECT_EQ(1, match("E3", "T1", "A1"));
+  EXPECT_EQ(3, subCacheItems());
+
+  subCacheDestroy();
+}
+
+
+
+/* ****************************************************************************
+*
+* subCache_matchBenchmark -
+*
+* Micro-benchmark of subCacheMatch, showing the match latency against the number
+* of subscriptions in the cache. Each entity has its own non-patterned subscription
+* and one out of every hundred subscriptions is patterned on a different type, so
+* the number of candidates for a given update stays small while the total number
+* of subscriptions grows.
+*/
+TEST(subCache, matchBenchmark)
+{
+  const int  sizes[]  = { 100, 1000, 10000, 50000 };
+  const int  matches  = 10000;
+
+  for (unsigned int sIx = 0; sIx < sizeof(sizes) / sizeof(sizes[0]); ++sIx)
+  {
+    subCacheInit();
+
+    for (int ix = 0; ix < sizes[sIx]; ++ix)
+    {
+      char subId[32];
+      char entityId[32];
+      char entityType[32];
+
+      snprintf(subId,      sizeof(subId),      "%024d", ix);
+      snprintf(entityId,   sizeof(entityId),   "E%d", ix);
+      snprintf(entityType, sizeof(entityType), "T%d", ix / 100);
+
+      if ((ix % 100) == 0)
+      {
+        subCacheItemInsert(subCreate(subId, "E.*", entityType, "true", "A1"));
+      }
+      else
+      {
+        subCacheItemInsert(subCreate(subId, entityId, "T", "false", "A1"));
+      }
+    }
+
+    struct timespec  start;
+    struct timespec  end;
+    struct timespec  diff;
+    int              matched = 0;
+
+    clock_gettime(CLOCK_REALTIME, &start);
+    for (int ix = 0; ix < matches; ++ix)
+    {
+      char entityId[32];
+
+      snprintf(entityId, sizeof(entityId), "E%d", (ix * 7) % sizes[sIx]);
+      matched += match(entityId, "T", "A1");
+    }
+    clock_gettime(CLOCK_REALTIME, &end);
+    clock_difftime(&end, &start, &diff);
+
+    double usecs = (diff.tv_sec * 1000000.0 + diff.tv_nsec / 1000.0) / matches;
+
+    LM_M(("subCacheMatch: %6d subscriptions: %.3f microseconds per match (%d matches)", sizes[sIx], usecs, matched));
+    printf("subCacheMatch: %6d subscriptions: %.3f microseconds per match\n", sizes[sIx], usecs);
+
+    EXPECT_GT(matched, 0);
+
+    subCacheDestroy();
+  }
+}
@@ -0,0 +1,209 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+#include <map>
+
+#include "gtest/gtest.h"
+
+#include "cache/typeCatalog.h"
+
+
+
+/* ****************************************************************************
+*
+* change - 
+*/
+static TypeCatalogChange change
+(
+  const std::string&  servicePath,
+  const std::string&  type,
+  const std::string&  oldAttrs,
+  const std::string&  newAttrs
+)
+{
+  TypeCatalogChange c;
+
+  c.servicePath = servicePath;
+  c.entityType  = type;
+  c.existed     = (oldAttrs != "-");
+  c.exists      = (newAttrs != "-");
+
+  for (unsigned int ix = 0; c.existed && (ix < oldAttrs.size()); ++ix)
+  {
+    c.oldAttrs[oldAttrs.substr(ix, 1)] = "Number";
+  }
+
+  for (unsigned int ix = 0; c.exists && (ix < newAttrs.size()); ++ix)
+  {
+    c.newAttrs[newAttrs.substr(ix, 1)] = "Text";
+  }
+
+  return c;
+}
+
+
+
+/* ****************************************************************************
+*
+* applyAndQuery -
+*/
+TEST(typeCatalog, applyAndQuery)
+{
+  std::map<std::string, TypeCatalogEntry>  types;
+  std::vector<std::string>                 servicePathV;
+
+  typeCatalogInit();
+  typeCatalogRelease();
+
+  // Not loaded: changes are ignored and queries fail
+  typeCatalogApply("t1", change("/", "T1", "-", "ab"));
+  EXPECT_FALSE(typeCatalogLoaded("t1"));
+  EXPECT_FALSE(typeCatalogTypes("t1", servicePathV, &types));
+
+  TypeCatalog empty;
+
+  typeCatalogSet("t1", &empty, typeCatalogLoadStart("t1"));
+  EXPECT_TRUE(typeCatalogLoaded("t1"));
+
+  typeCatalogApply("t1", change("/a",   "T1", "-", "ab"));   // created
+  typeCatalogApply("t1", change("/a/b", "T1", "-", "bc"));   // created
+  typeCatalogApply("t1", change("/x",   "T2", "-", ""));     // created, no attributes
+  typeCatalogApply("t1", change("/a",   "T1", "ab", "a"));   // 'b' removed
+
+  EXPECT_TRUE(typeCatalogTypes("t1", servicePathV, &types));
+  ASSERT_EQ(2, types.size());
+  EXPECT_EQ(2, types["T1"].count);
+  ASSERT_EQ(3, types["T1"].attrs.size());
+  EXPECT_EQ(1, types["T1"].attrs["a"].count);
+  EXPECT_EQ(1, types["T1"].attrs["b"].count);
+  EXPECT_EQ("Text", types["T1"].attrs["b"].type);
+  EXPECT_EQ(1, types["T2"].count);
+  EXPECT_EQ(0, types["T2"].attrs.size());
+
+  // servicePath filters
+  types.clear();
+  servicePathV.push_back("/a");
+  EXPECT_TRUE(typeCatalogTypes("t1", servicePathV, &types));
+  ASSERT_EQ(1, types.size());
+  EXPECT_EQ(1, types["T1"].count);
+  EXPECT_EQ(1, types["T1"].attrs.size());
+
+  types.clear();
+  servicePathV[0] = "/a/#";
+  EXPECT_TRUE(typeCatalogTypes("t1", servicePathV, &types));
+  ASSERT_EQ(1, types.size());
+  EXPECT_EQ(2, types["T1"].count);
+
+  types.clear();
+  servicePathV[0] = "/b";
+  EXPECT_TRUE(typeCatalogTypes("t1", servicePathV, &types));
+  EXPECT_EQ(0, types.size());
+
+  // removing the last entity of a type removes the type
+  typeCatalogApply("t1", change("/x", "T2", "", "-"));
+  types.clear();
+  servicePathV.clear();
+  EXPECT_TRUE(typeCatalogTypes("t1", servicePathV, &types));
+  EXPECT_EQ(1, types.size());
+
+  typeCatalogRelease();
+}
+
+
+
+/* ****************************************************************************
+*
+* writeDuringLoad - the writes done while a tenant is read are replayed on the catalog read
+*/
+TEST(typeCatalog, writeDuringLoad)
+{
+  std::map<std::string, TypeCatalogEntry>  types;
+  std::vector<std::string>                 servicePathV;
+  TypeCatalog                              catalog;
+  unsigned long long                       start;
+
+  typeCatalogInit();
+  typeCatalogRelease();
+
+  // First load, with a write before setting it
+  catalog["/"]["T1"].count = 1;
+  start = typeCatalogLoadStart("t1");
+  typeCatalogApply("t1", change("/", "T1", "-", "a"));
+  typeCatalogSet("t1", &catalog, start);
+
+  EXPECT_TRUE(typeCatalogLoaded("t1"));
+  EXPECT_TRUE(typeCatalogTypes("t1", servicePathV, &types));
+  EXPECT_EQ(2, types["T1"].count);
+  EXPECT_EQ(1, types["T1"].attrs["a"].count);
+
+  // Reload, with a write before setting it: the catalog read is set, with the write
+  catalog.clear();
+  catalog["/"]["T1"].count = 7;
+  start = typeCatalogLoadStart("t1");
+  typeCatalogApply("t1", change("/", "T1", "-", "b"));
+  typeCatalogSet("t1", &catalog, start);
+
+  types.clear();
+  EXPECT_TRUE(typeCatalogTypes("t1", servicePathV, &types));
+  EXPECT_EQ(8, types["T1"].count);
+  EXPECT_EQ(0, types["T1"].attrs.count("a"));
+  EXPECT_EQ(1, types["T1"].attrs["b"].count);
+
+  // Overlapping loads: each one replays only the writes done since it started
+  TypeCatalog  catalog2;
+  unsigned long long start2;
+
+  catalog.clear();
+  catalog["/"]["T1"].count = 1;
+  catalog2["/"]["T1"].count = 1;
+
+  start = typeCatalogLoadStart("t1");
+  typeCatalogApply("t1", change("/", "T1", "-", ""));
+  start2 = typeCatalogLoadStart("t1");
+  typeCatalogApply("t1", change("/", "T1", "-", ""));
+
+  typeCatalogSet("t1", &catalog, start);
+  types.clear();
+  EXPECT_TRUE(typeCatalogTypes("t1", servicePathV, &types));
+  EXPECT_EQ(3, types["T1"].count);
+
+  typeCatalogSet("t1", &catalog2, start2);
+  types.clear();
+  EXPECT_TRUE(typeCatalogTypes("t1", servicePathV, &types));
+  EXPECT_EQ(2, types["T1"].count);
+
+  // An aborted load leaves the catalog as it was
+  start = typeCatalogLoadStart("t1");
+  typeCatalogApply("t1", change("/", "T2", "-", ""));
+  typeCatalogLoadAbort("t1");
+
+  types.clear();
+  EXPECT_TRUE(typeCatalogTypes("t1", servicePathV, &types));
+  EXPECT_EQ(2, types["T1"].count);
+  EXPECT_EQ(1, types["T2"].count);
+
+  typeCatalogRelease();
+}
@@ -0,0 +1,90 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string.h>
+#include <stdint.h>
+
+#include "gtest/gtest.h"
+
+#include "common/Arena.h"
+
+
+
+/* ****************************************************************************
+*
+* alloc - aligned, non-overlapping chunks, small and big
+*/
+TEST(commonArena, alloc)
+{
+  Arena  arena;
+  char*  a = (char*) arena.alloc(3);
+  char*  b = (char*) arena.alloc(100);
+  char*  c = (char*) arena.alloc(3 * ARENA_BLOCK_SIZE);
+  char*  d = (char*) arena.alloc(10);
+
+  ASSERT_TRUE((a != NULL) && (b != NULL) && (c != NULL) && (d != NULL));
+
+  EXPECT_EQ(0, (uintptr_t) a % sizeof(double));
+  EXPECT_EQ(0, (uintptr_t) b % sizeof(double));
+  EXPECT_EQ(0, (uintptr_t) d % sizeof(double));
+
+  // The big chunk doesn't waste the room left in the current block
+  EXPECT_TRUE(b >= a + 3);
+  EXPECT_TRUE(d >= b + 100);
+  EXPECT_TRUE(d < b + ARENA_BLOCK_SIZE);
+
+  memset(a, 'a', 3);
+  memset(b, 'b', 100);
+  memset(c, 'c', 3 * ARENA_BLOCK_SIZE);
+  memset(d, 'd', 10);
+  EXPECT_EQ('a', a[2]);
+  EXPECT_EQ('b', b[99]);
+
+  EXPECT_STREQ("abc", arena.strndup("abcdef", 3));
+
+  arena.release();
+  EXPECT_EQ(0, arena.allocated());
+}
+
+
+
+/* ****************************************************************************
+*
+* reuse - blocks given back are reused by the next arena of the thread
+*/
+TEST(commonArena, reuse)
+{
+  void* first;
+
+  {
+    Arena arena;
+
+    first = arena.alloc(10);
+  }
+
+  Arena arena;
+
+  EXPECT_EQ(first, arena.alloc(10));
+  EXPECT_EQ(16, arena.allocated());
+}
@@ -22,6 +22,9 @@
 *
 * Author: Ken Zangelin
 */
+#include <string.h>
+#include <stdlib.h>
+
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
 
@@ -263,3 +266,29 @@ TEST(commonGlobals, getCurrentTime)
   EXPECT_TRUE(now != -1);
   utExit();
 }
+
+
+
+/* ****************************************************************************
+*
+* transactionIdSet - 
+*/
+TEST(commonGlobals, transactionIdSet)
+{
+  char  first[64];
+  int   transaction;
+
+  transactionIdSet();
+  strncpy(first, transactionId, sizeof(first));
+  transaction = transactionIdGet();
+
+  transactionIdSet();
+
+  // Same prefix (start time of the broker), next running number
+  EXPECT_EQ(strlen(first), strlen(transactionId));
+  EXPECT_EQ(0, strncmp(first, transactionId, strlen(first) - 11));
+  EXPECT_EQ(transaction + 1, atoi(&transactionId[strlen(transactionId) - 11]));
+  EXPECT_EQ(transaction + 1, transactionIdGet());
+
+  lmTransactionReset();
+}
@@ -0,0 +1,242 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "gtest/gtest.h"
+
+#include "logMsg/logMsg.h"
+#include "common/clockFunctions.h"
+#include "common/SyncQOverflow.h"
+#include "common/RingQOverflow.h"
+
+
+
+/* ****************************************************************************
+*
+* overflow - fill a queue, check it rejects beyond its size and empty it
+*/
+static void overflow(QueueOverflow<long>* queue, size_t queueSize)
+{
+  long   batch[8];
+  size_t n;
+  size_t left;
+
+  for (size_t ix = 0; ix < queueSize; ++ix)
+  {
+    EXPECT_TRUE(queue->try_push(ix));
+  }
+  EXPECT_FALSE(queue->try_push(queueSize));
+  EXPECT_EQ(queueSize, queue->size());
+
+  EXPECT_EQ(0, queue->pop());
+  EXPECT_TRUE(queue->try_push(queueSize));
+
+  n = queue->popBatch(batch, 3, &left);
+  ASSERT_EQ(3, n);
+  EXPECT_EQ(queueSize - 3, left);
+  EXPECT_EQ(1, batch[0]);
+  EXPECT_EQ(3, batch[2]);
+
+  for (long expected = 4; expected <= (long) queueSize; ++expected)
+  {
+    EXPECT_EQ(expected, queue->pop());
+  }
+  EXPECT_EQ(0, queue->size());
+}
+
+
+
+/* ****************************************************************************
+*
+* commonQueueOverflow_overflow -
+*/
+TEST(commonQueueOverflow, overflow)
+{
+  SyncQOverflow<long>  syncQ(10);
+  RingQOverflow<long>  ringQ(10);
+  RingQOverflow<long>  ringQ2(16);
+
+  overflow(&syncQ, 10);
+  overflow(&ringQ, 10);
+  overflow(&ringQ2, 16);
+
+  // Wrapping around the ring many times
+  for (long ix = 0; ix < 1000; ++ix)
+  {
+    EXPECT_TRUE(ringQ.try_push(ix));
+    EXPECT_TRUE(ringQ.try_push(ix + 1));
+    EXPECT_EQ(ix, ringQ.pop());
+    EXPECT_EQ(ix + 1, ringQ.pop());
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* producer/consumer - threads of the concurrency test
+*
+* Each producer pushes the numbers 1..ITEMS (retrying when the queue is full) and each
+* consumer adds up what it pops until it pops a 0 (end mark, pushed once the producers are done)
+*/
+#define ITEMS     200000
+#define PRODUCERS 4
+#define CONSUMERS 4
+
+typedef struct QueueTestThread
+{
+  QueueOverflow<long>*  queue;
+  long                  sum;
+  long                  count;
+} QueueTestThread;
+
+static void* producer(void* vP)
+{
+  QueueTestThread* ttP = (QueueTestThread*) vP;
+
+  for (long ix = 1; ix <= ITEMS; ++ix)
+  {
+    while (!ttP->queue->try_push(ix))
+    {
+      sched_yield();
+    }
+  }
+
+  return NULL;
+}
+
+static void* consumer(void* vP)
+{
+  QueueTestThread* ttP = (QueueTestThread*) vP;
+  long             batch[16];
+
+  for (;;)
+  {
+    size_t n = ttP->queue->popBatch(batch, 16, NULL);
+
+    for (size_t ix = 0; ix < n; ++ix)
+    {
+      if (batch[ix] == 0)
+      {
+        // End marks come after all the elements: give back the others taken in this batch
+        for (size_t rest = ix + 1; rest < n; ++rest)
+        {
+          while (!ttP->queue->try_push(0))
+          {
+            sched_yield();
+          }
+        }
+
+        return NULL;
+      }
+
+      ttP->sum   += batch[ix];
+      ttP->count += 1;
+    }
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* concurrent - run producers and consumers on a queue, returning the time in seconds
+*
+* No element can be lost or duplicated: the sum of what the consumers get must be
+* the sum of what the producers push
+*/
+static double concurrent(QueueOverflow<long>* queue)
+{
+  pthread_t        tid[PRODUCERS + CONSUMERS];
+  QueueTestThread  tt[PRODUCERS + CONSUMERS];
+  struct timespec  start;
+  struct timespec  end;
+  struct timespec  diff;
+  long             sum   = 0;
+  long             count = 0;
+
+  clock_gettime(CLOCK_REALTIME, &start);
+
+  for (int ix = 0; ix < PRODUCERS + CONSUMERS; ++ix)
+  {
+    tt[ix].queue = queue;
+    tt[ix].sum   = 0;
+    tt[ix].count = 0;
+    pthread_create(&tid[ix], NULL, (ix < PRODUCERS)? producer : consumer, &tt[ix]);
+  }
+
+  for (int ix = 0; ix < PRODUCERS; ++ix)
+  {
+    pthread_join(tid[ix], NULL);
+  }
+
+  // One end mark per consumer, a consumer stops after taking it
+  for (int ix = 0; ix < CONSUMERS; ++ix)
+  {
+    while (!queue->try_push(0))
+    {
+      sched_yield();
+    }
+  }
+
+  for (int ix = PRODUCERS; ix < PRODUCERS + CONSUMERS; ++ix)
+  {
+    pthread_join(tid[ix], NULL);
+    sum   += tt[ix].sum;
+    count += tt[ix].count;
+  }
+
+  clock_gettime(CLOCK_REALTIME, &end);
+  clock_difftime(&end, &start, &diff);
+
+  EXPECT_EQ((long) PRODUCERS * ITEMS, count);
+  EXPECT_EQ((long) PRODUCERS * ((long) ITEMS * (ITEMS + 1) / 2), sum);
+
+  return diff.tv_sec + diff.tv_nsec / 1000000000.0;
+}
+
+
+
+/* ****************************************************************************
+*
+* commonQueueOverflow_concurrent -
+*
+* Also a micro-benchmark of both queue implementations with several producers and consumers
+*/
+TEST(commonQueueOverflow, concurrent)
+{
+  SyncQOverflow<long>  syncQ(1000);
+  RingQOverflow<long>  ringQ(1000);
+
+  double syncSecs = concurrent(&syncQ);
+  double ringSecs = concurrent(&ringQ);
+
+  LM_M(("%d producers, %d consumers, %d elements each: SyncQOverflow %.3f s, RingQOverflow %.3f s", PRODUCERS, CONSUMERS, ITEMS, syncSecs, ringSecs));
+  printf("%d producers, %d consumers, %d elements each: SyncQOverflow %.3f s, RingQOverflow %.3f s\n", PRODUCERS, CONSUMERS, ITEMS, syncSecs, ringSecs);
+}
@@ -22,11 +22,19 @@
 *
 * Author: Ken Zangelin
 */
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "logMsg/logMsg.h"
 #include "logMsg/traceLevels.h"
 #include "common/sem.h"
+#include "common/clockFunctions.h"
 
 
 
@@ -56,3 +64,160 @@ TEST(commonSem, unique)
    EXPECT_EQ(0, s);
    EXPECT_TRUE(taken);
 }
+
+
+
+/* ****************************************************************************
+*
+* update - simulate an update request of entity 'entityId', taking 'dbTime' microseconds
+*
+* 'inside' counts the requests updating the entity at the same time, which must never
+* be more than one.
+*/
+static volatile int  inside;
+static volatile int  overlaps;
+
+static void update(const std::string& entityId, int dbTime, bool countInside)
+{
+  bool reqSemTaken;
+
+  reqSemTake(__FUNCTION__, "test update", SemWriteOp, &reqSemTaken);
+  entitySemTake(__FUNCTION__, "test update", "", std::vector<std::string>(1, entityId));
+
+  if (countInside && (__sync_add_and_fetch(&inside, 1) > 1))
+  {
+    __sync_fetch_and_add(&overlaps, 1);
+  }
+
+  usleep(dbTime);
+
+  if (countInside)
+  {
+    __sync_fetch_and_sub(&inside, 1);
+  }
+
+  reqSemGive(__FUNCTION__, "test update", reqSemTaken);
+}
+
+
+
+/* ****************************************************************************
+*
+* updater - thread doing 'updates' updates
+*/
+typedef struct UpdaterParams
+{
+  std::string  entityId;
+  int          updates;
+  int          dbTime;
+  bool         countInside;
+} UpdaterParams;
+
+static void* updater(void* vP)
+{
+  UpdaterParams* paramsP = (UpdaterParams*) vP;
+
+  for (int ix = 0; ix < paramsP->updates; ++ix)
+  {
+    update(paramsP->entityId, paramsP->dbTime, paramsP->countInside);
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* updatersRun - run 'threads' updaters, returning the elapsed time in milliseconds
+*
+* If 'sameEntity' is true, all threads update the same entity, otherwise each thread
+* updates an entity of its own.
+*/
+static double updatersRun(int threads, int updates, int dbTime, bool sameEntity)
+{
+  std::vector<pthread_t>      tidV(threads);
+  std::vector<UpdaterParams>  paramsV(threads);
+  struct timespec             start;
+  struct timespec             end;
+  struct timespec             diff;
+
+  clock_gettime(CLOCK_REALTIME, &start);
+
+  for (int ix = 0; ix < threads; ++ix)
+  {
+    char entityId[32];
+
+    snprintf(entityId, sizeof(entityId), "E%d", sameEntity? 0 : ix);
+
+    paramsV[ix].entityId    = entityId;
+    paramsV[ix].updates     = updates;
+    paramsV[ix].dbTime      = dbTime;
+    paramsV[ix].countInside = sameEntity;
+
+    pthread_create(&tidV[ix], NULL, updater, &paramsV[ix]);
+  }
+
+  for (int ix = 0; ix < threads; ++ix)
+  {
+    pthread_join(tidV[ix], NULL);
+  }
+
+  clock_gettime(CLOCK_REALTIME, &end);
+  clock_difftime(&end, &start, &diff);
+
+  return diff.tv_sec * 1000.0 + diff.tv_nsec / 1000000.0;
+}
+
+
+
+/* ****************************************************************************
+*
+* entityPolicy -
+*
+* Under the 'entity' policy, updates of the same entity are serialized
+*/
+TEST(commonSem, entityPolicy)
+{
+  semInit(SemEntityOp);
+
+  inside   = 0;
+  overlaps = 0;
+
+  updatersRun(4, 50, 100, true);
+
+  EXPECT_EQ(0, overlaps);
+
+  // Nothing is taken for other policies
+  semInit(SemReadWriteOp);
+  EXPECT_EQ(-1, entitySemTake(__FUNCTION__, "test", "", std::vector<std::string>(1, "E1")));
+}
+
+
+
+/* ****************************************************************************
+*
+* mutexPolicyBenchmark -
+*
+* Concurrent updates of disjoint entities (each thread updating its own entity, with a
+* simulated DB time of 500 microseconds per update), under the 'all' and 'entity' policies.
+*/
+TEST(commonSem, mutexPolicyBenchmark)
+{
+  const int  threads = 8;
+  const int  updates = 100;
+  const int  dbTime  = 500;
+
+  semInit(SemReadWriteOp);
+  double allTime = updatersRun(threads, updates, dbTime, false);
+
+  semInit(SemEntityOp);
+  double entityTime = updatersRun(threads, updates, dbTime, false);
+
+  printf("%d threads, %d updates of disjoint entities each: policy 'all': %.1f ms, policy 'entity': %.1f ms\n",
+         threads, updates, allTime, entityTime);
+
+  EXPECT_LT(entityTime, allTime / 2);
+
+  semInit();
+}
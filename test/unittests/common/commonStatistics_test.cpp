@@ -170,3 +170,69 @@ TEST(commonStatistics, statisticsUpdate)
   EXPECT_EQ(20, noOfXmlRequests);
   EXPECT_EQ(21, noOfJsonRequests);
 }
+
+
+
+/* ****************************************************************************
+*
+* statCounter - 
+*/
+TEST(commonStatistics, statCounter)
+{
+  StatCounter counter(-1);
+
+  EXPECT_EQ(-1, counter.get());
+
+  ++counter;
+  counter.add(10);
+  EXPECT_EQ(10, counter);
+
+  counter = 0;
+  EXPECT_EQ(0, counter.get());
+}
+
+
+
+/* ****************************************************************************
+*
+* statHistogram - 
+*/
+TEST(commonStatistics, statHistogram)
+{
+  StatHistogram histogram;
+
+  EXPECT_EQ(0, histogram.count());
+  EXPECT_EQ(0, histogram.percentile(50));
+
+  // Small values are kept exactly
+  EXPECT_EQ(5, StatHistogram::bucketValue(StatHistogram::bucket(5)));
+  EXPECT_EQ(15, StatHistogram::bucketValue(StatHistogram::bucket(15)));
+
+  // Bigger values with a relative error under 1/8
+  for (long long v = 16; v < 100000000; v = v * 3 + 1)
+  {
+    long long kept = StatHistogram::bucketValue(StatHistogram::bucket(v));
+
+    EXPECT_LE(v, kept);
+    EXPECT_GE(v + v / 8, kept);
+  }
+
+  // Out of range values are clamped
+  EXPECT_EQ(STAT_HISTOGRAM_BUCKETS - 1, StatHistogram::bucket(1LL << 40));
+  EXPECT_EQ(0, StatHistogram::bucket(-3));
+
+  // 1..1000 microseconds
+  for (int ix = 1; ix <= 1000; ++ix)
+  {
+    histogram.record(ix);
+  }
+
+  EXPECT_EQ(1000, histogram.count());
+  EXPECT_NEAR(500, histogram.percentile(50), 500 / 8);
+  EXPECT_NEAR(900, histogram.percentile(90), 900 / 8);
+  EXPECT_NEAR(990, histogram.percentile(99), 990 / 8);
+  EXPECT_LE(1000, histogram.percentile(100));
+
+  histogram.reset();
+  EXPECT_EQ(0, histogram.count());
+}
@@ -514,3 +514,17 @@ TEST(string, str2double)
   EXPECT_TRUE(b);
   EXPECT_EQ(23, d);
 }
+
+
+
+/* ****************************************************************************
+*
+* regexEscape -
+*/
+TEST(commonString, regexEscape)
+{
+  EXPECT_EQ("E1", regexEscape("E1"));
+  EXPECT_EQ("urn:ngsi:Room:1", regexEscape("urn:ngsi:Room:1"));
+  EXPECT_EQ("a\\.b\\*", regexEscape("a.b*"));
+  EXPECT_EQ("\\^\\(x\\|y\\)\\$", regexEscape("^(x|y)$"));
+}
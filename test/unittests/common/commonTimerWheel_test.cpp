@@ -0,0 +1,149 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "common/TimerWheel.h"
+
+
+
+/* ****************************************************************************
+*
+* expiredAt - advance the wheel to 'now' and check which entry (if any) expired
+*/
+static TimerWheelEntry* expiredAt(TimerWheel* wheelP, unsigned long long now, unsigned int* countP)
+{
+  std::vector<TimerWheelEntry*> expired;
+
+  wheelP->advance(now, &expired);
+  *countP = expired.size();
+
+  return expired.empty()? NULL : expired[0];
+}
+
+
+
+/* ****************************************************************************
+*
+* expiration - entries expire exactly at their tick, near and far in the future
+*/
+TEST(commonTimerWheel, expiration)
+{
+  unsigned long long  start    = 1000;
+  unsigned long long  delays[] = { 0, 1, 255, 256, 300, 4096, 70000, 20000000 };
+
+  for (unsigned int ix = 0; ix < sizeof(delays) / sizeof(delays[0]); ++ix)
+  {
+    TimerWheel          wheel(start);
+    TimerWheelEntry     entry;
+    unsigned int        count;
+    unsigned long long  expires = start + delays[ix];
+
+    wheel.add(&entry, expires);
+    EXPECT_TRUE(entry.pending());
+
+    if (expires > start)
+    {
+      EXPECT_EQ(NULL, expiredAt(&wheel, expires - 1, &count)) << "delay " << delays[ix];
+      EXPECT_EQ(0, count);
+    }
+
+    EXPECT_EQ(&entry, expiredAt(&wheel, expires, &count)) << "delay " << delays[ix];
+    EXPECT_EQ(1, count);
+    EXPECT_FALSE(entry.pending());
+  }
+}
+
+
+
+/* ****************************************************************************
+*
+* addRemove - past timers expire on next advance, removed timers never do
+*/
+TEST(commonTimerWheel, addRemove)
+{
+  TimerWheel                     wheel(100);
+  TimerWheelEntry                past;
+  TimerWheelEntry                removed;
+  TimerWheelEntry                moved;
+  std::vector<TimerWheelEntry*>  expired;
+
+  wheel.add(&past, 10);
+  wheel.add(&removed, 500);
+  wheel.add(&moved, 100000);
+  wheel.add(&moved, 600);
+  wheel.remove(&removed);
+  EXPECT_FALSE(removed.pending());
+
+  wheel.advance(100, &expired);
+  ASSERT_EQ(1, expired.size());
+  EXPECT_EQ(&past, expired[0]);
+
+  expired.clear();
+  wheel.advance(700, &expired);
+  ASSERT_EQ(1, expired.size());
+  EXPECT_EQ(&moved, expired[0]);
+  EXPECT_EQ(701, wheel.current());
+}
+
+
+
+/* ****************************************************************************
+*
+* periodic - re-adding an entry every 'interval' ticks, as the ONTIMEINTERVAL scheduler does
+*/
+TEST(commonTimerWheel, periodic)
+{
+  TimerWheel                     wheel(0);
+  TimerWheelEntry                entries[3];
+  int                            intervals[3] = { 1, 7, 60 };
+  int                            fired[3]     = { 0, 0, 0 };
+  std::vector<TimerWheelEntry*>  expired;
+
+  for (int ix = 0; ix < 3; ++ix)
+  {
+    wheel.add(&entries[ix], intervals[ix]);
+  }
+
+  for (unsigned long long now = 1; now <= 3600; ++now)
+  {
+    expired.clear();
+    wheel.advance(now, &expired);
+
+    for (unsigned int eIx = 0; eIx < expired.size(); ++eIx)
+    {
+      int ix = expired[eIx] - entries;
+
+      EXPECT_EQ(0, now % intervals[ix]);
+      ++fired[ix];
+      wheel.add(expired[eIx], now + intervals[ix]);
+    }
+  }
+
+  EXPECT_EQ(3600,  fired[0]);
+  EXPECT_EQ(514,   fired[1]);
+  EXPECT_EQ(60,    fired[2]);
+}
@@ -0,0 +1,156 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+
+#include "jsonParse/jsonParse.h"
+#include "ngsi/ParseData.h"
+#include "rest/ConnectionInfo.h"
+
+#include "unittest.h"
+
+
+
+/* ****************************************************************************
+*
+* treated - the path=value pairs passed to the treat functions
+*/
+static std::string treated;
+
+
+
+/* ****************************************************************************
+*
+* record -
+*/
+static std::string record(const std::string& path, const std::string& value, ParseData* parseDataP)
+{
+  treated += path + "=" + value + ";";
+  return "OK";
+}
+
+
+
+/* ****************************************************************************
+*
+* parseVector -
+*/
+static JsonNode parseVector[] =
+{
+  { "/contextElements",                              record },
+  { "/contextElements/contextElement",               record },
+  { "/contextElements/contextElement/id",            record },
+  { "/contextElements/contextElement/type",          record },
+  { "/contextElements/contextElement/isPattern",     record },
+  { "/updateAction",                                 record },
+  { "LAST", NULL }
+};
+
+
+
+/* ****************************************************************************
+*
+* parse -
+*/
+static std::string parse(const char* payload)
+{
+  ConnectionInfo  ci("/v1/updateContext", "POST", "1.1");
+  ParseData       parseData;
+
+  treated = "";
+  return jsonParse(&ci, payload, "updateContextRequest", parseVector, &parseData);
+}
+
+
+
+/* ****************************************************************************
+*
+* values - values are passed as they were written in the payload
+*/
+TEST(jsonParse, values)
+{
+  utInit();
+
+  EXPECT_EQ("OK", parse("{ \"contextElements\": [ { \"id\": \"E\\u00e9\\n\", \"type\": 1.50, \"isPattern\": false } ], \"updateAction\": null }"));
+  EXPECT_EQ("/contextElements=;/contextElements/contextElement=;/contextElements/contextElement/id=E\xc3\xa9\n;"
+            "/contextElements/contextElement/type=1.50;/contextElements/contextElement/isPattern=false;/updateAction=null;", treated);
+
+  EXPECT_EQ("OK", parse("\xef\xbb\xbf{ \"contextElements\": [], \"updateAction\": {} }"));
+  EXPECT_EQ("/contextElements=;/updateAction=;", treated);
+
+  utExit();
+}
+
+
+
+/* ****************************************************************************
+*
+* errors -
+*/
+TEST(jsonParse, errors)
+{
+  utInit();
+
+  EXPECT_EQ("JSON Parse Error: unknown field: /contextElements/contextElement/attributes",
+            parse("{ \"contextElements\": [ { \"id\": \"E\", \"attributes\": [] } ] }"));
+
+  EXPECT_THROW(parse(""), std::exception);
+  EXPECT_THROW(parse("\"updateAction\""), std::exception);
+  EXPECT_THROW(parse(" 12"), std::exception);
+  EXPECT_THROW(parse("null"), std::exception);
+  EXPECT_THROW(parse("{ \"updateAction\": \"x\", }"), std::exception);
+  EXPECT_THROW(parse("{ \"updateAction\": 01 }"), std::exception);
+  EXPECT_THROW(parse("{ \"updateAction\": \"\\x\" }"), std::exception);
+  EXPECT_THROW(parse("{ \"updateAction\": \"\xff\" }"), std::exception);
+  EXPECT_THROW(parse("{ \"updateAction\": \"x\" } x"), std::exception);
+  EXPECT_THROW(parse("{ \"contextElements\": { \"contextElement\": { \"id\": \"E\" } } }"), std::exception);
+
+  utExit();
+}
+
+
+
+/* ****************************************************************************
+*
+* index - parse vectors indexed by jsonParseIndex give the same results
+*/
+TEST(jsonParse, index)
+{
+  utInit();
+
+  jsonParseIndex(parseVector);
+  jsonParseIndex(parseVector);
+
+  EXPECT_EQ("OK", parse("{ \"contextElements\": [ { \"id\": \"E\", \"type\": \"T\" } ], \"updateAction\": \"APPEND\" }"));
+  EXPECT_EQ("/contextElements=;/contextElements/contextElement=;/contextElements/contextElement/id=E;"
+            "/contextElements/contextElement/type=T;/updateAction=APPEND;", treated);
+
+  EXPECT_EQ("JSON Parse Error: unknown field: /contextElements/contextElement/attributes",
+            parse("{ \"contextElements\": [ { \"id\": \"E\", \"attributes\": [] } ] }"));
+
+  utExit();
+}
@@ -0,0 +1,258 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "logMsg/logMsg.h"
+
+
+
+/* ****************************************************************************
+*
+* ASYNC_BUFFER_SIZE - rounded up to the minimum ring size (1024 bytes) by lmAsyncStart
+*
+* Each test stops asynchronous logging at its end, so the tests after it log synchronously.
+*/
+#define ASYNC_BUFFER_SIZE  1
+
+
+
+/* ****************************************************************************
+*
+* logOpen - register a temporary log file, with only the text of the lines
+*/
+static int logOpen(char* path)
+{
+  int fd = mkstemp(path);
+
+  EXPECT_NE(-1, fd);
+  EXPECT_EQ(LmsOk, lmFdRegister(fd, "TEXT", "DEF", "test", NULL));
+
+  return fd;
+}
+
+
+
+/* ****************************************************************************
+*
+* logContent - content of the temporary log file, as written so far
+*/
+static std::string logContent(int fd)
+{
+  std::string content;
+  char        buf[1024];
+  ssize_t     nb;
+
+  lseek(fd, 0, SEEK_SET);
+  while ((nb = read(fd, buf, sizeof(buf))) > 0)
+  {
+    content.append(buf, nb);
+  }
+
+  return content;
+}
+
+
+
+/* ****************************************************************************
+*
+* logClose - unregister the temporary log file and return its content
+*/
+static std::string logClose(int fd, char* path)
+{
+  lmAsyncFlush();
+  lmFdUnregister(fd);
+
+  std::string content = logContent(fd);
+
+  close(fd);
+  unlink(path);
+
+  return content;
+}
+
+
+
+/* ****************************************************************************
+*
+* logLine - thread logging a single line
+*/
+static void* logLine(void* vP)
+{
+  LM_M(("%s", (const char*) vP));
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* ring - lines go through the ring of the thread, wrapping around its end, and reach the file intact
+*/
+TEST(logMsgAsync, ring)
+{
+  char path[] = "/tmp/logMsgAsync_ring_XXXXXX";
+
+  EXPECT_EQ(LmsOk, lmAsyncStart(ASYNC_BUFFER_SIZE));
+
+  int fd = logOpen(path);
+
+  // Each line is flushed before the next one, so they always fit and the ring wraps many times
+  for (int ix = 0; ix < 40; ++ix)
+  {
+    LM_M(("async ring line %03d: 0123456789abcdefghijklmnopqrstuvwxyz", ix));
+    lmAsyncFlush();
+  }
+
+  std::string content = logClose(fd, path);
+
+  for (int ix = 0; ix < 40; ++ix)
+  {
+    char line[128];
+
+    snprintf(line, sizeof(line), "async ring line %03d: 0123456789abcdefghijklmnopqrstuvwxyz\n", ix);
+    EXPECT_NE(std::string::npos, content.find(line)) << line;
+  }
+
+  lmAsyncStop();
+}
+
+
+
+/* ****************************************************************************
+*
+* dropped - a line that doesn't fit in the ring is dropped and counted, the next ones are logged
+*/
+TEST(logMsgAsync, dropped)
+{
+  char        path[] = "/tmp/logMsgAsync_dropped_XXXXXX";
+  std::string big(2048, 'x');
+
+  EXPECT_EQ(LmsOk, lmAsyncStart(ASYNC_BUFFER_SIZE));
+
+  int       fd      = logOpen(path);
+  long long dropped = lmAsyncDropped();
+
+  LM_M(("async big line %s", big.c_str()));
+  EXPECT_LT(dropped, lmAsyncDropped());
+
+  dropped = lmAsyncDropped();
+  LM_M(("async small line"));
+  EXPECT_EQ(dropped, lmAsyncDropped());
+
+  std::string content = logClose(fd, path);
+
+  EXPECT_EQ(std::string::npos, content.find("async big line"));
+  EXPECT_NE(std::string::npos, content.find("async small line\n"));
+
+  lmAsyncStop();
+}
+
+
+
+/* ****************************************************************************
+*
+* recycle - the buffer of a finished thread, once written, is taken by the next thread
+*/
+TEST(logMsgAsync, recycle)
+{
+  char       path[] = "/tmp/logMsgAsync_recycle_XXXXXX";
+  pthread_t  tid;
+  int        freeBuffers = 0;
+
+  EXPECT_EQ(LmsOk, lmAsyncStart(ASYNC_BUFFER_SIZE));
+
+  int fd = logOpen(path);
+
+  EXPECT_EQ(0, pthread_create(&tid, NULL, logLine, (void*) "async thread 1"));
+  EXPECT_EQ(0, pthread_join(tid, NULL));
+
+  // The writer thread frees the buffer after writing its lines
+  for (int nap = 0; (nap < 200) && (freeBuffers == 0); ++nap)
+  {
+    usleep(10000);
+    lmAsyncBuffers(&freeBuffers);
+  }
+  EXPECT_LT(0, freeBuffers);
+
+  int buffers = lmAsyncBuffers(NULL);
+
+  EXPECT_EQ(0, pthread_create(&tid, NULL, logLine, (void*) "async thread 2"));
+  EXPECT_EQ(0, pthread_join(tid, NULL));
+
+  // No new buffer, the second thread used the free one
+  EXPECT_EQ(buffers, lmAsyncBuffers(NULL));
+
+  std::string content = logClose(fd, path);
+
+  EXPECT_NE(std::string::npos, content.find("async thread 1\n"));
+  EXPECT_NE(std::string::npos, content.find("async thread 2\n"));
+
+  lmAsyncStop();
+}
+
+
+
+/* ****************************************************************************
+*
+* stop - lmAsyncStop writes the pending lines and logging is synchronous again, until the next lmAsyncStart
+*/
+TEST(logMsgAsync, stop)
+{
+  char        path[] = "/tmp/logMsgAsync_stop_XXXXXX";
+  std::string big(2048, 'x');
+
+  EXPECT_EQ(LmsOk, lmAsyncStart(ASYNC_BUFFER_SIZE));
+
+  int fd = logOpen(path);
+
+  LM_M(("async line before stop"));
+  lmAsyncStop();
+
+  // Synchronous: the line is in the file as soon as LM_M returns, even if it doesn't fit in a ring
+  long long dropped = lmAsyncDropped();
+
+  LM_M(("sync big line %s", big.c_str()));
+  EXPECT_EQ(dropped, lmAsyncDropped());
+  EXPECT_NE(std::string::npos, logContent(fd).find("sync big line " + big + "\n"));
+
+  // Restarted with bigger rings, a line that didn't fit in the former ones is not dropped
+  EXPECT_EQ(LmsOk, lmAsyncStart(4096));
+  LM_M(("async big line %s", big.c_str()));
+  EXPECT_EQ(dropped, lmAsyncDropped());
+  lmAsyncStop();
+
+  std::string content = logClose(fd, path);
+
+  EXPECT_NE(std::string::npos, content.find("async line before stop\n"));
+  EXPECT_NE(std::string::npos, content.find("async big line " + big + "\n"));
+}
@@ -70,6 +70,7 @@ bool          noCache               = false;
 char          fwdHost[64];
 char          notificationMode[64];
 bool          simulatedNotification;
+bool          notifCoalesce         = false;
 int           lsPeriod             = 0;
 
 
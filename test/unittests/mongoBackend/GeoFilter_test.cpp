@@ -0,0 +1,143 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "common/globals.h"
+#include "ngsi/ContextElementResponse.h"
+#include "mongoBackend/GeoFilter.h"
+
+
+
+/* ****************************************************************************
+*
+* match - does an entity located at lat/lon match the geo filter?
+*/
+static bool match(const std::string& geometry, const std::string& coords, const std::string& georel, double lat, double lon)
+{
+  GeoFilterP gfP = geoFilterCompile(geometry, coords, georel);
+
+  return gfP->match(orion::Point(lat, lon));
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoFilter_match -
+*/
+TEST(GeoFilter, match)
+{
+  // Square polygon, from (0,0) to (10,10)
+  const char* square = "0,0;0,10;10,10;10,0;0,0";
+
+  EXPECT_TRUE(match("polygon", square, "coveredBy", 5, 5));
+  EXPECT_TRUE(match("polygon", square, "intersects", 0, 5));
+  EXPECT_FALSE(match("polygon", square, "coveredBy", 5, 11));
+  EXPECT_FALSE(match("polygon", square, "disjoint", 5, 5));
+  EXPECT_TRUE(match("polygon", square, "disjoint", -1, 5));
+  EXPECT_FALSE(match("polygon", square, "equals", 5, 5));
+
+  // Triangle: the point (8,2) is inside its bounding box but not inside it
+  EXPECT_TRUE(match("polygon", "0,0;10,0;0,10;0,0", "coveredBy", 2, 2));
+  EXPECT_FALSE(match("polygon", "0,0;10,0;0,10;0,0", "coveredBy", 8, 8));
+
+  EXPECT_TRUE(match("box", "1,1;3,4", "coveredBy", 2, 3));
+  EXPECT_FALSE(match("box", "1,1;3,4", "coveredBy", 2, 5));
+
+  EXPECT_TRUE(match("line", "0,0;10,10", "intersects", 5, 5));
+  EXPECT_FALSE(match("line", "0,0;10,10", "intersects", 5, 6));
+
+  EXPECT_TRUE(match("point", "40.4,-3.7", "equals", 40.4, -3.7));
+  EXPECT_FALSE(match("point", "40.4,-3.7", "equals", 40.4, -3.6));
+
+  // Madrid - Toledo is about 67 km
+  EXPECT_TRUE(match("point", "40.4168,-3.7038", "near;maxDistance:70000", 39.8628, -4.0273));
+  EXPECT_FALSE(match("point", "40.4168,-3.7038", "near;maxDistance:60000", 39.8628, -4.0273));
+  EXPECT_TRUE(match("point", "40.4168,-3.7038", "near;minDistance:60000", 39.8628, -4.0273));
+  EXPECT_FALSE(match("point", "40.4168,-3.7038", "near;minDistance:1000;maxDistance:60000", 39.8628, -4.0273));
+
+  // Invalid filters don't match
+  EXPECT_FALSE(match("polygon", square, "", 5, 5));
+  EXPECT_FALSE(match("polygon", "0,0;0,10;10,10", "coveredBy", 5, 5));
+  EXPECT_FALSE(match("circle", "0,0", "coveredBy", 0, 0));
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoFilter_bounds -
+*/
+TEST(GeoFilter, bounds)
+{
+  EXPECT_TRUE(geoFilterCompile("", "", "").get() == NULL);
+
+  GeoFilterP gfP = geoFilterCompile("polygon", "0,0;2,10;10,10;10,-1;0,0", "coveredBy");
+
+  EXPECT_TRUE(gfP->valid);
+  EXPECT_TRUE(gfP->bounded);
+  EXPECT_EQ(0,  gfP->minLat);
+  EXPECT_EQ(10, gfP->maxLat);
+  EXPECT_EQ(-1, gfP->minLon);
+  EXPECT_EQ(10, gfP->maxLon);
+  EXPECT_TRUE(gfP->inBounds(orion::Point(5, 5)));
+  EXPECT_FALSE(gfP->inBounds(orion::Point(5, 11)));
+
+  gfP = geoFilterCompile("point", "40,-3", "near;maxDistance:1000");
+  EXPECT_TRUE(gfP->bounded);
+  EXPECT_TRUE(gfP->inBounds(orion::Point(40.005, -3.005)));
+  EXPECT_FALSE(gfP->inBounds(orion::Point(40.01, -3)));
+
+  EXPECT_FALSE(geoFilterCompile("point", "40,-3", "near;minDistance:1000")->bounded);
+  EXPECT_FALSE(geoFilterCompile("box", "1,1;3,4", "disjoint")->bounded);
+  EXPECT_FALSE(geoFilterCompile("box", "1,1;3,4", "")->valid);
+}
+
+
+
+/* ****************************************************************************
+*
+* GeoFilter_location -
+*/
+TEST(GeoFilter, location)
+{
+  ContextElementResponse cer;
+  orion::Point           location;
+
+  cer.contextElement.contextAttributeVector.push_back(new ContextAttribute("temperature", "Number", 23.5));
+  EXPECT_FALSE(geoFilterLocation(cer.contextElement.contextAttributeVector, &location));
+  EXPECT_FALSE(geoFilterCompile("box", "1,1;3,4", "coveredBy")->match(&cer));
+
+  cer.contextElement.contextAttributeVector.push_back(new ContextAttribute("position", GEO_POINT, "2, 3"));
+  EXPECT_TRUE(geoFilterLocation(cer.contextElement.contextAttributeVector, &location));
+  EXPECT_EQ(2, location.latitude());
+  EXPECT_EQ(3, location.longitude());
+  EXPECT_TRUE(geoFilterCompile("box", "1,1;3,4", "coveredBy")->match(&cer));
+  EXPECT_FALSE(geoFilterCompile("box", "1,1;3,4", "disjoint")->match(&cer));
+
+  cer.release();
+}
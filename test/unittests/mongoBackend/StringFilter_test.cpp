@@ -0,0 +1,142 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Ken Zangelin
+*/
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "common/globals.h"
+#include "ngsi/ContextElementResponse.h"
+#include "mongoBackend/StringFilter.h"
+
+
+
+/* ****************************************************************************
+*
+* match - parse 'q' and match it on an entity with a number, a string and a date attribute
+*/
+static bool match(const std::string& q)
+{
+  ContextElementResponse cer;
+  StringFilter           sf;
+
+  cer.contextElement.entityId.fill("E1", "T1", "false");
+  cer.contextElement.creDate = 1000;
+  cer.contextElement.modDate = 2000;
+  cer.contextElement.contextAttributeVector.push_back(new ContextAttribute("temperature", "Number", 23.5));
+  cer.contextElement.contextAttributeVector.push_back(new ContextAttribute("color", "Text", "red"));
+  cer.contextElement.contextAttributeVector.push_back(new ContextAttribute("when", "DateTime", (double) parse8601Time("2016-04-05T14:00:00Z")));
+
+  sf.parse(q);
+  bool result = sf.match(&cer);
+
+  cer.release();
+
+  return result;
+}
+
+
+
+/* ****************************************************************************
+*
+* StringFilter_match -
+*/
+TEST(StringFilter, match)
+{
+  EXPECT_TRUE(match("temperature==23.5"));
+  EXPECT_FALSE(match("temperature==23"));
+  EXPECT_TRUE(match("temperature!=23"));
+  EXPECT_TRUE(match("temperature>23"));
+  EXPECT_FALSE(match("temperature<23"));
+  EXPECT_TRUE(match("temperature>=23.5"));
+  EXPECT_TRUE(match("temperature<=23.5"));
+  EXPECT_TRUE(match("temperature==20..25"));
+  EXPECT_FALSE(match("temperature!=20..25"));
+  EXPECT_TRUE(match("temperature==1,23.5,7"));
+  EXPECT_FALSE(match("temperature!=1,23.5,7"));
+
+  EXPECT_TRUE(match("color==red"));
+  EXPECT_FALSE(match("color==blue"));
+  EXPECT_TRUE(match("color!=blue"));
+  EXPECT_TRUE(match("color==blue,'red'"));
+  EXPECT_FALSE(match("color>1"));
+
+  EXPECT_TRUE(match("when==2016-04-05T14:00:00Z"));
+  EXPECT_TRUE(match("when>2016-04-05T13:00:00Z"));
+  EXPECT_TRUE(match("when==2016-04-05T13:00:00Z..2016-04-05T15:00:00Z"));
+  EXPECT_TRUE(match("dateCreated<1500"));
+  EXPECT_TRUE(match("dateModified==2000"));
+
+  EXPECT_TRUE(match("color"));
+  EXPECT_FALSE(match("!color"));
+  EXPECT_TRUE(match("!humidity"));
+  EXPECT_FALSE(match("humidity==1"));
+
+  EXPECT_TRUE(match("temperature>20;color==red;!humidity"));
+  EXPECT_FALSE(match("temperature>20;color==blue"));
+}
+
+
+
+/* ****************************************************************************
+*
+* StringFilter_parse -
+*/
+TEST(StringFilter, parse)
+{
+  StringFilter sf;
+
+  EXPECT_FALSE(sf.parse(""));
+  EXPECT_FALSE(sf.parse(";"));
+  EXPECT_FALSE(sf.parse("a==1;;b==2"));
+  EXPECT_FALSE(sf.parse("a>1..2"));
+  EXPECT_FALSE(sf.parse("a=="));
+  EXPECT_FALSE(sf.parse("==1"));
+
+  // An invalid filter doesn't match
+  EXPECT_FALSE(match("temperature=="));
+
+  EXPECT_TRUE(sf.parse("a==1..2;b!=x,'y,z';c>=2016-04-05T14:00:00Z;!d"));
+  ASSERT_EQ(4, sf.filters.size());
+
+  EXPECT_EQ("==", sf.filters[0].opr);
+  EXPECT_TRUE(sf.filters[0].rangeIsNumber);
+  EXPECT_EQ(1, sf.filters[0].rangeFromNumber);
+  EXPECT_EQ(2, sf.filters[0].rangeToNumber);
+
+  EXPECT_EQ("!=", sf.filters[1].opr);
+  ASSERT_EQ(2, sf.filters[1].valVector.size());
+  EXPECT_EQ("y,z", sf.filters[1].valVector[1]);
+  EXPECT_FALSE(sf.filters[1].valIsNumber[1]);
+
+  EXPECT_EQ("DATE", sf.filters[2].right);
+  EXPECT_TRUE(sf.filters[2].rightIsNumber);
+  EXPECT_EQ(parse8601Time("2016-04-05T14:00:00Z"), sf.filters[2].seconds);
+
+  EXPECT_EQ(OPR_NOT_EXIST, sf.filters[3].opr);
+  EXPECT_EQ("d", sf.filters[3].right);
+
+  EXPECT_TRUE(stringFilterCompile("").get() == NULL);
+  EXPECT_FALSE(stringFilterCompile("a==")->valid);
+}
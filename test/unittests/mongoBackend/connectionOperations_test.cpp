@@ -0,0 +1,118 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "unittest.h"
+#include "mongo/client/dbclient.h"
+
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/connectionOperations.h"
+
+using mongo::BSONObj;
+using mongo::DBClientBase;
+
+
+
+/* ****************************************************************************
+*
+* bulkInsertWriteErrors - only the documents that cannot be inserted are flagged
+*
+* The second E1 is a duplicate key error, the rest of the documents are inserted
+* anyway (the command is unordered).
+*/
+TEST(connectionOperations, bulkInsertWriteErrors)
+{
+  std::vector<BSONObj>  docs;
+  std::vector<bool>     writtenV;
+  std::string           err;
+
+  utInit();
+  setupDatabase();
+
+  docs.push_back(BSON("_id" << BSON("id" << "E1" << "type" << "T")));
+  docs.push_back(BSON("_id" << BSON("id" << "E2" << "type" << "T")));
+  docs.push_back(BSON("_id" << BSON("id" << "E1" << "type" << "T")));
+  docs.push_back(BSON("_id" << BSON("id" << "E3" << "type" << "T")));
+
+  EXPECT_FALSE(collectionBulkInsert(ENTITIES_COLL, docs, &writtenV, &err));
+  ASSERT_EQ(4, writtenV.size());
+  EXPECT_TRUE(writtenV[0]);
+  EXPECT_TRUE(writtenV[1]);
+  EXPECT_FALSE(writtenV[2]);
+  EXPECT_TRUE(writtenV[3]);
+  EXPECT_NE(std::string::npos, err.find("E11000"));
+
+  DBClientBase* connection = getMongoConnection();
+  EXPECT_EQ(3, connection->count(ENTITIES_COLL, BSONObj()));
+  releaseMongoConnection(connection);
+
+  utExit();
+}
+
+
+
+/* ****************************************************************************
+*
+* bulkUpdateWriteErrors - only the documents that cannot be updated are flagged
+*/
+TEST(connectionOperations, bulkUpdateWriteErrors)
+{
+  std::vector<BSONObj>  queries;
+  std::vector<BSONObj>  docs;
+  std::vector<bool>     writtenV;
+  std::string           err;
+
+  utInit();
+  setupDatabase();
+
+  DBClientBase* connection = getMongoConnection();
+  connection->insert(ENTITIES_COLL, BSON("_id" << BSON("id" << "E1" << "type" << "T") << "modDate" << 1));
+  connection->insert(ENTITIES_COLL, BSON("_id" << BSON("id" << "E2" << "type" << "T") << "modDate" << 1));
+  releaseMongoConnection(connection);
+
+  // The update of the _id of E1 is rejected, that of E2 is done
+  queries.push_back(BSON("_id.id" << "E1"));
+  docs.push_back(BSON("$set" << BSON("_id.id" << "E3")));
+  queries.push_back(BSON("_id.id" << "E2"));
+  docs.push_back(BSON("$set" << BSON("modDate" << 2)));
+
+  EXPECT_FALSE(collectionBulkUpdate(ENTITIES_COLL, queries, docs, false, &writtenV, &err));
+  ASSERT_EQ(2, writtenV.size());
+  EXPECT_FALSE(writtenV[0]);
+  EXPECT_TRUE(writtenV[1]);
+
+  connection = getMongoConnection();
+  EXPECT_EQ(2, connection->findOne(ENTITIES_COLL, BSON("_id.id" << "E2")).getIntField("modDate"));
+  releaseMongoConnection(connection);
+
+  // Nothing to do
+  queries.clear();
+  docs.clear();
+  EXPECT_TRUE(collectionBulkUpdate(ENTITIES_COLL, queries, docs, false, &writtenV, &err));
+  EXPECT_EQ(0, writtenV.size());
+
+  utExit();
+}
@@ -0,0 +1,323 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "unittest.h"
+#include "mongo/client/dbclient.h"
+
+#include "common/limits.h"
+#include "ngsi/EntityIdVector.h"
+#include "ngsi/Restriction.h"
+#include "mongoBackend/MongoGlobal.h"
+#include "mongoBackend/jsonResponses.h"
+
+using mongo::BSONObj;
+using mongo::DBClientBase;
+
+
+
+/* ****************************************************************************
+*
+* entityDoc - an entity document as stored in the database
+*/
+static BSONObj entityDoc(void)
+{
+  return BSON("_id"     << BSON("id" << "E1" << "type" << "T1") <<
+              "attrs"   << BSON("A1" << BSON("type" << "float" << "value" << 23.5) <<
+                                "A2" << BSON("type" << "" << "value" << "x" <<
+                                             "md" << BSON_ARRAY(BSON("name" << "m1" << "type" << "T" << "value" << "v"))) <<
+                                "A3" << BSON("type" << "T" << "value" << BSON("a" << BSON_ARRAY("b" << 1.0 << true)))) <<
+              "creDate" << 1360232700 <<
+              "modDate" << 1360232800);
+}
+
+
+
+/* ****************************************************************************
+*
+* normalized -
+*/
+TEST(jsonResponses, normalized)
+{
+  std::string out;
+
+  entityJsonResponse(entityDoc(), "normalized", "", false, false, &out);
+
+  EXPECT_EQ("{\"id\":\"E1\",\"type\":\"T1\","
+            "\"A1\":{\"type\":\"float\",\"value\":23.5,\"metadata\":{}},"
+            "\"A2\":{\"type\":\"none\",\"value\":\"x\",\"metadata\":{\"m1\":{\"type\":\"T\",\"value\":\"v\"}}},"
+            "\"A3\":{\"type\":\"T\",\"value\":{\"a\":[\"b\",1,true]},\"metadata\":{}}}", out);
+}
+
+
+
+/* ****************************************************************************
+*
+* keyValues -
+*/
+TEST(jsonResponses, keyValues)
+{
+  std::string out;
+
+  entityJsonResponse(entityDoc(), "keyValues", "A3,A1", false, false, &out);
+  EXPECT_EQ("{\"id\":\"E1\",\"type\":\"T1\",\"A3\":{\"a\":[\"b\",1,true]},\"A1\":23.5}", out);
+
+  out = "";
+  entityJsonResponse(entityDoc(), "values", "A2", false, false, &out);
+  EXPECT_EQ("[\"x\"]", out);
+}
+
+
+
+/* ****************************************************************************
+*
+* dates -
+*/
+TEST(jsonResponses, dates)
+{
+  std::string out;
+
+  entityJsonResponse(entityDoc(), "keyValues", "A1,dateCreated,dateModified", true, true, &out);
+  EXPECT_EQ("{\"id\":\"E1\",\"type\":\"T1\",\"A1\":23.5,"
+            "\"dateCreated\":\"2013-02-07T10:25:00.00Z\",\"dateModified\":\"2013-02-07T10:26:40.00Z\"}", out);
+}
+
+
+
+/* ****************************************************************************
+*
+* prepareDatabase - 'n' entities E0, E1, ... of type T, of about 1 KB each
+*
+* The creation dates give the order in which they are returned.
+*/
+static void prepareDatabase(int n)
+{
+  setupDatabase();
+
+  DBClientBase*  connection = getMongoConnection();
+  std::string    value(1000, 'x');
+
+  for (int ix = 0; ix < n; ++ix)
+  {
+    char id[16];
+
+    snprintf(id, sizeof(id), "E%d", ix);
+    connection->insert(ENTITIES_COLL, BSON("_id"       << BSON("id" << id << "type" << "T") <<
+                                           "attrNames" << BSON_ARRAY("A") <<
+                                           "attrs"     << BSON("A" << BSON("type" << "T" << "value" << value)) <<
+                                           "creDate"   << 1360232700 + ix));
+  }
+
+  releaseMongoConnection(connection);
+}
+
+
+
+/* ****************************************************************************
+*
+* expectedEntities - the JSON array of the entities E<from> to E<to - 1> of prepareDatabase
+*/
+static std::string expectedEntities(int from, int to)
+{
+  std::string  out   = "[";
+  std::string  value(1000, 'x');
+
+  for (int ix = from; ix < to; ++ix)
+  {
+    char id[16];
+
+    snprintf(id, sizeof(id), "E%d", ix);
+    if (ix != from)
+    {
+      out += ",";
+    }
+
+    entityJsonResponse(BSON("_id"   << BSON("id" << id << "type" << "T") <<
+                            "attrs" << BSON("A" << BSON("type" << "T" << "value" << value))),
+                       "normalized", "", false, false, &out);
+  }
+
+  return out + "]";
+}
+
+
+
+/* ****************************************************************************
+*
+* queryRender - GET /v2/entities?type=T with the given pagination, streamed (if big enough) in blocks of 'block' bytes
+*/
+static bool queryRender(int offset, int limit, int block, std::string* outP, bool* streamedP)
+{
+  EntityIdVector            enV;
+  Restriction               res;
+  std::vector<std::string>  servicePathV;
+  std::string               err;
+  ResponseStream*           streamP = NULL;
+
+  enV.push_back(new EntityId(".*", "T", "true"));
+
+  bool ok = entitiesQueryRender(enV, res, "", servicePathV, offset, limit, NULL, "", false, false, "normalized", "", outP, &streamP, &err);
+
+  enV.release();
+
+  *streamedP = (streamP != NULL);
+  if (streamP == NULL)
+  {
+    return ok;
+  }
+
+  std::vector<char>  buf(block);
+  int                n;
+
+  while ((n = streamP->read(&buf[0], block)) > 0)
+  {
+    outP->append(&buf[0], n);
+  }
+
+  delete streamP;
+
+  return ok && (n == 0);
+}
+
+
+
+/* ****************************************************************************
+*
+* streamNotNeeded - a response under STREAM_RESPONSE_THRESHOLD is rendered at once
+*/
+TEST(jsonResponses, streamNotNeeded)
+{
+  std::string  out;
+  bool         streamed;
+
+  utInit();
+  prepareDatabase(10);
+
+  EXPECT_TRUE(queryRender(0, 20, 1024, &out, &streamed));
+  EXPECT_FALSE(streamed);
+  EXPECT_EQ(expectedEntities(0, 10), out);
+
+  utExit();
+}
+
+
+
+/* ****************************************************************************
+*
+* streamAll - the rest of a big response is read in several batches
+*/
+TEST(jsonResponses, streamAll)
+{
+  std::string  out;
+  bool         streamed;
+
+  utInit();
+  prepareDatabase(3 * STREAM_BATCH_SIZE + 10);
+
+  EXPECT_TRUE(queryRender(0, 1000, 1000, &out, &streamed));
+  EXPECT_TRUE(streamed);
+  EXPECT_EQ(expectedEntities(0, 3 * STREAM_BATCH_SIZE + 10), out);
+
+  // Reading the stream in small blocks gives the same payload
+  out.clear();
+  EXPECT_TRUE(queryRender(0, 1000, 7, &out, &streamed));
+  EXPECT_TRUE(streamed);
+  EXPECT_EQ(expectedEntities(0, 3 * STREAM_BATCH_SIZE + 10), out);
+
+  utExit();
+}
+
+
+
+/* ****************************************************************************
+*
+* streamPagination - offset and limit are kept across the batches of the stream
+*/
+TEST(jsonResponses, streamPagination)
+{
+  std::string  out;
+  bool         streamed;
+
+  utInit();
+  prepareDatabase(4 * STREAM_BATCH_SIZE);
+
+  // Limit in the middle of a batch
+  EXPECT_TRUE(queryRender(5, 2 * STREAM_BATCH_SIZE + 30, 4096, &out, &streamed));
+  EXPECT_TRUE(streamed);
+  EXPECT_EQ(expectedEntities(5, 2 * STREAM_BATCH_SIZE + 35), out);
+
+  // Limit at the end of a batch: no extra (empty) batch is needed to close the array
+  out.clear();
+  EXPECT_TRUE(queryRender(0, 3 * STREAM_BATCH_SIZE, 4096, &out, &streamed));
+  EXPECT_TRUE(streamed);
+  EXPECT_EQ(expectedEntities(0, 3 * STREAM_BATCH_SIZE), out);
+
+  utExit();
+}
+
+
+
+/* ****************************************************************************
+*
+* streamRemovedEntity - the rest of the response is read from the database as it is sent
+*
+* So an entity removed after the response has started (but before it is read) is not in it.
+*/
+TEST(jsonResponses, streamRemovedEntity)
+{
+  EntityIdVector            enV;
+  Restriction               res;
+  std::vector<std::string>  servicePathV;
+  std::string               err;
+  std::string               out;
+  ResponseStream*           streamP = NULL;
+  char                      buf[1024];
+  int                       n;
+
+  utInit();
+  prepareDatabase(2 * STREAM_BATCH_SIZE);
+
+  enV.push_back(new EntityId(".*", "T", "true"));
+  EXPECT_TRUE(entitiesQueryRender(enV, res, "", servicePathV, 0, 1000, NULL, "", false, false, "normalized", "", &out, &streamP, &err));
+  enV.release();
+  ASSERT_TRUE(streamP != NULL);
+
+  // E199, in the last batch, is removed before the stream reads it
+  DBClientBase* connection = getMongoConnection();
+  connection->remove(ENTITIES_COLL, BSON("_id.id" << "E199"));
+  releaseMongoConnection(connection);
+
+  while ((n = streamP->read(buf, sizeof(buf))) > 0)
+  {
+    out.append(buf, n);
+  }
+  delete streamP;
+
+  EXPECT_EQ(0, n);
+  EXPECT_EQ(expectedEntities(0, 2 * STREAM_BATCH_SIZE - 1), out);
+
+  utExit();
+}
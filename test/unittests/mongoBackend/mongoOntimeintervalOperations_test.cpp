@@ -522,8 +522,8 @@ TEST(mongoOntimeintervalOperations, mongoGetContextElementResponses_dbfail)
     /* Check results */
     EXPECT_EQ(SccOk, ms);
     EXPECT_EQ("Database Error (collection: utest.entities - "
-              "query(): { query: { $or: [ { _id.id: \"E1\", _id.type: \"T\" }, { _id.id: \"E2\", _id.type: \"T\" } ], _id.servicePath: { $in: [ /^/.*/, null ] }, "
-              "attrNames: { $in: [ \"A1\", \"A2\", \"A3\", \"A4\" ] } }, orderby: { creDate: 1 } } - "
+              "query(): { query: { _id.servicePath: { $in: [ /^//, null ] }, attrNames: { $in: [ \"A1\", \"A2\", \"A3\", \"A4\" ] }, "
+              "$or: [ { _id.id: \"E1\", _id.type: \"T\" }, { _id.id: \"E2\", _id.type: \"T\" } ] }, orderby: { creDate: 1 } } - "
               "exception: boom!!)", err);
 
     /* Restore real DB connection */
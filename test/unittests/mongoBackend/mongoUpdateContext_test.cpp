@@ -10231,6 +10231,234 @@ bool firstTimeTrue(void)
     }
 }
 
+/* ****************************************************************************
+*
+* noActualChangesNGSIv2 -
+*
+* Same values than in DB (note A2 has no value in DB, which is the same than "")
+*/
+TEST(mongoUpdateContextRequest, noActualChangesNGSIv2)
+{
+  HttpStatusCode         ms;
+  UpdateContextRequest   req;
+  UpdateContextResponse  res;
+
+  utInit();
+
+  /* Prepare database */
+  prepareDatabase();
+
+  /* Forge the request (from "inside" to "outside") */
+  ContextElement ce;
+  ce.entityId.fill("E1", "T1", "false");
+  ContextAttribute ca1("A1", "", "val1");
+  ContextAttribute ca2("A2", "", "");
+  ce.contextAttributeVector.push_back(&ca1);
+  ce.contextAttributeVector.push_back(&ca2);
+  req.contextElementVector.push_back(&ce);
+  req.updateActionType.set("UPDATE");
+
+  /* Invoke the function in mongoBackend library */
+  servicePathVector.clear();
+  ms = mongoUpdateContext(&req, &res, "", servicePathVector, uriParams, "", "v2");
+
+  /* Check response is as expected */
+  EXPECT_EQ(SccOk, ms);
+
+  EXPECT_EQ(SccOk, res.errorCode.code);
+  EXPECT_EQ("OK", res.errorCode.reasonPhrase);
+  EXPECT_EQ(0, res.errorCode.details.size());
+
+  ASSERT_EQ(1, res.contextElementResponseVector.size());
+  /* Context Element response # 1 */
+  EXPECT_EQ("E1", RES_CER(0).entityId.id);
+  EXPECT_EQ("T1", RES_CER(0).entityId.type);
+  EXPECT_EQ("false", RES_CER(0).entityId.isPattern);
+  ASSERT_EQ(2, RES_CER(0).contextAttributeVector.size());
+  EXPECT_EQ("A1", RES_CER_ATTR(0, 0)->name);
+  EXPECT_EQ("A2", RES_CER_ATTR(0, 1)->name);
+  EXPECT_EQ(SccOk, RES_CER_STATUS(0).code);
+  EXPECT_EQ("OK", RES_CER_STATUS(0).reasonPhrase);
+  EXPECT_EQ("", RES_CER_STATUS(0).details);
+
+  /* Check that every involved collection at MongoDB is as expected */
+  /* Note we are using EXPECT_STREQ() for some cases, as Mongo Driver returns const char*, not string
+   * objects (see http://code.google.com/p/googletest/wiki/Primer#String_Comparison) */
+
+  DBClientBase* connection = getMongoConnection();
+
+  /* entities collection */
+  BSONObj ent, attrs;
+  ASSERT_EQ(5, connection->count(ENTITIES_COLL, BSONObj()));
+
+  ent = connection->findOne(ENTITIES_COLL, BSON("_id.id" << "E1" << "_id.type" << "T1"));
+  EXPECT_FALSE(ent.hasField("modDate"));
+  attrs = ent.getField("attrs").embeddedObject();
+  ASSERT_EQ(2, attrs.nFields());
+  BSONObj a1 = attrs.getField("A1").embeddedObject();
+  BSONObj a2 = attrs.getField("A2").embeddedObject();
+  EXPECT_STREQ("TA1", C_STR_FIELD(a1, "type"));
+  EXPECT_STREQ("val1", C_STR_FIELD(a1, "value"));
+  EXPECT_FALSE(a1.hasField("modDate"));
+  EXPECT_STREQ("TA2", C_STR_FIELD(a2, "type"));
+  EXPECT_FALSE(a2.hasField("value"));
+  EXPECT_FALSE(a2.hasField("modDate"));
+
+  utExit();
+}
+
+/* ****************************************************************************
+*
+* onlyTypeChangesNGSIv2 -
+*
+* Entity without type in the request, only the type of the attribute changes
+*/
+TEST(mongoUpdateContextRequest, onlyTypeChangesNGSIv2)
+{
+  HttpStatusCode         ms;
+  UpdateContextRequest   req;
+  UpdateContextResponse  res;
+
+  utInit();
+
+  /* Prepare database */
+  prepareDatabase();
+
+  /* Forge the request (from "inside" to "outside") */
+  ContextElement ce;
+  ce.entityId.fill("E3", "", "false");
+  ContextAttribute ca("A5", "TA5bis", "val5");
+  ce.contextAttributeVector.push_back(&ca);
+  req.contextElementVector.push_back(&ce);
+  req.updateActionType.set("UPDATE");
+
+  /* Invoke the function in mongoBackend library */
+  servicePathVector.clear();
+  ms = mongoUpdateContext(&req, &res, "", servicePathVector, uriParams, "", "v2");
+
+  /* Check response is as expected */
+  EXPECT_EQ(SccOk, ms);
+
+  EXPECT_EQ(SccOk, res.errorCode.code);
+  EXPECT_EQ("OK", res.errorCode.reasonPhrase);
+  EXPECT_EQ(0, res.errorCode.details.size());
+
+  ASSERT_EQ(1, res.contextElementResponseVector.size());
+  /* Context Element response # 1 */
+  EXPECT_EQ("E3", RES_CER(0).entityId.id);
+  EXPECT_EQ("T3", RES_CER(0).entityId.type);
+  EXPECT_EQ("false", RES_CER(0).entityId.isPattern);
+  ASSERT_EQ(1, RES_CER(0).contextAttributeVector.size());
+  EXPECT_EQ("A5", RES_CER_ATTR(0, 0)->name);
+  EXPECT_EQ("TA5bis", RES_CER_ATTR(0, 0)->type);
+  EXPECT_EQ(SccOk, RES_CER_STATUS(0).code);
+  EXPECT_EQ("OK", RES_CER_STATUS(0).reasonPhrase);
+  EXPECT_EQ("", RES_CER_STATUS(0).details);
+
+  /* Check that every involved collection at MongoDB is as expected */
+  DBClientBase* connection = getMongoConnection();
+
+  /* entities collection */
+  BSONObj ent, attrs;
+  ASSERT_EQ(5, connection->count(ENTITIES_COLL, BSONObj()));
+
+  ent = connection->findOne(ENTITIES_COLL, BSON("_id.id" << "E3" << "_id.type" << "T3"));
+  EXPECT_EQ(1360232700, ent.getIntField("modDate"));
+  attrs = ent.getField("attrs").embeddedObject();
+  ASSERT_EQ(2, attrs.nFields());
+  BSONObj a5 = attrs.getField("A5").embeddedObject();
+  BSONObj a6 = attrs.getField("A6").embeddedObject();
+  EXPECT_STREQ("TA5bis", C_STR_FIELD(a5, "type"));
+  EXPECT_STREQ("val5", C_STR_FIELD(a5, "value"));
+  EXPECT_EQ(1360232700, a5.getIntField("modDate"));
+  EXPECT_STREQ("TA6", C_STR_FIELD(a6, "type"));
+  EXPECT_FALSE(a6.hasField("value"));
+  EXPECT_FALSE(a6.hasField("modDate"));
+
+  utExit();
+}
+
+/* ****************************************************************************
+*
+* batchSameEntityTwiceNGSIv2 -
+*
+* The second element of the batch appends to the entity created by the first one
+*/
+TEST(mongoUpdateContextRequest, batchSameEntityTwiceNGSIv2)
+{
+  HttpStatusCode         ms;
+  UpdateContextRequest   req;
+  UpdateContextResponse  res;
+
+  utInit();
+
+  /* Prepare database */
+  prepareDatabase();
+
+  /* Forge the request (from "inside" to "outside") */
+  ContextElement ce1;
+  ce1.entityId.fill("E4", "T4", "false");
+  ContextAttribute ca1("A1", "TA1", "val1");
+  ce1.contextAttributeVector.push_back(&ca1);
+  req.contextElementVector.push_back(&ce1);
+
+  ContextElement ce2;
+  ce2.entityId.fill("E3", "T3", "false");
+  ContextAttribute ca2("A5", "TA5", "new_val5");
+  ce2.contextAttributeVector.push_back(&ca2);
+  req.contextElementVector.push_back(&ce2);
+
+  ContextElement ce3;
+  ce3.entityId.fill("E4", "T4", "false");
+  ContextAttribute ca3("A2", "TA2", "val2");
+  ce3.contextAttributeVector.push_back(&ca3);
+  req.contextElementVector.push_back(&ce3);
+
+  req.updateActionType.set("APPEND");
+
+  /* Invoke the function in mongoBackend library */
+  servicePathVector.clear();
+  ms = mongoUpdateContext(&req, &res, "", servicePathVector, uriParams, "", "v2");
+
+  /* Check response is as expected */
+  EXPECT_EQ(SccOk, ms);
+
+  EXPECT_EQ(SccOk, res.errorCode.code);
+
+  ASSERT_EQ(3, res.contextElementResponseVector.size());
+  EXPECT_EQ("E4", RES_CER(0).entityId.id);
+  EXPECT_EQ(SccOk, RES_CER_STATUS(0).code);
+  EXPECT_EQ("E3", RES_CER(1).entityId.id);
+  EXPECT_EQ(SccOk, RES_CER_STATUS(1).code);
+  EXPECT_EQ("E4", RES_CER(2).entityId.id);
+  EXPECT_EQ(SccOk, RES_CER_STATUS(2).code);
+
+  /* Check that every involved collection at MongoDB is as expected */
+  DBClientBase* connection = getMongoConnection();
+
+  /* entities collection */
+  BSONObj ent, attrs;
+  std::vector<BSONElement> attrNames;
+  ASSERT_EQ(6, connection->count(ENTITIES_COLL, BSONObj()));
+
+  ent = connection->findOne(ENTITIES_COLL, BSON("_id.id" << "E4" << "_id.type" << "T4"));
+  attrs = ent.getField("attrs").embeddedObject();
+  attrNames = ent.getField("attrNames").Array();
+  ASSERT_EQ(2, attrs.nFields());
+  ASSERT_EQ(2, attrNames.size());
+  EXPECT_TRUE(findAttr(attrNames, "A1"));
+  EXPECT_TRUE(findAttr(attrNames, "A2"));
+  EXPECT_STREQ("val1", C_STR_FIELD(attrs.getField("A1").embeddedObject(), "value"));
+  EXPECT_STREQ("val2", C_STR_FIELD(attrs.getField("A2").embeddedObject(), "value"));
+
+  ent = connection->findOne(ENTITIES_COLL, BSON("_id.id" << "E3" << "_id.type" << "T3"));
+  attrs = ent.getField("attrs").embeddedObject();
+  EXPECT_STREQ("new_val5", C_STR_FIELD(attrs.getField("A5").embeddedObject(), "value"));
+  EXPECT_EQ(1360232700, ent.getIntField("modDate"));
+
+  utExit();
+}
+
 /* ****************************************************************************
 *
 * mongoDbUpdateFail -
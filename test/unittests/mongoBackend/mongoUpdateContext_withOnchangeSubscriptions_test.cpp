@@ -435,8 +435,8 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_updateMatch)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860001");
-    ASSERT_TRUE(subP != NULL);
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860001");
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
     /* Release mock */
@@ -499,8 +499,8 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_appendMatch)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860001");
-    ASSERT_TRUE(subP != NULL);
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860001");
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
     delete notifierMock;
@@ -558,8 +558,8 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_deleteMatch)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860001");
-    ASSERT_TRUE(subP != NULL);
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860001");
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
     /* Release mock */
@@ -625,11 +625,11 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_updateMatch_noType)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* sub1P = subCacheItemLookup("", "51307b66f481db11bf860001");
-    CachedSubscription* sub2P = subCacheItemLookup("", "51307b66f481db11bf860004");
+    CachedSubscriptionP sub1P = subCacheItemLookup("", "51307b66f481db11bf860001");
+    CachedSubscriptionP sub2P = subCacheItemLookup("", "51307b66f481db11bf860004");
 
-    ASSERT_TRUE(sub1P != NULL);
-    ASSERT_TRUE(sub2P != NULL);
+    ASSERT_TRUE(sub1P.get() != NULL);
+    ASSERT_TRUE(sub2P.get() != NULL);
 
     EXPECT_EQ(1360232700, sub1P->lastNotificationTime);
     EXPECT_EQ(1360232700, sub2P->lastNotificationTime);
@@ -700,11 +700,11 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_appendMatch_noType)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* sub1P = subCacheItemLookup("", "51307b66f481db11bf860001");
-    CachedSubscription* sub2P = subCacheItemLookup("", "51307b66f481db11bf860004");
+    CachedSubscriptionP sub1P = subCacheItemLookup("", "51307b66f481db11bf860001");
+    CachedSubscriptionP sub2P = subCacheItemLookup("", "51307b66f481db11bf860004");
 
-    ASSERT_TRUE(sub1P != NULL);
-    ASSERT_TRUE(sub2P != NULL);
+    ASSERT_TRUE(sub1P.get() != NULL);
+    ASSERT_TRUE(sub2P.get() != NULL);
 
     EXPECT_EQ(1360232700, sub1P->lastNotificationTime);
     EXPECT_EQ(1360232700, sub2P->lastNotificationTime);
@@ -771,11 +771,11 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_deleteMatch_noType)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* sub1P = subCacheItemLookup("", "51307b66f481db11bf860001");
-    CachedSubscription* sub2P = subCacheItemLookup("", "51307b66f481db11bf860004");
+    CachedSubscriptionP sub1P = subCacheItemLookup("", "51307b66f481db11bf860001");
+    CachedSubscriptionP sub2P = subCacheItemLookup("", "51307b66f481db11bf860004");
 
-    ASSERT_TRUE(sub1P != NULL);
-    ASSERT_TRUE(sub2P != NULL);
+    ASSERT_TRUE(sub1P.get() != NULL);
+    ASSERT_TRUE(sub2P.get() != NULL);
 
     EXPECT_EQ(1360232700, sub1P->lastNotificationTime);
     EXPECT_EQ(1360232700, sub2P->lastNotificationTime);
@@ -838,9 +838,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_updateMatch_pattern)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860003");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860003");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -904,9 +904,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_appendMatch_pattern)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860003");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860003");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -966,9 +966,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_deleteMatch_pattern)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860003");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860003");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
     /* Release mock */
@@ -1029,9 +1029,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_updateMatch_pattern_noT
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860005");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860005");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
     /* Release mock */
@@ -1094,9 +1094,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_appendMatch_pattern_noT
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860005");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860005");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
     /* Release mock */
@@ -1155,9 +1155,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_deleteMatch_pattern_noT
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860005");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860005");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
     /* Release mock */
@@ -1218,9 +1218,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_updateMatchDisjoint)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860001");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860001");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
     /* Release mock */
@@ -1281,9 +1281,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_appendMatchDisjoint)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860001");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860001");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
     /* Release mock */
@@ -1344,9 +1344,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_deleteMatchDisjoint)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860001");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860001");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
     /* Release mock */
@@ -1396,9 +1396,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_updateNoMatch)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860001");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860001");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(20000000, subP->lastNotificationTime);
 
     /* Release mock */
@@ -1614,9 +1614,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_updateMixMatchNoMatch)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860001");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860001");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -1682,9 +1682,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_appendMixMatchNoMatch)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860001");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860001");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -1746,9 +1746,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_deleteMixMatchNoMatch)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860001");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860001");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -1812,9 +1812,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_update2Matches1Notifica
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860001");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860001");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
     EXPECT_EQ(1, subP->count);
 
@@ -1881,9 +1881,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_append2Matches1Notifica
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860001");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860001");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
     EXPECT_EQ(1, subP->count);
 
@@ -1944,9 +1944,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, Cond1_delete2Matches1Notifica
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860001");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860001");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -2009,9 +2009,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, CondN_updateMatch)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860002");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860002");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -2075,9 +2075,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, CondN_appendMatch)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860002");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860002");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -2137,9 +2137,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, CondN_deleteMatch)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860002");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860002");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -2201,9 +2201,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, CondN_updateMatchDisjoint)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860002");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860002");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -2265,9 +2265,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, CondN_appendMatchDisjoint)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860002");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860002");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -2329,9 +2329,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, CondN_deleteMatchDisjoint)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860002");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860002");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -2599,9 +2599,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, CondN_updateMixMatchNoMatch)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860002");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860002");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -2667,9 +2667,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, CondN_appendMixMatchNoMatch)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860002");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860002");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -2731,9 +2731,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, CondN_deleteMixMatchNoMatch)
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860002");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860002");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -2797,9 +2797,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, CondN_update2Matches1Notifica
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860002");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860002");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
     EXPECT_EQ(1, subP->count);
 
@@ -2866,9 +2866,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, CondN_append2Matches1Notifica
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860002");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860002");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
     EXPECT_EQ(1, subP->count);
 
@@ -2929,9 +2929,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, CondN_delete2Matches1Notifica
     EXPECT_EQ(SccOk, ms);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860002");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860002");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(1360232700, subP->lastNotificationTime);
 
 
@@ -3006,9 +3006,9 @@ TEST(mongoUpdateContext_withOnchangeSubscriptions, DISABLED_MongoDbQueryFail)
     EXPECT_EQ("", RES_CER_STATUS(0).details);
 
     /* Check lastNotification */
-    CachedSubscription* subP = subCacheItemLookup("", "51307b66f481db11bf860001");
+    CachedSubscriptionP subP = subCacheItemLookup("", "51307b66f481db11bf860001");
 
-    ASSERT_TRUE(subP != NULL);
+    ASSERT_TRUE(subP.get() != NULL);
     EXPECT_EQ(20000000, subP->lastNotificationTime);
 
 
@@ -0,0 +1,141 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "mongo/client/dbclient.h"
+
+#include "mongoBackend/queryPlan.h"
+
+using mongo::BSONObj;
+using mongo::BSONObjBuilder;
+
+
+
+/* ****************************************************************************
+*
+* filter - the filter on 'f' that appendRegexFilter() builds for 'regex'
+*/
+static std::string filter(const std::string& regex)
+{
+  BSONObjBuilder bob;
+
+  appendRegexFilter(&bob, "f", regex);
+
+  return bob.obj().toString();
+}
+
+
+
+/* ****************************************************************************
+*
+* regexLiterals -
+*/
+TEST(queryPlan, regexLiterals)
+{
+  std::vector<std::string> literals;
+
+  EXPECT_TRUE(regexLiterals("^E1$", &literals));
+  ASSERT_EQ(1, literals.size());
+  EXPECT_EQ("E1", literals[0]);
+
+  EXPECT_TRUE(regexLiterals("^E1$|^a\\.b$|^c$", &literals));
+  ASSERT_EQ(3, literals.size());
+  EXPECT_EQ("a.b", literals[1]);
+  EXPECT_EQ("c", literals[2]);
+
+  EXPECT_FALSE(regexLiterals("", &literals));
+  EXPECT_FALSE(regexLiterals("E1", &literals));
+  EXPECT_FALSE(regexLiterals("^E1", &literals));
+  EXPECT_FALSE(regexLiterals("^E.$", &literals));
+  EXPECT_FALSE(regexLiterals("^E1$|", &literals));
+  EXPECT_FALSE(regexLiterals("^E1$|E2", &literals));
+  EXPECT_FALSE(regexLiterals("^E\\d$", &literals));
+}
+
+
+
+/* ****************************************************************************
+*
+* regexPrefix -
+*/
+TEST(queryPlan, regexPrefix)
+{
+  std::string prefix;
+
+  EXPECT_TRUE(regexPrefix("^Room", &prefix));
+  EXPECT_EQ("Room", prefix);
+
+  EXPECT_TRUE(regexPrefix("^urn\\.Room.*", &prefix));
+  EXPECT_EQ("urn.Room", prefix);
+
+  EXPECT_FALSE(regexPrefix("^", &prefix));
+  EXPECT_FALSE(regexPrefix(".*", &prefix));
+  EXPECT_FALSE(regexPrefix("Room", &prefix));
+  EXPECT_FALSE(regexPrefix("^Room$", &prefix));
+  EXPECT_FALSE(regexPrefix("^Room.*1", &prefix));
+  EXPECT_FALSE(regexPrefix("^Room[12]", &prefix));
+}
+
+
+
+/* ****************************************************************************
+*
+* appendRegexFilter -
+*/
+TEST(queryPlan, appendRegexFilter)
+{
+  EXPECT_EQ("{ f: \"E1\" }", filter("^E1$"));
+  EXPECT_EQ("{ f: { $in: [ \"E1\", \"E2\" ] } }", filter("^E1$|^E2$"));
+  EXPECT_EQ("{ f: { $gte: \"Room\", $lt: \"Roon\" } }", filter("^Room.*"));
+  EXPECT_EQ("{ f: /^Room~/ }", filter("^Room~"));
+  EXPECT_EQ("{ f: /Room/ }", filter("Room"));
+}
+
+
+
+/* ****************************************************************************
+*
+* servicePathFilter -
+*/
+TEST(queryPlan, servicePathFilter)
+{
+  std::vector<std::string> servicePathV;
+
+  EXPECT_EQ("{ $in: [ /^//, null ] }", servicePathFilter(servicePathV).toString());
+
+  servicePathV.push_back("/");
+  EXPECT_EQ("{ $in: [ null, \"/\" ] }", servicePathFilter(servicePathV).toString());
+
+  servicePathV.clear();
+  servicePathV.push_back("/#");
+  EXPECT_EQ("{ $in: [ null, \"\", /^// ] }", servicePathFilter(servicePathV).toString());
+
+  servicePathV.clear();
+  servicePathV.push_back("/home/#");
+  servicePathV.push_back("/work");
+  EXPECT_EQ("{ $in: [ \"/home\", /^/home//, \"/work\" ] }", servicePathFilter(servicePathV).toString());
+}
@@ -0,0 +1,166 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "ngsi/ContextElementResponse.h"
+#include "ngsi10/NotifyContextRequest.h"
+#include "ngsiNotify/Notifier.h"
+#include "ngsiNotify/notifCoalesce.h"
+
+
+
+/* ****************************************************************************
+*
+* NotifierCapture - notifier keeping the subscription id and entities of each notification
+*/
+class NotifierCapture : public Notifier
+{
+ public:
+  std::vector<std::string>  subIdV;
+  std::vector<std::string>  urlV;
+  std::vector<std::string>  entitiesV;
+
+  void sendNotifyContextRequest(NotifyContextRequest* ncr, const std::string& url, const std::string& tenant, const std::string& xauthToken, Format format)
+  {
+    std::string entities;
+
+    for (unsigned int ix = 0; ix < ncr->contextElementResponseVector.size(); ++ix)
+    {
+      ContextElement* ceP = &ncr->contextElementResponseVector[ix]->contextElement;
+
+      entities += ceP->entityId.id + ":" + ceP->contextAttributeVector[0]->stringValue + " ";
+    }
+
+    subIdV.push_back(ncr->subscriptionId.get());
+    urlV.push_back(url);
+    entitiesV.push_back(entities);
+  }
+};
+
+
+
+/* ****************************************************************************
+*
+* notify - notify entity 'id' with attribute A1 set to 'value', for subscription 'subId'
+*/
+static void notify(NotifierCapture* notifierP, const std::string& subId, const std::string& id, const std::string& value)
+{
+  NotifyContextRequest    ncr;
+  ContextElementResponse* cerP = new ContextElementResponse();
+
+  cerP->contextElement.entityId.fill(id, "T", "false");
+  cerP->contextElement.contextAttributeVector.push_back(new ContextAttribute("A1", "Text", value));
+  cerP->statusCode.fill(SccOk);
+
+  ncr.subscriptionId.set(subId);
+  ncr.originator.set("localhost");
+  ncr.contextElementResponseVector.push_back(cerP);
+
+  if (!notifCoalesceAdd(notifierP, &ncr, "http://localhost:1028/" + subId, "", "", JSON))
+  {
+    notifierP->sendNotifyContextRequest(&ncr, "http://localhost:1028/" + subId, "", "", JSON);
+  }
+
+  ncr.release();
+}
+
+
+
+/* ****************************************************************************
+*
+* notifCoalesce_coalesce -
+*/
+TEST(notifCoalesce, coalesce)
+{
+  NotifierCapture notifier;
+
+  // Not coalescing: one notification per call
+  notify(&notifier, "S1", "E1", "a");
+  notify(&notifier, "S1", "E2", "b");
+  EXPECT_EQ(2, notifier.subIdV.size());
+  EXPECT_EQ(0, notifCoalesceFlush(&notifier, NULL));
+
+  notifier.subIdV.clear();
+  notifier.urlV.clear();
+  notifier.entitiesV.clear();
+
+  // Coalescing: one notification per subscription, the last value of each entity
+  notifCoalesceBegin();
+  notify(&notifier, "S1", "E1", "a");
+  notify(&notifier, "S2", "E1", "a");
+  notify(&notifier, "S1", "E2", "b");
+  notify(&notifier, "S1", "E1", "c");
+  EXPECT_EQ(0, notifier.subIdV.size());
+
+  std::vector<std::string> subIdV;
+
+  EXPECT_EQ(2, notifCoalesceFlush(&notifier, &subIdV));
+  ASSERT_EQ(2, notifier.subIdV.size());
+  ASSERT_EQ(2, subIdV.size());
+  EXPECT_EQ("S1", subIdV[0]);
+  EXPECT_EQ("S2", subIdV[1]);
+  EXPECT_EQ("S1", notifier.subIdV[0]);
+  EXPECT_EQ("http://localhost:1028/S1", notifier.urlV[0]);
+  EXPECT_EQ("E1:c E2:b ", notifier.entitiesV[0]);
+  EXPECT_EQ("S2", notifier.subIdV[1]);
+  EXPECT_EQ("E1:a ", notifier.entitiesV[1]);
+
+  // Flushed: no longer coalescing
+  notify(&notifier, "S1", "E1", "d");
+  EXPECT_EQ(3, notifier.subIdV.size());
+}
+
+
+
+/* ****************************************************************************
+*
+* notifCoalesce_maxEntities - a coalesced notification doesn't grow beyond NOTIF_COALESCE_MAX_ENTITIES
+*/
+TEST(notifCoalesce, maxEntities)
+{
+  NotifierCapture           notifier;
+  std::vector<std::string>  subIdV;
+
+  notifCoalesceBegin();
+  for (int ix = 0; ix < NOTIF_COALESCE_MAX_ENTITIES + 10; ++ix)
+  {
+    char id[32];
+
+    snprintf(id, sizeof(id), "E%d", ix);
+    notify(&notifier, "S1", id, "a");
+  }
+  EXPECT_EQ(1, notifier.subIdV.size());
+
+  notifCoalesceFlush(&notifier, &subIdV);
+  EXPECT_EQ(2, notifier.subIdV.size());
+
+  // Both notifications are reported, the one sent when the limit was reached too
+  ASSERT_EQ(2, subIdV.size());
+  EXPECT_EQ("S1", subIdV[0]);
+  EXPECT_EQ("S1", subIdV[1]);
+}
@@ -0,0 +1,93 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "ngsi/ContextElementResponse.h"
+#include "ngsi10/NotifyContextRequest.h"
+#include "ngsiNotify/notifPayloadCache.h"
+
+
+
+/* ****************************************************************************
+*
+* render - render the notification of the first 'attrs' attributes of 'baseP', as processSubscriptions does
+*/
+static std::string render(ContextElementResponse* baseP, const std::string& subId, unsigned int attrs, Format format)
+{
+  NotifyContextRequest    ncr;
+  ContextElementResponse  cer;
+
+  cer.contextElement.entityId.fill(&baseP->contextElement.entityId);
+  for (unsigned int ix = 0; ix < attrs; ++ix)
+  {
+    cer.contextElement.contextAttributeVector.push_back(baseP->contextElement.contextAttributeVector[ix]);
+  }
+  cer.statusCode.fill(SccOk);
+
+  ncr.subscriptionId.set(subId);
+  ncr.originator.set("localhost");
+  ncr.contextElementResponseVector.push_back(&cer);
+
+  return notifPayloadRender(&ncr, format);
+}
+
+
+
+/* ****************************************************************************
+*
+* notifPayloadCache_render -
+*/
+TEST(notifPayloadCache, render)
+{
+  ContextElementResponse base;
+
+  base.contextElement.entityId.fill("E1", "T", "false");
+  base.contextElement.contextAttributeVector.push_back(new ContextAttribute("A1", "Text", "a"));
+  base.contextElement.contextAttributeVector.push_back(new ContextAttribute("A2", "Text", "@@orionSubscriptionId@@"));
+
+  // Rendered without cache
+  std::string s1Json = render(&base, "51bf1e0ad6a8e8e1b4b9c1e0", 2, JSON);
+  std::string s2Json = render(&base, "51bf1e0ad6a8e8e1b4b9c1e1", 2, JSON);
+  std::string s3Json = render(&base, "51bf1e0ad6a8e8e1b4b9c1e2", 1, JSON);
+  std::string s4Xml  = render(&base, "51bf1e0ad6a8e8e1b4b9c1e3", 1, XML);
+  std::string s5Json = render(&base, "51bf1e0ad6a8e8e1b4b9c1e4", 1, JSON);
+
+  EXPECT_NE(std::string::npos, s2Json.find("51bf1e0ad6a8e8e1b4b9c1e1"));
+
+  // Rendered with cache: the same payloads (the second JSON one is spliced)
+  notifPayloadCacheBegin();
+  EXPECT_EQ(s3Json, render(&base, "51bf1e0ad6a8e8e1b4b9c1e2", 1, JSON));
+  EXPECT_EQ(s4Xml,  render(&base, "51bf1e0ad6a8e8e1b4b9c1e3", 1, XML));
+  EXPECT_EQ(s5Json, render(&base, "51bf1e0ad6a8e8e1b4b9c1e4", 1, JSON));
+
+  // A payload where the placeholder is found twice is not spliced
+  EXPECT_EQ(s1Json, render(&base, "51bf1e0ad6a8e8e1b4b9c1e0", 2, JSON));
+  EXPECT_EQ(s2Json, render(&base, "51bf1e0ad6a8e8e1b4b9c1e1", 2, JSON));
+  notifPayloadCacheEnd();
+
+  base.release();
+}
@@ -0,0 +1,315 @@
+/*
+*
+* Copyright 2016 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Orion dev team
+*/
+#include <stdio.h>
+#include <time.h>
+#include <strings.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "logMsg/logMsg.h"
+#include "common/string.h"
+#include "common/clockFunctions.h"
+#include "rest/RestService.h"
+#include "rest/RestRouter.h"
+
+
+
+/* ****************************************************************************
+*
+* treat - 
+*/
+static std::string treat(ConnectionInfo* ciP, int components, std::vector<std::string>& compV, ParseData* parseDataP)
+{
+  return "OK";
+}
+
+
+
+/* ****************************************************************************
+*
+* rs - a subset of the service vector of the broker, in the same order
+*/
+static RestService rs[] =
+{
+  { "GET",    EntryPointsRequest,          1, { "v2"                                                  }, "", treat },
+  { "*",      EntryPointsRequest,          1, { "v2"                                                  }, "", treat },
+  { "GET",    EntitiesRequest,             2, { "v2", "entities"                                      }, "", treat },
+  { "POST",   EntitiesRequest,             2, { "v2", "entities"                                      }, "", treat },
+  { "*",      EntitiesRequest,             2, { "v2", "entities"                                      }, "", treat },
+  { "GET",    EntityRequest,               3, { "v2", "entities", "*"                                 }, "", treat },
+  { "POST",   EntityRequest,               3, { "v2", "entities", "*"                                 }, "", treat },
+  { "PUT",    EntityRequest,               3, { "v2", "entities", "*"                                 }, "", treat },
+  { "DELETE", EntityRequest,               3, { "v2", "entities", "*"                                 }, "", treat },
+  { "PATCH",  EntityRequest,               3, { "v2", "entities", "*"                                 }, "", treat },
+  { "*",      EntityRequest,               3, { "v2", "entities", "*"                                 }, "", treat },
+  { "GET",    EntityAttributeValueRequest, 6, { "v2", "entities", "*", "attrs", "*", "value"          }, "", treat },
+  { "PUT",    EntityAttributeValueRequest, 6, { "v2", "entities", "*", "attrs", "*", "value"          }, "", treat },
+  { "*",      EntityAttributeValueRequest, 6, { "v2", "entities", "*", "attrs", "*", "value"          }, "", treat },
+  { "GET",    EntityAttributeRequest,      5, { "v2", "entities", "*", "attrs", "*"                   }, "", treat },
+  { "PUT",    EntityAttributeRequest,      5, { "v2", "entities", "*", "attrs", "*"                   }, "", treat },
+  { "DELETE", EntityAttributeRequest,      5, { "v2", "entities", "*", "attrs", "*"                   }, "", treat },
+  { "*",      EntityAttributeRequest,      5, { "v2", "entities", "*", "attrs", "*"                   }, "", treat },
+  { "GET",    EntityTypeRequest,           3, { "v2", "types", "*"                                    }, "", treat },
+  { "*",      EntityTypeRequest,           3, { "v2", "types", "*"                                    }, "", treat },
+  { "GET",    SubscriptionsRequest,        2, { "v2", "subscriptions"                                 }, "", treat },
+  { "POST",   SubscriptionsRequest,        2, { "v2", "subscriptions"                                 }, "", treat },
+  { "*",      SubscriptionsRequest,        2, { "v2", "subscriptions"                                 }, "", treat },
+  { "GET",    IndividualSubscriptionRequest, 3, { "v2", "subscriptions", "*"                          }, "", treat },
+  { "DELETE", IndividualSubscriptionRequest, 3, { "v2", "subscriptions", "*"                          }, "", treat },
+  { "*",      IndividualSubscriptionRequest, 3, { "v2", "subscriptions", "*"                          }, "", treat },
+  { "POST",   BatchUpdateRequest,          3, { "v2", "op", "update"                                  }, "", treat },
+  { "*",      BatchUpdateRequest,          3, { "v2", "op", "update"                                  }, "", treat },
+
+  { "POST",   RegisterContext,             2, { "ngsi9", "registerContext"                            }, "registerContextRequest", treat },
+  { "*",      RegisterContext,             2, { "ngsi9", "registerContext"                            }, "registerContextRequest", treat },
+  { "POST",   RegisterContext,             3, { "v1", "registry", "registerContext"                   }, "registerContextRequest", treat },
+  { "*",      RegisterContext,             3, { "v1", "registry", "registerContext"                   }, "registerContextRequest", treat },
+  { "POST",   UpdateContext,               2, { "ngsi10", "updateContext"                             }, "updateContextRequest", treat },
+  { "*",      UpdateContext,               2, { "ngsi10", "updateContext"                             }, "updateContextRequest", treat },
+  { "POST",   QueryContext,                2, { "ngsi10", "queryContext"                              }, "queryContextRequest",  treat },
+  { "*",      QueryContext,                2, { "ngsi10", "queryContext"                              }, "queryContextRequest",  treat },
+  { "POST",   UpdateContext,               2, { "v1", "updateContext"                                 }, "updateContextRequest", treat },
+  { "*",      UpdateContext,               2, { "v1", "updateContext"                                 }, "updateContextRequest", treat },
+  { "POST",   QueryContext,                2, { "v1", "queryContext"                                  }, "queryContextRequest",  treat },
+  { "*",      QueryContext,                2, { "v1", "queryContext"                                  }, "queryContextRequest",  treat },
+
+  { "GET",    IndividualContextEntity,     3, { "v1", "contextEntities", "*"                          }, "", treat },
+  { "PUT",    IndividualContextEntity,     3, { "v1", "contextEntities", "*"                          }, "updateContextElementRequest", treat },
+  { "POST",   IndividualContextEntity,     3, { "v1", "contextEntities", "*"                          }, "appendContextElementRequest", treat },
+  { "DELETE", IndividualContextEntity,     3, { "v1", "contextEntities", "*"                          }, "", treat },
+  { "*",      IndividualContextEntity,     3, { "v1", "contextEntities", "*"                          }, "", treat },
+  { "GET",    IndividualContextEntityAttribute, 5, { "v1", "contextEntities", "*", "attributes", "*"  }, "", treat },
+  { "*",      IndividualContextEntityAttribute, 5, { "v1", "contextEntities", "*", "attributes", "*"  }, "", treat },
+  { "GET",    AttributeValueInstance,      6, { "v1", "contextEntities", "*", "attributes", "*", "*"  }, "", treat },
+  { "*",      AttributeValueInstance,      6, { "v1", "contextEntities", "*", "attributes", "*", "*"  }, "", treat },
+  { "GET",    AllContextEntities,          2, { "v1", "contextEntities"                               }, "", treat },
+  { "*",      AllContextEntities,          2, { "v1", "contextEntities"                               }, "", treat },
+  { "GET",    AllEntitiesWithTypeAndId,    6, { "v1", "contextEntities", "type", "*", "id", "*"       }, "", treat },
+  { "*",      AllEntitiesWithTypeAndId,    6, { "v1", "contextEntities", "type", "*", "id", "*"       }, "", treat },
+
+  { "GET",    LogRequest,                  2, { "log", "trace"                                        }, "", treat },
+  { "GET",    StatisticsRequest,           1, { "statistics"                                          }, "", treat },
+  { "GET",    StatisticsRequest,           3, { "v1", "admin", "statistics"                           }, "", treat },
+  { "GET",    VersionRequest,              1, { "version"                                             }, "", treat },
+
+  { "*",      InvalidRequest,              2, { "ngsi9",  "*"                                         }, "", treat },
+  { "*",      InvalidRequest,              2, { "ngsi10", "*"                                         }, "", treat },
+  { "*",      InvalidRequest,              0, { "*", "*", "*", "*", "*", "*"                          }, "", treat },
+
+  { "",       InvalidRequest,              0, {                                                       }, "", NULL  }
+};
+
+
+
+/* ****************************************************************************
+*
+* linearLookup - the linear scan of the service vector that the trie must be equivalent to
+*/
+static int linearLookup(RestService* serviceV, const std::string& verb, const std::vector<std::string>& compV)
+{
+  int components = compV.size();
+
+  for (int ix = 0; serviceV[ix].treat != NULL; ++ix)
+  {
+    if ((serviceV[ix].components != 0) && (serviceV[ix].components != components))
+    {
+      continue;
+    }
+
+    if ((verb != serviceV[ix].verb) && (serviceV[ix].verb != "*"))
+    {
+      continue;
+    }
+
+    bool match = true;
+    for (int compNo = 0; compNo < components; ++compNo)
+    {
+      if (serviceV[ix].compV[compNo] == "*")
+      {
+        continue;
+      }
+
+      if (strcasecmp(serviceV[ix].compV[compNo].c_str(), compV[compNo].c_str()) != 0)
+      {
+        match = false;
+        break;
+      }
+    }
+
+    if (match == true)
+    {
+      return ix;
+    }
+  }
+
+  return -1;
+}
+
+
+
+/* ****************************************************************************
+*
+* requestV - a mix of v1 and v2 requests, including some bad verbs and unknown URLs
+*/
+static const char* requestV[][2] =
+{
+  { "GET",    "/v2/entities"                                   },
+  { "GET",    "/v2/entities/Room1"                             },
+  { "POST",   "/v2/entities/Room1"                             },
+  { "PATCH",  "/v2/entities/Room1"                             },
+  { "GET",    "/v2/entities/Room1/attrs/temperature"           },
+  { "PUT",    "/v2/entities/Room1/attrs/temperature/value"     },
+  { "POST",   "/v2/entities"                                   },
+  { "GET",    "/v2/types/Room"                                 },
+  { "GET",    "/v2/subscriptions/57458eb60962ef754e7c0998"     },
+  { "POST",   "/v2/op/update"                                  },
+  { "GET",    "/v2"                                            },
+  { "POST",   "/v1/updateContext"                              },
+  { "POST",   "/v1/queryContext"                               },
+  { "POST",   "/ngsi10/updateContext"                          },
+  { "POST",   "/ngsi10/queryContext"                           },
+  { "POST",   "/NGSI10/QueryContext"                           },
+  { "POST",   "/v1/registry/registerContext"                   },
+  { "POST",   "/ngsi9/registerContext"                         },
+  { "GET",    "/v1/contextEntities/Room1"                      },
+  { "PUT",    "/v1/contextEntities/Room1"                      },
+  { "GET",    "/v1/contextEntities/Room1/attributes/temp"      },
+  { "GET",    "/v1/contextEntities/Room1/attributes/temp/ID1"  },
+  { "GET",    "/v1/contextEntities/type/Room/id/Room1"         },
+  { "GET",    "/v1/contextEntities"                            },
+  { "GET",    "/statistics"                                    },
+  { "GET",    "/version"                                       },
+  { "DELETE", "/version"                                       },
+  { "PUT",    "/v2/op/update"                                  },
+  { "GET",    "/ngsi10/nada"                                   },
+  { "GET",    "/v3/entities"                                   },
+  { "GET",    "/a/b/c/d/e/f/g"                                 },
+  { "GET",    "/v2/entities//attrs/temperature"                }
+};
+
+
+
+/* ****************************************************************************
+*
+* lookup - 
+*/
+TEST(RestRouter, lookup)
+{
+  // Not compiled: the service vector is scanned
+  for (unsigned int ix = 0; ix < sizeof(requestV) / sizeof(requestV[0]); ++ix)
+  {
+    std::vector<std::string> compV;
+
+    stringSplit(requestV[ix][1], '/', compV);
+    EXPECT_EQ(linearLookup(rs, requestV[ix][0], compV), restRouterLookup(rs, requestV[ix][0], compV)) << requestV[ix][0] << " " << requestV[ix][1];
+  }
+
+  // Compiled: the trie is used
+  restRouterCompile(rs);
+
+  for (unsigned int ix = 0; ix < sizeof(requestV) / sizeof(requestV[0]); ++ix)
+  {
+    std::vector<std::string> compV;
+
+    stringSplit(requestV[ix][1], '/', compV);
+    EXPECT_EQ(linearLookup(rs, requestV[ix][0], compV), restRouterLookup(rs, requestV[ix][0], compV)) << requestV[ix][0] << " " << requestV[ix][1];
+  }
+
+  std::vector<std::string> compV;
+
+  stringSplit("/v2/entities/Room1/attrs/temperature", '/', compV);
+  EXPECT_EQ(14, restRouterLookup(rs, "GET", compV));
+  EXPECT_EQ(17, restRouterLookup(rs, "POST", compV));
+
+  compV.clear();
+  stringSplit("/a/b/c/d/e/f/g", '/', compV);
+  EXPECT_EQ(-1, restRouterLookup(rs, "GET", compV));
+
+  compV.clear();
+  stringSplit("/ngsi10/nada", '/', compV);
+  EXPECT_EQ(58, restRouterLookup(rs, "GET", compV));
+}
+
+
+
+/* ****************************************************************************
+*
+* benchmark -
+*
+* Micro-benchmark of restRouterLookup, routing the request mix above with the trie
+* and with a linear scan of the service vector. Only the timings are shown, the
+* results of both lookups are checked to be the same.
+*/
+TEST(RestRouter, benchmark)
+{
+  const int                              loops    = 20000;
+  unsigned int                           requests = sizeof(requestV) / sizeof(requestV[0]);
+  std::vector<std::vector<std::string> > compVV(requests);
+  struct timespec                        start;
+  struct timespec                        end;
+  struct timespec                        linearDiff;
+  struct timespec                        trieDiff;
+  int                                    sum      = 0;
+
+  for (unsigned int ix = 0; ix < requests; ++ix)
+  {
+    stringSplit(requestV[ix][1], '/', compVV[ix]);
+  }
+
+  restRouterCompile(rs);
+
+  clock_gettime(CLOCK_REALTIME, &start);
+  for (int loop = 0; loop < loops; ++loop)
+  {
+    for (unsigned int ix = 0; ix < requests; ++ix)
+    {
+      sum += linearLookup(rs, requestV[ix][0], compVV[ix]);
+    }
+  }
+  clock_gettime(CLOCK_REALTIME, &end);
+  clock_difftime(&end, &start, &linearDiff);
+
+  clock_gettime(CLOCK_REALTIME, &start);
+  for (int loop = 0; loop < loops; ++loop)
+  {
+    for (unsigned int ix = 0; ix < requests; ++ix)
+    {
+      sum -= restRouterLookup(rs, requestV[ix][0], compVV[ix]);
+    }
+  }
+  clock_gettime(CLOCK_REALTIME, &end);
+  clock_difftime(&end, &start, &trieDiff);
+
+  EXPECT_EQ(0, sum);
+
+  double linearUsecs = (linearDiff.tv_sec * 1000000.0 + linearDiff.tv_nsec / 1000.0) / (loops * requests);
+  double trieUsecs   = (trieDiff.tv_sec * 1000000.0 + trieDiff.tv_nsec / 1000.0) / (loops * requests);
+
+  LM_M(("restRouterLookup: %d lookups: linear scan %.3f microseconds, trie %.3f microseconds per lookup", loops * requests, linearUsecs, trieUsecs));
+  printf("restRouterLookup: %d lookups: linear scan %.3f microseconds, trie %.3f microseconds per lookup\n", loops * requests, linearUsecs, trieUsecs);
+}
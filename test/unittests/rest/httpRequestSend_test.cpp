@@ -0,0 +1,167 @@
+/*
+*
+* Copyright 2014 Telefonica Investigacion y Desarrollo, S.A.U
+*
+* This file is part of Orion Context Broker.
+*
+* Orion Context Broker is free software: you can redistribute it and/or
+* modify it under the terms of the GNU Affero General Public License as
+* published by the Free Software Foundation, either version 3 of the
+* License, or (at your option) any later version.
+*
+* Orion Context Broker is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero
+* General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with Orion Context Broker. If not, see http://www.gnu.org/licenses/.
+*
+* For those usages not covered by this license please contact with
+* iot_support at tid dot es
+*
+* Author: Ken Zangelin
+*/
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <string>
+#include <vector>
+
+#include "unittest.h"
+
+#include "rest/httpRequestSend.h"
+
+
+
+/* ****************************************************************************
+*
+* listenSocket - a socket listening on a free port of 127.0.0.1
+*/
+static int listenSocket(unsigned short* portP)
+{
+  struct sockaddr_in  sa;
+  socklen_t           saLen = sizeof(sa);
+  int                 fd    = socket(AF_INET, SOCK_STREAM, 0);
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family      = AF_INET;
+  sa.sin_addr.s_addr = inet_addr("127.0.0.1");
+  sa.sin_port        = 0;
+
+  bind(fd, (struct sockaddr*) &sa, sizeof(sa));
+  listen(fd, 16);
+  getsockname(fd, (struct sockaddr*) &sa, &saLen);
+
+  *portP = ntohs(sa.sin_port);
+
+  return fd;
+}
+
+
+
+/* ****************************************************************************
+*
+* server - answer 'connections' requests with "200 OK" and a payload, one at a time
+*/
+static int connections;
+
+static void* server(void* vP)
+{
+  int fd = *((int*) vP);
+
+  for (int ix = 0; ix < connections; ++ix)
+  {
+    int          cfd = accept(fd, NULL, NULL);
+    std::string  request;
+    char         buf[1024];
+    int          n;
+
+    while ((request.find("\r\n\r\n") == std::string::npos) && ((n = read(cfd, buf, sizeof(buf))) > 0))
+    {
+      request.append(buf, n);
+    }
+
+    const char* response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 13\r\nConnection: close\r\n\r\n{\"ok\":\"yes\"}\n";
+
+    if (write(cfd, response, strlen(response)) < 0)
+    {
+      break;
+    }
+
+    close(cfd);
+  }
+
+  return NULL;
+}
+
+
+
+/* ****************************************************************************
+*
+* requestCreate -
+*/
+static HttpRequest* requestCreate(unsigned short port)
+{
+  HttpRequest* reqP = new HttpRequest();
+
+  reqP->ip       = "127.0.0.1";
+  reqP->port     = port;
+  reqP->protocol = "http:";
+  reqP->verb     = "GET";
+  reqP->resource = "/v2/entities";
+  reqP->result   = 1;
+
+  return reqP;
+}
+
+
+
+/* ****************************************************************************
+*
+* sendMulti - requests to a server and to a closed port, at the same time
+*
+* The connection to the closed port is refused right away, typically in the first
+* curl_multi_perform, and the rest are done later on.
+*/
+TEST(httpRequestSend, sendMulti)
+{
+  unsigned short             port;
+  unsigned short             closedPort;
+  int                        fd       = listenSocket(&port);
+  int                        closedFd = listenSocket(&closedPort);
+  pthread_t                  tid;
+  std::vector<HttpRequest*>  requestV;
+
+  close(closedFd);  // connections to closedPort are refused right away
+
+  connections = 2;
+  pthread_create(&tid, NULL, server, &fd);
+
+  requestV.push_back(requestCreate(port));
+  requestV.push_back(requestCreate(closedPort));
+  requestV.push_back(requestCreate(port));
+  requestV.push_back(requestCreate(0));
+
+  httpRequestSendMulti(requestV, 5000);
+  pthread_join(tid, NULL);
+  close(fd);
+
+  EXPECT_EQ(0, requestV[0]->result);
+  EXPECT_NE(std::string::npos, requestV[0]->out.find("{\"ok\":\"yes\"}"));
+  EXPECT_EQ(-9, requestV[1]->result);
+  EXPECT_EQ("notification failure", requestV[1]->out);
+  EXPECT_EQ(0, requestV[2]->result);
+  EXPECT_NE(std::string::npos, requestV[2]->out.find("{\"ok\":\"yes\"}"));
+  EXPECT_EQ(-1, requestV[3]->result);  // port 0
+  EXPECT_EQ("error", requestV[3]->out);
+
+  for (unsigned int ix = 0; ix < requestV.size(); ++ix)
+  {
+    delete requestV[ix];
+  }
+}